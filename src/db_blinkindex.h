@@ -0,0 +1,852 @@
+/******************************************************************************
+ *  Copyright (c) 2014-2015 Jamis Hoo
+ *  Distributed under the MIT license
+ *  (See accompanying file LICENSE or copy at http://opensource.org/licenses/MIT)
+ *
+ *  Project: Database
+ *  Filename: db_blinkindex.h
+ *  Version: 1.0
+ *  Author: Jamis Hoo
+ *  E-mail: hjm211324@gmail.com
+ *  Description: Index of a table which can be searched and modified by threads.
+ *               Data structure: B-link tree (Lehman and Yao),
+ *               every node has a high key and a link to its right sibling.
+ *****************************************************************************/
+
+/****************************************
+ *  Structure of index file:
+ *      Page0:  file header of DBBuffer
+ *      Page1:  root page, number of records, data length, comparator type
+ *      Page2:  the first root node, a leaf
+ *      ...
+ *
+ *  Structure of each node:
+ *      Header: level, size, right sibling, has high key, high key and position
+ *      Data:   entries of key, position and child, in ascending order
+ *
+ *  Entries are ordered by key and then position, so all entries are distinct.
+ *  Position of a leaf entry is its record, child of an inner entry is
+ *  a node whose entries are not larger than the inner entry.
+ *  Entries of a node are not larger than its high key,
+ *  the rightmost node of each level has no high key,
+ *  and the last entry of a rightmost inner node is larger than everything.
+ *  Nodes are never merged or freed, removed entries leave nodes less filled.
+ *
+ *  Insertion and removal of an entry are logged by key for the transaction going on,
+ *  which undoes them by removing or inserting the entry again, since nodes may be split
+ *  by others meanwhile. Changes of nodes are logged by an action, which holds latches
+ *  of nodes it changed until it commits, see DBLog.
+ *******************************************************/
+
+#ifndef DB_BLINKINDEX_H_
+#define DB_BLINKINDEX_H_
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "db_common.h"
+#include "db_fields.h"
+#include "db_buffer.h"
+#include "db_log.h"
+
+// search, insert and remove can be called by multiple threads.
+// traversal state is kept in each call or cursor,
+// at most one node latch is held when going down or right,
+// splits latch a node and then its parent, so latches never form a cycle
+template<class Comparator>
+class Database::DBBLinkIndex {
+public:
+    // size of buffer for nodes, in Bytes
+    static constexpr uint64 BUFFER_SIZE = 2 * 1024 * 1024;
+    static constexpr uint64 META_PAGE = 1;
+    static constexpr uint64 FIRST_ROOT_PAGE = 2;
+
+    // changes of index are logged to log if it's not null,
+    // and nodes are kept for snapshots in versions if it's not null
+    DBBLinkIndex(const std::string& file, DBLog* log = nullptr, DBVersions* versions = nullptr):
+        _file(file, BUFFER_SIZE, log, versions), _log(log), _root(0), _root_level(0), _num_records(0), _next_page(0),
+        _data_length(0), _entry_size(0), _header_size(0), _max_entries(0) { }
+
+    ~DBBLinkIndex() {
+        if (isopen()) close();
+    }
+
+    DBBLinkIndex(const DBBLinkIndex&) = delete;
+    DBBLinkIndex& operator=(const DBBLinkIndex&) = delete;
+
+    // create index file, with an empty leaf as root
+    // index won't be opened after creating
+    // return 0 if create successfully, return 1 when error
+    bool create(const uint64 page_size, const uint64 data_length, const uint64 comp_type) {
+        std::unique_ptr<char[]> buffer(new char[page_size]);
+        memset(buffer.get(), 0x00, page_size);
+        // file header of DBFile, page size and number of pages
+        uint64 num_pages = 1;
+        memcpy(buffer.get(), &page_size, sizeof(uint64));
+        memcpy(buffer.get() + sizeof(uint64), &num_pages, sizeof(uint64));
+        if (_file.create(page_size, buffer.get())) return 1;
+        if (!_file.open()) return 1;
+
+        memset(buffer.get(), 0x00, page_size);
+        const uint64 meta[] = { FIRST_ROOT_PAGE, 0, data_length, comp_type };
+        memcpy(buffer.get(), meta, sizeof(meta));
+        _file.writePage(META_PAGE, buffer.get());
+
+        // an empty leaf, all of whose header fields are 0
+        memset(buffer.get(), 0x00, page_size);
+        _file.writePage(FIRST_ROOT_PAGE, buffer.get());
+
+        _file.close();
+        return 0;
+    }
+
+    // open index file, return number of pages if open successfully
+    // return 0 when error
+    uint64 open() {
+        if (isopen()) return _next_page;
+        const uint64 page_size = _file.open();
+        if (!page_size) return 0;
+        // buffer is needed to latch nodes
+        assert(BUFFER_SIZE >= page_size);
+
+        std::unique_ptr<char[]> buffer(new char[page_size]);
+        _file.readPage(META_PAGE, buffer.get());
+        uint64 meta[4];
+        memcpy(meta, buffer.get(), sizeof(meta));
+        _root = meta[0];
+        _num_records = meta[1];
+        _data_length = meta[2];
+        _comparator.type = meta[3];
+
+        _entry_size = _data_length + sizeof(uint64) * 2;
+        _header_size = sizeof(uint64) * 5 + _data_length;
+        _max_entries = (page_size - _header_size) / _entry_size;
+        // a node is split into two halves, each of which has 2 entries at least
+        assert(_max_entries >= 4);
+        _next_page = _file.numPages();
+        _root_level = Node::of(_file.fetchPage(_root, 0).data(), this).level();
+
+        return _next_page;
+    }
+
+    // write back meta data and all nodes
+    // return 0 if close successfully, return 1 when error
+    bool close() {
+        if (!isopen()) return 1;
+        saveMeta();
+        return _file.close();
+    }
+
+    // remove this index file
+    // returns 0 if succeed, 1 otherwise
+    bool remove() {
+        if (isopen()) close();
+        return _file.remove();
+    }
+
+    bool isopen() const { return _file.isopen(); }
+
+    const std::string& filename() const { return _file.filename(); }
+
+    uint64 getNumRecords() const { return _num_records; }
+
+    // length of keys
+    uint64 keyLength() const { return _data_length; }
+
+    // whether snapshot of calling thread, if any, can read this index,
+    // which it can't if entries not committed when it began are in it
+    bool readable() const { return _file.readable(); }
+
+    // count records in leaves, and save the number to meta page
+    // number saved is outdated after a crash, since it's saved only when root is split
+    // returns number of records
+    uint64 countRecords() {
+        uint64 page_id = _root;
+        DBBuffer::PageGuard page = _file.fetchPage(page_id, 0);
+        while (Node::of(page.data(), this).level()) {
+            page_id = Node::of(page.data(), this).child(0);
+            page.release();
+            page = _file.fetchPage(page_id, 0);
+        }
+        uint64 count = 0;
+        while (true) {
+            Node node = Node::of(page.data(), this);
+            count += node.size();
+            if (!node.right()) break;
+            page_id = node.right();
+            page.release();
+            page = _file.fetchPage(page_id, 0);
+        }
+        page.release();
+        _num_records = count;
+        saveMeta();
+        return count;
+    }
+
+    // return RID(0,0) if not found
+    RID searchRecord(const char* key) const {
+        RID rid(0, 0);
+        forEqual(key, [&rid](const char*, const RID r) {
+            rid = r;
+            return 0;
+        });
+        return rid;
+    }
+
+    // return an empty vector if not found
+    std::vector<RID> searchRecords(const char* key) const {
+        std::vector<RID> rids;
+        forEqual(key, [&rids](const char*, const RID r) {
+            rids.push_back(r);
+            return 1;
+        });
+        return rids;
+    }
+
+    // search for lower <= key < upper
+    // return an empty vector if not found
+    std::vector<RID> rangeQuery(const char* lower, const char* upper) const {
+        std::vector<RID> rids;
+        if (_comparator(lower, upper, _data_length) >= 0) return rids;
+        forEach(Target(lower, 0), [this, &rids, upper](const char* k, const RID r) {
+            if (_comparator(k, upper, _data_length) >= 0) return 0;
+            rids.push_back(r);
+            return 1;
+        });
+        return rids;
+    }
+
+    // insert a record into the btree
+    // return false if error
+    // ifPrimary: is this key a primary key(cannot insert twice)?
+    bool insertRecord(const char* key, const RID rid, const bool ifPrimary) {
+        // check and insert of primary keys are serialized
+        std::unique_lock<std::mutex> lock(_primary_mutex, std::defer_lock);
+        if (ifPrimary) {
+            lock.lock();
+            if (searchRecord(key) != RID(0, 0)) return false;
+        }
+
+        const Target target(key, encode(rid));
+        std::vector<uint64> path;
+        uint64 page_id;
+        DBBuffer::PageGuard page = findLeaf(target, 1, &path, page_id);
+        Node node = Node::of(page, this);
+        const uint64 pos = node.lowerBound(target);
+        // the entry already exists
+        if (pos < node.size() && node.compare(pos, target) == 0) return false;
+
+        logEntry(1, key, rid);
+        const uint64 txn = beginAction();
+        // nodes changed, latched until the action commits
+        std::vector<DBBuffer::PageGuard> changed;
+        if (node.size() < _max_entries) {
+            node.insert(pos, key, target.pos, 0);
+            page.markDirty();
+            changed.push_back(std::move(page));
+        } else {
+            split(page, page_id, target, &path, changed);
+        }
+        ++_num_records;
+        endAction(txn, changed);
+        return true;
+    }
+
+    // remove all records where index.key == key
+    // return true if success, else return false
+    bool removeRecords(const char* key) {
+        bool answer = false;
+        while (removeRecord(key)) answer = true;
+        return answer;
+    }
+
+    // remove the first record if index.key == key
+    // don't check the RID
+    bool removeRecord(const char* key) {
+        const RID rid = searchRecord(key);
+        return rid != RID(0, 0) && removeRecord(key, rid);
+    }
+
+    // remove only one record if index.key == key && index.rid == rid
+    bool removeRecord(const char* key, const RID rid) {
+        const Target target(key, encode(rid));
+        uint64 page_id;
+        DBBuffer::PageGuard page = findLeaf(target, 1, nullptr, page_id);
+        Node node = Node::of(page, this);
+        const uint64 pos = node.lowerBound(target);
+        if (pos == node.size() || node.compare(pos, target) != 0) return false;
+
+        logEntry(0, key, rid);
+        const uint64 txn = beginAction();
+        node.remove(pos);
+        page.markDirty();
+        --_num_records;
+        std::vector<DBBuffer::PageGuard> changed;
+        changed.push_back(std::move(page));
+        endAction(txn, changed);
+        return true;
+    }
+
+    // traverse all records
+    // callback function is like: void func(const char* key, const RID rid)
+    template<class CALLBACKFUNC>
+    void traverseRecords(CALLBACKFUNC func) const {
+        Cursor cursor = firstRecord();
+        traverseRecords(cursor, std::numeric_limits<uint64>::max(), func);
+    }
+
+    // position of an ordered traversal, which can be resumed later
+    // cursor remembers the last record traversed,
+    // so it keeps valid when the index is modified
+    class Cursor {
+        friend class DBBLinkIndex;
+        // key and position of the last record traversed
+        std::string _key;
+        uint64 _pos;
+        // leaf of the last record when traversing forward
+        uint64 _page;
+        // 0 if no record has been traversed
+        bool _started;
+        bool _end;
+        // 1 if records are traversed in descending order
+        bool _backward;
+    public:
+        Cursor(): _pos(0), _page(0), _started(0), _end(1), _backward(0) { }
+        // returns 1 if no more records
+        bool end() const { return _end; }
+    };
+
+    // get cursor pointing to the first record
+    Cursor firstRecord() const {
+        Cursor cursor;
+        cursor._end = 0;
+        return cursor;
+    }
+
+    // get cursor pointing to the last record,
+    // which traverses records in descending order
+    Cursor lastRecord() const {
+        Cursor cursor;
+        cursor._end = 0;
+        cursor._backward = 1;
+        return cursor;
+    }
+
+    // traverse at most n records from cursor in its order,
+    // and move cursor to the record after them
+    // callback function is like: void func(const char* key, const RID rid)
+    // func is called without any latch held
+    // returns number of records traversed
+    template<class CALLBACKFUNC>
+    uint64 traverseRecords(Cursor& cursor, const uint64 n, CALLBACKFUNC func) const {
+        uint64 count = 0;
+        std::vector<char> entries;
+        while (!cursor._end && count < n) {
+            entries.clear();
+            if (cursor._backward)
+                collectBackward(cursor, n - count, entries);
+            else
+                collectForward(cursor, n - count, entries);
+
+            for (uint64 i = 0; i < entries.size(); i += _entry_size) {
+                uint64 pos;
+                memcpy(&pos, entries.data() + i + _data_length, sizeof(uint64));
+                func(entries.data() + i, decode(pos));
+                ++count;
+            }
+            if (!entries.empty()) {
+                const char* last = entries.data() + entries.size() - _entry_size;
+                cursor._key.assign(last, _data_length);
+                memcpy(&cursor._pos, last + _data_length, sizeof(uint64));
+                cursor._started = 1;
+            }
+        }
+        return count;
+    }
+
+private:
+    // key and position to search for
+    struct Target {
+        const char* key;
+        uint64 pos;
+        // smaller or larger than all entries if key is null
+        bool larger;
+        Target(const char* k, const uint64 p, const bool l = 0): key(k), pos(p), larger(l) { }
+    };
+
+    // view of a node in a page
+    struct Node {
+        char* data;
+        const DBBLinkIndex* index;
+        // page latched exclusively, to log entries moved, null if read only
+        DBBuffer::PageGuard* page;
+
+        static Node of(const char* data, const DBBLinkIndex* index) {
+            return Node{ const_cast<char*>(data), index, nullptr };
+        }
+        static Node of(DBBuffer::PageGuard& page, const DBBLinkIndex* index) {
+            return Node{ page.mutableData(), index, &page };
+        }
+
+        uint64 field(const uint64 i) const {
+            uint64 value;
+            memcpy(&value, data + sizeof(uint64) * i, sizeof(uint64));
+            return value;
+        }
+        void setField(const uint64 i, const uint64 value) {
+            memcpy(data + sizeof(uint64) * i, &value, sizeof(uint64));
+        }
+
+        // leaf is level 0
+        uint64 level() const { return field(0); }
+        uint64 size() const { return field(1); }
+        uint64 right() const { return field(2); }
+        bool hasHigh() const { return field(3); }
+        uint64 highPos() const { return field(4); }
+        const char* highKey() const { return data + sizeof(uint64) * 5; }
+
+        char* entry(const uint64 i) const { return data + index->_header_size + index->_entry_size * i; }
+        const char* key(const uint64 i) const { return entry(i); }
+        uint64 pos(const uint64 i) const {
+            uint64 p;
+            memcpy(&p, entry(i) + index->_data_length, sizeof(uint64));
+            return p;
+        }
+        uint64 child(const uint64 i) const {
+            uint64 c;
+            memcpy(&c, entry(i) + index->_data_length + sizeof(uint64), sizeof(uint64));
+            return c;
+        }
+        void setChild(const uint64 i, const uint64 c) {
+            memcpy(entry(i) + index->_data_length + sizeof(uint64), &c, sizeof(uint64));
+        }
+
+        // compare entry i with target
+        int compare(const uint64 i, const Target& target) const {
+            if (level() && !hasHigh() && i + 1 == size()) return 1;
+            return index->compare(key(i), pos(i), target);
+        }
+        // returns 1 if target is larger than high key, i.e. in right siblings
+        bool beyond(const Target& target) const {
+            return hasHigh() && index->compare(highKey(), highPos(), target) < 0;
+        }
+        // the first entry not smaller than target
+        uint64 lowerBound(const Target& target) const {
+            uint64 low = 0, high = size();
+            while (low < high) {
+                uint64 mid = (low + high) / 2;
+                if (compare(mid, target) < 0) low = mid + 1;
+                else high = mid;
+            }
+            return low;
+        }
+        // child of inner node where target is
+        uint64 childOf(const Target& target) const {
+            return child(std::min(lowerBound(target), size() - 1));
+        }
+
+        void insert(const uint64 i, const char* k, const uint64 p, const uint64 c) {
+            move(entry(i + 1), entry(i), index->_entry_size * (size() - i));
+            memcpy(entry(i), k, index->_data_length);
+            memcpy(entry(i) + index->_data_length, &p, sizeof(uint64));
+            setChild(i, c);
+            setField(1, size() + 1);
+        }
+        void remove(const uint64 i) {
+            move(entry(i), entry(i + 1), index->_entry_size * (size() - i - 1));
+            setField(1, size() - 1);
+        }
+        void move(char* destination, const char* source, const uint64 length) {
+            if (page) 
+                page->move(destination, source, length);
+            else
+                memmove(destination, source, length);
+        }
+        void setHigh(const char* k, const uint64 p) {
+            setField(3, 1);
+            setField(4, p);
+            memcpy(data + sizeof(uint64) * 5, k, index->_data_length);
+        }
+    };
+
+    // compare key and position with target
+    int compare(const char* key, const uint64 pos, const Target& target) const {
+        if (!target.key) return target.larger? -1: 1;
+        int comp_result = _comparator(key, target.key, _data_length);
+        if (comp_result) return comp_result;
+        return pos < target.pos? -1: pos > target.pos;
+    }
+
+    // go down from root to the leaf where target is, and latch it
+    // leaf is latched exclusively if exclusive is 1, inner nodes are latched shared
+    // inner nodes passed by are pushed into path if it's not null
+    DBBuffer::PageGuard findLeaf(const Target& target, const bool exclusive,
+                                 std::vector<uint64>* path, uint64& page_id) const {
+        page_id = root();
+        DBBuffer::PageGuard page = _file.fetchPage(page_id, 0);
+        // root is a leaf, latch it again in the right mode, levels never change
+        if (exclusive && Node::of(page.data(), this).level() == 0) {
+            page.release();
+            page = _file.fetchPage(page_id, 1);
+        }
+        while (true) {
+            Node node = Node::of(page.data(), this);
+            uint64 next;
+            bool next_exclusive = exclusive && node.level() <= 1;
+            if (node.beyond(target)) {
+                next = node.right();
+                next_exclusive = exclusive && node.level() == 0;
+            } else if (node.level() == 0) {
+                return page;
+            } else {
+                if (path) path->push_back(page_id);
+                next = node.childOf(target);
+            }
+            // never wait for a latch with another one held when going down
+            page.release();
+            page_id = next;
+            page = _file.fetchPage(page_id, next_exclusive);
+        }
+    }
+
+    // latch the node at level where target is, starting from page_id,
+    // or from root if page_id is 0
+    // root split at level - 1 may be not above it yet, which is waited for
+    DBBuffer::PageGuard findNode(const Target& target, const uint64 level, uint64& page_id) {
+        if (!page_id) {
+            {
+                std::unique_lock<std::mutex> lock(_root_mutex);
+                _root_raised.wait(lock, [this, level]() { return _root_level >= level; });
+                page_id = _root;
+            }
+            DBBuffer::PageGuard page = _file.fetchPage(page_id, 0);
+            while (Node::of(page.data(), this).level() > level) {
+                Node node = Node::of(page.data(), this);
+                const uint64 next = node.beyond(target)? node.right(): node.childOf(target);
+                page.release();
+                page_id = next;
+                page = _file.fetchPage(page_id, 0);
+            }
+        }
+        DBBuffer::PageGuard page = _file.fetchPage(page_id, 1);
+        assert(Node::of(page.data(), this).level() == level);
+        while (Node::of(page.data(), this).beyond(target)) {
+            page_id = Node::of(page.data(), this).right();
+            page.release();
+            page = _file.fetchPage(page_id, 1);
+        }
+        return page;
+    }
+
+    uint64 newPage() {
+        return _next_page++;
+    }
+
+    // root to go down from, which is the one saved in meta page if reading a snapshot,
+    // since nodes split after snapshot began are not seen by it
+    uint64 root() const {
+        if (!_file.inSnapshot()) return _root;
+        DBBuffer::PageGuard page = _file.fetchPage(META_PAGE, 0);
+        uint64 root;
+        memcpy(&root, page.data(), sizeof(root));
+        return root;
+    }
+
+    // write root, number of records and key description to meta page
+    // called when root changes, so a logged index finds its root after a crash
+    void saveMeta() {
+        DBBuffer::PageGuard page = _file.fetchPage(META_PAGE, 1);
+        const uint64 meta[] = { _root, _num_records, _data_length, _comparator.type };
+        memcpy(page.mutableData(), meta, sizeof(meta));
+        page.markDirty();
+    }
+
+    // log insertion or removal of entry for the transaction going on, if any
+    void logEntry(const bool insert, const char* key, const RID rid) {
+        if (_log && _log->transaction()) 
+            _log->logIndex(_file.filename(), insert, key, _data_length, rid);
+    }
+
+    // begin action of changes of nodes, see DBLog::beginAction()
+    uint64 beginAction() {
+        return _log? _log->beginAction(): 0;
+    }
+
+    // log changes of nodes latched by pages and commit action begun with txn,
+    // pages are unlatched after that
+    void endAction(const uint64 txn, std::vector<DBBuffer::PageGuard>& pages) {
+        if (!_log) return;
+        for (auto& page: pages) page.log();
+        _log->endAction(txn);
+    }
+
+    // insert target with child into full node latched by page, which is split
+    // the high key of the new left half is then inserted into parent,
+    // nodes changed are moved into changed, latched until the action commits
+    void split(DBBuffer::PageGuard& page, const uint64 page_id, const Target& target,
+               std::vector<uint64>* path, std::vector<DBBuffer::PageGuard>& changed,
+               const uint64 child = 0) {
+        Node left = Node::of(page, this);
+        const uint64 level = left.level();
+        const uint64 right_id = newPage();
+        DBBuffer::PageGuard right_page = _file.fetchPage(right_id, 1, 0);
+        Node right = Node::of(right_page, this);
+        memset(right.data, 0x00, _header_size);
+
+        // upper half is moved to right node, which takes the old high key and link
+        const uint64 half = left.size() / 2;
+        right.setField(0, level);
+        right.setField(1, left.size() - half);
+        right.setField(2, left.right());
+        if (left.hasHigh()) right.setHigh(left.highKey(), left.highPos());
+        memcpy(right.entry(0), left.entry(half), _entry_size * (left.size() - half));
+        left.setField(1, half);
+        left.setField(2, right_id);
+        left.setHigh(left.key(half - 1), left.pos(half - 1));
+
+        if (left.beyond(target))
+            right.insert(right.lowerBound(target), target.key, target.pos, child);
+        else
+            left.insert(left.lowerBound(target), target.key, target.pos, child);
+        right_page.markDirty();
+        page.markDirty();
+        changed.push_back(std::move(right_page));
+
+        // separator in parent, the high key of left node
+        std::string separator(left.highKey(), _data_length);
+        const Target high(separator.data(), left.highPos());
+
+        // a new root above the old one
+        std::unique_lock<std::mutex> lock(_root_mutex);
+        if (_root == page_id) {
+            const uint64 root_id = newPage();
+            DBBuffer::PageGuard root_page = _file.fetchPage(root_id, 1, 0);
+            Node root = Node::of(root_page, this);
+            memset(root.data, 0x00, _header_size);
+            root.setField(0, level + 1);
+            root.insert(0, high.key, high.pos, page_id);
+            // the last entry of the rightmost node is larger than everything
+            root.insert(1, high.key, high.pos, right_id);
+            root_page.markDirty();
+            _root = root_id;
+            _root_level = level + 1;
+            saveMeta();
+            lock.unlock();
+            _root_raised.notify_all();
+            changed.push_back(std::move(page));
+            changed.push_back(std::move(root_page));
+            return;
+        }
+        lock.unlock();
+
+        // parent may be found from path, or from root if the old root is split
+        uint64 parent_id = 0;
+        if (path && !path->empty()) {
+            parent_id = path->back();
+            path->pop_back();
+        }
+        DBBuffer::PageGuard parent_page = findNode(high, level + 1, parent_id);
+        changed.push_back(std::move(page));
+
+        // entry to left node now points to right node,
+        // and the separator of left node is inserted before it
+        while (true) {
+            Node parent = Node::of(parent_page, this);
+            uint64 i = parent.lowerBound(high);
+            for (; i < parent.size() && parent.child(i) != page_id; ++i) { }
+            if (i < parent.size()) {
+                parent.setChild(i, right_id);
+                if (parent.size() < _max_entries) {
+                    parent.insert(i, high.key, high.pos, page_id);
+                    parent_page.markDirty();
+                    changed.push_back(std::move(parent_page));
+                } else {
+                    parent_page.markDirty();
+                    split(parent_page, parent_id, high, path, changed, page_id);
+                }
+                return;
+            }
+            // entry may be moved right by a split of parent
+            assert(parent.right());
+            parent_id = parent.right();
+            parent_page.release();
+            parent_page = _file.fetchPage(parent_id, 1);
+        }
+    }
+
+    // call func(key, rid) for entries not smaller than target in order,
+    // until func returns 0 or there's no more entry
+    template<class FUNC>
+    void forEach(const Target& target, FUNC func) const {
+        uint64 page_id;
+        DBBuffer::PageGuard page = findLeaf(target, 0, nullptr, page_id);
+        std::vector<char> entries;
+        while (true) {
+            Node node = Node::of(page.data(), this);
+            const uint64 pos = node.lowerBound(target);
+            entries.assign(node.entry(pos), node.entry(node.size()));
+            const uint64 right = node.right();
+            page.release();
+            for (uint64 i = 0; i < entries.size(); i += _entry_size) {
+                uint64 v;
+                memcpy(&v, entries.data() + i + _data_length, sizeof(uint64));
+                if (!func(entries.data() + i, decode(v))) return;
+            }
+            if (!right) return;
+            page_id = right;
+            page = _file.fetchPage(page_id, 0);
+        }
+    }
+
+    // call func(key, rid) for entries with key in order, until func returns 0
+    template<class FUNC>
+    void forEqual(const char* key, FUNC func) const {
+        forEach(Target(key, 0), [this, key, &func](const char* k, const RID r) {
+            return _comparator(k, key, _data_length) == 0 && func(k, r);
+        });
+    }
+
+    // copy at most n entries after cursor in ascending order
+    void collectForward(Cursor& cursor, const uint64 n, std::vector<char>& entries) const {
+        const Target target(cursor._key.data(), cursor._pos);
+        uint64 page_id = cursor._page;
+        DBBuffer::PageGuard page;
+        if (cursor._started) {
+            page = _file.fetchPage(page_id, 0);
+        } else {
+            // the leftmost leaf
+            page_id = root();
+            page = _file.fetchPage(page_id, 0);
+            while (Node::of(page.data(), this).level()) {
+                page_id = Node::of(page.data(), this).child(0);
+                page.release();
+                page = _file.fetchPage(page_id, 0);
+            }
+        }
+        while (true) {
+            Node node = Node::of(page.data(), this);
+            uint64 pos = cursor._started? node.lowerBound(target): 0;
+            // skip the last record traversed
+            if (cursor._started && pos < node.size() && node.compare(pos, target) == 0) ++pos;
+            const uint64 end = pos + std::min(node.size() - pos, n);
+            if (pos < end) {
+                entries.assign(node.entry(pos), node.entry(end));
+                cursor._page = page_id;
+                return;
+            }
+            if (!node.right()) {
+                cursor._end = 1;
+                return;
+            }
+            page_id = node.right();
+            page.release();
+            page = _file.fetchPage(page_id, 0);
+        }
+    }
+
+    // copy at most n entries before cursor in descending order
+    void collectBackward(Cursor& cursor, const uint64 n, std::vector<char>& entries) const {
+        const Target target(cursor._started? cursor._key.data(): nullptr, cursor._pos, 1);
+        uint64 page_id = lastLess(root(), target);
+        if (!page_id) {
+            cursor._end = 1;
+            return;
+        }
+        // the leaf may be split meanwhile, entries smaller than target
+        // are collected from it and its right siblings in ascending order
+        std::vector<char> ascending;
+        DBBuffer::PageGuard page = _file.fetchPage(page_id, 0);
+        while (true) {
+            Node node = Node::of(page.data(), this);
+            ascending.insert(ascending.end(), node.entry(0), node.entry(node.lowerBound(target)));
+            if (!node.beyond(target)) break;
+            page_id = node.right();
+            page.release();
+            page = _file.fetchPage(page_id, 0);
+        }
+        page.release();
+
+        const uint64 num = std::min(n, ascending.size() / _entry_size);
+        for (uint64 i = 0; i < num; ++i) {
+            const char* entry = ascending.data() + ascending.size() - (i + 1) * _entry_size;
+            entries.insert(entries.end(), entry, entry + _entry_size);
+        }
+    }
+
+    // find the leaf with the largest entry smaller than target,
+    // in subtree of page_id and its right siblings
+    // returns 0 if there's none
+    uint64 lastLess(uint64 page_id, const Target& target) const {
+        // children or leaves which may have entries smaller than target, in order
+        std::vector<uint64> candidates;
+        DBBuffer::PageGuard page = _file.fetchPage(page_id, 0);
+        bool leaf;
+        while (true) {
+            Node node = Node::of(page.data(), this);
+            leaf = node.level() == 0;
+            if (leaf && node.size() && node.compare(0, target) < 0)
+                candidates.push_back(page_id);
+            // a child has entries smaller than target if the entry before it is smaller
+            for (uint64 i = 0; !leaf && i < node.size() && (i == 0 || node.compare(i - 1, target) < 0); ++i)
+                candidates.push_back(node.child(i));
+            if (!node.beyond(target)) break;
+            page_id = node.right();
+            page.release();
+            page = _file.fetchPage(page_id, 0);
+        }
+        page.release();
+
+        if (leaf) return candidates.empty()? 0: candidates.back();
+        // children near target first, children without entries are skipped
+        for (auto ite = candidates.rbegin(); ite != candidates.rend(); ++ite)
+            if (uint64 leaf_id = lastLess(*ite, target)) return leaf_id;
+        return 0;
+    }
+
+    // change pageID and  slotID to a uint64
+    inline static uint64 encode(RID rid) {
+        return (rid.pageID << 32) + rid.slotID;
+    }
+
+    // change uint64 to pageID and slotID
+    inline static RID decode(uint64 position) {
+        return RID(position >> 32, (position << 32) >> 32);
+    }
+
+    mutable DBBuffer _file;
+    DBLog* _log;
+    // root page, changed only if root is split
+    std::atomic<uint64> _root;
+    // level of root, guarded by _root_mutex
+    uint64 _root_level;
+    std::mutex _root_mutex;
+    // notified when a new root is installed
+    std::condition_variable _root_raised;
+    // serializes checking and inserting of primary keys
+    std::mutex _primary_mutex;
+    std::atomic<uint64> _num_records;
+    // next page to allocate
+    std::atomic<uint64> _next_page;
+
+    uint64 _data_length;
+    uint64 _entry_size;
+    uint64 _header_size;
+    // max entries in a node
+    uint64 _max_entries;
+    Comparator _comparator;
+};
+
+template<class Comparator>
+constexpr Database::uint64 Database::DBBLinkIndex<Comparator>::BUFFER_SIZE;
+template<class Comparator>
+constexpr Database::uint64 Database::DBBLinkIndex<Comparator>::META_PAGE;
+template<class Comparator>
+constexpr Database::uint64 Database::DBBLinkIndex<Comparator>::FIRST_ROOT_PAGE;
+
+#endif /* DB_BLINKINDEX_H_ */
@@ -12,111 +12,180 @@
  *  Time: 15:04:35
  *  Description: Fixed sized data buffer.
                  Read pages from disk, write pages back to disk.
+                 Pages can be read and written by multiple threads,
+                 page table is sharded, frames are pinned and latched,
+                 and replaced with CLOCK algorithm, clean frames first.
+                 A dirty page replaced is written back with no shard locked.
+                 Pages can be prefetched, which are read by I/O threads.
+                 A frame being loaded is marked, and others finding it wait until it's loaded.
+                 Changes of pages are logged if a log is given,
+                 and a page is written back only after its log records are flushed.
+                 The first change of a page not dirty logs a checksum of it,
+                 from which recovery finds where to redo the page.
+                 Pages are copied before changed if snapshots may read them,
+                 and read from copies by threads reading snapshots.
  *****************************************************************************/
 #ifndef DB_BUFFER_H_
 #define DB_BUFFER_H_
 
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <cstring>
-#include <list>
-#include <map>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/thread/shared_mutex.hpp>
 #include "db_common.h"
 #include "db_file.h"
+#include "db_ioqueue.h"
+#include "db_log.h"
+#include "db_versions.h"
 
 class Database::DBBuffer {
 private:
-    class LRU {
+    // a buffer page
+    struct Frame {
+        // page in this frame, NO_PAGE if frame is unused
+        std::atomic<uint64> page_id;
+        // number of users of this frame, a pinned frame is never replaced
+        std::atomic<uint64> pin_count;
+        // set when visited, cleared when clock hand passes
+        std::atomic<bool> referenced;
+        std::atomic<bool> dirty;
+        // LSN of the last log record changing this page, 0 if none
+        std::atomic<uint64> lsn;
+        // changes logged from this LSN may be not on disk, 0 if none
+        std::atomic<uint64> rec_lsn;
+        // set while page is read in, or old page is written back, by the thread taking the frame
+        std::atomic<bool> loading;
+        // shared when reading data, exclusive when writing data
+        boost::shared_mutex latch;
+        Frame(): page_id(NO_PAGE), pin_count(0), referenced(0), dirty(0), lsn(0), rec_lsn(0),
+                 loading(0) { }
+    };
+
+    // part of page table, page i is in shard i % NUM_SHARDS
+    struct Shard {
+        std::mutex mutex;
+        // page ID -> frame ID
+        std::unordered_map<uint64, uint64> frames;
+        // pages replaced and being written back -> LSN from which they are logged,
+        // which are read from disk only after written
+        std::unordered_map<uint64, uint64> writing;
+        std::condition_variable written;
+    };
+
+public:
+    static constexpr uint64 NO_PAGE = std::numeric_limits<uint64>::max();
+    static constexpr uint64 NUM_SHARDS = 16;
+    // changed bytes of a page closer than this are logged in one record
+    static constexpr uint64 LOG_GAP = 32;
+    // dirty frames the clock passes by at most, looking for a clean one to replace
+    static constexpr uint64 DIRTY_SKIP = 8;
+
+    // a pinned and latched page, unlatched and unpinned when destructed
+    class PageGuard {
     public:
-        LRU(const uint64 maxsize): _unused_buffer(0), _max_size(maxsize) {
-            assert(maxsize);
+        // guard of no page
+        PageGuard(): _buffer(nullptr), _frame_id(0), _exclusive(0), _version(nullptr), _saved(0) { }
+        PageGuard(PageGuard&& other): 
+            _buffer(other._buffer), _frame_id(other._frame_id), _exclusive(other._exclusive),
+            _before(std::move(other._before)), _version(other._version), _saved(other._saved) {
+            other._buffer = nullptr;
+        }
+        ~PageGuard() { release(); }
+        PageGuard& operator=(PageGuard&& other) {
+            if (this == &other) return *this;
+            release();
+            _buffer = other._buffer;
+            _frame_id = other._frame_id;
+            _exclusive = other._exclusive;
+            _before = std::move(other._before);
+            _version = other._version;
+            _saved = other._saved;
+            other._buffer = nullptr;
+            return *this;
+        }
+        PageGuard(const PageGuard&) = delete;
+        PageGuard& operator=(const PageGuard&) = delete;
+
+        // unlatch and unpin page before destruction
+        // changes are logged when released
+        void release() {
+            if (!_buffer) return;
+            if (_before) _buffer->logFrame(_frame_id, _before.get());
+            _buffer->release(_frame_id, _exclusive);
+            _buffer = nullptr;
+            _before.reset();
         }
 
-        // visit pageID, return bufferID
-        // if a dirty LRU page is moved out of buffer, 
-        // callback(pageid, bufferid) will be called
-        template <class CALLBACK>
-        uint64 find(const uint64 pageID, CALLBACK callback, bool* pagemiss = nullptr) {
-            auto ite = _map.find(pageID);
-            // page miss
-            if (ite == _map.end()) {
-                if (pagemiss) *pagemiss = 1;
-                uint64 bufferID;
-
-                // buffer not yet full
-                if (_unused_buffer < _max_size) {
-                    bufferID = _unused_buffer++;
-                } else {
-                // buffer is already full
-                // move the LRU page out of buffer
-                    uint64 oldPageID = std::get<0>(*_stack.begin());
-                    bufferID = std::get<1>(*_stack.begin());
-
-                    // page is dirty
-                    if (std::get<2>(*_stack.begin()))
-                        callback(oldPageID, bufferID);
-                    
-                    // remove from stack and hash map
-                    assert(_map.erase(oldPageID) == 1);
-
-                    _stack.pop_front();
-                }
-                _map[pageID] = _stack.insert(_stack.end(), 
-                                             std::make_tuple(pageID, bufferID, 0));
-                return bufferID;
+        // page as seen by snapshot of calling thread, if any
+        const char* data() const { return _version? _version: _buffer->frameData(_frame_id); }
+        // only if latched exclusively
+        // page is copied on first call if logged, to find changes when released,
+        // and saved for snapshots
+        char* mutableData() { 
+            assert(_exclusive);
+            if (!_saved) {
+                _buffer->saveVersion(_frame_id);
+                _saved = 1;
             }
-            // else, page hit
-            uint64 bufferID = std::get<1>(*(ite->second));
-            // move to list end
-            auto node = *(ite->second);
-            _stack.erase(ite->second);
-            // ite->second = _stack.insert(_stack.end(), node);
-            _map[pageID] = _stack.insert(_stack.end(), node);
-            return bufferID;
+            if (_buffer->_log && !_before) {
+                _before.reset(new char[_buffer->pageSize()]);
+                memcpy(_before.get(), _buffer->frameData(_frame_id), _buffer->pageSize());
+            }
+            return _buffer->frameData(_frame_id); 
+        }
+        void markDirty() {
+            assert(_exclusive);
+            _buffer->_frames[_frame_id].dirty = 1;
         }
 
-        // mark page as dirty
-        void markDirty(const uint64 pageID) {
-            auto ite = _map.find(pageID);
-            assert(ite != _map.end());
-            std::get<2>(*(ite->second)) = 1;
+        // log changes made so far, and keep page latched,
+        // so an action commits before its pages are unlatched
+        void log() {
+            if (!_before) return;
+            _buffer->logFrame(_frame_id, _before.get());
+            memcpy(_before.get(), _buffer->frameData(_frame_id), _buffer->pageSize());
         }
-        
-        // traverse all dirty pages
-        // dirty flag will be cleaned after callback returns
-        // callback(pageID, bufferID)
-        template <class CALLBACK>
-        void traverseDirtyBuffer(CALLBACK callback) {
-            for (const auto& node: _map)
-                if (std::get<2>(*node.second) == 1) {
-                    callback(std::get<0>(*node.second), std::get<1>(*node.second));
-                    std::get<2>(*node.second) = 0;
-                }
+
+        // memmove inside page, which is logged as one record
+        // rather than all bytes moved
+        void move(char* destination, const char* source, const uint64 length) {
+            char* data = mutableData();
+            if (_before && destination != source && length) 
+                _buffer->logMove(_frame_id, _before.get(), destination - data, source - data, length);
+            memmove(destination, source, length);
         }
 
-    private: 
-        // <page ID, buffer page ID, dirty>
-        // 1 means dirty
-        // simulate a non-duplicate stack with a list
-        // _stack.front() is least recently used, _stack.back() is most recently used
-        std::list< std::tuple<uint64, uint64, bool> > _stack;
-        // <page ID, _stack iterator>
-        std::unordered_map<uint64, std::list< std::tuple<uint64, uint64, bool> >::iterator> _map;
-        // std::map<uint64, std::list< std::tuple<uint64, uint64, bool> >::iterator> _map;
-        // buffer pages with ID >= _unused_buffer have not been used
-        // when _unused_buffer == _max_size; all buffer pages have been used
-        uint64 _unused_buffer;
-        // max size of buffer, range of bufferID is [0, _max_size)
-        uint64 _max_size;
-        
+    private:
+        friend class DBBuffer;
+        PageGuard(DBBuffer* buffer, const uint64 frame_id, const bool exclusive, const char* version):
+            _buffer(buffer), _frame_id(frame_id), _exclusive(exclusive), _version(version), _saved(0) { }
+
+        DBBuffer* _buffer;
+        uint64 _frame_id;
+        bool _exclusive;
+        // page before changed, if logged
+        std::unique_ptr<char[]> _before;
+        // copy of page read by snapshot, nullptr if frame is read
+        const char* _version;
+        // whether page is saved for snapshots before changed
+        bool _saved;
     };
 
-
-public:
-    DBBuffer(const std::string& filename, const uint64 buffer_size): 
-        _file(filename), _lru(nullptr),
+    // changes of pages are logged to log if it's not null,
+    // and pages are saved to versions before changed if it's not null
+    DBBuffer(const std::string& filename, const uint64 buffer_size, DBLog* log = nullptr,
+             DBVersions* versions = nullptr): 
+        _num_pages(0), _filename(filename), _file(filename), _log(log), _versions(versions), _num_frames(0), 
         _buffer(new char[buffer_size]), 
-        _buffer_size(buffer_size) { }
+        _buffer_size(buffer_size), _hand(0), _num_prefetching(0) { }
 
     ~DBBuffer() {
         if (isopen()) close();
@@ -128,10 +197,19 @@ public:
     bool accessible() const { return _file.accessible(); }
     uint64 pageSize() const { return _file.pageSize(); }
     // both create() and remove() write through to disk
+    // creation and removal are logged, and flushed before done,
+    // so redo never reaches a file removed or created again later
+    // they fail if the log fails
     bool create(const uint64 page_size, const char* buffer) {
+        if (_log && _log->flush(_log->logFile(DBLog::RECORD_CREATE, _filename))) return 1;
         return _file.create(page_size, buffer);
     }
-    bool remove() { return _file.remove(); }
+    bool remove() { 
+        if (_log && !_file.isopen() && _file.accessible() &&
+            _log->flush(_log->logFile(DBLog::RECORD_REMOVE, _filename)))
+            return 1;
+        return _file.remove(); 
+    }
 
     uint64 open() { 
         uint64 page_size = _file.open();
@@ -140,57 +218,155 @@ public:
 
         // if buffer size < page size
         // buffer is disabled
-        if (_buffer_size >= page_size)
-            _lru = new LRU(_buffer_size / page_size);
-        else 
-            _lru = nullptr;
+        _num_frames = _buffer_size / page_size;
+        _frames.reset(_num_frames? new Frame[_num_frames]: nullptr);
+        for (uint64 i = 0; i < NUM_SHARDS; ++i)
+            _shards[i].frames.clear();
+        _hand = 0;
 
         _num_pages = _file.numPages();
+        if (_log) _log->attach(this);
 
         return page_size; 
     }
 
     // write back all dirty data before closing the file.
+    // dirty pages are left to recovery if their log records can't be flushed
+    // no page should be in use
     bool close() {
+        if (_log) _log->detach(this);
+        // prefetched pages must arrive before their frames are freed
+        {
+            std::unique_lock<std::mutex> lock(_prefetch_mutex);
+            _prefetched.wait(lock, [this]() { return !_num_prefetching; });
+        }
+
         // if buffer is enabled
-        // write back all dirty data
-        if (_lru)
-            _lru->traverseDirtyBuffer(
-                [this](const uint64 pageid, const uint64 bufferpageid) {
-                    _file.writePage(pageid, _buffer + bufferpageid * pageSize());
-                });
-
-        delete _lru;
-        _lru = nullptr;
+        // write back all dirty data, after their log records
+        uint64 lsn = 0;
+        for (uint64 i = 0; i < _num_frames; ++i) {
+            assert(_frames[i].pin_count == 0);
+            if (_frames[i].page_id != NO_PAGE && _frames[i].dirty)
+                lsn = std::max<uint64>(lsn, _frames[i].lsn);
+        }
+        const bool logged = !_log || !lsn || !_log->flush(lsn);
+        for (uint64 i = 0; logged && i < _num_frames; ++i) 
+            if (_frames[i].page_id != NO_PAGE && _frames[i].dirty)
+                _file.writePage(_frames[i].page_id, frameData(i));
+        // log may be discarded after pages are closed
+        if (_log) _file.sync();
+
+        _frames.reset();
+        _num_frames = 0;
+        for (uint64 i = 0; i < NUM_SHARDS; ++i)
+            _shards[i].frames.clear();
         _num_pages = 0;
         _file.close();
         return 0;
     }
+
+    // pin page in buffer and latch it, shared if not exclusive
+    // if load is 0, page is not read from disk, caller is going to overwrite all of it
+    // page latched shared is the one seen by snapshot of calling thread, if any
+    // buffer must be enabled
+    PageGuard fetchPage(const uint64 pageid, const bool exclusive, const bool load = 1) {
+        assert(_num_frames);
+        const uint64 frame_id = pin(pageid, load);
+        if (exclusive) {
+            _frames[frame_id].latch.lock();
+            return PageGuard(this, frame_id, 1, nullptr);
+        }
+        _frames[frame_id].latch.lock_shared();
+        // page is copied with latch held exclusively, so copy is found if it's changed
+        return PageGuard(this, frame_id, 0, 
+                         _versions? _versions->find(this, pageid, frameData(frame_id), pageSize()): nullptr);
+    }
+
+    // whether calling thread reads a snapshot of this buffer
+    bool inSnapshot() const {
+        return _versions && _versions->inSnapshot();
+    }
+
+    // whether snapshot of calling thread, if any, can read this buffer, see DBVersions
+    bool readable() const {
+        return !_versions || _versions->readable(this);
+    }
     
-    // write to buffer rather than disk
-    void writePage(const uint64 pageid, const char* data) {
-        // if buffer is disabled
-        if (!_lru) return _file.writePage(pageid, data);
+    // start reading pages not in buffer, without waiting for them
+    // fetching a page being read waits until it arrives
+    // pages not in file and pages exceeding the limit of reads in flight are skipped
+    void prefetch(const uint64* pageids, const uint64 n) {
+        // prefetching more pages than a part of buffer replaces pages prefetched
+        const uint64 max_prefetching = _num_frames / 4;
+        for (uint64 i = 0; i < n; ++i) {
+            const uint64 pageid = pageids[i];
+            if (pageid >= _num_pages) continue;
+            {
+                std::lock_guard<std::mutex> lock(_prefetch_mutex);
+                if (_num_prefetching >= max_prefetching) return;
+                ++_num_prefetching;
+            }
 
-        // get buffer page ID of this page
-        uint64 bufferID = _lru->find(pageid, 
-            [this](const uint64 oldpageid, const uint64 oldbufferid) {
-                _file.writePage(oldpageid, _buffer + oldbufferid * pageSize()); 
+            bool missed = 0;
+            const uint64 frame_id = pinFrame(pageid, missed);
+            if (!missed) {
+                --_frames[frame_id].pin_count;
+                finishPrefetch();
+                continue;
+            }
+            // frame stays pinned and loading until page arrives
+            DBIOQueue::shared().submit([this, pageid, frame_id]() {
+                readFrame(pageid, frame_id);
+                finishLoad(frame_id);
+                --_frames[frame_id].pin_count;
+                finishPrefetch();
             });
+        }
+    }
 
-        
-        // write to buffer
-        memcpy(_buffer + bufferID * pageSize(), 
-               data,
-               pageSize());
+    void prefetch(const std::vector<uint64>& pageids) {
+        if (_num_frames && !pageids.empty()) prefetch(pageids.data(), pageids.size());
+    }
 
-        // mark this page as dirty
-        _lru->markDirty(pageid);
+    // write to buffer rather than disk
+    // pages can be read and written by multiple threads
+    void writePage(const uint64 pageid, const char* data) {
+        // if buffer is disabled
+        if (!_num_frames) {
+            std::lock_guard<std::mutex> lock(_file_mutex);
+            if (_log || _versions) {
+                std::unique_ptr<char[]> before(new char[pageSize()]);
+                if (pageid < _file.numPages()) 
+                    _file.readPageAt(pageid, before.get());
+                else 
+                    memset(before.get(), 0x00, pageSize());
+                if (_versions) _versions->save(this, pageid, before.get(), pageSize());
+                // each write makes page dirty and then clean
+                if (_log && mismatch(before.get(), data, 0, pageSize()) < pageSize()) {
+                    _log->logDirty(_filename, pageid, before.get(), pageSize());
+                    if (_log->flush(logChanges(pageid, before.get(), data))) return;
+                }
+            }
+            return _file.writePage(pageid, data);
+        }
+
+        if (_log) {
+            // old data is needed by log, which is compared in place
+            PageGuard page = fetchPage(pageid, 1);
+            saveVersion(page._frame_id);
+            logFrame(page._frame_id, page.data(), data);
+            memcpy(frameData(page._frame_id), data, pageSize());
+            page.markDirty();
+        } else {
+            // old data is needed by snapshots
+            PageGuard page = fetchPage(pageid, 1, _versions);
+            memcpy(page.mutableData(), data, pageSize());
+            page.markDirty();
+        }
 
         // when expanding this file
-        if (pageid >= _num_pages) 
-            _num_pages = pageid + 1;
-        
+        uint64 num_pages = _num_pages;
+        while (pageid >= num_pages && !_num_pages.compare_exchange_weak(num_pages, pageid + 1)) { }
     }
     
     // check whether already in buffer.
@@ -198,46 +374,84 @@ public:
     // else, read to buffer and return
     void readPage(const uint64 pageid, char* data) {
         // if buffer is disabled
-        if (!_lru) return _file.readPage(pageid, data);
-
-        // if this flag is set to 1, 
-        // the lru only assign a buffer page ID for this page,
-        // u've got to read it from file to this buffer page
-        bool page_miss = 0;
-
-        // get buffer page ID of this page
-        uint64 bufferID = _lru->find(pageid,
-            [this](const uint64 oldpageid, const uint64 oldbufferid) {
-                _file.writePage(oldpageid, _buffer + oldbufferid * pageSize()); 
-            }, &page_miss);
-
-        // if page miss, read in
-        if (page_miss) {
-            // first time read a page which is in the buffer but not yet written to disk
-            // read action will fail if read in this case
-            if (pageid >= _file.numPages() && pageid < _num_pages) {
-                memset(data, 0x00, _file.pageSize());
-                memset(_buffer + bufferID * pageSize(), 0x00, _file.pageSize());
-                return;
-            }
-
-            _file.readPage(pageid, _buffer + bufferID * pageSize());
+        if (!_num_frames) {
+            std::lock_guard<std::mutex> lock(_file_mutex);
+            // pages appended after a snapshot began are not read by it from file
+            if (pageid < _file.numPages())
+                _file.readPage(pageid, data);
+            else
+                memset(data, 0x00, pageSize());
+            const char* version = _versions? _versions->find(this, pageid, data, pageSize()): nullptr;
+            if (version) memcpy(data, version, pageSize());
+            return;
         }
 
-        // copy to buffer
-        memcpy(data,
-               _buffer + bufferID * pageSize(),
-               pageSize());
+        PageGuard page = fetchPage(pageid, 0);
+        memcpy(data, page.data(), pageSize());
     }
 
     // if this function is called before new pages is written back to disk,
     // it will returns a wrong number
     // there's a delay if using buffer
     uint64 numPages() const {
-        if (!_lru) return _file.numPages();
+        if (!_num_frames) return _file.numPages();
         return _num_pages;
     }
 
+    const std::string& filename() const { return _filename; }
+
+    // pages whose changes may be not on disk, with LSN from which they are logged,
+    // pages are not latched, so they're only those dirty at some moment of this call
+    void dirtyPages(std::vector< std::pair<uint64, uint64> >& pages) {
+        for (uint64 i = 0; i < _num_frames; ++i) {
+            const uint64 pageid = _frames[i].page_id;
+            const uint64 rec_lsn = _frames[i].rec_lsn;
+            if (pageid != NO_PAGE && rec_lsn) pages.emplace_back(pageid, rec_lsn);
+        }
+        // after frames, a page leaves its frame before it's found here
+        for (Shard& shard: _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& w: shard.writing) 
+                if (w.second) pages.emplace_back(w.first, w.second);
+        }
+    }
+
+    // write back pages dirty since before lsn, or all dirty pages if not logged,
+    // after their log records
+    // pages can be read meanwhile
+    void writeBack(const uint64 lsn) {
+        for (uint64 i = 0; i < _num_frames; ++i) {
+            const uint64 pageid = _frames[i].page_id;
+            const uint64 rec_lsn = _frames[i].rec_lsn;
+            if (pageid == NO_PAGE || !_frames[i].dirty || rec_lsn >= lsn) continue;
+            // frame may be replaced before latched
+            PageGuard page = fetchPage(pageid, 0);
+            Frame& frame = _frames[page._frame_id];
+            if (!frame.dirty) continue;
+            if (_log && _log->flush(frame.lsn)) continue;
+            std::lock_guard<std::mutex> file_lock(_file_mutex);
+            _file.writePage(pageid, page.data());
+            frame.dirty = 0;
+            frame.rec_lsn = 0;
+        }
+        // and those replaced, which are being written back by others
+        for (Shard& shard: _shards) {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            shard.written.wait(lock, [&shard, lsn]() {
+                for (const auto& w: shard.writing) 
+                    if (w.second < lsn) return false;
+                return true;
+            });
+        }
+    }
+
+    // flush pages written back to disk
+    // returns 0 if succeed, 1 otherwise
+    bool sync() {
+        std::lock_guard<std::mutex> file_lock(_file_mutex);
+        return _file.sync();
+    }
+
 private:
     // forbid copying
     DBBuffer(const DBBuffer&) = delete;
@@ -245,20 +459,296 @@ private:
     DBBuffer& operator=(const DBBuffer&) & = delete;
     DBBuffer& operator=(DBBuffer&&) & = delete;
 
+    char* frameData(const uint64 frame_id) const {
+        return _buffer + frame_id * pageSize();
+    }
+
+    // returns pinned frame of pageid, reads page in if missing and load is 1
+    uint64 pin(const uint64 pageid, const bool load) {
+        bool missed = 0;
+        const uint64 frame_id = pinFrame(pageid, missed);
+        if (!missed) {
+            waitLoad(frame_id);
+            return frame_id;
+        }
+        if (load) 
+            readFrame(pageid, frame_id);
+        else 
+            // pages not loaded are new, which are read as zeros before written
+            memset(frameData(frame_id), 0x00, pageSize());
+        finishLoad(frame_id);
+        return frame_id;
+    }
+
+    // wait until frame is loaded by the thread taking it
+    void waitLoad(const uint64 frame_id) {
+        Frame& frame = _frames[frame_id];
+        if (!frame.loading) return;
+        std::unique_lock<std::mutex> lock(_load_mutex);
+        _loaded.wait(lock, [&frame]() { return !frame.loading; });
+    }
+
+    // frame is loaded, by any thread
+    void finishLoad(const uint64 frame_id) {
+        {
+            std::lock_guard<std::mutex> lock(_load_mutex);
+            _frames[frame_id].loading = 0;
+        }
+        _loaded.notify_all();
+    }
+
+    // returns pinned frame of pageid, which may be still loading
+    // if page is not in buffer, missed is set to 1 and 
+    // a frame is taken for it and marked loading, with its data not loaded,
+    // and finishLoad() must be called after its data is loaded
+    uint64 pinFrame(const uint64 pageid, bool& missed) {
+        Shard& shard = _shards[pageid % NUM_SHARDS];
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            // page being written back is read from disk after written
+            shard.written.wait(lock, [&shard, pageid]() { return !shard.writing.count(pageid); });
+            // page hit
+            auto ite = shard.frames.find(pageid);
+            if (ite != shard.frames.end()) {
+                Frame& frame = _frames[ite->second];
+                ++frame.pin_count;
+                frame.referenced = 1;
+                return ite->second;
+            }
+        }
+
+        // page miss, find a victim frame with clock
+        // a dirty frame is taken only after DIRTY_SKIP frames find no clean one
+        for (uint64 checked = 0; ; ++checked) {
+            const uint64 frame_id = _hand++ % _num_frames;
+            Frame& frame = _frames[frame_id];
+            if (frame.pin_count) {
+                // all frames may be pinned, let others go on
+                if (frame_id == _num_frames - 1) std::this_thread::yield();
+                continue;
+            }
+            if (frame.referenced.exchange(0)) continue;
+            if (frame.dirty && checked < DIRTY_SKIP) continue;
+
+            // pin count only increases with shard of its page locked,
+            // lock shard of old page and shard of new page together
+            const uint64 old_pageid = frame.page_id;
+            Shard& old_shard = _shards[(old_pageid == NO_PAGE? pageid: old_pageid) % NUM_SHARDS];
+            std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+            std::unique_lock<std::mutex> old_lock(old_shard.mutex, std::defer_lock);
+            if (&old_shard == &shard) 
+                lock.lock();
+            else 
+                std::lock(lock, old_lock);
+
+            // page is read in by another thread meanwhile
+            auto ite = shard.frames.find(pageid);
+            if (ite != shard.frames.end()) {
+                Frame& hit = _frames[ite->second];
+                ++hit.pin_count;
+                hit.referenced = 1;
+                return ite->second;
+            }
+            // or replaced by another thread, and being written back
+            if (shard.writing.count(pageid)) {
+                if (old_lock.owns_lock()) old_lock.unlock();
+                lock.unlock();
+                return pinFrame(pageid, missed);
+            }
+            // frame is taken by another thread meanwhile
+            uint64 unpinned = 0;
+            if (frame.page_id != old_pageid || !frame.pin_count.compare_exchange_strong(unpinned, 1)) 
+                continue;
+
+            // no one else uses an unpinned frame
+            frame.referenced = 1;
+            frame.loading = 1;
+            // old page must reach disk before others can read it from disk again
+            const bool write_back = old_pageid != NO_PAGE && frame.dirty;
+            const uint64 old_lsn = frame.lsn;
+            if (old_pageid != NO_PAGE) {
+                old_shard.frames.erase(old_pageid);
+                if (write_back) old_shard.writing.emplace(old_pageid, frame.rec_lsn.load());
+            }
+            frame.dirty = 0;
+            frame.lsn = 0;
+            frame.rec_lsn = 0;
+            frame.page_id = pageid;
+            shard.frames.emplace(pageid, frame_id);
+            if (old_lock.owns_lock()) old_lock.unlock();
+            lock.unlock();
+
+            // others finding the new page wait for loading meanwhile
+            if (write_back) writeOld(old_shard, old_pageid, old_lsn, frame_id);
+            missed = 1;
+            return frame_id;
+        }
+    }
+
+    // write back old page of frame, which is replaced, after its log records
+    // if they can't be flushed, the page is not written, and left to recovery
+    void writeOld(Shard& shard, const uint64 pageid, const uint64 lsn, const uint64 frame_id) {
+        if (!_log || !_log->flush(lsn)) {
+            std::lock_guard<std::mutex> file_lock(_file_mutex);
+            _file.writePage(pageid, frameData(frame_id));
+        }
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.writing.erase(pageid);
+        }
+        shard.written.notify_all();
+    }
+
+    // read page into frame, reads of different pages run in parallel
+    void readFrame(const uint64 pageid, const uint64 frame_id) {
+        {
+            std::lock_guard<std::mutex> lock(_file_mutex);
+            // first time read a page which is in the buffer but not yet written to disk
+            // read action will fail if read in this case
+            if (pageid >= _file.numPages()) {
+                memset(frameData(frame_id), 0x00, pageSize());
+                return;
+            }
+        }
+        _file.readPageAt(pageid, frameData(frame_id));
+    }
+
+    // save page in frame for snapshots before it's changed
+    // frame must be latched exclusively
+    void saveVersion(const uint64 frame_id) {
+        if (_versions) _versions->save(this, _frames[frame_id].page_id, frameData(frame_id), pageSize());
+    }
+
+    // log bytes of frame changed from before to after, and mark it dirty if changed
+    // frame must be latched exclusively
+    void logFrame(const uint64 frame_id, const char* before, const char* after) {
+        Frame& frame = _frames[frame_id];
+        const uint64 begin = mismatch(before, after, 0, pageSize());
+        if (begin == pageSize()) return;
+        if (!frame.rec_lsn) logDirty(frame, before);
+        frame.lsn = logChanges(frame.page_id, before, after, begin);
+        frame.dirty = 1;
+    }
+
+    void logFrame(const uint64 frame_id, const char* before) {
+        logFrame(frame_id, before, frameData(frame_id));
+    }
+
+    // log memmove in frame, which is done to before too,
+    // so bytes changed later are found relative to it
+    // frame must be latched exclusively
+    void logMove(const uint64 frame_id, char* before, const uint64 destination, 
+                 const uint64 source, const uint64 length) {
+        Frame& frame = _frames[frame_id];
+        // bytes changed before are logged first, so they are redone before the move
+        const char* data = frameData(frame_id);
+        if (mismatch(before, data, 0, pageSize()) != pageSize()) {
+            logFrame(frame_id, before, data);
+            memcpy(before, data, pageSize());
+        }
+        if (!frame.rec_lsn) logDirty(frame, before);
+        // bytes overwritten and not moved from
+        const uint64 lost = destination > source? 
+            std::max(destination, source + length): destination;
+        frame.lsn = _log->logMove(_filename, frame.page_id, destination, source, length, before + lost);
+        frame.dirty = 1;
+        memmove(before + destination, before + source, length);
+    }
+
+    // log that frame not dirty is going to be changed, data is the page on disk
+    // frame must be latched exclusively
+    void logDirty(Frame& frame, const char* data) {
+        // a checkpoint collecting dirty pages meanwhile gets an LSN not after the record
+        frame.rec_lsn = _log->nextLSN();
+        frame.lsn = _log->logDirty(_filename, frame.page_id, data, pageSize());
+    }
+
+    // log bytes of page pageid changed from before to after, from byte i
+    // returns LSN of the last record, 0 if nothing changed
+    uint64 logChanges(const uint64 pageid, const char* before, const char* after, uint64 i = 0) {
+        const uint64 page_size = pageSize();
+        uint64 lsn = 0;
+        while (true) {
+            // a run of changed bytes, ending with LOG_GAP unchanged bytes or end of page
+            i = mismatch(before, after, i, page_size);
+            if (i == page_size) break;
+            const uint64 begin = i;
+            uint64 end = i;
+            while (i < page_size && i < end + LOG_GAP) {
+                if (before[i] != after[i]) end = i + 1;
+                ++i;
+            }
+            lsn = _log->logUpdate(_filename, pageid, begin, before + begin, after + begin, end - begin);
+        }
+        return lsn;
+    }
+
+    // position of the first different byte of a and b in [i, n), n if none
+    // most of a page is unchanged, which is skipped by words
+    static uint64 mismatch(const char* a, const char* b, uint64 i, const uint64 n) {
+        constexpr uint64 BLOCK = 64;
+        while (i + BLOCK <= n && !memcmp(a + i, b + i, BLOCK)) i += BLOCK;
+        for (; i + sizeof(uint64) <= n; i += sizeof(uint64)) {
+            uint64 x, y;
+            memcpy(&x, a + i, sizeof(uint64));
+            memcpy(&y, b + i, sizeof(uint64));
+            if (x != y) break;
+        }
+        while (i < n && a[i] == b[i]) ++i;
+        return i;
+    }
+
+    void finishPrefetch() {
+        {
+            std::lock_guard<std::mutex> lock(_prefetch_mutex);
+            --_num_prefetching;
+        }
+        _prefetched.notify_all();
+    }
+
+    void release(const uint64 frame_id, const bool exclusive) {
+        Frame& frame = _frames[frame_id];
+        if (exclusive) 
+            frame.latch.unlock();
+        else 
+            frame.latch.unlock_shared();
+        --frame.pin_count;
+    }
+
 private:
     // cache for _file._num_pages
-    uint64 _num_pages;
+    std::atomic<uint64> _num_pages;
+    std::string _filename;
     // disk manipulator
     DBFile _file;
-    // LUR manager
-    LRU* _lru;
+    // log of changes, null if not logged
+    DBLog* _log;
+    // copies of pages read by snapshots, null if none
+    DBVersions* _versions;
+    // guards file, which is shared by threads
+    std::mutex _file_mutex;
+    // number of frames, 0 if buffer is disabled
+    uint64 _num_frames;
+    std::unique_ptr<Frame[]> _frames;
+    Shard _shards[NUM_SHARDS];
     // pointer to buffer
     char* _buffer;
     // size of buffer
     uint64 _buffer_size;
-    
-
+    // clock hand, frame _hand % _num_frames is checked next
+    std::atomic<uint64> _hand;
+    // number of pages being prefetched
+    uint64 _num_prefetching;
+    std::mutex _prefetch_mutex;
+    std::condition_variable _prefetched;
+    // notified when frames are loaded
+    std::mutex _load_mutex;
+    std::condition_variable _loaded;
 };
 
+constexpr Database::uint64 Database::DBBuffer::NO_PAGE;
+constexpr Database::uint64 Database::DBBuffer::NUM_SHARDS;
+constexpr Database::uint64 Database::DBBuffer::LOG_GAP;
+constexpr Database::uint64 Database::DBBuffer::DIRTY_SKIP;
 
 #endif /* DB_BUFFER_H_ */
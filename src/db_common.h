@@ -15,6 +15,7 @@
 #ifndef COMMON_H_
 #define COMMON_H_
 
+#include <atomic>
 #include <boost/chrono.hpp>
 
 namespace Database {
@@ -28,9 +29,18 @@ class DBTableManager;
 class DBFields;
 class DBBuffer;
 template<class /* Comparator */> class DBIndexManager;
+template<class /* Comparator */> class DBBLinkIndex;
 class DBQuery;
 class DBInterface;
 class AlignedOutputer;
+class DelimitedReader;
+class DBThreadPool;
+class DBIOQueue;
+class DBLog;
+class DBRecovery;
+class DBVersions;
+class DBLockManager;
+class DBServer;
 
 struct RID {
     uint64 pageID;
@@ -95,11 +105,18 @@ const boost::chrono::system_clock::duration sys_clock_epoch =
 const boost::chrono::high_resolution_clock::time_point hr_clock_epoch = 
     boost::chrono::high_resolution_clock::now();
 
+// numbers are increasing across threads, a call getting the same time as another
+// takes the next number
 template <class T = uint64>
 T uniqueNumber() {
-    return boost::chrono::duration_cast<boost::chrono::nanoseconds>(sys_clock_epoch).count() +
-           boost::chrono::duration_cast<boost::chrono::nanoseconds>(boost::chrono::high_resolution_clock::now() - hr_clock_epoch).count();
-
+    static std::atomic<T> last(0);
+    T number = boost::chrono::duration_cast<boost::chrono::nanoseconds>(sys_clock_epoch).count() +
+               boost::chrono::duration_cast<boost::chrono::nanoseconds>(boost::chrono::high_resolution_clock::now() - hr_clock_epoch).count();
+    T previous = last;
+    do {
+        if (number <= previous) number = previous + 1;
+    } while (!last.compare_exchange_weak(previous, number));
+    return number;
 }
 
 } // namespace Database
@@ -87,6 +87,32 @@ struct OpenTableFailed: T {
     }
 };
 template <class T>
+struct OpenFileFailed: T {
+    std::string path;
+    template <class ...Para>
+    OpenFileFailed(const std::string& p, const Para&... para): T(para...), path(p) { }
+    virtual std::string getInfo() const {
+        return T::getInfo() + "Failed when opening file " + T::quoted(path) + ". ";
+    }
+};
+template <class T>
+struct FileNotAllowed: T {
+    std::string path;
+    template <class ...Para>
+    FileNotAllowed(const std::string& p, const Para&... para): T(para...), path(p) { }
+    virtual std::string getInfo() const {
+        return T::getInfo() + "File " + T::quoted(path) + " is out of the directory allowed. ";
+    }
+};
+template <class T>
+struct StatementNotPrepared: T {
+    template <class ...Para>
+    StatementNotPrepared(const Para&... p): T(p...) { }
+    virtual std::string getInfo() const {
+        return T::getInfo() + "Statement not prepared. ";
+    }
+};
+template <class T>
 struct AggregateFailed: T {
     std::string function, field_name;
     template <class ...Para>
@@ -229,6 +255,13 @@ struct UseDBFailed: Error {
         return Error::getInfo() + "Failed when opening database " + quoted(db_name) + ". ";
     }
 };
+    struct RecoveryFailed: UseDBFailed {
+        RecoveryFailed(const std::string& db_n): UseDBFailed(db_n) { }
+        virtual std::string getInfo() const {
+            return UseDBFailed::getInfo() + "Recovery from log failed. ";
+        }
+    };
+
     
 struct CreateTableFailed: Error {
     std::string table_name;
@@ -411,6 +444,126 @@ struct UpdateRecordFailed: Error {
     }
 };
 
+struct LoadDataFailed: Error {
+    std::string path;
+    std::string table_name;
+    LoadDataFailed(const std::string& p, const std::string& tn): path(p), table_name(tn) { }
+    virtual std::string getInfo() const {
+        return Error::getInfo() + "Failed when loading file " + quoted(path) + 
+               " into table " + quoted(table_name) + ". ";
+    }
+};
+    struct MalformedRecord: LoadDataFailed {
+        uint64 line;
+        MalformedRecord(const std::string& p, const std::string& tn, const uint64 l):
+            LoadDataFailed(p, tn), line(l) { }
+        virtual std::string getInfo() const {
+            return LoadDataFailed::getInfo() + "Malformed record at line " + std::to_string(line) + ". ";
+        }
+    };
+
+struct PrepareFailed: Error {
+    std::string name;
+    PrepareFailed(const std::string& n): name(n) { }
+    virtual std::string getInfo() const {
+        return Error::getInfo() + "Failed when preparing statement " + quoted(name) + ". ";
+    }
+};
+    struct UnsupportedStatement: PrepareFailed {
+        UnsupportedStatement(const std::string& n): PrepareFailed(n) { }
+        virtual std::string getInfo() const {
+            return PrepareFailed::getInfo() + "Only INSERT, DELETE, UPDATE and simple SELECT can be prepared. ";
+        }
+    };
+
+struct ExecuteFailed: Error {
+    std::string name;
+    ExecuteFailed(const std::string& n): name(n) { }
+    virtual std::string getInfo() const {
+        return Error::getInfo() + "Failed when executing prepared statement " + quoted(name) + ". ";
+    }
+};
+    struct WrongParameterSize: ExecuteFailed {
+        uint64 given_size;
+        uint64 expected_size;
+        WrongParameterSize(const std::string& n, const uint64 g, const uint64 e):
+            ExecuteFailed(n), given_size(g), expected_size(e) { }
+        virtual std::string getInfo() const {
+            return ExecuteFailed::getInfo() + std::to_string(expected_size) + " parameter(s) expected, " + 
+                   std::to_string(given_size) + " given. ";
+        }
+    };
+
+struct DeallocateFailed: Error {
+    std::string name;
+    DeallocateFailed(const std::string& n): name(n) { }
+    virtual std::string getInfo() const {
+        return Error::getInfo() + "Failed when deallocating prepared statement " + quoted(name) + ". ";
+    }
+};
+
+struct BeginFailed: Error {
+    virtual std::string getInfo() const {
+        return Error::getInfo() + "Failed when beginning transaction. ";
+    }
+};
+    struct LogNotOpened: BeginFailed {
+        virtual std::string getInfo() const {
+            return BeginFailed::getInfo() + "Log of database can't be opened. ";
+        }
+    };
+
+struct LogFailed: Error {
+    virtual std::string getInfo() const {
+        return Error::getInfo() + "Failed when writing log, changes are not durable. ";
+    }
+};
+
+struct RollbackFailed: Error {
+    virtual std::string getInfo() const {
+        return Error::getInfo() + "Failed when rolling back transaction. ";
+    }
+};
+
+struct NotAllowedInTransaction: Error {
+    std::string statement;
+    NotAllowedInTransaction(const std::string& s): statement(s) { }
+    virtual std::string getInfo() const {
+        return Error::getInfo() + statement + " is not allowed in a transaction. ";
+    }
+};
+
+struct TransactionAborted: Error {
+    virtual std::string getInfo() const {
+        return Error::getInfo() + "Transaction is rolled back. ";
+    }
+};
+    struct Deadlock: TransactionAborted {
+        virtual std::string getInfo() const {
+            return TransactionAborted::getInfo() + "It deadlocks with others waiting for locks. ";
+        }
+    };
+    struct DatabaseClosed: TransactionAborted {
+        virtual std::string getInfo() const {
+            return TransactionAborted::getInfo() + "Database was closed by others. ";
+        }
+    };
+
+// statement waits for locks of other transactions, and is executed again later
+struct LockWait: Error {
+    virtual std::string getInfo() const {
+        return Error::getInfo() + "Waiting for locks of other transactions. ";
+    }
+};
+
+struct TempFileFailed: Error {
+    std::string path;
+    TempFileFailed(const std::string& p): path(p) { }
+    virtual std::string getInfo() const {
+        return Error::getInfo() + "Failed when writing temp file " + quoted(path) + ". ";
+    }
+};
+
 
 } // namespace DBError
 } // namespace Database
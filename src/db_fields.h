@@ -15,7 +15,11 @@
 #ifndef DB_FIELDS_H_
 #define DB_FIELDS_H_
 
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <strings.h>
 #include <string>
 #include <vector>
 #include <cassert>
@@ -357,309 +361,308 @@ public:
         }
     };
 
+    // parser of unquoted text, e.g. a field of CSV file
+    struct TextParser {
+        // parse data[0, length) as Type(type), save the result to buffer
+        // result contains null flag, which is always not null
+        // returns 0 if parse succeed.
+        // returns 1 if parse failed
+        // returns 2 if out of range
+        int operator()(const char* data, const uint64 data_length, 
+                       const uint64 type, const uint64 length, void* buffer) const {
+            char* buff = pointer_convert<char*>(buffer);
+            // not null flag
+            buff[0] = '\xff';
+            ++buff;
+
+            switch (type) {
+                case TYPE_CHAR:
+                case TYPE_UCHAR:
+                    if (data_length > length - 1) return 2;
+                    memcpy(buff, data, data_length);
+                    memset(buff + data_length, 0x00, length - 1 - data_length);
+                    return 0;
+                case TYPE_BOOL: {
+                    bool x;
+                    if (equal(data, data_length, "1") || equal(data, data_length, "true")) x = true;
+                    else if (equal(data, data_length, "0") || equal(data, data_length, "false")) x = false;
+                    else return 1;
+                    memcpy(buff, &x, sizeof(bool));
+                    return 0;
+                } case TYPE_INT8:
+                  case TYPE_INT16:
+                  case TYPE_INT32:
+                  case TYPE_INT64: {
+                    // numbers are short, copy to make it null-terminated
+                    char str[32];
+                    if (!data_length || data_length >= sizeof(str)) return data_length? 2: 1;
+                    memcpy(str, data, data_length);
+                    str[data_length] = '\0';
+                    char* end;
+                    errno = 0;
+                    long long x = strtoll(str, &end, 10);
+                    if (end != str + data_length) return 1;
+                    if (errno == ERANGE) return 2;
+                    switch (type) {
+                        case TYPE_INT8: return store<int8_t>(x, buff);
+                        case TYPE_INT16: return store<int16_t>(x, buff);
+                        case TYPE_INT32: return store<int32_t>(x, buff);
+                        default: return store<int64_t>(x, buff);
+                    }
+                } case TYPE_UINT8:
+                  case TYPE_UINT16:
+                  case TYPE_UINT32:
+                  case TYPE_UINT64: {
+                    char str[32];
+                    if (!data_length || data_length >= sizeof(str)) return data_length? 2: 1;
+                    memcpy(str, data, data_length);
+                    str[data_length] = '\0';
+                    // strtoull accepts negative numbers
+                    if (str[0] == '-') return 2;
+                    char* end;
+                    errno = 0;
+                    unsigned long long x = strtoull(str, &end, 10);
+                    if (end != str + data_length) return 1;
+                    if (errno == ERANGE) return 2;
+                    switch (type) {
+                        case TYPE_UINT8: return store<uint8_t>(x, buff);
+                        case TYPE_UINT16: return store<uint16_t>(x, buff);
+                        case TYPE_UINT32: return store<uint32_t>(x, buff);
+                        default: return store<uint64_t>(x, buff);
+                    }
+                } case TYPE_FLOAT:
+                  case TYPE_DOUBLE: {
+                    char str[64];
+                    if (!data_length || data_length >= sizeof(str)) return 1;
+                    memcpy(str, data, data_length);
+                    str[data_length] = '\0';
+                    char* end;
+                    errno = 0;
+                    double x = strtod(str, &end);
+                    if (end != str + data_length) return 1;
+                    if (errno == ERANGE) return 2;
+                    if (type == TYPE_DOUBLE) {
+                        memcpy(buff, &x, sizeof(double));
+                        return 0;
+                    }
+                    if (std::abs(x) > std::numeric_limits<float>::max()) return 2;
+                    float y = x;
+                    memcpy(buff, &y, sizeof(float));
+                    return 0;
+                } default:
+                    assert(0);
+                    return 1;
+            }
+        }
+    private:
+        // case insensitive comparison of data[0, length) and str
+        static bool equal(const char* data, const uint64 length, const char* str) {
+            return length == strlen(str) && strncasecmp(data, str, length) == 0;
+        }
+        // save x as T to buff
+        // returns 2 if out of range
+        template <class T, class X>
+        static int store(const X x, char* buff) {
+            if (x < X(std::numeric_limits<T>::min()) || x > X(std::numeric_limits<T>::max()))
+                return 2;
+            T y = x;
+            memcpy(buff, &y, sizeof(T));
+            return 0;
+        }
+    };
+
     struct Aggregator {
+        static constexpr uint64 FUNC_COUNT = 0;
+        static constexpr uint64 FUNC_SUM   = 1;
+        static constexpr uint64 FUNC_AVG   = 2;
+        static constexpr uint64 FUNC_MAX   = 3;
+        static constexpr uint64 FUNC_MIN   = 4;
+        // count(*), counts all rows including null
+        static constexpr uint64 FUNC_COUNT_ALL = 5;
+
+        // running result of an aggregate function
+        // states are updated with values one by one,
+        // states of different parts of data can be merged
+        struct State {
+            // number of not null values
+            uint64 count;
+            // sum of integers
+            int64 int_sum;
+            // sum of floating points, or sum of all types for avg
+            double float_sum;
+            // max or min value till now, with null flag
+            std::string extreme;
+            State(): count(0), int_sum(0), float_sum(0) { }
+        };
+
+        // returns function number of function name
+        // returns max of uint64 if no such function
+        static uint64 function(const std::string& name) {
+            if (name == "count") return FUNC_COUNT;
+            if (name == "sum") return FUNC_SUM;
+            if (name == "avg") return FUNC_AVG;
+            if (name == "max") return FUNC_MAX;
+            if (name == "min") return FUNC_MIN;
+            return std::numeric_limits<uint64>::max();
+        }
+
+        // check if function can be applied to type
+        static bool applicable(const uint64 func, const uint64 type) {
+            if (func == FUNC_SUM || func == FUNC_AVG)
+                return type != TYPE_CHAR && type != TYPE_UCHAR && type <= TYPE_DOUBLE;
+            return type <= TYPE_DOUBLE;
+        }
+
+        void init(State& state) const {
+            state = State();
+        }
+
+        // add value data of type to state
+        // data starts with null flag
+        // assert function can be applied to type
+        void update(State& state, const uint64 func, const void* data, 
+                    const uint64 type, const uint64 length) const {
+            if (func == FUNC_COUNT_ALL) {
+                ++state.count;
+                return;
+            }
+            const char* value = pointer_convert<const char*>(data);
+            // null is ignored
+            if (value[0] == '\x00') return;
+            ++state.count;
+
+            switch (func) {
+                case FUNC_COUNT: 
+                    break;
+                case FUNC_SUM:
+                    if (type == TYPE_FLOAT || type == TYPE_DOUBLE)
+                        state.float_sum += readNumber<double>(value + 1, type);
+                    else
+                        state.int_sum += readNumber<int64>(value + 1, type);
+                    break;
+                case FUNC_AVG:
+                    state.float_sum += readNumber<double>(value + 1, type);
+                    break;
+                case FUNC_MAX:
+                case FUNC_MIN: {
+                    Comparator comp;
+                    comp.type = type;
+                    if (state.count == 1) 
+                        state.extreme.assign(value, length);
+                    else if (func == FUNC_MAX? comp(value, state.extreme.data(), length) > 0:
+                                               comp(value, state.extreme.data(), length) < 0)
+                        state.extreme.assign(value, length);
+                    break;
+                } default:
+                    assert(0);
+            }
+        }
+
+        // merge other into state, as if all values of other are added to state
+        void merge(State& state, const State& other, const uint64 func, 
+                   const uint64 type, const uint64 length) const {
+            if (!other.count) return;
+            if ((func == FUNC_MAX || func == FUNC_MIN) && state.count) {
+                Comparator comp;
+                comp.type = type;
+                int comp_result = comp(other.extreme.data(), state.extreme.data(), length);
+                if (func == FUNC_MAX? comp_result > 0: comp_result < 0)
+                    state.extreme = other.extreme;
+            } else if (func == FUNC_MAX || func == FUNC_MIN) {
+                state.extreme = other.extreme;
+            }
+            state.count += other.count;
+            state.int_sum += other.int_sum;
+            state.float_sum += other.float_sum;
+        }
+
+        // save result of state to result
+        // result of count is uint64, 
+        // result of sum is int64 for integral types, double for floating point types,
+        // result of avg is double, result of max and min are of type
+        // result is null if there's no value, except for count
+        void finalize(const State& state, const uint64 func, const uint64 type, 
+                      const uint64 length, void* result) const {
+            char* buff = pointer_convert<char*>(result);
+            if (func == FUNC_COUNT || func == FUNC_COUNT_ALL) {
+                buff[0] = '\xff';
+                memcpy(buff + 1, &state.count, sizeof(uint64));
+                return;
+            }
+            if (!state.count) {
+                memset(buff, 0x00, func == FUNC_MAX || func == FUNC_MIN? length: 1 + sizeof(double));
+                return;
+            }
+            buff[0] = '\xff';
+            if (func == FUNC_SUM && (type == TYPE_FLOAT || type == TYPE_DOUBLE))
+                memcpy(buff + 1, &state.float_sum, sizeof(double));
+            else if (func == FUNC_SUM)
+                memcpy(buff + 1, &state.int_sum, sizeof(int64));
+            else if (func == FUNC_AVG) {
+                double average = state.float_sum / state.count;
+                memcpy(buff + 1, &average, sizeof(double));
+            } else 
+                memcpy(buff, state.extreme.data(), length);
+        }
+
+        // aggregate field at offset of each data
         // returns 0 if succeed, 1 if type error
         int count(const std::vector<void*>& data, const uint64 offset,
                   void* result) const {
-            uint64 count = 0;
-            for (const auto d: data) 
-                if (pointer_convert<const char*>(d)[offset] == '\xff')
-                    ++count;
-            memcpy(pointer_convert<char*>(result) + 1, &count, sizeof(uint64));
-            pointer_convert<char*>(result)[0] = '\xff';
-            return 0;
+            return aggregate(data, FUNC_COUNT, offset, TYPE_UINT64, 0, result);
         }
         int sum(const std::vector<void*>& data, const uint64 offset, 
                 const uint64 type, const uint64 length, void* result) const {
-            uint64 count;
-            switch (type) {
-                case TYPE_INT8: {
-                    int64 sum_result = 0;
-                    int8_t init = 0;
-                    count = getSum<int8_t>(data, offset, init, sum_result);
-                    memcpy(pointer_convert<char*>(result) + 1, &sum_result, sizeof(int64));
-                    pointer_convert<char*>(result)[0] = '\xff';
-                    break;
-                } case TYPE_UINT8: {
-                    int64 sum_result = 0;
-                    uint8_t init = 0;
-                    count = getSum<uint8_t>(data, offset, init, sum_result);
-                    memcpy(pointer_convert<char*>(result) + 1, &sum_result, sizeof(int64));
-                    pointer_convert<char*>(result)[0] = '\xff';
-                    break;
-                } case TYPE_INT16: {
-                    int64 sum_result = 0;
-                    int16_t init = 0;
-                    count = getSum<int16_t>(data, offset, init, sum_result);
-                    memcpy(pointer_convert<char*>(result) + 1, &sum_result, sizeof(int64));
-                    pointer_convert<char*>(result)[0] = '\xff';
-                    break;
-                } case TYPE_UINT16: {
-                    int64 sum_result = 0;
-                    uint16_t init = 0;
-                    count = getSum<uint16_t>(data, offset, init, sum_result);
-                    memcpy(pointer_convert<char*>(result) + 1, &sum_result, sizeof(int64));
-                    pointer_convert<char*>(result)[0] = '\xff';
-                    break;
-                } case TYPE_INT32: {
-                    int64 sum_result = 0;
-                    int32_t init = 0;
-                    count = getSum<int32_t>(data, offset, init, sum_result);
-                    memcpy(pointer_convert<char*>(result) + 1, &sum_result, sizeof(int64));
-                    pointer_convert<char*>(result)[0] = '\xff';
-                    break;
-                } case TYPE_UINT32: {
-                    int64 sum_result = 0;
-                    uint32_t init = 0;
-                    count = getSum<uint32_t>(data, offset, init, sum_result);
-                    memcpy(pointer_convert<char*>(result) + 1, &sum_result, sizeof(int64));
-                    pointer_convert<char*>(result)[0] = '\xff';
-                    break;
-                } case TYPE_INT64: {
-                    int64 sum_result = 0;
-                    int64_t init = 0;
-                    count = getSum<int64_t>(data, offset, init, sum_result);
-                    memcpy(pointer_convert<char*>(result) + 1, &sum_result, sizeof(int64));
-                    pointer_convert<char*>(result)[0] = '\xff';
-                    break;
-                } case TYPE_UINT64: {
-                    int64 sum_result = 0;
-                    uint64_t init = 0;
-                    count = getSum<uint64_t>(data, offset, init, sum_result);
-                    memcpy(pointer_convert<char*>(result) + 1, &sum_result, sizeof(int64));
-                    pointer_convert<char*>(result)[0] = '\xff';
-                    break;
-                } case TYPE_BOOL: {
-                    int64 sum_result = 0;
-                    bool init = 0;
-                    count = getSum<bool>(data, offset, init, sum_result);
-                    memcpy(pointer_convert<char*>(result) + 1, &sum_result, sizeof(int64));
-                    pointer_convert<char*>(result)[0] = '\xff';
-                    break;
-                } case TYPE_FLOAT: {
-                    double sum_result = 0;
-                    float init = 0;
-                    count = getSum<float>(data, offset, init, sum_result);
-                    memcpy(pointer_convert<char*>(result) + 1, &sum_result, sizeof(double));
-                    pointer_convert<char*>(result)[0] = '\xff';
-                    break;
-                } case TYPE_DOUBLE: {
-                    double sum_result = 0;
-                    double init = 0;
-                    count = getSum<double>(data, offset, init, sum_result);
-                    memcpy(pointer_convert<char*>(result) + 1, &sum_result, sizeof(double));
-                    pointer_convert<char*>(result)[0] = '\xff';
-                    break;
-                } default: 
-                    return 1;
-            }
-            if (!count) memset(result, 0x00, length);
-            return 0;
+            return aggregate(data, FUNC_SUM, offset, type, length, result);
         }
         int avg(const std::vector<void*>& data, const uint64 offset, 
                 const uint64 type, void* result) const {
-            uint64 count;
-            double average = 0;
-            switch (type) {
-                case TYPE_INT8: {
-                    int8_t init = 0;
-                    count = getAvg<int8_t>(data, offset, init, average);
-                    break;
-                } case TYPE_UINT8: {
-                    uint8_t init = 0;
-                    count = getAvg<uint8_t>(data, offset, init, average);
-                    break;
-                } case TYPE_INT16: {
-                    int16_t init = 0;
-                    count = getAvg<int16_t>(data, offset, init, average);
-                    break;
-                } case TYPE_UINT16: {
-                    uint16_t init = 0;
-                    count = getAvg<uint16_t>(data, offset, init, average);
-                    break;
-                } case TYPE_INT32: {
-                    int32_t init = 0;
-                    count = getAvg<int32_t>(data, offset, init, average);
-                    break;
-                } case TYPE_UINT32: {
-                    uint32_t init = 0;
-                    count = getAvg<uint32_t>(data, offset, init, average);
-                    break;
-                } case TYPE_INT64: {
-                    int64_t init = 0;
-                    count = getAvg<int64_t>(data, offset, init, average);
-                    break;
-                } case TYPE_UINT64: {
-                    uint64_t init = 0;
-                    count = getAvg<uint64_t>(data, offset, init, average);
-                    break;
-                } case TYPE_BOOL: {
-                    bool init = 0;
-                    count = getAvg<bool>(data, offset, init, average);
-                    break;
-                } case TYPE_FLOAT: {
-                    float init = 0;
-                    count = getAvg<float>(data, offset, init, average);
-                    break;
-                } case TYPE_DOUBLE: {
-                    double init = 0;
-                    count = getAvg<double>(data, offset, init, average);
-                    break;
-                } default: 
-                    return 1;
-            }
-            memcpy(pointer_convert<char*>(result) + 1, &average, sizeof(average));
-            pointer_convert<char*>(result)[0] = '\xff';
-            if (!count) memset(result, 0x00, sizeof(average) + 1);
-            return 0;
+            return aggregate(data, FUNC_AVG, offset, type, 0, result);
         }
         int max(const std::vector<void*>& data, const uint64 offset, 
                 const uint64 type, const uint64 length, void* result) const {
-            MinGenerator minGenerator;
-            minGenerator(type, result, length);
-            uint64 count;
-            switch (type) {
-                case TYPE_INT8: 
-                    count = getMax<int8_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_UINT8: 
-                    count = getMax<uint8_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_INT16:
-                    count = getMax<int16_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_UINT16:
-                    count = getMax<uint16_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_INT32:
-                    count = getMax<int32_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_UINT32:
-                    count = getMax<uint32_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_INT64:
-                    count = getMax<int64_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_UINT64:
-                    count = getMax<uint64_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_BOOL:
-                    count = getMax<bool>(data, type, offset, length, result);
-                    break;
-                case TYPE_CHAR:
-                    count = getMax<char>(data, type, offset, length, result);
-                    break;
-                case TYPE_UCHAR:
-                    count = getMax<unsigned char>(data, type, offset, length, result);
-                    break;
-                case TYPE_FLOAT:
-                    count = getMax<float>(data, type, offset, length, result);
-                    break;
-                case TYPE_DOUBLE:
-                    count = getMax<double>(data, type, offset, length, result);
-                    break;
-                default:
-                    return 1;
-            }
-            if (!count) memset(result, 0x00, length);
-            return 0;
+            return aggregate(data, FUNC_MAX, offset, type, length, result);
         }
         int min(const std::vector<void*>& data, const uint64 offset, 
                 const uint64 type, const uint64 length, void* result) const {
-            memset(result, 0x00, length);
-            uint64 count;
-            switch (type) {
-                case TYPE_INT8: 
-                    count = getMin<int8_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_UINT8: 
-                    count = getMin<uint8_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_INT16:
-                    count = getMin<int16_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_UINT16:
-                    count = getMin<uint16_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_INT32:
-                    count = getMin<int32_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_UINT32:
-                    count = getMin<uint32_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_INT64:
-                    count = getMin<int64_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_UINT64:
-                    count = getMin<uint64_t>(data, type, offset, length, result);
-                    break;
-                case TYPE_BOOL:
-                    count = getMin<bool>(data, type, offset, length, result);
-                    break;
-                case TYPE_CHAR:
-                    count = getMin<char>(data, type, offset, length, result);
-                    break;
-                case TYPE_UCHAR:
-                    count = getMin<unsigned char>(data, type, offset, length, result);
-                    break;
-                case TYPE_FLOAT:
-                    count = getMin<float>(data, type, offset, length, result);
-                    break;
-                case TYPE_DOUBLE:
-                    count = getMin<double>(data, type, offset, length, result);
-                    break;
-                default:
-                    return 1;
-            }
-            if (!count) memset(result, 0x00, length);
-            return 0;
+            return aggregate(data, FUNC_MIN, offset, type, length, result);
         }
 
     private:
-        template <class T, class T1>
-        uint64 getSum(const std::vector<void*>& data, const uint64 offset, T& initial, T1& result) const {
-            uint64 count = 0;
-            result = initial;
-            for (const auto p: data) {
-                // if is null, ignore
-                if (pointer_convert<const char*>(p)[offset] == '\x00') continue;
-                ++count;
-                result += *pointer_convert<const T*>(pointer_convert<const char*>(p) + 1 + offset);
-            }
-            return count;
-        }
-        template <class T>
-        uint64 getAvg(const std::vector<void*>& data, const uint64 offset ,T& initial, double& result) const {
-            result = 0;
-            uint64 count = getSum(data, offset, initial, result);
-            if (count) result = result / count;
-            return count;
+        int aggregate(const std::vector<void*>& data, const uint64 func, const uint64 offset, 
+                      const uint64 type, const uint64 length, void* result) const {
+            if (func != FUNC_COUNT && !applicable(func, type)) return 1;
+            State state;
+            for (const auto d: data)
+                update(state, func, pointer_convert<const char*>(d) + offset, type, length);
+            finalize(state, func, type, length, result);
+            return 0;
         }
+
+        // read number of type, convert to T
         template <class T>
-        uint64 getMax(const std::vector<void*>& data, const uint64 type, const uint64 offset, const uint64 length, void* initial) const {
-            Comparator comp;
-            comp.type = type;
-            uint64 count = 0;
-            for (std::size_t i = 0; i < data.size(); ++i) {
-                if (pointer_convert<const char*>(data[i])[offset] == '\x00') continue;
-                ++count;
-                if (comp(pointer_convert<const char*>(data[i]) + offset, initial, length) > 0)
-                    memcpy(initial, pointer_convert<const char*>(data[i]) + offset, length);
+        static T readNumber(const char* data, const uint64 type) {
+            switch (type) {
+                case TYPE_INT8: return readNumber<T, int8_t>(data);
+                case TYPE_UINT8: return readNumber<T, uint8_t>(data);
+                case TYPE_INT16: return readNumber<T, int16_t>(data);
+                case TYPE_UINT16: return readNumber<T, uint16_t>(data);
+                case TYPE_INT32: return readNumber<T, int32_t>(data);
+                case TYPE_UINT32: return readNumber<T, uint32_t>(data);
+                case TYPE_INT64: return readNumber<T, int64_t>(data);
+                case TYPE_UINT64: return readNumber<T, uint64_t>(data);
+                case TYPE_BOOL: return readNumber<T, bool>(data);
+                case TYPE_FLOAT: return readNumber<T, float>(data);
+                case TYPE_DOUBLE: return readNumber<T, double>(data);
+                default: assert(0);
             }
-            return count;
+            return T();
         }
-        template <class T>
-        uint64 getMin(const std::vector<void*>& data, const uint64 type, const uint64 offset, const uint64 length, void* initial) const {
-            Comparator comp;
-            comp.type = type;
-            uint64 count = 0;
-            for (std::size_t i = 0; i < data.size(); ++i) {
-                if (pointer_convert<const char*>(data[i])[offset] == '\x00') continue;
-                ++count;
-                if (comp(pointer_convert<const char*>(data[i]) + offset, initial, length) < 0)
-                    memcpy(initial, pointer_convert<const char*>(data[i]) + offset, length);
-            }
-            return count;
+        template <class T, class U>
+        static T readNumber(const char* data) {
+            U value;
+            memcpy(&value, data, sizeof(U));
+            return static_cast<T>(value);
         }
     };
 
@@ -800,8 +803,109 @@ public:
         }
     };
 
+    struct KeyGenerator {
+        // generate a binary comparable key of data, append it to key
+        // keys compared with memcmp are in the same order as Comparator
+        // i.e. null is larger than non-null, chars are case insensitive
+        // keys of the same type and length are of the same length
+        void operator()(const void* data, const uint64 type, const uint64 length, std::string& key) const {
+            const char* buff = pointer_convert<const char*>(data);
+            // null flag, 0x00 for not null, 0x01 for null
+            if (buff[0] == '\x00') {
+                key.push_back('\x01');
+                key.append(keyLength(type, length) - 1, '\x00');
+                return;
+            }
+            key.push_back('\x00');
+            ++buff;
+            switch (type) {
+                case TYPE_INT8:
+                    appendInteger<int8_t, uint8_t>(buff, key);
+                    break;
+                case TYPE_UINT8:
+                    appendInteger<uint8_t, uint8_t>(buff, key);
+                    break;
+                case TYPE_INT16:
+                    appendInteger<int16_t, uint16_t>(buff, key);
+                    break;
+                case TYPE_UINT16:
+                    appendInteger<uint16_t, uint16_t>(buff, key);
+                    break;
+                case TYPE_INT32:
+                    appendInteger<int32_t, uint32_t>(buff, key);
+                    break;
+                case TYPE_UINT32:
+                    appendInteger<uint32_t, uint32_t>(buff, key);
+                    break;
+                case TYPE_INT64:
+                    appendInteger<int64_t, uint64_t>(buff, key);
+                    break;
+                case TYPE_UINT64:
+                    appendInteger<uint64_t, uint64_t>(buff, key);
+                    break;
+                case TYPE_BOOL:
+                    key.push_back(*pointer_convert<const bool*>(buff)? '\x01': '\x00');
+                    break;
+                case TYPE_CHAR:
+                case TYPE_UCHAR: {
+                    // Comparator compares null flag and the first length - 2 chars,
+                    // and stops at '\0'
+                    bool end = 0;
+                    for (uint64 i = 0; i + 2 < length; ++i) {
+                        char c = end? '\x00': buff[i];
+                        if (c == '\x00') end = 1;
+                        key.push_back(c >= 'A' && c <= 'Z'? c - 'A' + 'a': c);
+                    }
+                    break;
+                } case TYPE_FLOAT: {
+                    float x = *pointer_convert<const float*>(buff);
+                    // -0.0 == 0.0
+                    if (x == 0) x = 0;
+                    uint32_t bits;
+                    memcpy(&bits, &x, sizeof(bits));
+                    bits = bits & 0x80000000u? ~bits: bits | 0x80000000u;
+                    appendBigEndian(bits, key);
+                    break;
+                } case TYPE_DOUBLE: {
+                    double x = *pointer_convert<const double*>(buff);
+                    if (x == 0) x = 0;
+                    uint64_t bits;
+                    memcpy(&bits, &x, sizeof(bits));
+                    bits = bits & 0x8000000000000000ull? ~bits: bits | 0x8000000000000000ull;
+                    appendBigEndian(bits, key);
+                    break;
+                } default:
+                    assert(0);
+            }
+        }
+
+        // length of keys generated from data of type and length
+        static uint64 keyLength(const uint64 type, const uint64 length) {
+            if (type == TYPE_CHAR || type == TYPE_UCHAR)
+                return 1 + (length > 2? length - 2: 0);
+            return 1 + typeLength(type);
+        }
+
+    private:
+        template <class T, class U>
+        static void appendInteger(const char* data, std::string& key) {
+            T x;
+            memcpy(&x, data, sizeof(T));
+            U u = static_cast<U>(x);
+            // flip sign bit so that negative numbers are smaller
+            if (std::numeric_limits<T>::is_signed)
+                u ^= static_cast<U>(U(1) << (sizeof(U) * 8 - 1));
+            appendBigEndian(u, key);
+        }
+        template <class U>
+        static void appendBigEndian(const U u, std::string& key) {
+            for (std::size_t i = sizeof(U); i > 0; --i)
+                key.push_back(static_cast<char>(u >> ((i - 1) * 8)));
+        }
+    };
+
 public:
-    DBFields(): _total_length(0), 
+    DBFields(): _total_length(0),
                 _primary_key_field_id(std::numeric_limits<decltype(_primary_key_field_id)>::max()) { }
     ~DBFields() { }
 
@@ -1023,6 +1127,12 @@ private:
 
 // move these definitions to seperate cc file if multi-definition errors when compiling
 constexpr Database::uint64 Database::DBFields::TYPE_UINT64;
+constexpr Database::uint64 Database::DBFields::Aggregator::FUNC_COUNT;
+constexpr Database::uint64 Database::DBFields::Aggregator::FUNC_SUM;
+constexpr Database::uint64 Database::DBFields::Aggregator::FUNC_AVG;
+constexpr Database::uint64 Database::DBFields::Aggregator::FUNC_MAX;
+constexpr Database::uint64 Database::DBFields::Aggregator::FUNC_MIN;
+constexpr Database::uint64 Database::DBFields::Aggregator::FUNC_COUNT_ALL;
 
 const std::map< std::tuple<std::string, bool, bool>, 
                            std::tuple<Database::uint64, Database::uint64, bool> > Database::DBFields::datatype_map = { 
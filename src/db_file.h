@@ -19,16 +19,20 @@
 #include <cstring>
 #include <cassert>
 #include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
 #include "db_common.h"
 
 class Database::DBFile {
 public:
     DBFile(const std::string& filename): _file(filename),
                                          _page_size(0),
-                                         _num_pages(0) { }
+                                         _num_pages(0),
+                                         _fd(-1) { }
 
     ~DBFile() {
         _fs.close();
+        if (_fd != -1) ::close(_fd);
     }
 
     // opens an existing data file.
@@ -45,6 +49,12 @@ public:
         // open failed
         if (!isopen()) return 0;
 
+        // for reading pages at positions, which needs no seeking
+        _fd = ::open(_file.c_str(), O_RDONLY);
+        if (_fd == -1) {
+            _fs.close();
+            return 0;
+        }
 
         // read file header
         _fs.seekg(0);
@@ -105,6 +115,8 @@ public:
         if (!isopen()) return 1;
         _fs.close();
         if (isopen()) return 1;
+        ::close(_fd);
+        _fd = -1;
         _num_pages = 0;
         _page_size = 0;
         return 0;
@@ -120,6 +132,7 @@ public:
     }
 
     // write data in buffer to Page i
+    // data is flushed, so it can be read by readPageAt() at once
     void writePage(const uint64 i, const char* buffer) {
         _fs.seekp(_page_size * i);
         _fs.write(buffer, _page_size);
@@ -132,6 +145,7 @@ public:
             _fs.seekp(0);
             _fs.write(buffer2, sizeof(_num_pages) + sizeof(_num_pages));
         }
+        _fs.flush();
     }
 
     // read data in Page i to buffer
@@ -141,6 +155,30 @@ public:
         assert(_fs.gcount() > 0 && uint64(_fs.gcount()) == _page_size);
     }
 
+    // read data in Page i to buffer without moving file position,
+    // can be called by multiple threads, while no one is writing Page i
+    // a page counted in header but never written is read as zeros
+    // assert file is open
+    void readPageAt(const uint64 i, char* buffer) const {
+        assert(_fd != -1);
+        uint64 done = 0;
+        while (done < _page_size) {
+            ssize_t n = ::pread(_fd, buffer + done, _page_size - done, _page_size * i + done);
+            assert(n >= 0);
+            if (n <= 0) break;
+            done += n;
+        }
+        memset(buffer + done, 0x00, _page_size - done);
+    }
+
+    // flush data written to disk
+    // returns 0 if succeed, 1 otherwise
+    bool sync() {
+        if (_fd == -1) return 1;
+        _fs.flush();
+        return ::fdatasync(_fd) != 0;
+    }
+
     uint64 pageSize() const { return _page_size; }
 
     uint64 numPages() const { return _num_pages; }
@@ -160,6 +198,8 @@ private:
     uint64 _num_pages;
     // file input and output stream
     std::fstream _fs;
+    // file descriptor for readPageAt(), -1 if not open
+    int _fd;
 
 
 };
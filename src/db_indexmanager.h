@@ -264,6 +264,13 @@ class Database::DBIndexManager {
     };
 
 
+    // track different level of BTreeNode during search
+    // record the position and offset of every node from root to the target
+    struct Level {
+        uint64 _block;
+        uint64 _offset;
+    };
+
 public:
     DBIndexManager(const std::string& file): _num_pages(0), _page_size(0), _data_length(0), _num_records(0), _file(file)
     { _node_tracker = nullptr; }
@@ -632,6 +639,95 @@ public:
         }
     }
 
+    // position of an ordered traversal, which can be resumed later
+    // cursor gets invalid once the index is modified
+    class Cursor {
+        friend class DBIndexManager;
+        std::stack<Level> _level;
+        bool _end;
+        // 1 if records are traversed in descending order
+        // offset of leaf node is then the one after next record
+        bool _backward;
+    public:
+        Cursor(): _end(1), _backward(0) { }
+        // returns 1 if no more records
+        bool end() const { return _end; }
+    };
+
+    // get cursor pointing to the first record
+    Cursor firstRecord() {
+        Cursor cursor;
+        _level = std::stack<Level>();
+        _level.push(Level());
+        _node_tracker = &_root;
+        _level.top()._offset = 0;
+        _level.top()._block = 1;
+        findFirstNode();
+        cursor._level = _level;
+        cursor._end = 0;
+        return cursor;
+    }
+
+    // get cursor pointing to the last record, 
+    // which traverses records in descending order
+    Cursor lastRecord() {
+        Cursor cursor;
+        _level = std::stack<Level>();
+        _level.push(Level());
+        _node_tracker = &_root;
+        _level.top()._block = 1;
+        _level.top()._offset = _root._size - 1;
+        findLastSubNode();
+        _level.top()._offset = _node_tracker->_size;
+        cursor._level = _level;
+        cursor._end = 0;
+        cursor._backward = 1;
+        return cursor;
+    }
+
+    // traverse at most n records from cursor in its order,
+    // and move cursor to the record after them
+    // callback function is like: void func(const char* key, const RID rid)
+    // returns number of records traversed
+    template<class CALLBACKFUNC>
+    uint64 traverseRecords(Cursor& cursor, const uint64 n, CALLBACKFUNC func) {
+        if (cursor._end) return 0;
+        _level = cursor._level;
+        getBuffer(_level.top()._block);
+        uint64 count = 0;
+        while (cursor._backward && count < n) {
+            uint64 off = _level.top()._offset;
+            // beginning of this leaf node
+            if (off == 0) {
+                if (!findPrevNode()) {
+                    cursor._end = 1;
+                    break;
+                }
+                _level.top()._offset = _node_tracker->_size;
+                continue;
+            }
+            func(_node_tracker->getKey(off - 1), decode(_node_tracker->getPosition(off - 1)));
+            _level.top()._offset = off - 1;
+            ++count;
+        }
+        while (!cursor._backward && count < n) {
+            uint64 off = _level.top()._offset;
+            // end of this leaf node
+            if (off >= _node_tracker->_size) {
+                if (!findNextNode()) {
+                    cursor._end = 1;
+                    break;
+                }
+                continue;
+            }
+            func(_node_tracker->getKey(off), decode(_node_tracker->getPosition(off)));
+            _level.top()._offset = off + 1;
+            ++count;
+        }
+        cursor._level = _level;
+        return count;
+    }
+
     uint64 getNumRecords() {
         return _num_records;
     }
@@ -740,6 +836,43 @@ private:
         return true;
     }
 
+    // find previous record according to the current one
+    // return false if there is no previous node to find
+    bool findPrevNode() {
+        if (_level.size() == 1)
+            return false;
+
+        // search up to the common parent
+        uint64 off, pos;
+        while(true) {
+            _level.pop();
+            pos = _level.top()._block;
+            off = _level.top()._offset;
+            getBuffer(pos);
+            if(off > 0)
+                break;
+            if (_level.size() == 1)
+                return false;
+        }
+        _level.top()._offset = off - 1;
+
+        // search down and find the previous node
+        findLastSubNode();
+        return true;
+    }
+
+    // find the last leaf node according to current node
+    // the results are stored in _level and _node_tracker pointed to the node
+    void findLastSubNode() {
+        while(_node_tracker->_leaf == 0) {
+            uint64 next = _node_tracker->getPosition(_level.top()._offset);
+            _level.push(Level());
+            _level.top()._block = next;
+            getBuffer(next);
+            _level.top()._offset = _node_tracker->_size - 1;
+        }
+    }
+
 // private buffer operations
     void initBuffer() {
         for(uint64 i=0; i<BUFFER_SIZE; i++) {
@@ -1170,12 +1303,6 @@ private:
 // members of IndexManager
     static constexpr uint64 BUFFER_SIZE = 256;
 
-    // track different level of BTreeNode during search
-    // record the position and offset of every node from root to the target
-    struct Level {
-        uint64 _block;
-        uint64 _offset;
-    };
     std::stack<Level> _level;
 
 
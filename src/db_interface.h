@@ -16,82 +16,166 @@
 #define DB_INTERFACE_H_
 
 #include "db_common.h"
-#include <queue>
+#include <cstring>
 #include <string>
+#include <boost/utility/string_ref.hpp>
 
+// split input into statements ending with ';'
+// input is scanned in place, statements are returned as references to buffer
+// except those with escape characters or comments, which are rewritten
 class Database::DBInterface {
 
 public:
-    DBInterface(): _in_quote(0), _escaped(0), _in_comment(0) { }
+    DBInterface(): _start(0), _pos(0), _in_quote(0), _escaped(0), _in_comment(0), _rewrite(0) { }
     ~DBInterface() { }
 
+    // append input, statements returned by next() are invalidated
+    void feed(const char* data, const uint64 length) { 
+        // discard statements already returned
+        _buff.erase(0, _start);
+        _pos -= _start;
+        _start = 0;
+        _buff.append(data, length);
+    }
+
     void feed(const std::string& str) { 
-        for (const auto c: str) {
+        feed(str.data(), str.length());
+    }
+
+    // get next complete statement, trimmed
+    // returns 1 if there's a statement, 0 if more input is needed
+    bool next(boost::string_ref& statement) {
+        if (!scan()) return 0;
+        const char* begin = _buff.data() + _start;
+        const char* end = _buff.data() + _pos;
+        _start = _pos;
+        if (_rewrite) {
+            _rewrite = 0;
+            rewrite(begin, end);
+            begin = _statement.data();
+            end = begin + _statement.length();
+        }
+        statement = trim(begin, end);
+        return 1;
+    }
+
+    bool emptyBuff() const {
+        // only spaces and comments remain
+        bool in_comment = 0;
+        for (std::size_t i = _start; i < _buff.length(); ++i) {
+            if (in_comment) in_comment = _buff[i] != '\n';
+            else if (_buff[i] == '#') in_comment = 1;
+            else if (!isSpace(_buff[i])) return 0;
+        }
+        return 1;
+    }
+
+private:
+    // move _pos to the end of next statement
+    // returns 1 if a statement ends, 0 if input is exhausted
+    bool scan() {
+        const char* data = _buff.data();
+        const char* end = data + _buff.length();
+        while (_pos < _buff.length()) {
+            const char* p = data + _pos;
             if (_in_comment) {
-                if (c == '\n') {
-                    _in_comment = 0;
-                    _buff += c;
+                const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+                if (!newline) {
+                    _pos = _buff.length();
+                    break;
                 }
+                _pos = newline - data + 1;
+                _in_comment = 0;
                 continue;
-            } else if (_escaped) {
+            } 
+            if (_escaped) {
                 _escaped = 0;
+                ++_pos;
+                continue;
+            }
+
+            // in quote, only quote and escape character matter
+            while (p != end && !(_in_quote? (*p == '\'' || *p == '\\'): isSpecial(*p))) ++p;
+            _pos = p - data;
+            if (p == end) break;
+
+            ++_pos;
+            switch (*p) {
+                case '\\':
+                    _escaped = 1;
+                    _rewrite = 1;
+                    break;
+                case '\'':
+                    _in_quote = !_in_quote;
+                    break;
+                case ';':
+                    return 1;
+                case '#':
+                    _in_comment = 1;
+                    _rewrite = 1;
+                    break;
+            }
+        }
+        return 0;
+    }
+
+    // rewrite statement to _statement, escape characters are converted and comments are removed
+    void rewrite(const char* begin, const char* end) {
+        _statement.clear();
+        bool in_quote = 0, escaped = 0, in_comment = 0;
+        for (const char* p = begin; p != end; ++p) {
+            const char c = *p;
+            if (in_comment) {
+                if (c == '\n') {
+                    in_comment = 0;
+                    _statement += c;
+                }
+                continue;
+            } else if (escaped) {
+                escaped = 0;
                 switch (c) {
-                    case 'b': _buff += '\b'; break;
-                    case 'n': _buff += '\n'; break;
-                    case 'r': _buff += '\r'; break;
-                    case 't': _buff += '\t'; break;
-                    case '\'': _buff += "\\\'"; break;
-                    case '\\': _buff += "\\\\"; break;
-                    default : _buff += c;
+                    case 'b': _statement += '\b'; break;
+                    case 'n': _statement += '\n'; break;
+                    case 'r': _statement += '\r'; break;
+                    case 't': _statement += '\t'; break;
+                    case '\'': _statement += "\\\'"; break;
+                    case '\\': _statement += "\\\\"; break;
+                    default : _statement += c;
                 }
             } else {
                 switch (c) {
                     case '\\':
-                        _escaped = 1;
+                        escaped = 1;
                         break;
                     case '\'':
-                        _in_quote = !_in_quote;
-                        _buff += c;
-                        break;
-                    case ';':
-                        _buff += c;
-                        if (!_in_quote) {
-                            _commands.push(trim(_buff));
-                            _buff.clear();
-                        }
+                        in_quote = !in_quote;
+                        _statement += c;
                         break;
                     case '#':
-                        if (!_in_quote) _in_comment = 1;
-                        else _buff += c;
+                        if (!in_quote) in_comment = 1;
+                        else _statement += c;
                         break;
                     default:
-                        _buff += c;
+                        _statement += c;
                 }
             }
         }
     }
 
-    bool ready() const {
-        return _commands.size();
-    }
-
-    bool emptyBuff() const {
-        return !trim(_buff).size();
+    static bool isSpecial(const char c) {
+        return c == '\'' || c == ';' || c == '#' || c == '\\';
     }
 
-    std::string get() {
-        std::string tmp = _commands.front();
-        _commands.pop();
-        return tmp;
+    static bool isSpace(const char c) {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r';
     }
 
-private:
-    std::string trim(std::string str) const {
+    static boost::string_ref trim(const char* begin, const char* end) {
         // prefixing spaces
-        str.erase(0, str.find_first_not_of(" \n\t\r")); 
+        while (begin != end && isSpace(*begin)) ++begin;
         // suffixing spaces
-        str.erase(str.find_last_not_of(" \n\t\r") + 1);
-        return str;
+        while (begin != end && isSpace(end[-1])) --end;
+        return boost::string_ref(begin, end - begin);
     }
 
     // copy is forbidden
@@ -100,13 +184,19 @@ private:
     DBInterface& operator=(const DBInterface&)& = delete;
     DBInterface& operator=(DBInterface&&)& = delete;
 
+    // unsplitted input, statements returned are _buff[0, _start)
     std::string _buff;
+    // statement rewritten
+    std::string _statement;
+    // start of current statement
+    uint64 _start;
+    // scanned to
+    uint64 _pos;
     bool _in_quote;
     bool _escaped;
     bool _in_comment;
-
-    std::queue<std::string> _commands;
-
+    // current statement contains escape characters or comments
+    bool _rewrite;
 
 };
 
@@ -0,0 +1,91 @@
+/******************************************************************************
+ *  Copyright (c) 2014-2015 Jamis Hoo
+ *  Distributed under the MIT license
+ *  (See accompanying file LICENSE or copy at http://opensource.org/licenses/MIT)
+ *
+ *  Project: Database
+ *  Filename: db_ioqueue.h
+ *  Version: 1.0
+ *  Author: Jamis Hoo
+ *  E-mail: hjm211324@gmail.com
+ *  Description: Queue of asynchronous disk reads, served by I/O threads.
+ *               Threads of the queue are shared by all buffers,
+ *               so many page reads can be in flight at the same time.
+ *****************************************************************************/
+#ifndef DB_IOQUEUE_H_
+#define DB_IOQUEUE_H_
+
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "db_common.h"
+
+class Database::DBIOQueue {
+public:
+    // reads in flight at most, one per thread
+    static constexpr uint64 DEFAULT_THREADS = 8;
+
+    DBIOQueue(const uint64 num_threads): _stop(0) {
+        assert(num_threads);
+        for (uint64 i = 0; i < num_threads; ++i)
+            _threads.emplace_back([this]() { work(); });
+    }
+
+    // requests already submitted are finished before destruction
+    ~DBIOQueue() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = 1;
+        }
+        _wakeup.notify_all();
+        for (auto& thread: _threads) thread.join();
+    }
+
+    DBIOQueue(const DBIOQueue&) = delete;
+    DBIOQueue& operator=(const DBIOQueue&) = delete;
+
+    // queue shared by all buffers, created when first used
+    static DBIOQueue& shared() {
+        static DBIOQueue queue(DEFAULT_THREADS);
+        return queue;
+    }
+
+    // run request in an I/O thread, requests are started in order of submission
+    // request must not throw
+    void submit(std::function<void()> request) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _requests.push_back(std::move(request));
+        }
+        _wakeup.notify_one();
+    }
+
+private:
+    void work() {
+        while (true) {
+            std::function<void()> request;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wakeup.wait(lock, [this]() { return _stop || !_requests.empty(); });
+                if (_requests.empty()) return;
+                request = std::move(_requests.front());
+                _requests.pop_front();
+            }
+            request();
+        }
+    }
+
+    std::vector<std::thread> _threads;
+    std::deque< std::function<void()> > _requests;
+    bool _stop;
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+};
+
+constexpr Database::uint64 Database::DBIOQueue::DEFAULT_THREADS;
+
+#endif /* DB_IOQUEUE_H_ */
@@ -0,0 +1,444 @@
+/******************************************************************************
+ *  Copyright (c) 2014-2015 Jamis Hoo
+ *  Distributed under the MIT license
+ *  (See accompanying file LICENSE or copy at http://opensource.org/licenses/MIT)
+ *
+ *  Project: Database
+ *  Filename: db_lockmanager.h
+ *  Version: 1.0
+ *  Author: Jamis Hoo
+ *  E-mail: hjm211324@gmail.com
+ *  Description: Locks of transactions on a database, its tables and their records.
+ *               Tables and the database are locked in intention modes before
+ *               records and tables in them. Locks are held until transactions end.
+ *               A request not granted waits in queue of the lock, after those before it,
+ *               and is refused if the waiting would deadlock.
+ *****************************************************************************/
+
+/****************************************
+ *  Records are only locked exclusively, to be changed, inserted or removed.
+ *  Values of primary keys are locked exclusively too, to insert or remove records with them,
+ *  so a key removed and not committed is not taken by others.
+ *  Besides its mode, a table lock has fields read by predicates, of records not locked,
+ *  and fields changed in records locked exclusively, which are all fields for insertion
+ *  and removal. Fields read by one conflict with those changed by another,
+ *  so a predicate never sees changes not committed.
+ *
+ *  Nobody waits inside the lock manager. A request not granted is queued,
+ *  and the transaction is expected to request it again after those it waits for end,
+ *  keeping its place in the queue.
+ *  A transaction waits for at most one lock at a time, requesting another gives up the former.
+ *******************************************************/
+
+#ifndef DB_LOCKMANAGER_H_
+#define DB_LOCKMANAGER_H_
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "db_common.h"
+
+class Database::DBLockManager {
+public:
+    // lock modes
+    // intention shared, intention exclusive, shared, shared with intention exclusive, exclusive
+    static constexpr uint64 IS = 0;
+    static constexpr uint64 IX = 1;
+    static constexpr uint64 S = 2;
+    static constexpr uint64 SIX = 3;
+    static constexpr uint64 X = 4;
+
+    // lock table is divided into shards by hash of keys, each of which has its own mutex
+    static constexpr uint64 NUM_SHARDS = 16;
+    // a transaction locking more records of a table locks the table exclusively instead, if it can
+    static constexpr uint64 MAX_RECORD_LOCKS = 4096;
+    // bits of all fields, which are changed by insertion and removal of records
+    static constexpr uint64 ALL_FIELDS = ~uint64(0);
+
+    DBLockManager() { }
+
+    DBLockManager(const DBLockManager&) = delete;
+    DBLockManager& operator=(const DBLockManager&) = delete;
+
+    // bit of field field_id in fields of table locks
+    // fields after the 63rd share the last bit
+    static uint64 fieldBit(const uint64 field_id) {
+        return uint64(1) << std::min<uint64>(field_id, 63);
+    }
+
+    // lock database in mode for txn
+    // returns 0 if granted, 1 if txn has to wait, 2 if waiting would deadlock
+    int lockDatabase(const uint64 txn, const uint64 mode) {
+        return request(Key(), txn, mode, 0, 0, 1);
+    }
+
+    // lock table in mode for txn, fields whose bits are set in read are read from
+    // records of it not locked by txn, database is locked in intention mode first
+    // returns 0 if granted, 1 if txn has to wait, 2 if waiting would deadlock
+    int lockTable(const uint64 txn, const std::string& table, const uint64 mode, const uint64 read = 0) {
+        const int rtv = lockDatabase(txn, mode == IS || mode == S? IS: IX);
+        if (rtv) return rtv;
+        return request(Key(table), txn, mode, read, 0, 1);
+    }
+
+    // lock record rid of table exclusively for txn, to change fields whose bits are set in write
+    // table is locked in IX mode first, and exclusively instead of records
+    // after MAX_RECORD_LOCKS records and keys of it are locked
+    // if wait is 0, a record locked by others is not waited for
+    // returns 0 if granted, 1 if txn has to wait, 2 if waiting would deadlock
+    int lockRecord(const uint64 txn, const std::string& table, const RID rid, 
+                   const uint64 write, const bool wait = 1) {
+        return lockItem(txn, Key(table, rid), write, wait);
+    }
+
+    // lock value key of primary key of table exclusively for txn, to insert or remove
+    // records with it, table is locked as lockRecord() does
+    // returns 0 if granted, 1 if txn has to wait, 2 if waiting would deadlock
+    int lockKey(const uint64 txn, const std::string& table, const std::string& key) {
+        return lockItem(txn, Key(table, key), ALL_FIELDS, 1);
+    }
+
+    // stop waiting of txn, if it no longer needs the lock
+    void cancel(const uint64 txn) {
+        std::lock_guard<std::mutex> lock(_waits_mutex);
+        auto ite = _waits.find(txn);
+        if (ite == _waits.end()) return;
+        dequeue(ite->second, txn);
+        _waits.erase(ite);
+    }
+
+    // release all locks of txn and stop its waiting, when it ends
+    void release(const uint64 txn) {
+        for (Shard& shard: _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto ite = shard.keys.find(txn);
+            if (ite == shard.keys.end()) continue;
+            for (const Key& key: ite->second) {
+                auto lock_ite = shard.locks.find(key);
+                if (lock_ite == shard.locks.end()) continue;
+                removeRequests(lock_ite->second.granted, txn);
+                removeRequests(lock_ite->second.waiting, txn);
+                if (lock_ite->second.granted.empty() && lock_ite->second.waiting.empty())
+                    shard.locks.erase(lock_ite);
+            }
+            shard.keys.erase(ite);
+        }
+        std::lock_guard<std::mutex> lock(_waits_mutex);
+        _waits.erase(txn);
+    }
+
+    // transactions txn waits for, which hold or wait before it for the lock it waits for
+    void blockers(const uint64 txn, std::vector<uint64>& result) {
+        std::lock_guard<std::mutex> lock(_waits_mutex);
+        result.clear();
+        blockersOf(txn, result);
+    }
+
+    // whether txn holds or waits for any lock
+    bool active(const uint64 txn) {
+        for (Shard& shard: _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (shard.keys.count(txn)) return 1;
+        }
+        return 0;
+    }
+
+    // transactions holding or waiting for locks
+    void transactions(std::vector<uint64>& result) {
+        std::unordered_set<uint64> txns;
+        for (Shard& shard: _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& k: shard.keys) txns.insert(k.first);
+        }
+        result.assign(txns.begin(), txns.end());
+    }
+
+    // drop all locks, when no transaction goes on
+    void clear() {
+        for (Shard& shard: _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.locks.clear();
+            shard.keys.clear();
+        }
+        std::lock_guard<std::mutex> lock(_waits_mutex);
+        _waits.clear();
+    }
+
+private:
+    // database, table, record of table, or value of primary key of table
+    struct Key {
+        std::string table;
+        RID rid;
+        // value of primary key, of key locks
+        std::string value;
+        Key(): rid(0, 0) { }
+        explicit Key(const std::string& t): table(t), rid(0, 0) { }
+        Key(const std::string& t, const RID r): table(t), rid(r) { }
+        Key(const std::string& t, const std::string& v): table(t), rid(0, 0), value(v) { }
+        bool operator==(const Key& key) const { 
+            return rid == key.rid && table == key.table && value == key.value; 
+        }
+    };
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const {
+            return std::hash<std::string>()(key.table) ^ std::hash<std::string>()(key.value) ^
+                   std::hash<uint64>()(key.rid.pageID * 0x9e3779b97f4a7c15ULL + key.rid.slotID);
+        }
+    };
+    // lock held or waited by a transaction
+    struct Request {
+        uint64 txn;
+        uint64 mode;
+        // fields read and changed, of table locks
+        uint64 read;
+        uint64 write;
+        // records locked, of table locks
+        uint64 records;
+    };
+    struct Lock {
+        std::vector<Request> granted;
+        // in order of arrival
+        std::vector<Request> waiting;
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<Key, Lock, KeyHash> locks;
+        // transaction -> keys of locks it holds or waits for in this shard
+        std::unordered_map< uint64, std::vector<Key> > keys;
+    };
+
+    static bool conflicts(const Request& a, const Request& b) {
+        return !COMPATIBLE[a.mode][b.mode] || (a.read & b.write) || (a.write & b.read);
+    }
+
+    static void removeRequests(std::vector<Request>& requests, const uint64 txn) {
+        requests.erase(std::remove_if(requests.begin(), requests.end(),
+                                      [txn](const Request& r) { return r.txn == txn; }),
+                       requests.end());
+    }
+
+    static Request* find(std::vector<Request>& requests, const uint64 txn) {
+        for (auto& r: requests)
+            if (r.txn == txn) return &r;
+        return nullptr;
+    }
+
+    Shard& shard(const Key& key) {
+        return _shards[KeyHash()(key) % NUM_SHARDS];
+    }
+
+    // lock record or key of a table exclusively for txn, see lockRecord()
+    int lockItem(const uint64 txn, const Key& key, const uint64 write, const bool wait) {
+        int rtv = lockDatabase(txn, IX);
+        if (rtv) return rtv;
+        const Key table_key(key.table);
+        uint64 table_mode;
+        rtv = request(table_key, txn, IX, 0, write, 1, &table_mode);
+        if (rtv || table_mode == X) return rtv;
+
+        if (holds(key, txn)) return 0;
+        rtv = request(key, txn, X, 0, 0, wait);
+        if (rtv) return rtv;
+        if (countRecord(table_key, txn) > MAX_RECORD_LOCKS)
+            request(table_key, txn, X, 0, 0, 0);
+        return 0;
+    }
+
+    // request lock of key in mode for txn, with fields read and changed
+    // it's queued if not granted and wait is 1, and the waiting is checked for deadlock
+    // mode of lock held by txn is put into granted_mode if granted
+    // returns 0 if granted, 1 if txn has to wait, 2 if waiting would deadlock
+    int request(const Key& key, const uint64 txn, const uint64 mode,
+                const uint64 read, const uint64 write, const bool wait,
+                uint64* granted_mode = nullptr) {
+        Shard& shard = this->shard(key);
+        bool was_waiting;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            Lock& l = shard.locks[key];
+            Request* own = find(l.granted, txn);
+            Request wanted{ txn, mode, read, write, 0 };
+            if (own) {
+                wanted.mode = SUPREMUM[own->mode][mode];
+                wanted.read |= own->read;
+                wanted.write |= own->write;
+                wanted.records = own->records;
+                if (wanted.mode == own->mode && wanted.read == own->read && wanted.write == own->write) {
+                    if (granted_mode) *granted_mode = own->mode;
+                    return 0;
+                }
+            }
+
+            // conversions of locks held go before requests waiting
+            bool conflict = 0;
+            for (const auto& g: l.granted)
+                if (g.txn != txn && conflicts(wanted, g)) conflict = 1;
+            Request* queued = find(l.waiting, txn);
+            if (!own)
+                for (const auto& w: l.waiting) {
+                    if (&w == queued) break;
+                    if (conflicts(wanted, w)) conflict = 1;
+                }
+            was_waiting = queued;
+
+            if (!conflict) {
+                if (queued) removeRequests(l.waiting, txn);
+                if (own) {
+                    *own = wanted;
+                } else {
+                    l.granted.push_back(wanted);
+                    if (!was_waiting) shard.keys[txn].push_back(key);
+                }
+                if (granted_mode) *granted_mode = wanted.mode;
+            } else if (!wait) {
+                if (l.granted.empty() && l.waiting.empty()) shard.locks.erase(key);
+                return 1;
+            } else {
+                if (queued) {
+                    *queued = wanted;
+                } else {
+                    l.waiting.push_back(wanted);
+                    if (!own) shard.keys[txn].push_back(key);
+                }
+            }
+            if (!conflict && !was_waiting) return 0;
+        }
+
+        // shard mutex is not held with _waits_mutex locked, as in deadlock detection
+        std::lock_guard<std::mutex> lock(_waits_mutex);
+        auto ite = _waits.find(txn);
+        if (!waits(shard, key, txn)) {
+            // granted after waiting
+            if (ite != _waits.end() && ite->second == key) _waits.erase(ite);
+            return 0;
+        }
+        if (ite == _waits.end()) {
+            ite = _waits.emplace(txn, key).first;
+        } else if (!(ite->second == key)) {
+            // lock waited for before is no longer needed
+            dequeue(ite->second, txn);
+            ite->second = key;
+        }
+        if (!deadlocked(txn)) return 1;
+        // waiting is given up
+        _waits.erase(ite);
+        dequeue(key, txn);
+        return 2;
+    }
+
+    // remove request of txn waiting for lock of key
+    void dequeue(const Key& key, const uint64 txn) {
+        Shard& shard = this->shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto ite = shard.locks.find(key);
+        if (ite == shard.locks.end()) return;
+        removeRequests(ite->second.waiting, txn);
+        if (ite->second.granted.empty() && ite->second.waiting.empty())
+            shard.locks.erase(ite);
+    }
+
+    // whether txn waits for lock of key
+    bool waits(Shard& shard, const Key& key, const uint64 txn) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto ite = shard.locks.find(key);
+        return ite != shard.locks.end() && find(ite->second.waiting, txn);
+    }
+
+    // whether txn holds lock of key
+    bool holds(const Key& key, const uint64 txn) {
+        Shard& shard = this->shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto ite = shard.locks.find(key);
+        return ite != shard.locks.end() && find(ite->second.granted, txn);
+    }
+
+    // increase number of records locked by txn in table of table_key
+    // returns the number
+    uint64 countRecord(const Key& table_key, const uint64 txn) {
+        Shard& shard = this->shard(table_key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Request* own = find(shard.locks[table_key].granted, txn);
+        return own? ++own->records: 0;
+    }
+
+    // transactions txn waits for are put into result, with _waits_mutex held
+    void blockersOf(const uint64 txn, std::vector<uint64>& result) {
+        auto ite = _waits.find(txn);
+        if (ite == _waits.end()) return;
+        Shard& shard = this->shard(ite->second);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto lock_ite = shard.locks.find(ite->second);
+        if (lock_ite == shard.locks.end()) return;
+        Lock& l = lock_ite->second;
+        const Request* wanted = find(l.waiting, txn);
+        if (!wanted) return;
+        for (const auto& g: l.granted)
+            if (g.txn != txn && conflicts(*wanted, g)) result.push_back(g.txn);
+        if (find(l.granted, txn)) return;
+        for (const auto& w: l.waiting) {
+            if (&w == wanted) break;
+            if (conflicts(*wanted, w)) result.push_back(w.txn);
+        }
+    }
+
+    // whether txn waits for itself through those it waits for, with _waits_mutex held
+    bool deadlocked(const uint64 txn) {
+        std::vector<uint64> stack(1, txn);
+        std::unordered_set<uint64> visited;
+        std::vector<uint64> next;
+        while (!stack.empty()) {
+            const uint64 t = stack.back();
+            stack.pop_back();
+            next.clear();
+            blockersOf(t, next);
+            for (const uint64 u: next) {
+                if (u == txn) return 1;
+                if (visited.insert(u).second) stack.push_back(u);
+            }
+        }
+        return 0;
+    }
+
+    // COMPATIBLE[a][b]: whether modes a and b can be held by different transactions
+    static constexpr bool COMPATIBLE[5][5] = {
+        /*          IS IX  S SIX X */
+        /* IS  */ { 1, 1, 1, 1, 0 },
+        /* IX  */ { 1, 1, 0, 0, 0 },
+        /* S   */ { 1, 0, 1, 0, 0 },
+        /* SIX */ { 1, 0, 0, 0, 0 },
+        /* X   */ { 0, 0, 0, 0, 0 }
+    };
+    // SUPREMUM[a][b]: the weakest mode as strong as both a and b
+    static constexpr uint64 SUPREMUM[5][5] = {
+        /*          IS   IX   S    SIX  X */
+        /* IS  */ { IS,  IX,  S,   SIX, X },
+        /* IX  */ { IX,  IX,  SIX, SIX, X },
+        /* S   */ { S,   SIX, S,   SIX, X },
+        /* SIX */ { SIX, SIX, SIX, SIX, X },
+        /* X   */ { X,   X,   X,   X,   X }
+    };
+
+    std::array<Shard, NUM_SHARDS> _shards;
+    // guards _waits, and deadlock detection, which locks shards after it
+    std::mutex _waits_mutex;
+    // transaction -> key of the lock it waits for
+    std::unordered_map<uint64, Key> _waits;
+};
+
+constexpr Database::uint64 Database::DBLockManager::IS;
+constexpr Database::uint64 Database::DBLockManager::IX;
+constexpr Database::uint64 Database::DBLockManager::S;
+constexpr Database::uint64 Database::DBLockManager::SIX;
+constexpr Database::uint64 Database::DBLockManager::X;
+constexpr Database::uint64 Database::DBLockManager::NUM_SHARDS;
+constexpr Database::uint64 Database::DBLockManager::MAX_RECORD_LOCKS;
+constexpr Database::uint64 Database::DBLockManager::ALL_FIELDS;
+constexpr bool Database::DBLockManager::COMPATIBLE[5][5];
+constexpr Database::uint64 Database::DBLockManager::SUPREMUM[5][5];
+
+#endif /* DB_LOCKMANAGER_H_ */
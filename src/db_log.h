@@ -0,0 +1,820 @@
+/******************************************************************************
+ *  Copyright (c) 2014-2015 Jamis Hoo
+ *  Distributed under the MIT license
+ *  (See accompanying file LICENSE or copy at http://opensource.org/licenses/MIT)
+ *
+ *  Project: Database
+ *  Filename: db_log.h
+ *  Version: 1.0
+ *  Author: Jamis Hoo
+ *  E-mail: hjm211324@gmail.com
+ *  Description: Write-ahead log of a database.
+ *               Buffers log bytes of pages they change, before and after changed.
+ *               A page is written to disk only after its log records are.
+ *               Transactions committing meanwhile share one fdatasync.
+ *               After a write or sync of log fails, nothing is made durable again,
+ *               until the log is opened again and recovery runs.
+ *               Checkpoints record unfinished transactions and dirty pages,
+ *               so recovery starts from the last one, see db_recovery.h.
+ *               Entries of indexes are logged by key, and changes of their nodes
+ *               by atomic actions, which are committed on their own.
+ *               Each thread has its own current transaction, so threads log
+ *               changes of different transactions at the same time.
+ *****************************************************************************/
+
+/****************************************
+ *  Log file format:
+ *      LSN of the first record         uint64
+ *      LSN of the last checkpoint      uint64, 0 if none
+ *      records, each of which is:
+ *          length                      uint64, of the whole record
+ *          type                        uint64
+ *          transaction ID              uint64, 0 if none
+ *          LSN of previous record of the transaction, 0 if none
+ *          page ID                     uint64
+ *          offset in page              uint64
+ *          length of file name         uint64
+ *          length of before data       uint64
+ *          length of after data        uint64
+ *          file name
+ *          before data
+ *          after data
+ *          checksum                    uint64, of all above
+ *  Update record: bytes from offset in page are changed from before data to after data.
+ *  Move record: memmove(page + offset, page + source, length),
+ *               after data is source and length, before data is bytes overwritten
+ *               and not moved from, which are at the end of destination if moving forward,
+ *               or at the beginning otherwise.
+ *  Dirty record: page is changed when it's not dirty, its changes until it's written
+ *                to disk follow. After data is checksum of the page before the change,
+ *                which was on disk then. Redo of a page starts from the dirty record
+ *                whose checksum matches the page on disk, so redo needs no LSN in pages.
+ *  Create and remove record: file is created or removed.
+ *  Commit and abort record: transaction ends, with its changes kept or undone.
+ *  Index record: entry of before data as key, and after data as page ID and slot ID,
+ *                is inserted into index file if offset is 1, or removed if it's 0.
+ *                It's undone by removing or inserting the entry again, while changes
+ *                of nodes it made are logged by an action, which is redone only.
+ *  Action: changes of pages made by a thread as a transaction of its own, which commits
+ *          before they're unlatched, and isn't undone with the transaction going on.
+ *          An action not committed is undone before index records are.
+ *  Checkpoint record: in after data, see Checkpoint.
+ *  LSN of a record is its position in the log, counted from the first record
+ *  ever written, which is LSN 1, so LSN 0 means none.
+ *  Records before the last checkpoint that are no longer needed are punched out of file.
+ *******************************************************/
+
+#ifndef DB_LOG_H_
+#define DB_LOG_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "db_common.h"
+
+class Database::DBLog {
+public:
+    // types of record
+    // bytes of a page are changed
+    static constexpr uint64 RECORD_UPDATE = 1;
+    // transaction ends, all its changes are kept
+    static constexpr uint64 RECORD_COMMIT = 2;
+    // bytes of a page are moved
+    static constexpr uint64 RECORD_MOVE = 3;
+    // page not dirty is changed
+    static constexpr uint64 RECORD_DIRTY = 4;
+    // file is created
+    static constexpr uint64 RECORD_CREATE = 5;
+    // file is removed
+    static constexpr uint64 RECORD_REMOVE = 6;
+    // transaction ends, all its changes are undone
+    static constexpr uint64 RECORD_ABORT = 7;
+    // unfinished transactions and dirty pages
+    static constexpr uint64 RECORD_CHECKPOINT = 8;
+    // entry of an index is inserted or removed
+    static constexpr uint64 RECORD_INDEX = 9;
+
+    // records are written to file when this size of them are buffered
+    static constexpr uint64 BUFFER_SIZE = 1 << 20;
+    // a checkpoint is due when this size of records are appended after the last one
+    static constexpr uint64 CHECKPOINT_INTERVAL = 1 << 26;
+
+    struct Record {
+        uint64 type;
+        uint64 txn;
+        uint64 prev_lsn;
+        uint64 page_id;
+        uint64 offset;
+        std::string file;
+        std::string before;
+        std::string after;
+        Record(): type(0), txn(0), prev_lsn(0), page_id(0), offset(0) { }
+    };
+
+    // records of an unfinished transaction
+    struct Transaction {
+        uint64 first_lsn;
+        uint64 last_lsn;
+        // bytes of its records appended since it began or resumed
+        uint64 length;
+    };
+
+    // data of a checkpoint record
+    struct Checkpoint {
+        // records from begin are appended after dirty pages are collected
+        uint64 begin;
+        // transaction IDs are not reused after recovery
+        uint64 next_txn;
+        // transaction ID -> its records, of unfinished transactions
+        std::map<uint64, Transaction> transactions;
+        // file -> page ID and LSN of dirty pages,
+        // changes of a page before its LSN are on disk
+        std::map< std::string, std::vector< std::pair<uint64, uint64> > > pages;
+        Checkpoint(): begin(0), next_txn(0) { }
+    };
+
+    DBLog(const std::string& filename):
+        _filename(filename), _fd(-1), _start_lsn(0), _next_lsn(0), _written_lsn(0),
+        _flushed_lsn(0), _writing(0), _error(0), _checkpoint_lsn(0), _checkpoint_begin(0),
+        _discarded(0), _id(nextID()), _next_txn(1), _read_position(0) { }
+
+    ~DBLog() {
+        if (isopen()) close();
+    }
+
+    DBLog(const DBLog&) = delete;
+    DBLog& operator=(const DBLog&) = delete;
+
+    // open log file, or create it if not exists
+    // records after the last complete one, which are partially written, are discarded
+    // returns 0 if succeed, 1 otherwise
+    bool open() {
+        assert(!isopen());
+        _fd = ::open(_filename.c_str(), O_RDWR | O_CREAT, 0644);
+        if (_fd == -1) return 1;
+
+        uint64 header[2] = { 1, 0 };
+        if (::pread(_fd, header, sizeof(header), 0) != sizeof(header)) {
+            header[0] = 1;
+            header[1] = 0;
+            if (writeHeader(header[0], header[1])) return fail();
+        }
+        _start_lsn = header[0];
+        _checkpoint_lsn = header[1];
+        _checkpoint_begin = 0;
+        _discarded = 0;
+        _read_buffer.clear();
+
+        // find end of log, records before the last checkpoint may be discarded
+        _next_lsn = _checkpoint_lsn? _checkpoint_lsn: _start_lsn;
+        Record record;
+        if (_checkpoint_lsn) {
+            Checkpoint checkpoint;
+            if (!readRecord(_checkpoint_lsn, record) || record.type != RECORD_CHECKPOINT ||
+                !parseCheckpoint(record.after, checkpoint))
+                return fail();
+            _checkpoint_begin = checkpoint.begin;
+            _next_txn = std::max(_next_txn, checkpoint.next_txn);
+        }
+        while (uint64 next = readRecord(_next_lsn, record)) {
+            _next_txn = std::max(_next_txn, record.txn + 1);
+            _next_lsn = next;
+        }
+        if (::ftruncate(_fd, offset(_next_lsn))) return fail();
+        _read_buffer.clear();
+        _written_lsn = _flushed_lsn = _next_lsn;
+        _error = 0;
+        current() = 0;
+        _transactions.clear();
+        return 0;
+    }
+
+    // write all records to disk and close file
+    void close() {
+        assert(isopen());
+        if (_next_lsn > _start_lsn) flush(_next_lsn - 1);
+        ::close(_fd);
+        _fd = -1;
+    }
+
+    bool isopen() const { return _fd != -1; }
+
+    // start a transaction, which becomes the current one of calling thread
+    // returns its ID
+    uint64 begin() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return current() = _next_txn++;
+    }
+
+    // continue a transaction found in log, which becomes the current one of calling thread,
+    // its records are from first_lsn to last_lsn
+    void resume(const uint64 txn, const uint64 first_lsn, const uint64 last_lsn) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _transactions[txn] = Transaction{ first_lsn, last_lsn, 0 };
+        _next_txn = std::max(_next_txn, txn + 1);
+        current() = txn;
+    }
+
+    // current transaction of calling thread, to which changes it logs belong, 0 if none
+    uint64 transaction() const {
+        return current();
+    }
+
+    // records of unfinished transaction txn are put into records
+    // returns 1 if it has any, 0 otherwise
+    bool records(const uint64 txn, Transaction& records) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto ite = _transactions.find(txn);
+        if (ite == _transactions.end()) return 0;
+        records = ite->second;
+        return 1;
+    }
+
+    // number of unfinished transactions which have logged changes
+    uint64 numTransactions() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _transactions.size();
+    }
+
+    // unfinished transactions which have logged changes are put into transactions
+    void transactions(std::map<uint64, Transaction>& transactions) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        transactions.clear();
+        transactions.insert(_transactions.begin(), _transactions.end());
+    }
+
+    // switch calling thread to another transaction begun before, or to none with 0
+    void setTransaction(const uint64 txn) {
+        current() = txn;
+    }
+
+    // begin an action of changes, which becomes the current transaction until endAction()
+    // returns the transaction going on, to continue after the action
+    uint64 beginAction() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const uint64 txn = current();
+        current() = _next_txn++;
+        return txn;
+    }
+
+    // commit current action without flushing it, and continue transaction txn
+    // a transaction committed later flushes it, and one undone later undoes it before
+    void endAction(const uint64 txn) {
+        end(RECORD_COMMIT);
+        setTransaction(txn);
+    }
+
+    // end current transaction
+    // returns LSN of its commit record, which should be flushed to make it durable,
+    // 0 if the transaction changed nothing
+    uint64 commit() {
+        return end(RECORD_COMMIT);
+    }
+
+    // end current transaction, whose changes have been undone
+    // returns LSN of its abort record, 0 if the transaction changed nothing
+    uint64 abort() {
+        return end(RECORD_ABORT);
+    }
+
+    // log change of bytes [offset, offset + length) of page page_id in file,
+    // for current transaction
+    // returns LSN of the record
+    uint64 logUpdate(const std::string& file, const uint64 page_id, const uint64 offset,
+                     const char* before, const char* after, const uint64 length) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return append(lock, current(), RECORD_UPDATE, page_id, offset, file, before, length, after, length);
+    }
+
+    // log memmove of length bytes from source to destination in page page_id of file,
+    // for current transaction, lost is the bytes overwritten and not moved from
+    // returns LSN of the record
+    uint64 logMove(const std::string& file, const uint64 page_id, const uint64 destination,
+                   const uint64 source, const uint64 length, const char* lost) {
+        const uint64 move[] = { source, length };
+        std::unique_lock<std::mutex> lock(_mutex);
+        return append(lock, current(), RECORD_MOVE, page_id, destination, file,
+                      lost, std::min(length, destination > source? destination - source: source - destination),
+                      reinterpret_cast<const char*>(move), sizeof(move));
+    }
+
+    // log that page page_id in file, which is not dirty, is going to be changed,
+    // data is the page before changed, for current transaction
+    // returns LSN of the record
+    uint64 logDirty(const std::string& file, const uint64 page_id, const char* data, const uint64 length) {
+        const uint64 sum = checksum(data, length);
+        std::unique_lock<std::mutex> lock(_mutex);
+        return append(lock, current(), RECORD_DIRTY, page_id, 0, file, "", 0,
+                      reinterpret_cast<const char*>(&sum), sizeof(sum));
+    }
+
+    // log insertion of entry of key and rid into index file, or its removal if insert is 0,
+    // for current transaction
+    // returns LSN of the record
+    uint64 logIndex(const std::string& file, const bool insert, 
+                    const char* key, const uint64 length, const RID rid) {
+        const uint64 position[] = { rid.pageID, rid.slotID };
+        std::unique_lock<std::mutex> lock(_mutex);
+        return append(lock, current(), RECORD_INDEX, 0, insert, file, key, length,
+                      reinterpret_cast<const char*>(position), sizeof(position));
+    }
+
+    // log creation or removal of file, for current transaction
+    // type is RECORD_CREATE or RECORD_REMOVE
+    // returns LSN of the record
+    uint64 logFile(const uint64 type, const std::string& file) {
+        assert(type == RECORD_CREATE || type == RECORD_REMOVE);
+        std::unique_lock<std::mutex> lock(_mutex);
+        return append(lock, current(), type, 0, 0, file, "", 0, "", 0);
+    }
+
+    // make records until lsn durable, and those before them
+    // transactions flushing at the same time wait for one fdatasync
+    // returns 0 if succeed, 1 if log failed to be written or synced before they are durable
+    bool flush(const uint64 lsn) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        assert(lsn < _next_lsn);
+        while (_flushed_lsn <= lsn) {
+            if (_error) return 1;
+            // another thread is writing, records may be flushed by it
+            if (_writing) {
+                _written.wait(lock);
+                continue;
+            }
+            writeBuffer(lock, 1);
+        }
+        return 0;
+    }
+
+    // write records until lsn to file without syncing it, so they can be read
+    // returns 0 if succeed, 1 if log failed to be written
+    bool write(const uint64 lsn) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        assert(lsn < _next_lsn);
+        while (_written_lsn <= lsn) {
+            if (_error) return 1;
+            if (_writing) {
+                _written.wait(lock);
+                continue;
+            }
+            writeBuffer(lock, 0);
+        }
+        return 0;
+    }
+
+    // errno of the failed write or sync of log, 0 if none
+    int error() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _error;
+    }
+
+    // append a checkpoint record with dirty pages and begin in checkpoint,
+    // unfinished transactions are filled in
+    // recovery starts from it after it's flushed, records no longer needed are discarded
+    // returns 0 if succeed, 1 otherwise
+    bool checkpoint(Checkpoint& checkpoint) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        checkpoint.next_txn = _next_txn;
+        checkpoint.transactions.clear();
+        for (const auto& t: _transactions) checkpoint.transactions.insert(t);
+        const std::string data = makeCheckpoint(checkpoint);
+        const uint64 lsn = append(lock, 0, RECORD_CHECKPOINT, 0, 0, "", "", 0, data.data(), data.length());
+        lock.unlock();
+
+        if (flush(lsn)) return 1;
+        lock.lock();
+        _written.wait(lock, [this]() { return !_writing; });
+        if (writeHeader(_start_lsn, lsn) || ::fdatasync(_fd)) return 1;
+        _checkpoint_lsn = lsn;
+        _checkpoint_begin = checkpoint.begin;
+
+        // records before these are needed by neither redo nor undo
+        uint64 keep = checkpoint.begin;
+        for (const auto& t: checkpoint.transactions) keep = std::min(keep, t.second.first_lsn);
+        for (const auto& f: checkpoint.pages)
+            for (const auto& p: f.second) keep = std::min(keep, p.second);
+        discard(keep);
+        return 0;
+    }
+
+    // LSN of the last checkpoint record, 0 if none
+    uint64 checkpointLSN() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _checkpoint_lsn;
+    }
+
+    // begin of the last checkpoint, 0 if none
+    uint64 checkpointBegin() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _checkpoint_begin;
+    }
+
+    // whether records appended since the last checkpoint exceed CHECKPOINT_INTERVAL
+    bool checkpointDue() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _next_lsn - std::max(_checkpoint_lsn, _start_lsn) >= CHECKPOINT_INTERVAL;
+    }
+
+    // discard all records, when changes of them are all on disk
+    // LSNs of later records continue from those discarded
+    // returns 0 if succeed, 1 otherwise
+    bool truncate() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _written.wait(lock, [this]() { return !_writing; });
+        // records not written are needed by recovery
+        if (_error) return 1;
+        _buffer.clear();
+        // an empty log is left if crashed before header is written
+        if (::ftruncate(_fd, 0)) return 1;
+        if (writeHeader(_next_lsn, 0)) return 1;
+        if (::fdatasync(_fd)) return 1;
+        _start_lsn = _written_lsn = _flushed_lsn = _next_lsn;
+        _checkpoint_lsn = _checkpoint_begin = 0;
+        _discarded = 0;
+        _transactions.clear();
+        std::lock_guard<std::mutex> read_lock(_read_mutex);
+        _read_buffer.clear();
+        return 0;
+    }
+
+    // LSN of the first record in file, some of which may be discarded
+    uint64 firstLSN() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _start_lsn;
+    }
+
+    // LSN of the record to be appended next
+    uint64 nextLSN() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _next_lsn;
+    }
+
+    // read record at lsn, which has been written to file
+    // records read in order are read from file in large blocks
+    // returns LSN of next record, 0 if there's no complete record at lsn
+    uint64 readRecord(const uint64 lsn, Record& record) const {
+        uint64 fields[9];
+        if (lsn < _start_lsn) return 0;
+        std::lock_guard<std::mutex> lock(_read_mutex);
+        const char* data = read(offset(lsn), sizeof(fields));
+        if (!data) return 0;
+        memcpy(fields, data, sizeof(fields));
+        const uint64 length = fields[0];
+        // length of a partially written record may be anything
+        if (length > MAX_RECORD_LENGTH) return 0;
+        if (length != RECORD_HEADER_LENGTH + fields[6] + fields[7] + fields[8] + sizeof(uint64)) return 0;
+
+        data = read(offset(lsn), length);
+        if (!data) return 0;
+        uint64 sum = 0;
+        memcpy(&sum, data + length - sizeof(uint64), sizeof(uint64));
+        if (sum != checksum(data, length - sizeof(uint64))) return 0;
+
+        record.type = fields[1];
+        record.txn = fields[2];
+        record.prev_lsn = fields[3];
+        record.page_id = fields[4];
+        record.offset = fields[5];
+        const char* p = data + RECORD_HEADER_LENGTH;
+        record.file.assign(p, fields[6]);
+        record.before.assign(p + fields[6], fields[7]);
+        record.after.assign(p + fields[6] + fields[7], fields[8]);
+        return lsn + length;
+    }
+
+    // parse data of a checkpoint record
+    // returns 1 if succeed, 0 if data is broken
+    static bool parseCheckpoint(const std::string& data, Checkpoint& checkpoint) {
+        const char* p = data.data();
+        const char* end = p + data.length();
+        auto next = [&p, end](uint64& value) {
+            if (uint64(end - p) < sizeof(uint64)) return false;
+            memcpy(&value, p, sizeof(uint64));
+            p += sizeof(uint64);
+            return true;
+        };
+        uint64 num_transactions, num_files;
+        if (!next(checkpoint.begin) || !next(checkpoint.next_txn) || !next(num_transactions)) return 0;
+        checkpoint.transactions.clear();
+        for (uint64 i = 0; i < num_transactions; ++i) {
+            uint64 txn;
+            Transaction t{ 0, 0, 0 };
+            if (!next(txn) || !next(t.first_lsn) || !next(t.last_lsn)) return 0;
+            checkpoint.transactions[txn] = t;
+        }
+        if (!next(num_files)) return 0;
+        checkpoint.pages.clear();
+        for (uint64 i = 0; i < num_files; ++i) {
+            uint64 length, num_pages;
+            if (!next(length) || uint64(end - p) < length) return 0;
+            auto& pages = checkpoint.pages[std::string(p, length)];
+            p += length;
+            if (!next(num_pages)) return 0;
+            for (uint64 j = 0; j < num_pages; ++j) {
+                std::pair<uint64, uint64> page;
+                if (!next(page.first) || !next(page.second)) return 0;
+                pages.push_back(page);
+            }
+        }
+        return p == end;
+    }
+
+    // buffers logging to this log, whose dirty pages are checkpointed
+    // a buffer is attached when opened and detached when closed
+    void attach(DBBuffer* buffer) {
+        std::lock_guard<std::mutex> lock(_buffers_mutex);
+        _buffers.push_back(buffer);
+    }
+
+    void detach(DBBuffer* buffer) {
+        std::lock_guard<std::mutex> lock(_buffers_mutex);
+        _buffers.erase(std::remove(_buffers.begin(), _buffers.end(), buffer), _buffers.end());
+    }
+
+    // call func(DBBuffer&) for each buffer attached,
+    // buffers are not detached meanwhile
+    template <class FUNC>
+    void forEachBuffer(FUNC func) {
+        std::lock_guard<std::mutex> lock(_buffers_mutex);
+        for (DBBuffer* buffer: _buffers) func(*buffer);
+    }
+
+    // checksum of records, to find those partially written, and of pages
+    // hashed by words, which is much faster than CRC
+    static uint64 checksum(const char* data, const uint64 length) {
+        constexpr uint64 PRIME = 0x100000001b3ULL;
+        uint64 hash = length * 0x9e3779b97f4a7c15ULL;
+        uint64 i = 0;
+        for (; i + sizeof(uint64) <= length; i += sizeof(uint64)) {
+            uint64 word;
+            memcpy(&word, data + i, sizeof(uint64));
+            hash = (hash ^ word) * PRIME;
+            hash ^= hash >> 29;
+        }
+        for (; i < length; ++i)
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * PRIME;
+        return hash;
+    }
+
+private:
+    static constexpr uint64 HEADER_LENGTH = sizeof(uint64) * 2;
+    static constexpr uint64 RECORD_HEADER_LENGTH = sizeof(uint64) * 9;
+    // longer than records of any page
+    static constexpr uint64 MAX_RECORD_LENGTH = 1 << 26;
+    // records are read from file in blocks of this size
+    static constexpr uint64 READ_BLOCK = 1 << 20;
+    // file space is freed in blocks of this size
+    static constexpr uint64 DISCARD_BLOCK = 1 << 16;
+
+    // position of record in file
+    uint64 offset(const uint64 lsn) const {
+        return lsn - _start_lsn + HEADER_LENGTH;
+    }
+
+    // close file when open failed
+    // returns 1
+    bool fail() {
+        ::close(_fd);
+        _fd = -1;
+        return 1;
+    }
+
+    static std::string makeCheckpoint(const Checkpoint& checkpoint) {
+        std::string data;
+        auto put = [&data](const uint64 value) {
+            data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        };
+        put(checkpoint.begin);
+        put(checkpoint.next_txn);
+        put(checkpoint.transactions.size());
+        for (const auto& t: checkpoint.transactions) {
+            put(t.first);
+            put(t.second.first_lsn);
+            put(t.second.last_lsn);
+        }
+        put(checkpoint.pages.size());
+        for (const auto& f: checkpoint.pages) {
+            put(f.first.length());
+            data += f.first;
+            put(f.second.size());
+            for (const auto& p: f.second) {
+                put(p.first);
+                put(p.second);
+            }
+        }
+        return data;
+    }
+
+    bool writeHeader(const uint64 start_lsn, const uint64 checkpoint_lsn) {
+        const uint64 header[] = { start_lsn, checkpoint_lsn };
+        return ::pwrite(_fd, header, sizeof(header), 0) != sizeof(header);
+    }
+
+    // bytes [position, position + length) of file, from read buffer,
+    // which is refilled from position if they are not in it
+    // returns null if file is shorter
+    const char* read(const uint64 position, const uint64 length) const {
+        if (position < _read_position || position + length > _read_position + _read_buffer.size()) {
+            _read_buffer.resize(std::max(READ_BLOCK, length));
+            // block is around the data when reading backwards, as undo does
+            uint64 start = position;
+            if (position < _read_position)
+                start = position > READ_BLOCK / 2? position - READ_BLOCK / 2: 0;
+            uint64 done = 0;
+            while (done < _read_buffer.size()) {
+                ssize_t n = ::pread(_fd, &_read_buffer[done], _read_buffer.size() - done, start + done);
+                if (n <= 0) break;
+                done += n;
+            }
+            _read_buffer.resize(done);
+            _read_position = start;
+            if (start + done < position + length) return nullptr;
+        }
+        return _read_buffer.data() + (position - _read_position);
+    }
+
+    // free file space of records before keep, which are read as zeros then
+    // file is left as is if the file system can't do it
+    void discard(const uint64 keep) {
+        const uint64 begin = std::max(_discarded, DISCARD_BLOCK);
+        const uint64 end = offset(std::max(keep, _start_lsn)) / DISCARD_BLOCK * DISCARD_BLOCK;
+        if (begin >= end) return;
+        if (::fallocate(_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, begin, end - begin)) return;
+        _discarded = end;
+    }
+
+    // current transaction of calling thread in this log
+    uint64& current() const {
+        static thread_local std::unordered_map<uint64, uint64> transactions;
+        return transactions[_id];
+    }
+
+    // ID of a new log, never reused, so a log at the address of one destroyed
+    // doesn't take transactions left by it
+    static uint64 nextID() {
+        static std::atomic<uint64> id(0);
+        return ++id;
+    }
+
+    // end current transaction with a record of type, if it logged anything
+    // returns LSN of the record, 0 if none
+    uint64 end(const uint64 type) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        uint64 lsn = 0;
+        uint64& txn = current();
+        if (txn && _transactions.count(txn)) {
+            lsn = append(lock, txn, type, 0, 0, "", "", 0, "", 0);
+            _transactions.erase(txn);
+        }
+        txn = 0;
+        return lsn;
+    }
+
+    // append record of transaction txn to buffer, with lock held
+    // returns its LSN
+    uint64 append(std::unique_lock<std::mutex>& lock, const uint64 txn, const uint64 type,
+                  const uint64 page_id, const uint64 offset, const std::string& file,
+                  const char* before, const uint64 before_length,
+                  const char* after, const uint64 after_length) {
+        const uint64 lsn = _next_lsn;
+        const uint64 length = RECORD_HEADER_LENGTH + file.length() +
+                              before_length + after_length + sizeof(uint64);
+        uint64 prev_lsn = 0;
+        if (txn) {
+            auto ite = _transactions.find(txn);
+            if (ite == _transactions.end()) {
+                _transactions.emplace(txn, Transaction{ lsn, lsn, length });
+            } else {
+                prev_lsn = ite->second.last_lsn;
+                ite->second.last_lsn = lsn;
+                ite->second.length += length;
+            }
+        }
+
+        const uint64 fields[] = { length, type, txn, prev_lsn, page_id, offset,
+                                  file.length(), before_length, after_length };
+        const std::size_t start = _buffer.size();
+        _buffer.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+        _buffer += file;
+        _buffer.append(before, before_length);
+        _buffer.append(after, after_length);
+        const uint64 sum = checksum(_buffer.data() + start, _buffer.size() - start);
+        _buffer.append(reinterpret_cast<const char*>(&sum), sizeof(sum));
+        _next_lsn += length;
+
+        // records are written without waiting for commits, to bound memory
+        // and dropped if log has failed, since they can't be written after those lost
+        if (_error) 
+            _buffer.clear();
+        else if (_buffer.size() >= BUFFER_SIZE && !_writing) 
+            writeBuffer(lock, 0);
+        return lsn;
+    }
+
+    // write buffered records to file, and sync file if sync is 1
+    // lock is released while writing, so more records can be appended
+    // if it fails, records written and synced stay as before, and error is kept,
+    // a sync failed is never retried, since pages it lost may be reported synced then
+    void writeBuffer(std::unique_lock<std::mutex>& lock, const bool sync) {
+        assert(!_writing && !_error);
+        _writing = 1;
+        std::string data;
+        data.swap(_buffer);
+        const uint64 begin = _written_lsn;
+        const uint64 end = _next_lsn;
+        lock.unlock();
+
+        int error = 0;
+        uint64 done = 0;
+        while (done < data.length()) {
+            ssize_t n = ::pwrite(_fd, data.data() + done, data.length() - done, offset(begin) + done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                error = n? errno: EIO;
+                break;
+            }
+            done += n;
+        }
+        while (sync && !error && ::fdatasync(_fd))
+            if (errno != EINTR) error = errno;
+
+        lock.lock();
+        if (error) {
+            _error = error;
+        } else {
+            _written_lsn = end;
+            if (sync) _flushed_lsn = end;
+        }
+        _writing = 0;
+        _written.notify_all();
+    }
+
+    std::string _filename;
+    int _fd;
+    // LSN of the first record in file
+    uint64 _start_lsn;
+    // LSN of the record to be appended
+    uint64 _next_lsn;
+    // records before these are written to file, and synced to disk
+    uint64 _written_lsn;
+    uint64 _flushed_lsn;
+    // records appended but not yet written
+    std::string _buffer;
+    // a thread is writing buffer to file
+    bool _writing;
+    // errno of the failed write or sync, 0 if none
+    int _error;
+
+    // LSN and begin of the last checkpoint, 0 if none
+    uint64 _checkpoint_lsn;
+    uint64 _checkpoint_begin;
+    // file space before this has been freed
+    uint64 _discarded;
+
+    // identifies this log among those current transactions of threads are kept for
+    const uint64 _id;
+    uint64 _next_txn;
+    // transaction ID -> its records, for unfinished transactions
+    std::unordered_map<uint64, Transaction> _transactions;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _written;
+
+    // bytes of file from _read_position, read by readRecord()
+    mutable std::string _read_buffer;
+    mutable uint64 _read_position;
+    mutable std::mutex _read_mutex;
+
+    std::vector<DBBuffer*> _buffers;
+    std::mutex _buffers_mutex;
+};
+
+constexpr Database::uint64 Database::DBLog::RECORD_UPDATE;
+constexpr Database::uint64 Database::DBLog::RECORD_COMMIT;
+constexpr Database::uint64 Database::DBLog::RECORD_MOVE;
+constexpr Database::uint64 Database::DBLog::RECORD_DIRTY;
+constexpr Database::uint64 Database::DBLog::RECORD_CREATE;
+constexpr Database::uint64 Database::DBLog::RECORD_REMOVE;
+constexpr Database::uint64 Database::DBLog::RECORD_ABORT;
+constexpr Database::uint64 Database::DBLog::RECORD_CHECKPOINT;
+constexpr Database::uint64 Database::DBLog::RECORD_INDEX;
+constexpr Database::uint64 Database::DBLog::BUFFER_SIZE;
+constexpr Database::uint64 Database::DBLog::CHECKPOINT_INTERVAL;
+constexpr Database::uint64 Database::DBLog::HEADER_LENGTH;
+constexpr Database::uint64 Database::DBLog::RECORD_HEADER_LENGTH;
+constexpr Database::uint64 Database::DBLog::MAX_RECORD_LENGTH;
+constexpr Database::uint64 Database::DBLog::READ_BLOCK;
+constexpr Database::uint64 Database::DBLog::DISCARD_BLOCK;
+
+#endif /* DB_LOG_H_ */
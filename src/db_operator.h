@@ -0,0 +1,1600 @@
+/******************************************************************************
+ *  Copyright (c) 2014-2015 Jamis Hoo
+ *  Distributed under the MIT license
+ *  (See accompanying file LICENSE or copy at http://opensource.org/licenses/MIT)
+ *
+ *  Project: Database
+ *  Filename: db_operator.h
+ *  Version: 1.0
+ *  Author: Jamis Hoo
+ *  E-mail: hjm211324@gmail.com
+ *  Description: Physical operators.
+ *               Every operator produces batches of rows through
+ *               open(), next() and close(), operators are chained into a plan.
+ *****************************************************************************/
+#ifndef DB_OPERATOR_H_
+#define DB_OPERATOR_H_
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+#include <boost/filesystem.hpp>
+#include "db_common.h"
+#include "db_fields.h"
+#include "db_tablemanager.h"
+#include "db_outputer.h"
+#include "db_error.h"
+#include "db_threadpool.h"
+
+namespace Database {
+namespace Operator {
+
+// rows of the same length, stored continuously
+class RowBatch {
+public:
+    static constexpr uint64 DEFAULT_CAPACITY = 1024;
+
+    RowBatch(const uint64 record_length, const uint64 capacity = DEFAULT_CAPACITY):
+        _record_length(record_length), _capacity(capacity) {
+        _data.reserve(_record_length * _capacity);
+        _rids.reserve(_capacity);
+    }
+
+    uint64 size() const { return _rids.size(); }
+    uint64 capacity() const { return _capacity; }
+    uint64 recordLength() const { return _record_length; }
+    bool empty() const { return _rids.empty(); }
+    // capacity is a hint, a batch can hold more rows than its capacity
+    bool full() const { return _rids.size() >= _capacity; }
+
+    void clear() {
+        _data.clear();
+        _rids.clear();
+    }
+
+    char* row(const uint64 i) { return _data.data() + _record_length * i; }
+    const char* row(const uint64 i) const { return _data.data() + _record_length * i; }
+    // rid of row i, RID(0, 0) if row i isn't read from a table
+    RID rid(const uint64 i) const { return _rids[i]; }
+
+    // append a row, returns buffer of the new row
+    // buffer gets invalid after next append
+    char* append(const RID rid = RID(0, 0)) {
+        _data.resize(_data.size() + _record_length);
+        _rids.push_back(rid);
+        return row(_rids.size() - 1);
+    }
+    void append(const char* record, const RID rid = RID(0, 0)) {
+        memcpy(append(rid), record, _record_length);
+    }
+
+    // copy row i to row j
+    void copyRow(const uint64 i, const uint64 j) {
+        if (i == j) return;
+        memcpy(row(j), row(i), _record_length);
+        _rids[j] = _rids[i];
+    }
+
+    // keep the first n rows only
+    void truncate(const uint64 n) {
+        if (n >= _rids.size()) return;
+        _data.resize(_record_length * n);
+        _rids.erase(_rids.begin() + n, _rids.end());
+    }
+
+    // exchange rows with another batch of the same record length
+    void swap(RowBatch& batch) {
+        assert(_record_length == batch._record_length);
+        _data.swap(batch._data);
+        _rids.swap(batch._rids);
+    }
+
+private:
+    uint64 _record_length;
+    uint64 _capacity;
+    std::vector<char> _data;
+    std::vector<RID> _rids;
+};
+
+// interface of all physical operators
+// call open() once, then next() until it returns 0, then close()
+class PhysicalOperator {
+public:
+    virtual ~PhysicalOperator() { }
+    virtual void open() = 0;
+    // batch is cleared and filled with next rows
+    // returns 1 if there's at least one row in batch
+    // returns 0 if no more rows
+    virtual bool next(RowBatch& batch) = 0;
+    virtual void close() = 0;
+    // layout of rows produced by this operator
+    virtual const DBFields& fieldsDesc() const = 0;
+};
+
+typedef std::unique_ptr<PhysicalOperator> OperatorPtr;
+typedef std::function<bool(const char*)> Predicate;
+
+// read all records of a table, page by page
+class TableScan: public PhysicalOperator {
+public:
+    // pages read ahead in background
+    static constexpr uint64 PREFETCH_PAGES = 64;
+
+    TableScan(const DBTableManager* table_manager):
+        _table_manager(table_manager), _page_id(0), _prefetched(0) { }
+
+    virtual void open() {
+        _page_id = _table_manager->firstRecordPage();
+        _prefetched = _page_id;
+        _page.reset(new char[_table_manager->pageSize()]);
+    }
+
+    virtual bool next(RowBatch& batch) {
+        batch.clear();
+        auto append = [&batch](const char* record, const RID rid) {
+            batch.append(record, rid);
+        };
+        // whole pages are read
+        while (_page_id && !batch.full()) {
+            // record pages are created in increasing order of id
+            if (_prefetched < _page_id + PREFETCH_PAGES / 2) {
+                std::vector<uint64> pages;
+                for (uint64 i = std::max(_prefetched, _page_id); i < _page_id + PREFETCH_PAGES; ++i)
+                    pages.push_back(i);
+                _table_manager->prefetchPages(pages);
+                _prefetched = _page_id + PREFETCH_PAGES;
+            }
+            _page_id = _table_manager->traverseRecordPage(_page_id, _page.get(), append);
+        }
+        return !batch.empty();
+    }
+
+    virtual void close() {
+        _page_id = 0;
+        _prefetched = 0;
+        _page.reset();
+    }
+
+    virtual const DBFields& fieldsDesc() const {
+        return _table_manager->fieldsDesc();
+    }
+
+private:
+    const DBTableManager* _table_manager;
+    // next page to read, 0 if no more pages
+    uint64 _page_id;
+    // pages before it have been prefetched
+    uint64 _prefetched;
+    std::unique_ptr<char[]> _page;
+};
+
+// read records of a table meeting predicate, with pages read and filtered by threads
+// rows are produced in the same order as TableScan
+class ParallelTableScan: public PhysicalOperator {
+public:
+    // pages read by a task
+    static constexpr uint64 PAGES_PER_TASK = 16;
+    // tasks of each thread in a round, more tasks balance load better
+    static constexpr uint64 TASKS_PER_THREAD = 4;
+
+    // all records pass if predicate is empty
+    ParallelTableScan(const DBTableManager* table_manager, Predicate predicate, DBThreadPool* pool):
+        _table_manager(table_manager), _predicate(predicate), _pool(pool), 
+        _next_page(0), _prefetched(0), _num_results(0), _next_result(0) { }
+
+    virtual void open() {
+        _pages = _table_manager->recordPages();
+        _next_page = 0;
+        _prefetched = 0;
+        _num_results = 0;
+        _next_result = 0;
+    }
+
+    virtual bool next(RowBatch& batch) {
+        batch.clear();
+        while (true) {
+            // rows read in last round, in order of tasks
+            while (_next_result < _num_results) {
+                RowBatch& result = _results[_next_result++];
+                if (result.empty()) continue;
+                batch.swap(result);
+                return 1;
+            }
+            if (_next_page == _pages.size()) return 0;
+            readPages();
+        }
+    }
+
+    virtual void close() {
+        _pages.clear();
+        _results.clear();
+        _buffers.clear();
+        _next_page = 0;
+        _prefetched = 0;
+        _num_results = 0;
+        _next_result = 0;
+    }
+
+    virtual const DBFields& fieldsDesc() const {
+        return _table_manager->fieldsDesc();
+    }
+
+private:
+    // read next pages, task i reads PAGES_PER_TASK pages into _results[i]
+    void readPages() {
+        uint64 num_tasks = std::min<uint64>(_pool->size() * TASKS_PER_THREAD, 
+                                    (_pages.size() - _next_page + PAGES_PER_TASK - 1) / PAGES_PER_TASK);
+        while (_results.size() < num_tasks) {
+            _results.emplace_back(_table_manager->fieldsDesc().recordLength());
+            _buffers.emplace_back(new char[_table_manager->pageSize()]);
+        }
+
+        // pages of this round and the next one are read in background meanwhile
+        const uint64 prefetch_end = std::min<uint64>(_next_page + 2 * num_tasks * PAGES_PER_TASK, 
+                                                     _pages.size());
+        if (_prefetched < prefetch_end) {
+            _table_manager->prefetchPages(std::vector<uint64>(_pages.begin() + _prefetched, 
+                                                              _pages.begin() + prefetch_end));
+            _prefetched = prefetch_end;
+        }
+
+        const uint64 first_page = _next_page;
+        _pool->run(num_tasks, [this, first_page](const uint64 task) {
+            RowBatch& result = _results[task];
+            result.clear();
+            auto append = [this, &result](const char* record, const RID rid) {
+                if (!_predicate || _predicate(record)) result.append(record, rid);
+            };
+            uint64 begin = first_page + task * PAGES_PER_TASK;
+            uint64 end = std::min<uint64>(begin + PAGES_PER_TASK, _pages.size());
+            for (uint64 i = begin; i < end; ++i)
+                _table_manager->traverseRecordPage(_pages[i], _buffers[task].get(), append);
+        });
+
+        _next_page = std::min<uint64>(first_page + num_tasks * PAGES_PER_TASK, _pages.size());
+        _num_results = num_tasks;
+        _next_result = 0;
+    }
+
+    const DBTableManager* _table_manager;
+    Predicate _predicate;
+    DBThreadPool* _pool;
+    // ids of record pages
+    std::vector<uint64> _pages;
+    // next page to read
+    uint64 _next_page;
+    // pages before it have been prefetched
+    uint64 _prefetched;
+    // rows and page buffer of each task
+    std::vector<RowBatch> _results;
+    std::vector< std::unique_ptr<char[]> > _buffers;
+    // number of results of last round, and next result to produce
+    uint64 _num_results;
+    uint64 _next_result;
+};
+
+// read records of the given rids, which are usually found with index
+class IndexScan: public PhysicalOperator {
+public:
+    // records whose pages are read ahead in background
+    static constexpr uint64 PREFETCH_ROWS = 512;
+
+    IndexScan(const DBTableManager* table_manager, std::vector<RID> rids):
+        _table_manager(table_manager), _rids(std::move(rids)), _pos(0), _prefetched(0) { }
+
+    virtual void open() { _pos = _prefetched = 0; }
+
+    virtual bool next(RowBatch& batch) {
+        batch.clear();
+        for (; _pos < _rids.size() && !batch.full(); ++_pos) {
+            if (_prefetched < _pos + PREFETCH_ROWS / 2) prefetch();
+            bool rtv = _table_manager->selectRecord(_rids[_pos], batch.append(_rids[_pos]));
+            assert(rtv == 0);
+        }
+        return !batch.empty();
+    }
+
+    virtual void close() { _pos = _prefetched = _rids.size(); }
+
+    virtual const DBFields& fieldsDesc() const {
+        return _table_manager->fieldsDesc();
+    }
+
+private:
+    // prefetch pages of records until PREFETCH_ROWS records after _pos
+    void prefetch() {
+        const std::size_t end = std::min<std::size_t>(_pos + PREFETCH_ROWS, _rids.size());
+        std::vector<uint64> pages;
+        for (std::size_t i = std::max(_prefetched, _pos); i < end; ++i)
+            // rids found with index are usually in runs of the same page
+            if (pages.empty() || pages.back() != _rids[i].pageID) 
+                pages.push_back(_rids[i].pageID);
+        _table_manager->prefetchPages(pages);
+        _prefetched = end;
+    }
+
+    const DBTableManager* _table_manager;
+    std::vector<RID> _rids;
+    std::size_t _pos;
+    // records before it have their pages prefetched
+    std::size_t _prefetched;
+};
+
+// read all records of a table in order of field field_id,
+// which must be indexed
+class IndexOrderScan: public PhysicalOperator {
+public:
+    // order is 1 if ascending, 0 if descending
+    IndexOrderScan(const DBTableManager* table_manager, const uint64 field_id, const bool order):
+        _table_manager(table_manager), _field_id(field_id), _order(order) { }
+
+    virtual void open() {
+        _cursor = _order? _table_manager->firstIndexRecord(_field_id):
+                          _table_manager->lastIndexRecord(_field_id);
+    }
+
+    virtual bool next(RowBatch& batch) {
+        batch.clear();
+        _rids.clear();
+        _table_manager->traverseIndex(_cursor, _field_id, batch.capacity(), 
+            [this](const char*, const RID rid) { _rids.push_back(rid); });
+        for (const auto rid: _rids) {
+            bool rtv = _table_manager->selectRecord(rid, batch.append(rid));
+            assert(rtv == 0);
+        }
+        return !batch.empty();
+    }
+
+    virtual void close() { 
+        _cursor = DBTableManager::IndexCursor();
+    }
+
+    virtual const DBFields& fieldsDesc() const {
+        return _table_manager->fieldsDesc();
+    }
+
+private:
+    const DBTableManager* _table_manager;
+    uint64 _field_id;
+    bool _order;
+    DBTableManager::IndexCursor _cursor;
+    std::vector<RID> _rids;
+};
+
+// rows meeting predicate pass
+class Filter: public PhysicalOperator {
+public:
+    Filter(OperatorPtr child, Predicate predicate):
+        _child(std::move(child)), _predicate(predicate) { }
+
+    virtual void open() { _child->open(); }
+
+    virtual bool next(RowBatch& batch) {
+        while (_child->next(batch)) {
+            // remove rows not meeting predicate in place
+            uint64 kept = 0;
+            for (uint64 i = 0; i < batch.size(); ++i)
+                if (_predicate(batch.row(i)))
+                    batch.copyRow(i, kept++);
+            batch.truncate(kept);
+            if (kept) return 1;
+        }
+        return 0;
+    }
+
+    virtual void close() { _child->close(); }
+
+    virtual const DBFields& fieldsDesc() const {
+        return _child->fieldsDesc();
+    }
+
+private:
+    OperatorPtr _child;
+    Predicate _predicate;
+};
+
+// pick fields out of each row
+class Project: public PhysicalOperator {
+public:
+    Project(OperatorPtr child, const std::vector<uint64>& field_ids):
+        _child(std::move(child)), _field_ids(field_ids) {
+        const DBFields& fields_desc = _child->fieldsDesc();
+        for (const auto id: _field_ids)
+            _fields.insert(fields_desc.field_type()[id],
+                           fields_desc.field_length()[id] - 1,
+                           0, 0, fields_desc.notnull()[id],
+                           fields_desc.field_name()[id]);
+    }
+
+    virtual void open() {
+        _child->open();
+        _input.reset(new RowBatch(_child->fieldsDesc().recordLength()));
+    }
+
+    virtual bool next(RowBatch& batch) {
+        batch.clear();
+        const DBFields& fields_desc = _child->fieldsDesc();
+        if (!_child->next(*_input)) return 0;
+        for (uint64 i = 0; i < _input->size(); ++i) {
+            const char* in = _input->row(i);
+            char* out = batch.append(_input->rid(i));
+            for (std::size_t j = 0; j < _field_ids.size(); ++j)
+                memcpy(out + _fields.offset()[j],
+                       in + fields_desc.offset()[_field_ids[j]],
+                       fields_desc.field_length()[_field_ids[j]]);
+        }
+        return 1;
+    }
+
+    virtual void close() {
+        _child->close();
+        _input.reset();
+    }
+
+    virtual const DBFields& fieldsDesc() const {
+        return _fields;
+    }
+
+private:
+    OperatorPtr _child;
+    std::vector<uint64> _field_ids;
+    DBFields _fields;
+    std::unique_ptr<RowBatch> _input;
+};
+
+// base of joins
+// right input is read into memory, then each left row is matched against it
+// output row is left row followed by right row
+// output rows are in the order of left rows, then right rows
+class Join: public PhysicalOperator {
+public:
+    Join(OperatorPtr left, OperatorPtr right, Predicate predicate):
+        _left(std::move(left)), _right(std::move(right)),
+        _predicate(predicate), _matches(nullptr), _left_pos(0), _match_pos(0) {
+        for (const DBFields* fields_desc: { &_left->fieldsDesc(), &_right->fieldsDesc() })
+            for (uint64 i = 0; i < fields_desc->size(); ++i)
+                _fields.insert(fields_desc->field_type()[i],
+                               fields_desc->field_length()[i] - 1,
+                               0, 0, fields_desc->notnull()[i],
+                               fields_desc->field_name()[i]);
+    }
+
+    virtual void open() {
+        _left->open();
+        _right->open();
+        // read in right input
+        const uint64 right_length = _right->fieldsDesc().recordLength();
+        RowBatch batch(right_length);
+        _right_rows.clear();
+        _num_right_rows = 0;
+        while (_right->next(batch))
+            for (uint64 i = 0; i < batch.size(); ++i) {
+                _right_rows.insert(_right_rows.end(), batch.row(i), batch.row(i) + right_length);
+                build(batch.row(i), _num_right_rows++);
+            }
+        _left_batch.reset(new RowBatch(_left->fieldsDesc().recordLength()));
+        _left_pos = 0;
+        _match_pos = 0;
+        _matches = nullptr;
+    }
+
+    virtual bool next(RowBatch& batch) {
+        batch.clear();
+        const uint64 left_length = _left->fieldsDesc().recordLength();
+        const uint64 right_length = _right->fieldsDesc().recordLength();
+        while (!batch.full()) {
+            // current left row is done, move to next one
+            if (!_matches || _match_pos == _matches->size()) {
+                if (_matches) ++_left_pos;
+                if (_left_pos >= _left_batch->size()) {
+                    _matches = nullptr;
+                    _left_pos = 0;
+                    if (!_left->next(*_left_batch)) break;
+                }
+                _matches = probe(_left_batch->row(_left_pos));
+                _match_pos = 0;
+                continue;
+            }
+            char* out = batch.append();
+            memcpy(out, _left_batch->row(_left_pos), left_length);
+            memcpy(out + left_length, _right_rows.data() + right_length * (*_matches)[_match_pos++], right_length);
+            if (_predicate && !_predicate(out))
+                batch.truncate(batch.size() - 1);
+        }
+        return !batch.empty();
+    }
+
+    virtual void close() {
+        _left->close();
+        _right->close();
+        _right_rows.clear();
+        _left_batch.reset();
+    }
+
+    virtual const DBFields& fieldsDesc() const {
+        return _fields;
+    }
+
+protected:
+    // called for each right row when reading in right input
+    virtual void build(const char* right_row, const uint64 i) = 0;
+    // returns indexes of right rows that may match left row
+    virtual const std::vector<uint64>* probe(const char* left_row) = 0;
+
+    OperatorPtr _left;
+    OperatorPtr _right;
+
+private:
+    Predicate _predicate;
+    DBFields _fields;
+
+    std::vector<char> _right_rows;
+    uint64 _num_right_rows;
+
+    std::unique_ptr<RowBatch> _left_batch;
+    const std::vector<uint64>* _matches;
+    uint64 _left_pos;
+    uint64 _match_pos;
+};
+
+// every left row is matched against every right row
+class NestedLoopJoin: public Join {
+public:
+    NestedLoopJoin(OperatorPtr left, OperatorPtr right, Predicate predicate):
+        Join(std::move(left), std::move(right), predicate) { }
+
+protected:
+    virtual void build(const char*, const uint64 i) {
+        if (i == 0) _all.clear();
+        _all.push_back(i);
+    }
+    virtual const std::vector<uint64>* probe(const char*) {
+        return &_all;
+    }
+
+private:
+    std::vector<uint64> _all;
+};
+
+// left field left_field_id equals to right field right_field_id
+// null equals to null here, predicate should decide whether it's acceptable
+class HashJoin: public Join {
+public:
+    HashJoin(OperatorPtr left, OperatorPtr right,
+             const uint64 left_field_id, const uint64 right_field_id,
+             Predicate predicate):
+        Join(std::move(left), std::move(right), predicate),
+        _left_field_id(left_field_id), _right_field_id(right_field_id) {
+        assert(_left->fieldsDesc().field_type()[_left_field_id] ==
+               _right->fieldsDesc().field_type()[_right_field_id]);
+    }
+
+protected:
+    virtual void build(const char* right_row, const uint64 i) {
+        if (i == 0) _table.clear();
+        const DBFields& fields_desc = _right->fieldsDesc();
+        _key.clear();
+        keyGenerator(right_row + fields_desc.offset()[_right_field_id],
+                     fields_desc.field_type()[_right_field_id],
+                     fields_desc.field_length()[_right_field_id], _key);
+        _table[_key].push_back(i);
+    }
+    virtual const std::vector<uint64>* probe(const char* left_row) {
+        const DBFields& fields_desc = _left->fieldsDesc();
+        _key.clear();
+        keyGenerator(left_row + fields_desc.offset()[_left_field_id],
+                     fields_desc.field_type()[_left_field_id],
+                     // keys must be of the same length
+                     _right->fieldsDesc().field_length()[_right_field_id], _key);
+        auto ite = _table.find(_key);
+        return ite == _table.end()? &_empty: &ite->second;
+    }
+
+private:
+    uint64 _left_field_id;
+    uint64 _right_field_id;
+    std::unordered_map< std::string, std::vector<uint64> > _table;
+    std::vector<uint64> _empty;
+    std::string _key;
+    DBFields::KeyGenerator keyGenerator;
+};
+
+// aggregate function applied to field field_id
+// result is saved into field result_field_id of output row
+struct AggregateFunction {
+    std::string function;
+    uint64 field_id;
+    uint64 result_field_id;
+};
+
+// group rows and calculate aggregate functions of each group
+// rows are grouped in one pass with a hash table on group field,
+// only running results of aggregate functions are kept for each group
+// output row is the first row of a group followed by aggregate results
+// groups are output in the order they first appear
+// with a thread pool, batches are aggregated by threads into local tables,
+// each split into partitions by key hash, then partitions are merged by threads
+class Aggregate: public PhysicalOperator {
+public:
+    // no group by, all rows are in one group
+    static constexpr uint64 NO_GROUP = std::numeric_limits<uint64>::max();
+    // count(*)
+    static constexpr uint64 ALL_FIELDS = std::numeric_limits<uint64>::max();
+    // batches aggregated by a task in a round
+    static constexpr uint64 BATCHES_PER_TASK = 4;
+    // partitions of each local table for each thread
+    static constexpr uint64 PARTITIONS_PER_THREAD = 4;
+
+    // fields is the layout of output rows,
+    // whose leading fields are the same with those of child
+    // aggregate in parallel if pool is not null
+    Aggregate(OperatorPtr child, const DBFields& fields, const uint64 group_field_id,
+              const std::vector<AggregateFunction>& functions, DBThreadPool* pool = nullptr):
+        _child(std::move(child)), _fields(fields),
+        _group_field_id(group_field_id), _functions(functions), 
+        _pool(pool), _group(0) {
+        assert(_fields.recordLength() >= _child->fieldsDesc().recordLength());
+        const DBFields& fields_desc = _child->fieldsDesc();
+        for (const auto& func: _functions) {
+            Argument arg;
+            if (func.field_id == ALL_FIELDS) {
+                arg.function = DBFields::Aggregator::FUNC_COUNT_ALL;
+                arg.offset = arg.type = arg.length = 0;
+            } else {
+                arg.function = DBFields::Aggregator::function(func.function);
+                arg.offset = fields_desc.offset()[func.field_id];
+                arg.type = fields_desc.field_type()[func.field_id];
+                arg.length = fields_desc.field_length()[func.field_id];
+                // types are checked by caller
+                assert(DBFields::Aggregator::applicable(arg.function, arg.type));
+            }
+            arg.result_offset = _fields.offset()[func.result_field_id];
+            _arguments.push_back(arg);
+        }
+    }
+
+    virtual void open() {
+        _child->open();
+        _groups.clear();
+        _group = 0;
+
+        if (_pool && _pool->size() > 1) {
+            parallelAggregate();
+            return;
+        }
+
+        RowBatch batch(_child->fieldsDesc().recordLength());
+        std::string key;
+        uint64 seq = 0;
+        while (_child->next(batch))
+            for (uint64 i = 0; i < batch.size(); ++i)
+                addRow(_groups, batch.row(i), seq++, key);
+    }
+
+    virtual bool next(RowBatch& batch) {
+        batch.clear();
+        const uint64 length = _child->fieldsDesc().recordLength();
+        for (; _group < _groups.size() && !batch.full(); ++_group) {
+            char* out = batch.append();
+            memset(out, 0x00, _fields.recordLength());
+            // the first row in this group
+            memcpy(out, _groups.first_rows.data() + length * _group, length);
+            const DBFields::Aggregator::State* states = _groups.states.data() + _group * _arguments.size();
+            for (std::size_t j = 0; j < _arguments.size(); ++j)
+                aggregator.finalize(states[j], _arguments[j].function, _arguments[j].type,
+                                    _arguments[j].length, out + _arguments[j].result_offset);
+        }
+        return !batch.empty();
+    }
+
+    virtual void close() {
+        _child->close();
+        _groups.clear();
+    }
+
+    virtual const DBFields& fieldsDesc() const {
+        return _fields;
+    }
+
+private:
+    // aggregate function resolved against input and output rows
+    struct Argument {
+        uint64 function;
+        uint64 offset;
+        uint64 type;
+        uint64 length;
+        uint64 result_offset;
+    };
+
+    // groups in the order they are added
+    struct Groups {
+        // group key -> group number
+        std::unordered_map<std::string, uint64> table;
+        // the first row of each group, and its sequence number in input
+        std::vector<char> first_rows;
+        std::vector<uint64> first_seqs;
+        // running results, functions.size() for each group
+        std::vector<DBFields::Aggregator::State> states;
+
+        uint64 size() const { return first_seqs.size(); }
+        void clear() {
+            table.clear();
+            first_rows.clear();
+            first_seqs.clear();
+            states.clear();
+        }
+    };
+
+    // group key of row, empty without group by
+    void groupKey(const char* row, std::string& key) {
+        const DBFields& fields_desc = _child->fieldsDesc();
+        key.clear();
+        if (_group_field_id != NO_GROUP)
+            keyGenerator(row + fields_desc.offset()[_group_field_id],
+                         fields_desc.field_type()[_group_field_id],
+                         fields_desc.field_length()[_group_field_id], key);
+    }
+
+    // find group of key in groups, creates it with first row and seq if not found
+    // returns group number
+    uint64 findGroup(Groups& groups, const std::string& key, const char* row, const uint64 seq) {
+        auto ite = groups.table.find(key);
+        if (ite != groups.table.end()) return ite->second;
+        const uint64 length = _child->fieldsDesc().recordLength();
+        groups.table.emplace(key, groups.size());
+        groups.first_rows.insert(groups.first_rows.end(), row, row + length);
+        groups.first_seqs.push_back(seq);
+        groups.states.resize(groups.states.size() + _arguments.size());
+        return groups.size() - 1;
+    }
+
+    // update running results of row's group, key is a scratch buffer
+    void addRow(Groups& groups, const char* row, const uint64 seq, std::string& key) {
+        groupKey(row, key);
+        updateGroup(groups, findGroup(groups, key, row, seq), row);
+    }
+
+    void updateGroup(Groups& groups, const uint64 group, const char* row) {
+        DBFields::Aggregator::State* states = groups.states.data() + group * _arguments.size();
+        for (std::size_t j = 0; j < _arguments.size(); ++j)
+            aggregator.update(states[j], _arguments[j].function, row + _arguments[j].offset,
+                              _arguments[j].type, _arguments[j].length);
+    }
+
+    // merge all groups of other into groups,
+    // the first row of a group is the one with smaller seq
+    void mergeGroups(Groups& groups, const Groups& other) {
+        const uint64 length = _child->fieldsDesc().recordLength();
+        for (const auto& entry: other.table) {
+            const uint64 from = entry.second;
+            const char* row = other.first_rows.data() + from * length;
+            const uint64 seq = other.first_seqs[from];
+            const uint64 to = findGroup(groups, entry.first, row, seq);
+            if (seq < groups.first_seqs[to]) {
+                memcpy(groups.first_rows.data() + to * length, row, length);
+                groups.first_seqs[to] = seq;
+            }
+            DBFields::Aggregator::State* states = groups.states.data() + to * _arguments.size();
+            const DBFields::Aggregator::State* other_states = other.states.data() + from * _arguments.size();
+            for (std::size_t j = 0; j < _arguments.size(); ++j)
+                // a new group has empty states, merging into it copies other
+                aggregator.merge(states[j], other_states[j], _arguments[j].function,
+                                 _arguments[j].type, _arguments[j].length);
+        }
+    }
+
+    void parallelAggregate() {
+        const uint64 length = _child->fieldsDesc().recordLength();
+        const uint64 num_threads = _pool->size();
+        const uint64 num_partitions = num_threads * PARTITIONS_PER_THREAD;
+
+        // local tables of each task, split into partitions
+        std::vector< std::vector<Groups> > locals(num_threads, std::vector<Groups>(num_partitions));
+        std::vector<RowBatch> batches;
+        // sequence number of the first row of each batch
+        std::vector<uint64> batch_seqs;
+        uint64 seq = 0;
+        bool exhausted = 0;
+
+        // aggregate phase
+        // task i aggregates batches [i * BATCHES_PER_TASK, (i + 1) * BATCHES_PER_TASK) of a round,
+        // so rows of a local table are added in input order
+        while (!exhausted) {
+            uint64 num_batches = 0;
+            for (; num_batches < num_threads * BATCHES_PER_TASK; ++num_batches) {
+                if (batches.size() == num_batches) {
+                    batches.emplace_back(length);
+                    batch_seqs.push_back(0);
+                }
+                if (!_child->next(batches[num_batches])) {
+                    exhausted = 1;
+                    break;
+                }
+                batch_seqs[num_batches] = seq;
+                seq += batches[num_batches].size();
+            }
+            if (!num_batches) break;
+
+            const uint64 num_tasks = (num_batches + BATCHES_PER_TASK - 1) / BATCHES_PER_TASK;
+            _pool->run(num_tasks, [&, num_batches, num_partitions](const uint64 task) {
+                std::vector<Groups>& partitions = locals[task];
+                std::hash<std::string> hasher;
+                std::string key;
+                const uint64 end = std::min<uint64>((task + 1) * BATCHES_PER_TASK, num_batches);
+                for (uint64 b = task * BATCHES_PER_TASK; b < end; ++b)
+                    for (uint64 i = 0; i < batches[b].size(); ++i) {
+                        const char* row = batches[b].row(i);
+                        groupKey(row, key);
+                        Groups& groups = partitions[hasher(key) % num_partitions];
+                        updateGroup(groups, findGroup(groups, key, row, batch_seqs[b] + i), row);
+                    }
+            });
+        }
+        batches.clear();
+
+        // merge phase
+        // task p merges partition p of all local tables, keys of different partitions never meet
+        std::vector<Groups> merged(num_partitions);
+        _pool->run(num_partitions, [&](const uint64 partition) {
+            for (auto& partitions: locals) {
+                mergeGroups(merged[partition], partitions[partition]);
+                partitions[partition].clear();
+            }
+        });
+
+        // order groups by their first rows, as serial aggregation does
+        std::vector< std::pair<uint64, uint64> > order;
+        for (uint64 p = 0; p < num_partitions; ++p)
+            for (uint64 g = 0; g < merged[p].size(); ++g)
+                order.emplace_back(p, g);
+        std::sort(order.begin(), order.end(), 
+                  [&merged](const std::pair<uint64, uint64>& a, const std::pair<uint64, uint64>& b) {
+                      return merged[a.first].first_seqs[a.second] < merged[b.first].first_seqs[b.second];
+                  });
+
+        _groups.first_rows.resize(order.size() * length);
+        _groups.first_seqs.resize(order.size());
+        _groups.states.resize(order.size() * _arguments.size());
+        for (uint64 g = 0; g < order.size(); ++g) {
+            const Groups& groups = merged[order[g].first];
+            const uint64 from = order[g].second;
+            memcpy(_groups.first_rows.data() + g * length, groups.first_rows.data() + from * length, length);
+            _groups.first_seqs[g] = groups.first_seqs[from];
+            std::copy_n(groups.states.begin() + from * _arguments.size(), _arguments.size(),
+                        _groups.states.begin() + g * _arguments.size());
+        }
+    }
+
+    OperatorPtr _child;
+    DBFields _fields;
+    uint64 _group_field_id;
+    std::vector<AggregateFunction> _functions;
+    std::vector<Argument> _arguments;
+    DBThreadPool* _pool;
+
+    Groups _groups;
+    // next group to output
+    uint64 _group;
+    DBFields::KeyGenerator keyGenerator;
+    DBFields::Aggregator aggregator;
+};
+
+// sort rows by field field_id in asc(1) | desc(0) order
+// a normalized key is generated once for each row, rows are sorted by keys
+// if rows exceed memory limit, sorted runs are written to temp files and merged,
+// at most MERGE_FAN_IN of them at a time
+// rows with equal keys keep their input order
+class Sort: public PhysicalOperator {
+public:
+    // memory used for rows in memory, in Bytes
+    static constexpr uint64 DEFAULT_MEMORY = 64 * 1024 * 1024;
+    // keys not longer than this are sorted with radix sort
+    static constexpr uint64 RADIX_KEY_LENGTH = 16;
+    // fewer entries are sorted by one thread
+    static constexpr uint64 PARALLEL_SORT_ROWS = 1 << 16;
+    // runs merged at a time, more runs are first merged in passes into longer runs
+    static constexpr uint64 MERGE_FAN_IN = 64;
+
+    // only the first limit rows are output if limit is given
+    // entries in memory are sorted in parallel if pool is not null
+    Sort(OperatorPtr child, const uint64 field_id, const bool order,
+         const boost::filesystem::path& temp_dir = boost::filesystem::temp_directory_path(),
+         const uint64 memory = DEFAULT_MEMORY,
+         const uint64 limit = std::numeric_limits<uint64>::max(),
+         DBThreadPool* pool = nullptr):
+        _child(std::move(child)), _field_id(field_id), _order(order),
+        _temp_dir(temp_dir), _memory(memory), _limit(limit), _pool(pool),
+        _key_length(0), _entry_length(0), _pos(0) { }
+
+    ~Sort() { removeRuns(); }
+
+    virtual void open() {
+        _child->open();
+        const DBFields& fields_desc = _child->fieldsDesc();
+        const uint64 length = fields_desc.recordLength();
+        const uint64 type = fields_desc.field_type()[_field_id];
+        const uint64 offset = fields_desc.offset()[_field_id];
+        const uint64 field_length = fields_desc.field_length()[_field_id];
+
+        // each entry is key, rid and row
+        _key_length = DBFields::KeyGenerator::keyLength(type, field_length);
+        _entry_length = _key_length + sizeof(RID) + length;
+        const uint64 max_entries = std::max<uint64>(1, _memory / _entry_length);
+
+        removeRuns();
+        _entries.clear();
+        _sorted.clear();
+        _pos = 0;
+
+        // if only a few rows are needed, keep the smallest ones in a heap,
+        // whose top is the largest of them
+        const bool top_n = _limit < max_entries;
+        // input order of entries in heap
+        std::vector<uint64> seqs;
+        auto heapLess = [this, &seqs](const uint64 a, const uint64 b) {
+            int comp_result = memcmp(_entries.data() + _entry_length * a, 
+                                     _entries.data() + _entry_length * b, _key_length);
+            return comp_result? comp_result < 0: seqs[a] < seqs[b];
+        };
+
+        RowBatch batch(length);
+        std::string key;
+        uint64 seq = 0;
+        while (_child->next(batch))
+            for (uint64 i = 0; i < batch.size(); ++i, ++seq) {
+                key.clear();
+                keyGenerator(batch.row(i) + offset, type, field_length, key);
+                // larger key is smaller in desc order
+                if (!_order) 
+                    for (auto& c: key) c = ~c;
+                assert(key.length() == _key_length);
+
+                if (!top_n) {
+                    _entries.resize(_entries.size() + _entry_length);
+                    writeEntry(&_entries.back() + 1 - _entry_length, key, batch.rid(i), batch.row(i));
+                    if (_entries.size() / _entry_length >= max_entries) spill();
+                    continue;
+                }
+
+                if (_sorted.size() < _limit) {
+                    _entries.resize(_entries.size() + _entry_length);
+                    seqs.push_back(seq);
+                    _sorted.push_back(seqs.size() - 1);
+                } else if (_limit && memcmp(key.data(), _entries.data() + _entry_length * _sorted.front(), 
+                                            _key_length) < 0) {
+                    // replace the largest one
+                    std::pop_heap(_sorted.begin(), _sorted.end(), heapLess);
+                    seqs[_sorted.back()] = seq;
+                } else continue;
+                writeEntry(_entries.data() + _entry_length * _sorted.back(), key, batch.rid(i), batch.row(i));
+                std::push_heap(_sorted.begin(), _sorted.end(), heapLess);
+            }
+
+        if (top_n) {
+            std::sort(_sorted.begin(), _sorted.end(), heapLess);
+            return;
+        }
+
+        sortEntries();
+        // all rows fit in memory
+        if (_runs.empty()) return;
+
+        // merge runs
+        if (_entries.size()) spill();
+        mergePasses(max_entries);
+        startMerge(0, _runs.size(), max_entries);
+    }
+
+    virtual bool next(RowBatch& batch) {
+        batch.clear();
+        // in memory
+        if (_runs.empty()) {
+            for (; _pos < _sorted.size() && !batch.full(); ++_pos)
+                appendEntry(batch, _entries.data() + _entry_length * _sorted[_pos]);
+            return !batch.empty();
+        }
+
+        // merge runs
+        while (!batch.full() && 
+               popEntry([this, &batch](const char* entry) { appendEntry(batch, entry); })) { }
+        return !batch.empty();
+    }
+
+    virtual void close() {
+        _child->close();
+        _entries.clear();
+        _sorted.clear();
+        removeRuns();
+    }
+
+    virtual const DBFields& fieldsDesc() const {
+        return _child->fieldsDesc();
+    }
+
+private:
+    // sorted entries in a temp file, which is open only while written or merged
+    struct Run {
+        boost::filesystem::path path;
+        std::fstream file;
+        // entries in file
+        uint64 size;
+        // entries read from file
+        uint64 read;
+        std::vector<char> buffer;
+        uint64 entry_length;
+        uint64 block;
+        // current entry in buffer, and number of entries in buffer
+        uint64 pos;
+        uint64 buffered;
+
+        Run(const boost::filesystem::path& p): 
+            path(p), size(0), read(0), entry_length(0), block(0), pos(0), buffered(0) {
+            file.open(path.string(), std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!file) throw DBError::TempFileFailed(path.string());
+        }
+        ~Run() {
+            file.close();
+            boost::system::error_code ec;
+            boost::filesystem::remove(path, ec);
+        }
+        void write(const char* entry, const uint64 length) {
+            file.write(entry, length);
+            if (!file) throw DBError::TempFileFailed(path.string());
+            ++size;
+        }
+        // close after all entries are written
+        void finish() {
+            file.close();
+            if (!file) throw DBError::TempFileFailed(path.string());
+        }
+        // open for reading, read block entries each time
+        void open(const uint64 b, const uint64 length) {
+            file.open(path.string(), std::ios::in | std::ios::binary);
+            if (!file) throw DBError::TempFileFailed(path.string());
+            block = b;
+            entry_length = length;
+            buffer.resize(block * entry_length);
+            read = pos = buffered = 0;
+        }
+        // read next block, returns 0 if no more entries
+        bool fill() {
+            buffered = std::min(block, size - read);
+            pos = 0;
+            if (!buffered) return 0;
+            file.read(buffer.data(), buffered * entry_length);
+            assert(uint64(file.gcount()) == buffered * entry_length);
+            read += buffered;
+            return 1;
+        }
+        const char* entry() const {
+            return buffer.data() + pos * entry_length;
+        }
+        // move to next entry, returns 0 and closes file if no more entries
+        bool advance() {
+            if (++pos < buffered) return 1;
+            if (fill()) return 1;
+            file.close();
+            return 0;
+        }
+    };
+
+    // heap order of runs, run with smaller entry is on top
+    // runs written earlier go first if entries are equal
+    std::function<bool(const std::size_t, const std::size_t)> runGreater() const {
+        return [this](const std::size_t a, const std::size_t b) {
+            int comp_result = memcmp(_runs[a]->entry(), _runs[b]->entry(), _key_length);
+            return comp_result? comp_result > 0: a > b;
+        };
+    }
+
+    void writeEntry(char* entry, const std::string& key, const RID rid, const char* row) const {
+        memcpy(entry, key.data(), _key_length);
+        memcpy(entry + _key_length, &rid, sizeof(RID));
+        memcpy(entry + _key_length + sizeof(RID), row, _entry_length - _key_length - sizeof(RID));
+    }
+
+    void appendEntry(RowBatch& batch, const char* entry) const {
+        RID rid(0, 0);
+        memcpy(&rid, entry + _key_length, sizeof(RID));
+        batch.append(entry + _key_length + sizeof(RID), rid);
+    }
+
+    // sort entries in memory, result is saved in _sorted
+    // with a thread pool, ranges of entries are sorted by threads,
+    // then neighbouring ranges are merged in rounds
+    void sortEntries() {
+        const uint64 n = _entries.size() / _entry_length;
+        _sorted.resize(n);
+        for (uint64 i = 0; i < n; ++i) _sorted[i] = i;
+
+        if (!_pool || _pool->size() == 1 || n < PARALLEL_SORT_ROWS) {
+            std::vector<uint64> tmp(n);
+            sortRange(_sorted.data(), tmp.data(), n);
+            return;
+        }
+
+        // bounds of sorted ranges
+        std::vector<uint64> bounds;
+        for (uint64 i = 0; i <= _pool->size(); ++i)
+            bounds.push_back(n * i / _pool->size());
+        std::vector<uint64> tmp(n);
+        _pool->run(bounds.size() - 1, [this, &bounds, &tmp](const uint64 i) {
+            sortRange(_sorted.data() + bounds[i], tmp.data() + bounds[i], bounds[i + 1] - bounds[i]);
+        });
+
+        const char* entries = _entries.data();
+        const uint64 key_length = _key_length;
+        const uint64 entry_length = _entry_length;
+        auto less = [entries, key_length, entry_length](const uint64 a, const uint64 b) {
+            return memcmp(entries + entry_length * a, entries + entry_length * b, key_length) < 0;
+        };
+        while (bounds.size() > 2) {
+            // range 2i and 2i + 1 are merged, the last range is copied if there's an odd number of them
+            const uint64 num_ranges = bounds.size() - 1;
+            _pool->run((num_ranges + 1) / 2, [this, &bounds, &tmp, &less, num_ranges](const uint64 i) {
+                const uint64 begin = bounds[2 * i];
+                const uint64 middle = bounds[std::min(2 * i + 1, num_ranges)];
+                const uint64 end = bounds[std::min(2 * i + 2, num_ranges)];
+                // std::merge takes from the first range if equal, merged result is stable
+                std::merge(_sorted.begin() + begin, _sorted.begin() + middle,
+                           _sorted.begin() + middle, _sorted.begin() + end, tmp.begin() + begin, less);
+            });
+            _sorted.swap(tmp);
+            std::vector<uint64> merged_bounds;
+            for (uint64 i = 0; i < bounds.size(); i += 2)
+                merged_bounds.push_back(bounds[i]);
+            if (merged_bounds.back() != n) merged_bounds.push_back(n);
+            bounds.swap(merged_bounds);
+        }
+    }
+
+    // stable sort n entry numbers in sorted by keys, tmp is buffer of the same size
+    void sortRange(uint64* sorted, uint64* tmp, const uint64 n) const {
+        const char* entries = _entries.data();
+        const uint64 key_length = _key_length;
+        const uint64 entry_length = _entry_length;
+        if (_key_length > RADIX_KEY_LENGTH) {
+            std::stable_sort(sorted, sorted + n,
+                [entries, key_length, entry_length](const uint64 a, const uint64 b) {
+                    return memcmp(entries + entry_length * a, entries + entry_length * b, key_length) < 0;
+                });
+            return;
+        }
+
+        // lsd radix sort, from the last byte of key to the first one
+        uint64* from = sorted;
+        uint64* to = tmp;
+        for (uint64 p = _key_length; p-- > 0; ) {
+            uint64 count[256 + 1] = { 0 };
+            for (uint64 i = 0; i < n; ++i)
+                ++count[static_cast<unsigned char>(entries[entry_length * from[i] + p]) + 1];
+            // all keys have the same byte here
+            if (std::find(count + 1, count + 257, n) != count + 257) continue;
+            for (int b = 0; b < 256; ++b) count[b + 1] += count[b];
+            for (uint64 i = 0; i < n; ++i)
+                to[count[static_cast<unsigned char>(entries[entry_length * from[i] + p])]++] = from[i];
+            std::swap(from, to);
+        }
+        if (from != sorted) std::copy(from, from + n, sorted);
+    }
+
+    // write entries in memory to a new run
+    void spill() {
+        sortEntries();
+        _runs.push_back(newRun());
+        for (const auto i: _sorted)
+            _runs.back()->write(_entries.data() + _entry_length * i, _entry_length);
+        _runs.back()->finish();
+        _entries.clear();
+        _sorted.clear();
+    }
+
+    // a run in a new temp file, open for writing
+    std::unique_ptr<Run> newRun() const {
+        boost::filesystem::path path;
+        do {
+            path = _temp_dir / boost::filesystem::unique_path("sort%%%%%%%%%%%%%%%%");
+        } while (boost::filesystem::exists(path));
+        return std::unique_ptr<Run>(new Run(path));
+    }
+
+    // merge every MERGE_FAN_IN neighbouring runs into one, until no more than that are left
+    // runs stay in the order they're written, so equal entries keep their input order
+    void mergePasses(const uint64 max_entries) {
+        while (_runs.size() > MERGE_FAN_IN) {
+            std::vector< std::unique_ptr<Run> > merged;
+            for (std::size_t begin = 0; begin < _runs.size(); begin += MERGE_FAN_IN) {
+                const std::size_t end = std::min<std::size_t>(begin + MERGE_FAN_IN, _runs.size());
+                if (end - begin == 1) {
+                    merged.push_back(std::move(_runs[begin]));
+                    continue;
+                }
+                std::unique_ptr<Run> run = newRun();
+                startMerge(begin, end, max_entries);
+                while (popEntry([this, &run](const char* entry) { run->write(entry, _entry_length); })) { }
+                run->finish();
+                merged.push_back(std::move(run));
+                // temp files merged are removed
+                for (std::size_t i = begin; i < end; ++i) _runs[i].reset();
+            }
+            _runs.swap(merged);
+        }
+    }
+
+    // open runs [begin, end) for merging, memory is shared by them
+    void startMerge(const std::size_t begin, const std::size_t end, const uint64 max_entries) {
+        const uint64 block = std::max<uint64>(1, max_entries / (end - begin));
+        _heap.clear();
+        for (std::size_t i = begin; i < end; ++i) {
+            _runs[i]->open(block, _entry_length);
+            if (_runs[i]->fill()) _heap.push_back(i);
+        }
+        std::make_heap(_heap.begin(), _heap.end(), runGreater());
+    }
+
+    // pass the smallest entry of runs merged to output, and move past it
+    // returns 0 if no entries are left
+    template <class OUTPUT>
+    bool popEntry(OUTPUT output) {
+        if (_heap.empty()) return 0;
+        std::pop_heap(_heap.begin(), _heap.end(), runGreater());
+        Run& run = *_runs[_heap.back()];
+        output(run.entry());
+        if (run.advance())
+            std::push_heap(_heap.begin(), _heap.end(), runGreater());
+        else
+            _heap.pop_back();
+        return 1;
+    }
+
+    void removeRuns() {
+        _runs.clear();
+        _heap.clear();
+    }
+
+    OperatorPtr _child;
+    uint64 _field_id;
+    bool _order;
+    boost::filesystem::path _temp_dir;
+    uint64 _memory;
+    uint64 _limit;
+    DBThreadPool* _pool;
+
+    uint64 _key_length;
+    uint64 _entry_length;
+    std::vector<char> _entries;
+    std::vector<uint64> _sorted;
+    // next entry to output when in memory
+    std::size_t _pos;
+    DBFields::KeyGenerator keyGenerator;
+
+    std::vector< std::unique_ptr<Run> > _runs;
+    // heap of runs with entries left
+    std::vector<std::size_t> _heap;
+};
+
+// skip the first offset rows, then output at most limit rows
+// child won't be asked for more rows once limit is reached
+class Limit: public PhysicalOperator {
+public:
+    Limit(OperatorPtr child, const uint64 limit, const uint64 offset = 0):
+        _child(std::move(child)), _limit(limit), _offset(offset),
+        _skipped(0), _returned(0) { }
+
+    virtual void open() {
+        _child->open();
+        _skipped = 0;
+        _returned = 0;
+    }
+
+    virtual bool next(RowBatch& batch) {
+        batch.clear();
+        while (_returned < _limit && _child->next(batch)) {
+            // skip rows before offset
+            uint64 skip = std::min(_offset - _skipped, batch.size());
+            _skipped += skip;
+            for (uint64 i = skip; i < batch.size(); ++i)
+                batch.copyRow(i, i - skip);
+            batch.truncate(batch.size() - skip);
+            // rows after limit
+            batch.truncate(_limit - _returned);
+            _returned += batch.size();
+            if (!batch.empty()) return 1;
+        }
+        batch.clear();
+        return 0;
+    }
+
+    virtual void close() { _child->close(); }
+
+    virtual const DBFields& fieldsDesc() const {
+        return _child->fieldsDesc();
+    }
+
+private:
+    OperatorPtr _child;
+    uint64 _limit;
+    uint64 _offset;
+    uint64 _skipped;
+    uint64 _returned;
+};
+
+// write all rows of child as aligned text
+class Output {
+public:
+    // rows sampled to decide column widths, 
+    // later rows are written as they are produced
+    static constexpr uint64 SAMPLE_ROWS = 1024;
+
+    Output(OperatorPtr child, std::ostream& out):
+        _child(std::move(child)), _out(out) { }
+
+    // returns number of rows written
+    uint64 run() {
+        const DBFields& fields_desc = _child->fieldsDesc();
+        RowBatch batch(fields_desc.recordLength());
+        AlignedOutputer outputer(_out, SAMPLE_ROWS);
+        std::string str;
+        uint64 num_rows = 0;
+
+        _child->open();
+        while (_child->next(batch)) {
+            for (uint64 i = 0; i < batch.size(); ++i) {
+                for (uint64 j = 0; j < fields_desc.size(); ++j) {
+                    literalParser(batch.row(i) + fields_desc.offset()[j],
+                                  fields_desc.field_type()[j],
+                                  fields_desc.field_length()[j],
+                                  str);
+                    outputer << str;
+                }
+                outputer << AlignedOutputer::endl;
+            }
+            num_rows += batch.size();
+        }
+        _child->close();
+        return num_rows;
+    }
+
+private:
+    OperatorPtr _child;
+    std::ostream& _out;
+    DBFields::LiteralParser literalParser;
+};
+
+// write all rows of child in an exchange format
+// CSV: fields separated by ',', quoted if containing ',', '"' or line breaks,
+//      NULL is an empty field and empty string is ""
+// TSV: fields separated by '\t', with '\t', '\n', '\r' and '\\' escaped,
+//      NULL is \N
+// BINARY: header of "OSQB", number of fields, 
+//         and type, length, name length and name of every field, all uint64,
+//         then every field of every row as a byte of null flag, 
+//         followed by the value if not null
+//         numbers are in native byte order, strings are prefixed with uint32 length
+// floating point numbers are written with the fewest digits read back exactly
+class Export {
+public:
+    static constexpr uint64 FORMAT_CSV = 0;
+    static constexpr uint64 FORMAT_TSV = 1;
+    static constexpr uint64 FORMAT_BINARY = 2;
+    // size of buffer written to out at once
+    static constexpr uint64 BUFFER_SIZE = 1 << 20;
+
+    // returns format of name(case insensitive)
+    // returns max of uint64 if no such format
+    static uint64 format(std::string name) {
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (name == "csv") return FORMAT_CSV;
+        if (name == "tsv") return FORMAT_TSV;
+        if (name == "binary") return FORMAT_BINARY;
+        return std::numeric_limits<uint64>::max();
+    }
+
+    Export(OperatorPtr child, std::ostream& out, const uint64 format):
+        _child(std::move(child)), _out(out), _format(format) { 
+        assert(format <= FORMAT_BINARY);
+    }
+
+    // returns number of rows written
+    uint64 run() {
+        const DBFields& fields_desc = _child->fieldsDesc();
+        RowBatch batch(fields_desc.recordLength());
+        uint64 num_rows = 0;
+        _buffer.clear();
+        _buffer.reserve(BUFFER_SIZE + fields_desc.recordLength() * 4);
+
+        if (_format == FORMAT_BINARY) {
+            _buffer += "OSQB";
+            appendRaw(uint64(fields_desc.size()));
+            for (uint64 j = 0; j < fields_desc.size(); ++j) {
+                appendRaw(fields_desc.field_type()[j]);
+                appendRaw(fields_desc.field_length()[j] - 1);
+                appendRaw(uint64(fields_desc.field_name()[j].length()));
+                _buffer += fields_desc.field_name()[j];
+            }
+        }
+
+        _child->open();
+        while (_child->next(batch)) {
+            for (uint64 i = 0; i < batch.size(); ++i) {
+                for (uint64 j = 0; j < fields_desc.size(); ++j) {
+                    if (j && _format != FORMAT_BINARY) 
+                        _buffer += _format == FORMAT_CSV? ',': '\t';
+                    appendField(batch.row(i) + fields_desc.offset()[j],
+                                fields_desc.field_type()[j],
+                                fields_desc.field_length()[j]);
+                }
+                if (_format != FORMAT_BINARY) _buffer += '\n';
+                if (_buffer.size() >= BUFFER_SIZE) {
+                    _out.write(_buffer.data(), _buffer.size());
+                    _buffer.clear();
+                }
+            }
+            num_rows += batch.size();
+        }
+        _child->close();
+        _out.write(_buffer.data(), _buffer.size());
+        _out.flush();
+        _buffer.clear();
+        return num_rows;
+    }
+
+private:
+    template <class T>
+    void appendRaw(const T x) {
+        _buffer.append(pointer_convert<const char*>(&x), sizeof(T));
+    }
+
+    // append decimal representation of integer
+    template <class T>
+    void appendInteger(const T x) {
+        char str[24];
+        char* end = str + sizeof(str);
+        char* p = end;
+        // avoid overflow of negating min
+        typename std::make_unsigned<T>::type u = x < 0? 0 - static_cast<typename std::make_unsigned<T>::type>(x): x;
+        do {
+            *--p = '0' + u % 10;
+            u /= 10;
+        } while (u);
+        if (x < 0) *--p = '-';
+        _buffer.append(p, end - p);
+    }
+
+    // append number in binary format, or decimal representation
+    template <class T>
+    void appendNumber(const char* data) {
+        T x;
+        memcpy(&x, data, sizeof(T));
+        if (_format == FORMAT_BINARY) appendRaw(x);
+        else appendInteger(x);
+    }
+
+    // append shortest decimal representation read back as x, 
+    // trying digits10 digits before max_digits10 digits
+    template <class T>
+    void appendFloat(const T x) {
+        char str[32];
+        int n = snprintf(str, sizeof(str), "%.*g", std::numeric_limits<T>::digits10, x);
+        if (static_cast<T>(strtod(str, nullptr)) != x)
+            n = snprintf(str, sizeof(str), "%.*g", std::numeric_limits<T>::max_digits10, x);
+        _buffer.append(str, n);
+    }
+
+    void appendString(const char* data, const uint64 length) {
+        if (_format == FORMAT_BINARY) {
+            appendRaw(uint32_t(length));
+            _buffer.append(data, length);
+        } else if (_format == FORMAT_CSV) {
+            if (length && std::find_if(data, data + length, [](const char c) {
+                    return c == ',' || c == '"' || c == '\n' || c == '\r';
+                }) == data + length) {
+                _buffer.append(data, length);
+                return;
+            }
+            _buffer += '"';
+            for (uint64 i = 0; i < length; ++i) {
+                if (data[i] == '"') _buffer += '"';
+                _buffer += data[i];
+            }
+            _buffer += '"';
+        } else {
+            for (uint64 i = 0; i < length; ++i)
+                switch (data[i]) {
+                    case '\t': _buffer += "\\t"; break;
+                    case '\n': _buffer += "\\n"; break;
+                    case '\r': _buffer += "\\r"; break;
+                    case '\\': _buffer += "\\\\"; break;
+                    default: _buffer += data[i];
+                }
+        }
+    }
+
+    void appendField(const char* data, const uint64 type, const uint64 length) {
+        // null
+        if (data[0] == '\x00') {
+            if (_format == FORMAT_BINARY) _buffer += '\x00';
+            else if (_format == FORMAT_TSV) _buffer += "\\N";
+            return;
+        }
+        if (_format == FORMAT_BINARY) _buffer += '\x01';
+        ++data;
+
+        switch (type) {
+            case DBFields::TYPE_INT8: appendNumber<int8_t>(data); break;
+            case DBFields::TYPE_UINT8: appendNumber<uint8_t>(data); break;
+            case DBFields::TYPE_INT16: appendNumber<int16_t>(data); break;
+            case DBFields::TYPE_UINT16: appendNumber<uint16_t>(data); break;
+            case DBFields::TYPE_INT32: appendNumber<int32_t>(data); break;
+            case DBFields::TYPE_UINT32: appendNumber<uint32_t>(data); break;
+            case DBFields::TYPE_INT64: appendNumber<int64_t>(data); break;
+            case DBFields::TYPE_UINT64: appendNumber<uint64_t>(data); break;
+            case DBFields::TYPE_BOOL: {
+                bool x;
+                memcpy(&x, data, sizeof(bool));
+                if (_format == FORMAT_BINARY) appendRaw(x);
+                else _buffer += x? "TRUE": "FALSE";
+                break;
+            } case DBFields::TYPE_CHAR:
+              case DBFields::TYPE_UCHAR: {
+                // value is padded with '\0'
+                uint64 n = length - 1;
+                while (n && data[n - 1] == '\x00') --n;
+                appendString(data, n);
+                break;
+            } case DBFields::TYPE_FLOAT: {
+                float x;
+                memcpy(&x, data, sizeof(float));
+                if (_format == FORMAT_BINARY) appendRaw(x);
+                else appendFloat(x);
+                break;
+            } case DBFields::TYPE_DOUBLE: {
+                double x;
+                memcpy(&x, data, sizeof(double));
+                if (_format == FORMAT_BINARY) appendRaw(x);
+                else appendFloat(x);
+                break;
+            } default:
+                assert(0);
+        }
+    }
+
+    OperatorPtr _child;
+    std::ostream& _out;
+    uint64 _format;
+    std::string _buffer;
+};
+
+constexpr uint64 RowBatch::DEFAULT_CAPACITY;
+constexpr uint64 TableScan::PREFETCH_PAGES;
+constexpr uint64 ParallelTableScan::PAGES_PER_TASK;
+constexpr uint64 ParallelTableScan::TASKS_PER_THREAD;
+constexpr uint64 IndexScan::PREFETCH_ROWS;
+constexpr uint64 Aggregate::NO_GROUP;
+constexpr uint64 Aggregate::ALL_FIELDS;
+constexpr uint64 Aggregate::BATCHES_PER_TASK;
+constexpr uint64 Aggregate::PARTITIONS_PER_THREAD;
+constexpr uint64 Sort::DEFAULT_MEMORY;
+constexpr uint64 Sort::RADIX_KEY_LENGTH;
+constexpr uint64 Sort::PARALLEL_SORT_ROWS;
+constexpr uint64 Sort::MERGE_FAN_IN;
+constexpr uint64 Output::SAMPLE_ROWS;
+constexpr uint64 Export::FORMAT_CSV;
+constexpr uint64 Export::FORMAT_TSV;
+constexpr uint64 Export::FORMAT_BINARY;
+constexpr uint64 Export::BUFFER_SIZE;
+
+} // namespace Operator
+} // namespace Database
+
+#endif /* DB_OPERATOR_H_ */
@@ -11,7 +11,8 @@
  *  Date: Dec. 23, 2014
  *  Time: 11:04:05
  *  Description: Left-Aligned list outputer.
- *               It's kind of low-efficient.
+ *               Column widths are decided by all rows, or by sampled rows
+ *               when rows are streamed.
  *****************************************************************************/
 #ifndef DB_OUTPUTER_H_
 #define DB_OUTPUTER_H_
@@ -22,8 +23,20 @@ class Database::AlignedOutputer {
     std::vector< std::vector<std::string> > data;
     std::vector<std::size_t> max_length;
     std::ostream& out;
+    // number of rows buffered to decide column widths, 0 means all rows
+    std::size_t sample_rows;
+    // 1 if column widths are decided and rows are written as they come
+    bool streaming;
+    // formatted rows not written to out yet
+    std::string buffer;
 public:
-    AlignedOutputer(std::ostream& o): out(o) {
+    // size of buffer written to out at once
+    static constexpr std::size_t BUFFER_SIZE = 1 << 20;
+
+    // with sample_rows > 0, column widths are decided by the first sample_rows rows,
+    // longer values in later rows are not aligned
+    AlignedOutputer(std::ostream& o, const std::size_t sample = 0): 
+        out(o), sample_rows(sample), streaming(0) {
         // new row
         data.push_back(std::vector<std::string>());
     }
@@ -47,20 +60,27 @@ public:
     }
     // new row
     static AlignedOutputer& endl(AlignedOutputer& stream) {
+        if (stream.streaming) {
+            stream.writeRows();
+        } else if (stream.sample_rows && stream.data.size() >= stream.sample_rows) {
+            // column widths are decided
+            stream.writeRows();
+            stream.streaming = 1;
+        } 
         stream.data.push_back(std::vector<std::string>());
         return stream;
     }
     // flush
     static AlignedOutputer& flush(AlignedOutputer& stream) {
-        // code below using std::cout is extremely slow.
-        for (auto ite = stream.data.begin(); ite != stream.data.end() - 1; ++ite) {
-            for (std::size_t i = 0; i < ite->size(); ++i)
-                stream.out << (*ite)[i] << std::string(stream.max_length[i] + 1 - (*ite)[i].length(), ' ');
-            stream.out << std::endl;
-        }
-        stream.data.clear(); 
+        // the last row is not ended
+        stream.data.pop_back();
+        stream.writeRows();
+        stream.out.write(stream.buffer.data(), stream.buffer.size());
+        stream.out.flush();
+        stream.buffer.clear();
         stream.data.push_back(std::vector<std::string>());
         stream.max_length.clear();
+        stream.streaming = 0;
         return stream;
     }
     // for endl and flush
@@ -72,9 +92,27 @@ private:
     // add a new column
     void add(const std::string& str) {
         if (max_length.size() == data.back().size()) max_length.push_back(str.size());
-        else max_length[data.back().size()] = std::max(max_length[data.back().size()], str.size());
+        else if (!streaming) max_length[data.back().size()] = std::max(max_length[data.back().size()], str.size());
         data.back().push_back(str);
     }
+    // format all ended rows into buffer
+    // code using std::cout for every row is extremely slow.
+    void writeRows() {
+        for (const auto& row: data) {
+            for (std::size_t i = 0; i < row.size(); ++i) {
+                buffer += row[i];
+                buffer.append(max_length[i] > row[i].length()? max_length[i] + 1 - row[i].length(): 1, ' ');
+            }
+            buffer += '\n';
+        }
+        data.clear();
+        if (buffer.size() >= BUFFER_SIZE) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
 };
 
+constexpr std::size_t Database::AlignedOutputer::BUFFER_SIZE;
+
 #endif /* DB_OUTPUTER_H_ */
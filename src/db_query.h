@@ -16,30 +16,54 @@
 #ifndef DB_QUERY_H_
 #define DB_QUERY_H_
 
+#include <cctype>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <set>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <tuple>
 #include <regex>
 #include <boost/filesystem.hpp>
 #include <boost/regex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/utility/string_ref.hpp>
 #include "db_query_analyser.h"
 #include "db_tablemanager.h"
 #include "db_fields.h"
 #include "db_error.h"
 #include "db_outputer.h"
+#include "db_operator.h"
+#include "db_reader.h"
+#include "db_threadpool.h"
+#include "db_recovery.h"
+#include "db_versions.h"
+#include "db_lockmanager.h"
 
 class Database::DBQuery {
 public:
     static constexpr char* CHECK_CONSTRAINT_SUFFIX = (char*)".chk";
     static constexpr char* REFERENCED_CONSTRAINT_SUFFIX = (char*)".refed";
     static constexpr char* REFERENCING_CONSTRAINT_SUFFIX = (char*)".refing";
+    static constexpr char* LOG_SUFFIX = (char*)".log";
+    // out of sessions, commits are flushed together, once this many bytes of log or
+    // milliseconds have passed since the first of them, or by flushCommits()
+    static constexpr uint64 GROUP_COMMIT_SIZE = 1 << 20;
+    static constexpr uint64 GROUP_COMMIT_DELAY = 100;
+    // a snapshot isn't begun if transactions going on have logged more bytes than this,
+    // whose changes it would undo in copies of pages
+    static constexpr uint64 MAX_SNAPSHOT_UNDO = 16 * 1024 * 1024;
 
 
     DBQuery(std::ostream& o = std::cout, std::ostream& e = std::cerr): 
-        out(o), err(e) {
+        sort_memory(Operator::Sort::DEFAULT_MEMORY), 
+        output_format(std::numeric_limits<uint64>::max()), restrict_files(0), schema_version(0), 
+        in_session(0), commit_lsn(0), group_lsn(0), in_transaction(0), source(nullptr), close_pending(0), 
+        lock_waiting(0), 
+        out(o.rdbuf()), err(e.rdbuf()) {
         temp_dir = uniquePath();
         boost::filesystem::create_directories(temp_dir);
     }
@@ -49,37 +73,259 @@ public:
         closeDBInUse();
     }
 
-    bool execute(const std::string& str) {
-#ifdef DEBUG
-        err << "----------------------------\n";
-        err << "Stmt: " << (str.length() > 400? str.substr(0, 400): str) << std::endl;
-#endif
-        try {
-            // try to parse with different patterns
-            for (int i = 0; i < kParseFunctions; ++i) {
-                int rtv = (this->*parseFunctions[i])(str);
+    // each statement is a transaction, unless a transaction is begun by BEGIN and ended by COMMIT,
+    // which is durable when Session::waitDurable() returns in a session,
+    // out of sessions when flushCommits() returns, or commits after it are flushed with it
+    bool execute(const boost::string_ref str) {
+        assert(!snapshot || readOnly(str));
+        // snapshots of source begin between statements of writers
+        boost::shared_lock<boost::shared_mutex> lock;
+        if (source && !snapshot) lock = boost::shared_lock<boost::shared_mutex>(source->statement_latch);
+        lock_waiting = 0;
+        if (!in_transaction && log) log->begin();
+        bool rtv = executeStatement(str);
+        if (!in_transaction) 
+            rtv |= commitStatement();
+        else if (!lock_waiting)
+            // lock waited for by the statement last time may be not requested this time
+            lockManager().cancel(log->transaction());
+        return rtv;
+    }
 
-                switch (rtv) {
-                    // parse and execute sucessful
-                    case 0: 
-                        return 0;
-                    // parse failed
-                    case 1:
-                        continue;
-                    // parse sucessful but execute failed
-                    default:
-                        // all execution error will throw exceptions
-                        // this should never happen
-                        assert(0);
-                        return 1;
-                }
+    // set memory limit of sorting, in Bytes
+    // rows are sorted on disk if they exceed this limit
+    void setSortMemory(const uint64 bytes) {
+        sort_memory = bytes;
+    }
+
+    // set number of threads scanning tables, including the calling thread
+    // tables are scanned by the calling thread only if num_threads is 1
+    void setThreads(const uint64 num_threads) {
+        thread_pool.reset(num_threads > 1? new DBThreadPool(num_threads): nullptr);
+    }
+
+    // state of a client, when clients of a server share one DBQuery
+    class Session;
+
+    // switch to database and prepared statements of session,
+    // results and errors are written to o until leaveSession() is called
+    // session is left with no database in use if its database has been dropped
+    // or can't be recovered
+    // returns 0 if succeed, 1 if session uses another database, which can't be switched to
+    // until transactions on database in use end, see blocked()
+    bool enterSession(Session& session, std::ostream& o) {
+        lock_waiting = 0;
+        if (session.db != db_inuse) {
+            locks.transactions(lock_blockers);
+            if (!lock_blockers.empty()) {
+                lock_waiting = 1;
+                return 1;
             }
-            // parse failed
-            throw DBError::ParseFailed();
+        }
+        out.rdbuf(o.rdbuf());
+        err.rdbuf(o.rdbuf());
+        in_session = 1;
+        prepared_statements.swap(session.prepared_statements);
+        if (session.db == db_inuse) {
+            // transaction of session goes on
+            in_transaction = session.in_transaction;
+            if (in_transaction) log->setTransaction(session.txn);
+            return 0;
+        }
+        // transaction of session is left to recovery if its database was closed by others
+        if (session.in_transaction) {
+            session.in_transaction = 0;
+            err << DBError::DatabaseClosed().getInfo() << std::endl;
+        }
+        // tables read by snapshots are closed after they end
+        std::lock_guard<boost::shared_mutex> lock(snapshot_latch);
+        if (session.db.empty() || !boost::filesystem::is_directory(session.db)) {
+            closeDBInUse();
+            return 0;
+        }
+        try {
+            useDB(session.db);
         } catch (const DBError::Error& error) {
             err << error.getInfo() << std::endl;
         }
-        return 1;
+        return 0;
+    }
+
+    // make commits of statements executed out of sessions durable, by one log flush
+    // returns 0 if succeed, 1 if log failed, with error written to err
+    bool flushCommits() {
+        assert(!in_session);
+        const bool failed = commit_lsn && log->flush(commit_lsn);
+        commit_lsn = group_lsn = 0;
+        if (failed) err << DBError::LogFailed().getInfo() << std::endl;
+        return failed;
+    }
+
+    // whether the last statement executed, or session entered, has to wait for locks of
+    // transactions of other sessions, it's not executed then, and should be executed again
+    // after one of them ends
+    bool blocked() const {
+        return lock_waiting;
+    }
+
+    // transactions the last statement executed or session entered waits for, if blocked
+    const std::vector<uint64>& blockers() const {
+        return lock_blockers;
+    }
+
+    // whether transaction txn has ended, releasing its locks
+    bool ended(const uint64 txn) {
+        return !locks.active(txn);
+    }
+
+    // save state of session, and restore output streams
+    void leaveSession(Session& session, std::ostream& o = std::cout, std::ostream& e = std::cerr) {
+        session.db = db_inuse;
+        prepared_statements.swap(session.prepared_statements);
+        if (commit_lsn) {
+            session.log = log;
+            session.commit_lsn = commit_lsn;
+        }
+        commit_lsn = 0;
+        session.in_transaction = in_transaction;
+        session.txn = in_transaction? log->transaction(): 0;
+        if (in_transaction) log->setTransaction(0);
+        in_transaction = 0;
+        in_session = 0;
+        out.rdbuf(o.rdbuf());
+        err.rdbuf(e.rdbuf());
+    }
+
+    // whether statement only reads, so it can be executed with a snapshot
+    static bool readOnly(const boost::string_ref str) {
+        std::size_t pos = 0;
+        return nextWord(str, pos) == "select";
+    }
+
+    // whether statement changes schema or switches database, so it can't be executed by a writer
+    static bool changesSchema(const boost::string_ref str) {
+        std::size_t pos = 0;
+        const std::string first = nextWord(str, pos);
+        return first == "create" || first == "drop" || first == "use";
+    }
+
+    // let reader execute read only statements of session, with a snapshot of database in use,
+    // results and errors are written to o until endSnapshot() is called
+    // statements executed by this meanwhile are not seen by reader and don't wait for it,
+    // except those changing schema, which wait until snapshot ends
+    // execute() of this can't be called until this returns
+    // changes of transactions going on are not seen, reader sees pages as last committed
+    // returns 0 if succeed, 1 if session's database is not in use, it's in a transaction,
+    // or transactions going on have logged too much to be undone for reader
+    bool beginSnapshot(DBQuery& reader, const Session& session, std::ostream& o) {
+        if (!versions || session.db != db_inuse || session.in_transaction) return 1;
+        // no page is being changed by writers when changes are collected and snapshot begins
+        std::lock_guard<boost::shared_mutex> lock(statement_latch);
+        DBVersions::Uncommitted uncommitted;
+        if (log && log->numTransactions() && 
+            DBRecovery(*log).uncommitted(MAX_SNAPSHOT_UNDO, uncommitted)) 
+            return 1;
+        snapshot_latch.lock_shared();
+        reader.source = this;
+        reader.db_inuse = db_inuse;
+        reader.sort_memory = sort_memory;
+        reader.output_format = output_format;
+        reader.restrict_files = restrict_files;
+        reader.file_directory = file_directory;
+        reader.out.rdbuf(o.rdbuf());
+        reader.err.rdbuf(o.rdbuf());
+        reader.snapshot.reset(new DBVersions::Snapshot(*versions, std::move(uncommitted)));
+        return 0;
+    }
+
+    // end snapshot of reader begun by beginSnapshot(), in the same thread
+    void endSnapshot(DBQuery& reader, std::ostream& o = std::cout, std::ostream& e = std::cerr) {
+        reader.snapshot.reset();
+        reader.source = nullptr;
+        reader.db_inuse.clear();
+        reader.out.rdbuf(o.rdbuf());
+        reader.err.rdbuf(e.rdbuf());
+        snapshot_latch.unlock_shared();
+    }
+
+    // let writer enter session and execute its statements on database in use,
+    // at the same time as statements of other sessions executed by this and other writers,
+    // tables and locks of this are used, results and errors are written to o
+    // until endWriter() is called
+    // statements changing schema or database in use can't be executed by writer,
+    // and wait until it ends
+    // execute() of this can't be called until this returns
+    // returns 0 if succeed, 1 if session's database is not in use
+    bool beginWriter(DBQuery& writer, Session& session, std::ostream& o) {
+        if (db_inuse.empty() || session.db != db_inuse) return 1;
+        snapshot_latch.lock_shared();
+        writer.source = this;
+        writer.db_inuse = db_inuse;
+        writer.log = log;
+        writer.referencing_tables = referencing_tables;
+        writer.referenced_tables = referenced_tables;
+        writer.schema_version = schema_version;
+        writer.sort_memory = sort_memory;
+        writer.output_format = output_format;
+        writer.restrict_files = restrict_files;
+        writer.file_directory = file_directory;
+        writer.enterSession(session, o);
+        return 0;
+    }
+
+    // leave session entered by writer begun by beginWriter(), in the same thread
+    // returns 1 if writer failed to roll back a transaction, when database in use
+    // should be closed by closeDBAfterRollback(), 0 otherwise
+    bool endWriter(DBQuery& writer, Session& session, std::ostream& o = std::cout, std::ostream& e = std::cerr) {
+        writer.leaveSession(session, o, e);
+        const bool failed = writer.close_pending;
+        writer.close_pending = 0;
+        writer.source = nullptr;
+        writer.db_inuse.clear();
+        writer.log.reset();
+        writer.referencing_tables.clear();
+        writer.referenced_tables.clear();
+        snapshot_latch.unlock_shared();
+        return failed;
+    }
+
+    // close database after its rollback failed, which waits for snapshots and writers to end
+    // a writer leaves it to this, see endWriter()
+    void closeDBAfterRollback() {
+        if (source) {
+            log->setTransaction(0);
+            log.reset();
+            db_inuse.clear();
+            close_pending = 1;
+            return;
+        }
+        std::lock_guard<boost::shared_mutex> lock(snapshot_latch);
+        closeDBInUse();
+    }
+
+    // files read by LOAD DATA and written by INTO OUTFILE are restricted to directory,
+    // statements reading or writing files are refused if it's empty
+    // called when serving clients, which must not reach files of the server
+    void restrictFiles(const std::string& directory) {
+        restrict_files = 1;
+        file_directory.clear();
+        boost::system::error_code ec;
+        if (!directory.empty()) 
+            file_directory = boost::filesystem::canonical(directory, ec).string();
+    }
+
+    // set format of select results, which is one of csv, tsv, binary or text
+    // text means aligned text
+    // returns 0 if succeed, 1 if no such format
+    bool setOutputFormat(const std::string& name) {
+        if (name == "text") {
+            output_format = std::numeric_limits<uint64>::max();
+            return 0;
+        }
+        uint64 format = Operator::Export::format(name);
+        if (format == std::numeric_limits<uint64>::max()) return 1;
+        output_format = format;
+        return 0;
     }
 
 private:
@@ -117,20 +363,127 @@ private:
             return { right_name, right_id, new_op, left_name, left_id };
         }
     };
+    struct PreparedStatement {
+        enum Kind { INSERT, SIMPLE_SELECT, DELETE, UPDATE };
+        Kind kind;
+        // parsed statement, values may be placeholders
+        QueryProcess::InsertRecordStatement insert_query;
+        QueryProcess::SimpleSelectStatement select_query;
+        QueryProcess::DeleteStatement delete_query;
+        QueryProcess::UpdateStatement update_query;
+        // number of placeholders
+        uint64 num_params;
+        // compiled where clause, placeholders are compiled as null
+        std::vector<Condition> conditions;
+        // whether conditions are compiled, and schema version when compiled
+        bool compiled;
+        uint64 schema_version;
+        PreparedStatement(): num_params(0), compiled(0), schema_version(0) { }
+    };
+
+public:
+    class Session {
+    public:
+        Session(): commit_lsn(0), in_transaction(0), txn(0) { }
+
+        // whether a transaction begun by BEGIN is in progress
+        bool inTransaction() const { return in_transaction; }
+
+        // wait until statements committed in session are durable
+        // can be called without entering session, so sessions share log flushes
+        // returns 0 if succeed, 1 if log failed
+        bool waitDurable() {
+            const bool failed = log && commit_lsn && log->flush(commit_lsn);
+            commit_lsn = 0;
+            return failed;
+        }
 
-    // intermediate result
-    struct IntermediateTable {
-        DBQuery& parent;
-        DBTableManager* table_manager;
-        int table_manager_number;
-        IntermediateTable(DBQuery& p): parent(p), table_manager(nullptr), table_manager_number(-1) { }
-        ~IntermediateTable() { parent.removeTempTable(table_manager_number); }
+    private:
+        friend class DBQuery;
+        // database in use, empty if none
+        std::string db;
+        std::unordered_map<std::string, PreparedStatement> prepared_statements;
+        // log of database, and the last commit in it to be flushed
+        std::shared_ptr<DBLog> log;
+        uint64 commit_lsn;
+        // transaction begun by BEGIN, left in log when session is left
+        bool in_transaction;
+        uint64 txn;
     };
 
+private:
+
+    // parse and execute a statement
+    // returns 0 if succeed, 1 otherwise, with error written to err
+    bool executeStatement(const boost::string_ref str) {
+#ifdef DEBUG
+        err << "----------------------------\n";
+        err << "Stmt: " << (str.length() > 400? str.substr(0, 400): str) << std::endl;
+#endif
+        // tables read by snapshots are changed or closed after they end
+        std::unique_lock<boost::shared_mutex> lock(snapshot_latch, std::defer_lock);
+        try {
+            // parse functions are chosen by leading keywords
+            const std::vector<ParseFunctions>* parse_functions = dispatchParseFunctions(str);
+            if (!parse_functions) throw DBError::ParseFailed();
+            std::size_t pos = 0;
+            std::string first = nextWord(str, pos);
+            const bool schema_changed = first == "create" || first == "drop" || first == "use";
+            // schema changes can't be rolled back
+            if (in_transaction && schema_changed) {
+                std::transform(first.begin(), first.end(), first.begin(), ::toupper);
+                throw DBError::NotAllowedInTransaction(first);
+            }
+            // schema changes wait until transactions of others end
+            if (schema_changed && log) checkLock(locks.lockDatabase(log->transaction(), DBLockManager::X));
+            if (schema_changed) lock.lock();
+
+            // try to parse with different patterns
+            for (const auto parse_function: *parse_functions) {
+                int rtv = (this->*parse_function)(str);
+
+                switch (rtv) {
+                    // parse and execute sucessful
+                    case 0: 
+                        return 0;
+                    // parse failed
+                    case 1:
+                        continue;
+                    // parse sucessful but execute failed
+                    default:
+                        // all execution error will throw exceptions
+                        // this should never happen
+                        assert(0);
+                        return 1;
+                }
+            }
+            // parse failed
+            throw DBError::ParseFailed();
+        } catch (const DBError::LockWait&) {
+            // changes of statement are undone, it's executed again when those it waits for end
+            lock_waiting = 1;
+            lockManager().blockers(log->transaction(), lock_blockers);
+        } catch (const DBError::Deadlock& error) {
+            err << error.getInfo() << std::endl;
+            // transaction is rolled back, so that others waiting for it go on
+            // schema changes are not in transactions, so latch is not locked
+            if (in_transaction) {
+                in_transaction = 0;
+                if (rollbackTransaction()) {
+                    closeDBAfterRollback();
+                    err << DBError::RollbackFailed().getInfo() << std::endl;
+                }
+            }
+        } catch (const DBError::Error& error) {
+            err << error.getInfo() << std::endl;
+        }
+        return 1;
+    }
+
     // parse as statement "CREATE DATABASE <database name>"
     // returns 0 if parse and execute succeed
     // returns 1 if parse failed
-    int parseAsCreateDBStatement(const std::string& str) {
+    int parseAsCreateDBStatement(const boost::string_ref str) {
         QueryProcess::CreateDBStatement query;
         
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
@@ -153,7 +506,7 @@ private:
     // parse as statement "DROP DATABASE <database name>"
     // returns 0 if parse and execute succeed
     // returns 1 if parse failed
-    int parseAsDropDBStatement(const std::string& str) {
+    int parseAsDropDBStatement(const boost::string_ref str) {
         QueryProcess::DropDBStatement query;
         
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
@@ -185,7 +538,7 @@ private:
     // parse as statement "USE <database name>"
     // returns 0 if parse and execute succeed
     // returns 1 if parse failed
-    int parseAsUseDBStatement(const std::string& str) {
+    int parseAsUseDBStatement(const boost::string_ref str) {
         QueryProcess::UseDBStatement query;
 
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
@@ -199,32 +552,48 @@ private:
             if (!boost::filesystem::exists(query.db_name) || 
                 !boost::filesystem::is_directory(query.db_name)) 
                 throw DBError::DBNotExists<DBError::UseDBFailed>(query.db_name);
-            // if a database has already been opened, close it first
-            if (db_inuse.length())
-                closeDBInUse();
-
-            db_inuse = query.db_name;
-
-            // if existing foreign key reference configuration files
-            bool refed_exists = boost::filesystem::exists(db_inuse + '/' + db_inuse + REFERENCED_CONSTRAINT_SUFFIX) &&
-                                boost::filesystem::is_regular_file(db_inuse + '/' + db_inuse + REFERENCED_CONSTRAINT_SUFFIX);
-            bool refing_exists = boost::filesystem::exists(db_inuse + '/' + db_inuse + REFERENCING_CONSTRAINT_SUFFIX) &&
-                                 boost::filesystem::is_regular_file(db_inuse + '/' + db_inuse + REFERENCING_CONSTRAINT_SUFFIX);
-            assert(refed_exists == refing_exists);
-            // load them
-            loadForeignKeyConstraints(referenced_tables, db_inuse + '/' + db_inuse + REFERENCED_CONSTRAINT_SUFFIX);
-            loadForeignKeyConstraints(referencing_tables, db_inuse + '/' + db_inuse + REFERENCING_CONSTRAINT_SUFFIX);
-
+            useDB(query.db_name);
             return 0;
         }
         return 1;
     }
 
+    // use an existing database
+    void useDB(const std::string& db_name) {
+        // if a database has already been opened, close it first
+        if (db_inuse.length())
+            closeDBInUse();
+
+        db_inuse = db_name;
+        versions.reset(new DBVersions);
+
+        // database is used without log if it cannot be opened
+        log = std::make_shared<DBLog>(db_inuse + '/' + db_inuse + LOG_SUFFIX);
+        if (log->open()) {
+            log.reset();
+        } else if (recover()) {
+            // log is kept for another try
+            log.reset();
+            closeDBInUse();
+            throw DBError::RecoveryFailed(db_name);
+        }
+
+        // if existing foreign key reference configuration files
+        bool refed_exists = boost::filesystem::exists(db_inuse + '/' + db_inuse + REFERENCED_CONSTRAINT_SUFFIX) &&
+                            boost::filesystem::is_regular_file(db_inuse + '/' + db_inuse + REFERENCED_CONSTRAINT_SUFFIX);
+        bool refing_exists = boost::filesystem::exists(db_inuse + '/' + db_inuse + REFERENCING_CONSTRAINT_SUFFIX) &&
+                             boost::filesystem::is_regular_file(db_inuse + '/' + db_inuse + REFERENCING_CONSTRAINT_SUFFIX);
+        assert(refed_exists == refing_exists);
+        // load them
+        loadForeignKeyConstraints(referenced_tables, db_inuse + '/' + db_inuse + REFERENCED_CONSTRAINT_SUFFIX);
+        loadForeignKeyConstraints(referencing_tables, db_inuse + '/' + db_inuse + REFERENCING_CONSTRAINT_SUFFIX);
+    }
+
     // parse as statement "SHOW DATABASES"
     // returns 0 if parse and execute succeed
     // returns 1 if parse failed
     // this function should always execute succeed if parse succeed 
-    int parseAsShowDBStatement(const std::string& str) {
+    int parseAsShowDBStatement(const boost::string_ref str) {
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
                                                   str.end(), 
                                                   showDBStatementParser, 
@@ -244,7 +613,7 @@ private:
     // parse as statement "CREATE TABLE <table name> (+<field name>);"
     // returns 0 if parse and execute succeed
     // returns 1 if parse failed
-    int parseAsCreateTableStatement(const std::string& str) {
+    int parseAsCreateTableStatement(const boost::string_ref str) {
         QueryProcess::CreateTableStatement query;
 
         bool ok = boost::spirit::qi::phrase_parse(str.begin(),
@@ -382,7 +751,7 @@ private:
             if (db_inuse.length() == 0) 
                 throw DBError::DBNotOpened<DBError::CreateTableFailed>(query.table_name);
 
-            DBTableManager table_manager;
+            DBTableManager table_manager(log.get());
             // create table
             bool create_rtv = table_manager.create(db_inuse + '/' + query.table_name, dbfields, 
                                                    DBTableManager::DEFAULT_PAGE_SIZE);
@@ -416,7 +785,7 @@ private:
     // parse as statement "SHOW TABLES"
     // returns 0 if parse and execute succeed
     // returns 1 if parse failed
-    int parseAsShowTablesStatement(const std::string& str) {
+    int parseAsShowTablesStatement(const boost::string_ref str) {
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
                                                   str.end(), 
                                                   showTablesStatementParser, 
@@ -441,7 +810,7 @@ private:
     // parse as statement "DROP TABLE <table name>"
     // returns 0 if parse and execute succeed
     // returns 1 if parse failed
-    int parseAsDropTableStatement(const std::string& str) {
+    int parseAsDropTableStatement(const boost::string_ref str) {
         QueryProcess::DropTableStatement query;
         
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
@@ -492,7 +861,7 @@ private:
     // parse as statement "DESC[RIBE] TABLE <table name>"
     // returns 0 if parse and execute  succeed
     // returns 1 if parse failed
-    int parseAsDescTableStatement(const std::string& str) {
+    int parseAsDescTableStatement(const boost::string_ref str) {
         QueryProcess::DescTableStatement query;
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
                                                   str.end(),
@@ -536,7 +905,7 @@ private:
     // parse as statement "CREATE INDEX ON <table name> (<field name>)"
     // returns 0 if parse and execute  succeed
     // returns 1 if parse failed
-    int parseAsCreateIndexStatement(const std::string& str) {
+    int parseAsCreateIndexStatement(const boost::string_ref str) {
         QueryProcess::CreateIndexStatement query;
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
                                                   str.end(),
@@ -575,7 +944,7 @@ private:
     // parse as statement "DROP INDEX ON <table name> (<field name>)"
     // returns 0 if parse and execute  succeed
     // returns 1 if parse failed
-    int parseAsDropIndexStatement(const std::string& str) {
+    int parseAsDropIndexStatement(const boost::string_ref str) {
         QueryProcess::DropIndexStatement query;
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
                                                   str.end(),
@@ -613,7 +982,7 @@ private:
     // parse as statement "INSERT INTO <table name> VALUES (...);"
     // returns 0 if parse and execute  succeed
     // returns 1 if parse failed
-    int parseAsInsertRecordStatement(const std::string& str) {
+    int parseAsInsertRecordStatement(const boost::string_ref str) {
         QueryProcess::InsertRecordStatement query;
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
                                                   str.end(),
@@ -621,50 +990,54 @@ private:
                                                   boost::spirit::qi::space,
                                                   query);
         if (ok) {
-            // assert database is opened 
-            if (db_inuse.length() == 0) 
-                throw DBError::DBNotOpened<DBError::InsertRecordFailed>(query.table_name, query.value_tuples.front().value_tuple);
-            
-            // open table
-            DBTableManager* table_manager = openTable(query.table_name);
-            // open failed
-            if (!table_manager) 
-                throw DBError::OpenTableFailed<DBError::InsertRecordFailed>(query.table_name, query.table_name, query.value_tuples.front().value_tuple);
-            
-            // get fileds description
-            const DBFields& fields_desc = table_manager->fieldsDesc();
-            
-            std::unique_ptr<char[]> buffer(new char[fields_desc.recordLength()]);
-            
-            // store all rids
-            // if one record insert failed, remove all stored rids
-            std::vector<RID> rids;
-            try {
-                auto ite = tables_check_constraints.find(query.table_name);
-                std::vector<Condition>* check_constraint = ite == tables_check_constraints.end()? nullptr: &ite->second;
-
-                for (const auto& value_tuple: query.value_tuples) 
-                    rids.push_back(insertRecord(query.table_name, table_manager, 
-                                                value_tuple.value_tuple, 
-                                                buffer.get(),
-                                                check_constraint));
-            } catch (...) {
-                for (const auto& rid: rids) 
-                    assert(table_manager->removeRecord(rid) == 0);
-                throw;
-            }
-            
-            return 0;
+            return executeInsertRecord(query);
         }
         return 1;
+    }
 
+    // execute parsed statement "INSERT INTO <table name> VALUES (...);"
+    // returns 0 if succeed
+    int executeInsertRecord(const QueryProcess::InsertRecordStatement& query) {
+        // assert database is opened 
+        if (db_inuse.length() == 0) 
+            throw DBError::DBNotOpened<DBError::InsertRecordFailed>(query.table_name, query.value_tuples.front().value_tuple);
+        
+        // open table
+        DBTableManager* table_manager = openTable(query.table_name);
+        // open failed
+        if (!table_manager) 
+            throw DBError::OpenTableFailed<DBError::InsertRecordFailed>(query.table_name, query.table_name, query.value_tuples.front().value_tuple);
+        
+        // get fileds description
+        const DBFields& fields_desc = table_manager->fieldsDesc();
+        
+        std::unique_ptr<char[]> buffer(new char[fields_desc.recordLength()]);
+        
+        // store all rids
+        // if one record insert failed, remove all stored rids
+        std::vector<RID> rids;
+        try {
+            const std::vector<Condition>* check_constraint = checkConstraint(query.table_name);
+
+            for (const auto& value_tuple: query.value_tuples) 
+                rids.push_back(insertRecord(query.table_name, table_manager, 
+                                            value_tuple.value_tuple, 
+                                            buffer.get(),
+                                            check_constraint));
+        } catch (...) {
+            for (const auto& rid: rids) 
+                assert(table_manager->removeRecord(rid) == 0);
+            throw;
+        }
+        
+        return 0;
     }
 
     // parse as SELECT <table name>.<field name> [, <table name>.<field name>]* 
     //          FROM <table name> [, <table name>] [WHERE <condition>];
     // returns 0 if parse and execute  succeed
     // returns 1 if parse failed
-    int parseAsComplexSelectStatement(const std::string& str) {
+    int parseAsComplexSelectStatement(const boost::string_ref str) {
         QueryProcess::ComplexSelectStatement query;
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
                                                   str.end(),
@@ -686,6 +1059,7 @@ private:
                     throw DBError::OpenTableFailed<DBError::ComplexSelectFailed>(tn, query.table_names);
                 if (table_managers.emplace(tn, table_manager).second == 0)
                     throw DBError::DuplicateTableName(query.table_names, tn);
+                lockTable(table_manager, DBLockManager::S);
 
                 fields_descs.emplace(tn, table_manager->fieldsDesc());
             }
@@ -698,10 +1072,10 @@ private:
             // check where clause
             for (const auto& cond: query.conditions) 
                 // constant true condition
-                if (boost::regex_match(cond.left_expr.table_name, boost::regex("(true)", boost::regex_constants::icase)))
+                if (cond.left_expr.table_name == "true")
                     continue;
                 // constant false condition
-                else if (boost::regex_match(cond.left_expr.table_name, boost::regex("(false)", boost::regex_constants::icase)))
+                else if (cond.left_expr.table_name == "false")
                     for (auto& i: simple_conditions)
                         i.second.push_back(Condition(0, 0, 0, "", ""));
                 // right expr is literal, convert to simple condition
@@ -749,67 +1123,20 @@ private:
                                                    cond.right_expr.table_name,
                                                    right_field_id });
                 }
-            std::unordered_map< std::string, std::vector<RID> > rids;
-
-            // select rids meeting simple conditions
-            for (const auto tm: table_managers) 
-                rids.emplace(tm.first, selectRID(tm.second, simple_conditions[tm.first]));
-
-            
-            // intermediate result
-            // ATTENTION: 
-            // DONOT use vector,
-            // use list instead to avoid reallocating when inserting.
-            // Reallocatiing will lead to desctruct and then construct IntermediateTable
-            // which isn't what we want.
-            std::list<IntermediateTable> intermediates;
-
-            std::unordered_map<std::string, DBTableManager*> temp_table_managers;
-
-            // create temp table for each table
-            for (const auto& tb: table_managers) {
-                // create poitner to table manager
-                intermediates.push_back(IntermediateTable(*this));
-                std::tie(intermediates.back().table_manager_number,
-                         intermediates.back().table_manager) = getTempTable(-1);
-                auto temp_file = uniquePath(temp_dir);
-                // create temp table
-                intermediates.back().table_manager->create(
-                    temp_file.string(), fields_descs[tb.first], 
-                    DBTableManager::DEFAULT_PAGE_SIZE);
-                // open temp table
-                assert(intermediates.back().table_manager->open(temp_file.string()) == 0);
-                // insert records
-                std::unique_ptr<char[]> buff(new char[intermediates.back().table_manager->fieldsDesc().recordLength()]);
-                std::vector<RID> temp_rids;
-                for (const auto rid: rids[tb.first]) {
-                    assert(table_managers[tb.first]->selectRecord(rid, buff.get()) == 0);
-                    temp_rids.push_back(intermediates.back().table_manager->insertRecord(buff.get()));
-                    assert(temp_rids.back());
-                }
-                rids[tb.first] = temp_rids;
-
-                temp_table_managers.emplace(tb.first, intermediates.back().table_manager);
-            }
-            // now, records meeting simple conditions are all in temp table managers
-            // and rids contains rid to temp table managers
-            // table_managers are of no use any more
-
-
             std::vector<std::string> table_names_inorder;
             
             std::unordered_map<std::string, std::vector<ComplexCondition> > complex_conditions_inorder;
-            for (const auto& tb: temp_table_managers) {
+            for (const auto& tb: table_managers) {
                 table_names_inorder.push_back(tb.first);
                 complex_conditions_inorder[tb.first] = std::vector<ComplexCondition>();
             }
 
             // adjust table order to optimise performance
-            sort(table_names_inorder.begin(), table_names_inorder.end(),
-                 [&temp_table_managers]
+            std::stable_sort(table_names_inorder.begin(), table_names_inorder.end(),
+                 [&table_managers]
                      (const std::string& str1, const std::string& str2)->bool {
-                     const DBFields& fields1 = temp_table_managers[str1]->fieldsDesc();
-                     const DBFields& fields2 = temp_table_managers[str2]->fieldsDesc();
+                     const DBFields& fields1 = table_managers[str1]->fieldsDesc();
+                     const DBFields& fields2 = table_managers[str2]->fieldsDesc();
                      return 
                      fields1.field_name()[fields1.primary_key_field_id()].length() <
                      fields2.field_name()[fields2.primary_key_field_id()].length();
@@ -826,8 +1153,11 @@ private:
 
             // fields description for joined table
             DBFields joined_fields_desc;
+            // id of the first field of each table in joined table
+            std::unordered_map<std::string, uint64> field_bases;
             for (const auto& tn: table_names_inorder) {
-                const DBFields& fields_desc = temp_table_managers[tn]->fieldsDesc();
+                const DBFields& fields_desc = table_managers[tn]->fieldsDesc();
+                field_bases.emplace(tn, joined_fields_desc.size());
                 for (uint64 i = 0; i < fields_desc.size(); ++i) {
                     uint64 type = fields_desc.field_type()[i];
                     uint64 length = fields_desc.field_length()[i];
@@ -837,47 +1167,61 @@ private:
                     joined_fields_desc.insert(type, length - 1, 0, 0, not_null, field_name);
                 }
             }
-            joined_fields_desc.addPrimaryKey();
-            
-            // create intermediate table
-            IntermediateTable intermediate(*this);
-            std::tie(intermediate.table_manager_number,
-                     intermediate.table_manager) = getTempTable(-1);
-
-            auto temp_file = uniquePath(temp_dir);
-            intermediate.table_manager->create(
-                    temp_file.string(), joined_fields_desc, 
-                    DBTableManager::DEFAULT_PAGE_SIZE);
-            // open temp table
-            assert(intermediate.table_manager->open(temp_file.string()) == 0);
-            
-            // call back function for inner join
-            std::unique_ptr<char[]> buffer(new char[joined_fields_desc.recordLength()]);
-            std::vector<RID> joined_rids;
-            auto innerJoinResult = [this, &temp_table_managers, &table_names_inorder, &buffer, &intermediate, &joined_rids](const std::vector<RID>& new_record) {
-                uint64 offset = 0;
-                for (std::size_t i = 0; i < table_names_inorder.size(); ++i) {
-                    DBTableManager* tb_mgr = temp_table_managers.at(table_names_inorder[i]);
-                    tb_mgr->selectRecord(new_record.at(i), buffer.get() + offset);
-                    offset += tb_mgr->fieldsDesc().recordLength();
-                }
 
-                // add primary key
-                uint64 unique_number = uniqueNumber();
-                buffer[offset] = '\xff';
-                memcpy(buffer.get() + offset + 1, &unique_number, 
-                    intermediate.table_manager->fieldsDesc().field_length()[
-                        intermediate.table_manager->fieldsDesc().primary_key_field_id()] - 1);
+            // records meeting simple conditions are read from each table,
+            // then joined with tables before it
+            Operator::OperatorPtr plan;
+            for (const auto& tn: table_names_inorder) {
+                Operator::OperatorPtr scan = scanPlan(table_managers[tn], simple_conditions[tn]);
+                if (!plan) {
+                    plan = std::move(scan);
+                    continue;
+                }
 
-                // insert record
-                joined_rids.push_back(intermediate.table_manager->insertRecord(buffer.get()));
-                assert(joined_rids.back());
-            };
+                // left field of condition is in this table, right field is in tables before
+                // offset of left and right field in joined record, type, length, operator
+                typedef std::tuple<uint64, uint64, uint64, uint64, std::string> JoinCondition;
+                std::vector<JoinCondition> join_conds;
+                // hash join on the first equal condition
+                // floating point isn't hashed since nan equals to everything
+                uint64 hash_left_id = std::numeric_limits<uint64>::max();
+                uint64 hash_right_id = std::numeric_limits<uint64>::max();
+                for (const auto& cond: complex_conditions_inorder[tn]) {
+                    assert(cond.left_name == tn);
+                    uint64 left_id = field_bases[tn] + cond.left_id;
+                    uint64 right_id = field_bases[cond.right_name] + cond.right_id;
+                    uint64 type = joined_fields_desc.field_type()[left_id];
+                    uint64 length = joined_fields_desc.field_length()[left_id];
+                    join_conds.emplace_back(joined_fields_desc.offset()[left_id], 
+                                            joined_fields_desc.offset()[right_id],
+                                            type, length, cond.op);
+                    if (cond.op == "=" && hash_left_id == std::numeric_limits<uint64>::max() &&
+                        type != DBFields::TYPE_FLOAT && type != DBFields::TYPE_DOUBLE &&
+                        length == joined_fields_desc.field_length()[right_id]) {
+                        hash_left_id = right_id;
+                        hash_right_id = cond.left_id;
+                    }
+                }
 
-            innerJoin(table_names_inorder, temp_table_managers, complex_conditions_inorder, innerJoinResult);
+                Operator::Predicate predicate = [this, join_conds](const char* data) {
+                    for (const auto& cond: join_conds)
+                        // value of tables before is regarded as literal
+                        if (!meetCondition(data + std::get<0>(cond), data + std::get<1>(cond),
+                                           std::get<2>(cond), std::get<3>(cond), std::get<4>(cond), 1))
+                            return false;
+                    return true;
+                };
+                if (!join_conds.size()) predicate = nullptr;
+
+                if (hash_left_id != std::numeric_limits<uint64>::max())
+                    plan.reset(new Operator::HashJoin(std::move(plan), std::move(scan),
+                                                      hash_left_id, hash_right_id, predicate));
+                else
+                    plan.reset(new Operator::NestedLoopJoin(std::move(plan), std::move(scan), predicate));
+            }
 
             // code below is similar to that in SimpleSelect()
-            DBFields new_fields_desc = intermediate.table_manager->fieldsDesc();
+            DBFields new_fields_desc = joined_fields_desc;
             
             std::vector<uint64> original_field_ids;
             std::vector<uint64> display_field_ids;
@@ -892,22 +1236,22 @@ private:
                                                0, 0, 1, "count(*)");
                         display_field_ids.push_back(new_fields_desc.field_id().back());
                         functions.push_back(field_name.func);
-                        original_field_ids.push_back(intermediate.table_manager->fieldsDesc().primary_key_field_id());
+                        original_field_ids.push_back(Operator::Aggregate::ALL_FIELDS);
                     } else {
-                        for (const auto field_id: intermediate.table_manager->fieldsDesc().field_id())
-                            if (intermediate.table_manager->fieldsDesc().field_name()[field_id].length()) {
+                        for (const auto field_id: joined_fields_desc.field_id())
+                            if (joined_fields_desc.field_name()[field_id].length()) {
                                 display_field_ids.push_back(field_id);
                                 original_field_ids.push_back(field_id);
                                 functions.push_back(std::string());
                             }
                     }
                 } else {
-                    auto ite = std::find(intermediate.table_manager->fieldsDesc().field_name().begin(),
-                                         intermediate.table_manager->fieldsDesc().field_name().end(),
+                    auto ite = std::find(joined_fields_desc.field_name().begin(),
+                                         joined_fields_desc.field_name().end(),
                                          std::string(field_name.field_name));
-                    if (ite == intermediate.table_manager->fieldsDesc().field_name().end())
+                    if (ite == joined_fields_desc.field_name().end())
                         throw DBError::InvalidFieldName<DBError::ComplexSelectFailed>(field_name.field_name, query.table_names);
-                    uint64 field_id = ite - intermediate.table_manager->fieldsDesc().field_name().begin();
+                    uint64 field_id = ite - joined_fields_desc.field_name().begin();
 
                     if (field_name.func.length()) {
                         uint64 new_type, new_length, new_not_null = 0;
@@ -918,15 +1262,15 @@ private:
                             new_length = DBFields::typeLength(DBFields::TYPE_UINT64);
                             new_not_null = 1;
                         } else if (field_name.func == "max" || field_name.func == "min") {
-                            new_type = intermediate.table_manager->fieldsDesc().field_type()[field_id];
-                            new_length = intermediate.table_manager->fieldsDesc().field_length()[field_id] - 1;
+                            new_type = joined_fields_desc.field_type()[field_id];
+                            new_length = joined_fields_desc.field_length()[field_id] - 1;
                         } else if (field_name.func == "sum") {
-                            if (intermediate.table_manager->fieldsDesc().field_type()[field_id] == DBFields::TYPE_FLOAT ||
-                                intermediate.table_manager->fieldsDesc().field_type()[field_id] == DBFields::TYPE_DOUBLE)
+                            if (joined_fields_desc.field_type()[field_id] == DBFields::TYPE_FLOAT ||
+                                joined_fields_desc.field_type()[field_id] == DBFields::TYPE_DOUBLE)
                                 new_type = DBFields::TYPE_DOUBLE,
                                 new_length = DBFields::typeLength(DBFields::TYPE_DOUBLE);
                             else 
-                                new_type = DBFields::TYPE_INT64;
+                                new_type = DBFields::TYPE_INT64,
                                 new_length = DBFields::typeLength(DBFields::TYPE_INT64);
                         } else if (field_name.func == "avg") {
                             new_type = DBFields::TYPE_DOUBLE;
@@ -942,21 +1286,20 @@ private:
                     functions.push_back(field_name.func);
                 }
             
-            IntermediateTable group_by_intermediate(*this);
-
             // group by 
             // or aggregate function(s) without group by
             if (std::string(query.group_by_field_name).length() || 
-                new_fields_desc.size() > intermediate.table_manager->fieldsDesc().size()) {
-                joined_rids = groupBy<DBError::ComplexSelectFailed>
-                    (std::string(query.group_by_field_name), 
-                     group_by_intermediate, new_fields_desc, 
-                     intermediate.table_manager->fieldsDesc(), 
+                new_fields_desc.size() > joined_fields_desc.size()) {
+                plan = aggregatePlan<DBError::ComplexSelectFailed>
+                    (std::move(plan), std::string(query.group_by_field_name), 
+                     new_fields_desc, joined_fields_desc, 
                      original_field_ids, display_field_ids, 
-                     functions, intermediate.table_manager, joined_rids,
-                     query.table_names);
+                     functions, query.table_names);
             }
 
+            uint64 limit, offset;
+            parseLimit(query.limit, limit, offset);
+
             // order by
             if (std::string(query.order_by.field_name).length()) {
                 auto ite = std::find(new_fields_desc.field_name().begin(),
@@ -964,16 +1307,18 @@ private:
                                      std::string(query.order_by.field_name));
                 if (ite == new_fields_desc.field_name().end())
                     throw DBError::InvalidFieldName<DBError::ComplexSelectFailed>(query.order_by.field_name, query.table_names);
-                sortRID(group_by_intermediate.table_manager? 
-                            group_by_intermediate.table_manager: intermediate.table_manager,
-                        joined_rids, ite - new_fields_desc.field_name().begin(),
-                        query.order_by.order == "" || query.order_by.order == "asc");
+                plan.reset(new Operator::Sort(std::move(plan), ite - new_fields_desc.field_name().begin(),
+                                              query.order_by.order == "" || query.order_by.order == "asc",
+                                              temp_dir, sort_memory, saturatedAdd(limit, offset),
+                                              thread_pool.get()));
             }
+
+            if (limit != std::numeric_limits<uint64>::max() || offset)
+                plan.reset(new Operator::Limit(std::move(plan), limit, offset));
             
             // output result
-            outputRID((group_by_intermediate.table_manager?
-                          group_by_intermediate.table_manager: intermediate.table_manager),
-                      display_field_ids, joined_rids);
+            plan.reset(new Operator::Project(std::move(plan), display_field_ids));
+            outputPlan<DBError::ComplexSelectFailed>(std::move(plan), query.outfile, query.table_names);
 
             return 0;
         }
@@ -985,7 +1330,7 @@ private:
     //                 or "SELECT * FROM <table name> [WHERE <condition>];"
     // returns 0 if parse and execute  succeed
     // returns 1 if parse failed
-    int parseAsSimpleSelectStatement(const std::string& str) {
+    int parseAsSimpleSelectStatement(const boost::string_ref str) {
         QueryProcess::SimpleSelectStatement query;
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
                                                   str.end(),
@@ -993,142 +1338,174 @@ private:
                                                   boost::spirit::qi::space,
                                                   query);
         if (ok) {
-            if (db_inuse.length() == 0) 
-                throw DBError::DBNotOpened<DBError::SimpleSelectFailed>(query.table_name);
+            return executeSimpleSelect(query);
+        }
+        return 1;
+    }
 
-            DBTableManager* table_manager = openTable(query.table_name);
-            // open failed
-            if (!table_manager) 
-                throw DBError::OpenTableFailed<DBError::SimpleSelectFailed>(query.table_name, query.table_name);
+    // execute parsed simple select statement
+    // conditions are compiled from query, if compiled_conditions is nullptr
+    // returns 0 if succeed
+    int executeSimpleSelect(const QueryProcess::SimpleSelectStatement& query, 
+                            const std::vector<Condition>* compiled_conditions = nullptr) {
+        if (db_inuse.length() == 0) 
+            throw DBError::DBNotOpened<DBError::SimpleSelectFailed>(query.table_name);
 
-            const DBFields& fields_desc = table_manager->fieldsDesc();
-            // used for internmediate result
-            DBFields new_fields_desc = fields_desc;
-            for (std::size_t i = 0; i < new_fields_desc.indexed().size(); ++i)
-                if (i != new_fields_desc.primary_key_field_id())
-                    new_fields_desc.indexed()[i] = false;
-
-            // check field names
-            // id of fields aggregation function really applied to.
-            // won't expand even if there's aggregation
-            std::vector<uint64> original_field_ids;
-            // id of fields to display, expand if there's aggregations
-            std::vector<uint64> display_field_ids;
-            std::vector<std::string> functions;
-            for (const auto& field_name: query.field_names) {
-                if (field_name.field_name == "*") { 
-                    // no aggregate functions can be applied to * except 'count'
-                    if (field_name.func.length() && field_name.func != "count")
-                        throw DBError::AggregateFailed<DBError::SimpleSelectFailed>(field_name.func, field_name.field_name, query.table_name);
-                    if (field_name.func == "count") {
-                        new_fields_desc.insert(DBFields::TYPE_UINT64, 
-                                              DBFields::typeLength(DBFields::TYPE_UINT64),
-                                              0, 0, 1, "count(*)");
-                        display_field_ids.push_back(new_fields_desc.field_id().back());
-                        functions.push_back(field_name.func);
-                        original_field_ids.push_back(fields_desc.primary_key_field_id());
-                    } else {
-                        for (const auto field_id: fields_desc.field_id()) 
-                            if (fields_desc.field_name()[field_id].length()) {
-                                display_field_ids.push_back(field_id);
-                                original_field_ids.push_back(field_id);
-                                functions.push_back(std::string());
-                            }
-                    }
+        DBTableManager* table_manager = openTable(query.table_name);
+        // open failed
+        if (!table_manager) 
+            throw DBError::OpenTableFailed<DBError::SimpleSelectFailed>(query.table_name, query.table_name);
+        lockTable(table_manager, DBLockManager::S);
+
+        const DBFields& fields_desc = table_manager->fieldsDesc();
+        // used for internmediate result
+        DBFields new_fields_desc = fields_desc;
+        for (std::size_t i = 0; i < new_fields_desc.indexed().size(); ++i)
+            if (i != new_fields_desc.primary_key_field_id())
+                new_fields_desc.indexed()[i] = false;
+
+        // check field names
+        // id of fields aggregation function really applied to.
+        // won't expand even if there's aggregation
+        std::vector<uint64> original_field_ids;
+        // id of fields to display, expand if there's aggregations
+        std::vector<uint64> display_field_ids;
+        std::vector<std::string> functions;
+        for (const auto& field_name: query.field_names) {
+            if (field_name.field_name == "*") { 
+                // no aggregate functions can be applied to * except 'count'
+                if (field_name.func.length() && field_name.func != "count")
+                    throw DBError::AggregateFailed<DBError::SimpleSelectFailed>(field_name.func, field_name.field_name, query.table_name);
+                if (field_name.func == "count") {
+                    new_fields_desc.insert(DBFields::TYPE_UINT64, 
+                                          DBFields::typeLength(DBFields::TYPE_UINT64),
+                                          0, 0, 1, "count(*)");
+                    display_field_ids.push_back(new_fields_desc.field_id().back());
+                    functions.push_back(field_name.func);
+                    original_field_ids.push_back(Operator::Aggregate::ALL_FIELDS);
                 } else {
-                    auto ite = std::find(fields_desc.field_name().begin(),
-                                         fields_desc.field_name().end(),
-                                         field_name.field_name);
-                    // invalid field name
-                    if (ite == fields_desc.field_name().end()) 
-                        throw DBError::InvalidFieldName<DBError::SimpleSelectFailed>(field_name.field_name, query.table_name);
-                    uint64 field_id = ite - fields_desc.field_name().begin();
-                    
-                    // if there's a aggregate function 
-                    if (field_name.func.length()) {
-                        uint64 new_type, new_length, new_not_null = 0;
-                        std::string new_name = field_name.func + "(" + field_name.field_name + ")";
+                    for (const auto field_id: fields_desc.field_id()) 
+                        if (fields_desc.field_name()[field_id].length()) {
+                            display_field_ids.push_back(field_id);
+                            original_field_ids.push_back(field_id);
+                            functions.push_back(std::string());
+                        }
+                }
+            } else {
+                auto ite = std::find(fields_desc.field_name().begin(),
+                                     fields_desc.field_name().end(),
+                                     field_name.field_name);
+                // invalid field name
+                if (ite == fields_desc.field_name().end()) 
+                    throw DBError::InvalidFieldName<DBError::SimpleSelectFailed>(field_name.field_name, query.table_name);
+                uint64 field_id = ite - fields_desc.field_name().begin();
+                
+                // if there's a aggregate function 
+                if (field_name.func.length()) {
+                    uint64 new_type, new_length, new_not_null = 0;
+                    std::string new_name = field_name.func + "(" + field_name.field_name + ")";
 
-                        // use uint64 for count
-                        if (field_name.func == "count") {
-                            new_type = DBFields::TYPE_UINT64;
-                            new_length = DBFields::typeLength(DBFields::TYPE_UINT64);
-                            new_not_null = 1;
-                        // use original type for max and min
-                        } else if (field_name.func == "max" || field_name.func == "min") {
-                            new_type = fields_desc.field_type()[field_id];
-                            new_length = fields_desc.field_length()[field_id] - 1;
-                        // use int64 for sum of integral type 
-                        // double for sum of floating point type
-                        } else if (field_name.func == "sum") {
-                            if (fields_desc.field_type()[field_id] == DBFields::TYPE_FLOAT ||
-                                fields_desc.field_type()[field_id] == DBFields::TYPE_DOUBLE)
-                                new_type = DBFields::TYPE_DOUBLE,
-                                new_length = DBFields::typeLength(DBFields::TYPE_DOUBLE);
-                            else 
-                                new_type = DBFields::TYPE_INT64,
-                                new_length = DBFields::typeLength(DBFields::TYPE_INT64);
-                        // use double for average
-                        } else if (field_name.func == "avg") {
-                            new_type = DBFields::TYPE_DOUBLE;
+                    // use uint64 for count
+                    if (field_name.func == "count") {
+                        new_type = DBFields::TYPE_UINT64;
+                        new_length = DBFields::typeLength(DBFields::TYPE_UINT64);
+                        new_not_null = 1;
+                    // use original type for max and min
+                    } else if (field_name.func == "max" || field_name.func == "min") {
+                        new_type = fields_desc.field_type()[field_id];
+                        new_length = fields_desc.field_length()[field_id] - 1;
+                    // use int64 for sum of integral type 
+                    // double for sum of floating point type
+                    } else if (field_name.func == "sum") {
+                        if (fields_desc.field_type()[field_id] == DBFields::TYPE_FLOAT ||
+                            fields_desc.field_type()[field_id] == DBFields::TYPE_DOUBLE)
+                            new_type = DBFields::TYPE_DOUBLE,
                             new_length = DBFields::typeLength(DBFields::TYPE_DOUBLE);
-                        // other aggregate funtions not supported
-                        } else assert(0);
-                        
-                        new_fields_desc.insert(new_type, new_length, 0, 0, new_not_null, new_name);
+                        else 
+                            new_type = DBFields::TYPE_INT64,
+                            new_length = DBFields::typeLength(DBFields::TYPE_INT64);
+                    // use double for average
+                    } else if (field_name.func == "avg") {
+                        new_type = DBFields::TYPE_DOUBLE;
+                        new_length = DBFields::typeLength(DBFields::TYPE_DOUBLE);
+                    // other aggregate funtions not supported
+                    } else assert(0);
+                    
+                    new_fields_desc.insert(new_type, new_length, 0, 0, new_not_null, new_name);
 
-                        display_field_ids.push_back(new_fields_desc.field_id().back());
-                    } else {
-                        display_field_ids.push_back(field_id);
-                    }
-                    original_field_ids.push_back(field_id);
-                    functions.push_back(field_name.func);
+                    display_field_ids.push_back(new_fields_desc.field_id().back());
+                } else {
+                    display_field_ids.push_back(field_id);
                 }
+                original_field_ids.push_back(field_id);
+                functions.push_back(field_name.func);
             }
+        }
 
-            // check where clause
-            std::vector<Condition> conditions;
+        // check where clause, unless it's already compiled
+        std::vector<Condition> parsed_conditions;
+        if (!compiled_conditions)
             for (const auto& cond: query.conditions)
-                conditions.push_back(parseSimpleCondition<DBError::SimpleSelectFailed>(cond, fields_desc, query.table_name));
+                parsed_conditions.push_back(parseSimpleCondition<DBError::SimpleSelectFailed>(cond, fields_desc, query.table_name));
+        const std::vector<Condition>& conditions = compiled_conditions? *compiled_conditions: parsed_conditions;
+
+        uint64 limit, offset;
+        parseLimit(query.limit, limit, offset);
+
+        // group by 
+        // or aggregate function(s) without group by
+        bool aggregated = query.group_by_field_name.length() || new_fields_desc.size() > fields_desc.size();
+
+        // order by
+        uint64 order_field_id = std::numeric_limits<uint64>::max();
+        bool order = query.order_by.order == "" || query.order_by.order == "asc";
+        if (query.order_by.field_name.length()) {
+            auto ite = std::find(new_fields_desc.field_name().begin(),
+                                 new_fields_desc.field_name().end(),
+                                 query.order_by.field_name);
+            if (ite == new_fields_desc.field_name().end())
+                throw DBError::InvalidFieldName<DBError::SimpleSelectFailed>(query.order_by.field_name, query.table_name);
+            order_field_id = ite - new_fields_desc.field_name().begin();
+        }
 
-            // select records
-            auto rids = selectRID(table_manager, conditions);
+        // read records in index order if they are ordered by an indexed field,
+        // unless where clause selects fewer records with index
+        // with limit, reading stops once enough records are output
+        bool index_order = !aggregated && 
+                           order_field_id < fields_desc.size() &&
+                           table_manager->indexReadable(order_field_id) &&
+                           (limit != std::numeric_limits<uint64>::max() ||
+                            !indexSelectable(table_manager, conditions));
+
+        // select records
+        Operator::OperatorPtr plan = index_order? 
+            indexOrderPlan(table_manager, order_field_id, order, conditions):
+            scanPlan(table_manager, conditions);
+        
+        if (aggregated) {
+            plan = aggregatePlan<DBError::SimpleSelectFailed>
+                (std::move(plan), query.group_by_field_name, new_fields_desc, 
+                 fields_desc, original_field_ids, display_field_ids, 
+                 functions, query.table_name);
+        }
 
-            
-            IntermediateTable intermediate(*this);
-            
-            
-            // group by 
-            // or aggregate function(s) without group by
-            if (query.group_by_field_name.length() || new_fields_desc.size() > fields_desc.size()) {
-                rids = groupBy<DBError::SimpleSelectFailed>
-                    (query.group_by_field_name, intermediate, new_fields_desc, 
-                     fields_desc, original_field_ids, display_field_ids, 
-                     functions, table_manager, rids, query.table_name);
-            }
+        if (order_field_id != std::numeric_limits<uint64>::max() && !index_order)
+            plan.reset(new Operator::Sort(std::move(plan), order_field_id, order,
+                                          temp_dir, sort_memory, saturatedAdd(limit, offset),
+                                          thread_pool.get()));
 
-            // order by
-            if (query.order_by.field_name.length()) {
-                auto ite = std::find(new_fields_desc.field_name().begin(),
-                                     new_fields_desc.field_name().end(),
-                                     query.order_by.field_name);
-                if (ite == new_fields_desc.field_name().end())
-                    throw DBError::InvalidFieldName<DBError::SimpleSelectFailed>(query.order_by.field_name, query.table_name);
-                sortRID(intermediate.table_manager? intermediate.table_manager: table_manager,
-                        rids, ite - new_fields_desc.field_name().begin(),
-                        query.order_by.order == "" || query.order_by.order == "asc");
-            }
+        if (limit != std::numeric_limits<uint64>::max() || offset)
+            plan.reset(new Operator::Limit(std::move(plan), limit, offset));
 
-            outputRID(intermediate.table_manager? intermediate.table_manager: table_manager, display_field_ids, rids);
-            return 0;
-        }
-        return 1;
+        plan.reset(new Operator::Project(std::move(plan), display_field_ids));
+        outputPlan<DBError::SimpleSelectFailed>(std::move(plan), query.outfile, query.table_name);
+        return 0;
     }
 
     // parse as statement "DELETE FROM <table name> [WHERE <condition>];"
     // returns 0 if parse and execute  succeed
     // returns 1 if parse failed
-    int parseAsDeleteStatement(const std::string& str) {
+    int parseAsDeleteStatement(const boost::string_ref str) {
         QueryProcess::DeleteStatement query;
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
                                                   str.end(),
@@ -1136,50 +1513,63 @@ private:
                                                   boost::spirit::qi::space,
                                                   query);
         if (ok) {
-            if (db_inuse.length() == 0) 
-                throw DBError::DBNotOpened<DBError::DeleteRecordFailed>(query.table_name);
+            return executeDelete(query);
+        }
+        return 1;
+    }
 
-            DBTableManager* table_manager = openTable(query.table_name);
-            // open failed
-            if (!table_manager) 
-                throw DBError::OpenTableFailed<DBError::DeleteRecordFailed>(query.table_name, query.table_name);
+    // execute parsed statement "DELETE FROM <table name> [WHERE <condition>];"
+    // conditions are compiled from query, if compiled_conditions is nullptr
+    // returns 0 if succeed
+    int executeDelete(const QueryProcess::DeleteStatement& query, 
+                      const std::vector<Condition>* compiled_conditions = nullptr) {
+        if (db_inuse.length() == 0) 
+            throw DBError::DBNotOpened<DBError::DeleteRecordFailed>(query.table_name);
 
-            const DBFields& fields_desc = table_manager->fieldsDesc();
+        DBTableManager* table_manager = openTable(query.table_name);
+        // open failed
+        if (!table_manager) 
+            throw DBError::OpenTableFailed<DBError::DeleteRecordFailed>(query.table_name, query.table_name);
 
-            // check where clause
-            std::vector<Condition> conditions;
+        const DBFields& fields_desc = table_manager->fieldsDesc();
+
+        // check where clause, unless it's already compiled
+        std::vector<Condition> parsed_conditions;
+        if (!compiled_conditions)
             for (const auto& cond: query.conditions)
-                conditions.push_back(parseSimpleCondition<DBError::DeleteRecordFailed>(cond, fields_desc, query.table_name));
+                parsed_conditions.push_back(parseSimpleCondition<DBError::DeleteRecordFailed>(cond, fields_desc, query.table_name));
+        const std::vector<Condition>& conditions = compiled_conditions? *compiled_conditions: parsed_conditions;
 
-            // select records
-            auto rids = selectRID(table_manager, conditions);
-                
+        // select records
+        auto rids = selectRID(table_manager, conditions);
+            
 
-            // check foreign key constraint
-            std::unique_ptr<char[]> record_buff(new char[fields_desc.recordLength()]);
-            for (const auto rid: rids) {
-                assert(table_manager->selectRecord(rid, record_buff.get()) == 0);
-                auto eqr = referenced_tables.equal_range(query.table_name);
-                for (auto ite = eqr.first; ite != eqr.second; ++ite) {
-                    DBTableManager* foreign_table_manager = openTable(std::get<1>(ite->second));
-                    assert(foreign_table_manager);
-                    assert(fields_desc.primary_key_field_id() == std::get<0>(ite->second));
-                    Condition cond(2, std::get<2>(ite->second),
-                                   std::numeric_limits<uint64>::max(), "=",
-                                   std::string(record_buff.get() + fields_desc.offset()[std::get<0>(ite->second)],
-                                               fields_desc.field_length()[std::get<0>(ite->second)]));
-                    if (selectRID(foreign_table_manager, std::vector<Condition>(1, cond)).size())
-                        throw DBError::RecordReferenced<DBError::DeleteRecordFailed>(std::get<1>(ite->second), query.table_name);
-                }
+        // check foreign key constraint
+        std::unique_ptr<char[]> record_buff(new char[fields_desc.recordLength()]);
+        for (const auto rid: rids) {
+            assert(table_manager->selectRecord(rid, record_buff.get()) == 0);
+            auto eqr = referenced_tables.equal_range(query.table_name);
+            for (auto ite = eqr.first; ite != eqr.second; ++ite) {
+                DBTableManager* foreign_table_manager = openTable(std::get<1>(ite->second));
+                assert(foreign_table_manager);
+                assert(fields_desc.primary_key_field_id() == std::get<0>(ite->second));
+                Condition cond(2, std::get<2>(ite->second),
+                               std::numeric_limits<uint64>::max(), "=",
+                               std::string(record_buff.get() + fields_desc.offset()[std::get<0>(ite->second)],
+                                           fields_desc.field_length()[std::get<0>(ite->second)]));
+                if (selectRID(foreign_table_manager, std::vector<Condition>(1, cond)).size())
+                    throw DBError::RecordReferenced<DBError::DeleteRecordFailed>(std::get<1>(ite->second), query.table_name);
             }
+        }
 
-            // remove rids
-            for (const auto& rid: rids)
-                assert(table_manager->removeRecord(rid) == 0);
-
-            return 0;
+        // remove rids, each is locked before removed
+        for (const auto& rid: rids) {
+            int rtv = table_manager->removeRecord(rid);
+            if (rtv > 1) checkLock(rtv - 1);
+            assert(rtv == 0);
         }
-        return 1;
+
+        return 0;
     }
 
     // parse as statement "UPDATE <table name> SET <field name> = <new value> 
@@ -1187,7 +1577,7 @@ private:
     //                     [WHERE <condition>];"
     // returns 0 if parse and execute  succeed
     // returns 1 if parse failed
-    int parseAsUpdateStatement(const std::string& str) {
+    int parseAsUpdateStatement(const boost::string_ref str) {
         QueryProcess::UpdateStatement query;
         bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
                                                   str.end(),
@@ -1195,324 +1585,479 @@ private:
                                                   boost::spirit::qi::space,
                                                   query);
         if (ok) {
-            if (db_inuse.length() == 0) 
-                throw DBError::DBNotOpened<DBError::UpdateRecordFailed>(query.table_name);
+            return executeUpdate(query);
+        }
+        return 1;
+    }
 
-            DBTableManager* table_manager = openTable(query.table_name);
-            // open failed
-            if (!table_manager) 
-                throw DBError::OpenTableFailed<DBError::UpdateRecordFailed>(query.table_name, query.table_name);
+    // execute parsed update statement
+    // conditions are compiled from query, if compiled_conditions is nullptr
+    // returns 0 if succeed
+    int executeUpdate(const QueryProcess::UpdateStatement& query, 
+                      const std::vector<Condition>* compiled_conditions = nullptr) {
+        if (db_inuse.length() == 0) 
+            throw DBError::DBNotOpened<DBError::UpdateRecordFailed>(query.table_name);
 
-            const DBFields& fields_desc = table_manager->fieldsDesc();
-            // check new values
-            std::vector<uint64> modify_field_ids;
-            std::unique_ptr<char[]> buffer(new char[fields_desc.recordLength()]);
-            memset(buffer.get(), 0x00, fields_desc.recordLength());
-            std::vector<void*> args;
-            std::set<uint64> check_duplicate_field_id;
-            for (const auto& new_value: query.new_values) {
-                auto ite = std::find(fields_desc.field_name().begin(),
-                                     fields_desc.field_name().end(),
-                                     new_value.field_name);
-                // invalid field name
-                if (ite == fields_desc.field_name().end()) 
-                    throw DBError::InvalidFieldName<DBError::UpdateRecordFailed>(new_value.field_name, query.table_name);
-                uint64 field_id = ite - fields_desc.field_name().begin();
-                modify_field_ids.push_back(field_id);
-                check_duplicate_field_id.insert(field_id);
-
-                // parse new value
-                int rtv = literalParser(new_value.value,
-                                        fields_desc.field_type()[field_id],
-                                        fields_desc.field_length()[field_id],
-                                        buffer.get() + fields_desc.offset()[field_id]
-                                       );
-                // parse failed
-                if (rtv == 1) 
-                    throw DBError::LiteralParseFailed<DBError::UpdateRecordFailed>(new_value.value, query.table_name);
-                if (rtv == 2) 
-                    throw DBError::LiteralOutOfRange<DBError::UpdateRecordFailed>(new_value.value, query.table_name);
-                args.push_back(buffer.get() + fields_desc.offset()[field_id]);
-            }
-            // duplicate field_name
-            if (modify_field_ids.size() != check_duplicate_field_id.size()) 
-                throw DBError::DuplicateFieldName<DBError::UpdateRecordFailed>("", query.table_name);
+        DBTableManager* table_manager = openTable(query.table_name);
+        // open failed
+        if (!table_manager) 
+            throw DBError::OpenTableFailed<DBError::UpdateRecordFailed>(query.table_name, query.table_name);
 
-            // check where clause
-            std::vector<Condition> conditions;
+        const DBFields& fields_desc = table_manager->fieldsDesc();
+        // check new values
+        std::vector<uint64> modify_field_ids;
+        std::unique_ptr<char[]> buffer(new char[fields_desc.recordLength()]);
+        memset(buffer.get(), 0x00, fields_desc.recordLength());
+        std::vector<void*> args;
+        std::set<uint64> check_duplicate_field_id;
+        for (const auto& new_value: query.new_values) {
+            auto ite = std::find(fields_desc.field_name().begin(),
+                                 fields_desc.field_name().end(),
+                                 new_value.field_name);
+            // invalid field name
+            if (ite == fields_desc.field_name().end()) 
+                throw DBError::InvalidFieldName<DBError::UpdateRecordFailed>(new_value.field_name, query.table_name);
+            uint64 field_id = ite - fields_desc.field_name().begin();
+            modify_field_ids.push_back(field_id);
+            check_duplicate_field_id.insert(field_id);
+
+            // parse new value
+            int rtv = literalParser(new_value.value,
+                                    fields_desc.field_type()[field_id],
+                                    fields_desc.field_length()[field_id],
+                                    buffer.get() + fields_desc.offset()[field_id]
+                                   );
+            // parse failed
+            if (rtv == 1) 
+                throw DBError::LiteralParseFailed<DBError::UpdateRecordFailed>(new_value.value, query.table_name);
+            if (rtv == 2) 
+                throw DBError::LiteralOutOfRange<DBError::UpdateRecordFailed>(new_value.value, query.table_name);
+            args.push_back(buffer.get() + fields_desc.offset()[field_id]);
+        }
+        // duplicate field_name
+        if (modify_field_ids.size() != check_duplicate_field_id.size()) 
+            throw DBError::DuplicateFieldName<DBError::UpdateRecordFailed>("", query.table_name);
+
+        // check where clause, unless it's already compiled
+        std::vector<Condition> parsed_conditions;
+        if (!compiled_conditions)
             for (const auto& cond: query.conditions)
-                conditions.push_back(parseSimpleCondition<DBError::UpdateRecordFailed>(cond, fields_desc, query.table_name));
+                parsed_conditions.push_back(parseSimpleCondition<DBError::UpdateRecordFailed>(cond, fields_desc, query.table_name));
+        const std::vector<Condition>& conditions = compiled_conditions? *compiled_conditions: parsed_conditions;
 
-            // select records
-            auto rids = selectRID(table_manager, conditions);
+        // select records
+        auto rids = selectRID(table_manager, conditions);
 
-            
-            // if there's check constraint in this table
-            // read the record to be updated
-            auto ite = tables_check_constraints.find(query.table_name);
-            std::unique_ptr<char[]> record_buff;
-            if (ite != tables_check_constraints.end()) 
-                record_buff.reset(new char[fields_desc.recordLength()]);
-
-            // check foreign key constraints, referencing other tables
-            auto eqr = referencing_tables.equal_range(query.table_name);
-            for (auto ite = eqr.first; ite != eqr.second; ++ite) {
-                // if constraint field is updated
-                auto ite2 = std::find(modify_field_ids.begin(), modify_field_ids.end(), 
-                                      std::get<0>(ite->second));
-                if (ite2 != modify_field_ids.end()) {
-                    // null is permitted
-                    if (pointer_convert<const char*>(args[ite2 - modify_field_ids.begin()])[0] == '\x00')
-                        continue;
+        
+        // if there's check constraint in this table
+        // read the record to be updated
+        const std::vector<Condition>* check_constraint = checkConstraint(query.table_name);
+        std::unique_ptr<char[]> record_buff;
+        if (check_constraint) 
+            record_buff.reset(new char[fields_desc.recordLength()]);
+
+        // check foreign key constraints, referencing other tables
+        auto eqr = referencing_tables.equal_range(query.table_name);
+        for (auto ite = eqr.first; ite != eqr.second; ++ite) {
+            // if constraint field is updated
+            auto ite2 = std::find(modify_field_ids.begin(), modify_field_ids.end(), 
+                                  std::get<0>(ite->second));
+            if (ite2 != modify_field_ids.end()) {
+                // null is permitted
+                if (pointer_convert<const char*>(args[ite2 - modify_field_ids.begin()])[0] == '\x00')
+                    continue;
+                DBTableManager* foreign_table_manager = openTable(std::get<1>(ite->second));
+                assert(foreign_table_manager);
+                Condition cond(2, std::get<2>(ite->second),
+                               std::numeric_limits<uint64>::max(), "=",
+                               std::string(pointer_convert<const char*>(args[ite2 - modify_field_ids.begin()]),
+                                           fields_desc.field_length()[*ite2]));
+                if (selectRID(foreign_table_manager, std::vector<Condition>(1, cond)).size() == 0)
+                    throw DBError::ReferencedNotExists<DBError::UpdateRecordFailed>(
+                        query.new_values[ite2 - modify_field_ids.begin()].value, 
+                        std::get<1>(ite->second), query.table_name);
+            }
+        }
+
+        // check foreign key constraint, referenced by other tables
+        // only check when primary key is to be modified
+        std::size_t primary_field_id = std::find(
+            modify_field_ids.begin(), modify_field_ids.end(),
+            fields_desc.primary_key_field_id()) - modify_field_ids.begin();
+        if (primary_field_id != modify_field_ids.size()) {
+            DBFields::Comparator comp;
+            comp.type = fields_desc.field_type()[fields_desc.primary_key_field_id()];
+            std::unique_ptr<char[]> record_buff2(new char[fields_desc.recordLength()]);
+            // read each record
+            for (const auto rid: rids) {
+                assert(table_manager->selectRecord(rid, record_buff2.get()) == 0);
+                // if primary key won't be modified
+                if (comp(record_buff2.get() + fields_desc.offset()[fields_desc.primary_key_field_id()],
+                         args[primary_field_id], 
+                         fields_desc.field_length()[fields_desc.primary_key_field_id()]) == 0)
+                    continue;
+                
+                // check whether this record is referenced by other tables
+                auto eqr = referenced_tables.equal_range(query.table_name);
+                for (auto ite = eqr.first; ite != eqr.second; ++ite) {
                     DBTableManager* foreign_table_manager = openTable(std::get<1>(ite->second));
                     assert(foreign_table_manager);
+                    assert(fields_desc.primary_key_field_id() == std::get<0>(ite->second));
                     Condition cond(2, std::get<2>(ite->second),
                                    std::numeric_limits<uint64>::max(), "=",
-                                   std::string(pointer_convert<const char*>(args[ite2 - modify_field_ids.begin()]),
-                                               fields_desc.field_length()[*ite2]));
-                    if (selectRID(foreign_table_manager, std::vector<Condition>(1, cond)).size() == 0)
-                        throw DBError::ReferencedNotExists<DBError::UpdateRecordFailed>(
-                            query.new_values[ite2 - modify_field_ids.begin()].value, 
-                            std::get<1>(ite->second), query.table_name);
+                                   std::string(record_buff2.get() + fields_desc.offset()[std::get<0>(ite->second)],
+                                               fields_desc.field_length()[std::get<0>(ite->second)]));
+                    if (selectRID(foreign_table_manager, std::vector<Condition>(1, cond)).size())
+                        throw DBError::RecordReferenced<DBError::UpdateRecordFailed>(std::get<1>(ite->second), query.table_name);
                 }
             }
+        }
 
-            // check foreign key constraint, referenced by other tables
-            // only check when primary key is to be modified
-            std::size_t primary_field_id = std::find(
-                modify_field_ids.begin(), modify_field_ids.end(),
-                fields_desc.primary_key_field_id()) - modify_field_ids.begin();
-            if (primary_field_id != modify_field_ids.size()) {
-                DBFields::Comparator comp;
-                comp.type = fields_desc.field_type()[fields_desc.primary_key_field_id()];
-                std::unique_ptr<char[]> record_buff2(new char[fields_desc.recordLength()]);
-                // read each record
-                for (const auto rid: rids) {
-                    assert(table_manager->selectRecord(rid, record_buff2.get()) == 0);
-                    // if primary key won't be modified
-                    if (comp(record_buff2.get() + fields_desc.offset()[fields_desc.primary_key_field_id()],
-                             args[primary_field_id], 
-                             fields_desc.field_length()[fields_desc.primary_key_field_id()]) == 0)
-                        continue;
-                    
-                    // check whether this record is referenced by other tables
-                    auto eqr = referenced_tables.equal_range(query.table_name);
-                    for (auto ite = eqr.first; ite != eqr.second; ++ite) {
-                        DBTableManager* foreign_table_manager = openTable(std::get<1>(ite->second));
-                        assert(foreign_table_manager);
-                        assert(fields_desc.primary_key_field_id() == std::get<0>(ite->second));
-                        Condition cond(2, std::get<2>(ite->second),
-                                       std::numeric_limits<uint64>::max(), "=",
-                                       std::string(record_buff2.get() + fields_desc.offset()[std::get<0>(ite->second)],
-                                                   fields_desc.field_length()[std::get<0>(ite->second)]));
-                        if (selectRID(foreign_table_manager, std::vector<Condition>(1, cond)).size())
-                            throw DBError::RecordReferenced<DBError::UpdateRecordFailed>(std::get<1>(ite->second), query.table_name);
+        std::unique_ptr<char[]> old_args_buffer(new char[fields_desc.recordLength() * rids.size()]);
+        memset(old_args_buffer.get(), 0x00, fields_desc.recordLength() * rids.size());
+        // record operations, roll back if error occurs
+        std::vector< std::tuple<RID, uint64, void*> > rollback_info;
+        try {
+            for (std::size_t i = 0; i < rids.size(); ++i) {
+                // check constraint
+                if (record_buff.get()) {
+                    int rtv = table_manager->selectRecord(rids[i], record_buff.get());
+                    assert(rtv == 0);
+                    for (std::size_t j = 0; j < modify_field_ids.size(); ++j)
+                        memcpy(record_buff.get() + fields_desc.offset()[modify_field_ids[j]], 
+                               args[j], fields_desc.field_length()[modify_field_ids[j]]);
+                    if (!meetConditions(record_buff.get(), *check_constraint, table_manager)) 
+                        throw DBError::CheckConstraintFailed<DBError::UpdateRecordFailed>(query.table_name);
+                }
+
+                for (std::size_t j = 0; j < modify_field_ids.size(); ++j) {
+                    char* old_arg_pos = old_args_buffer.get() + i * fields_desc.recordLength() + fields_desc.offset()[modify_field_ids[j]];
+                    int rtv = table_manager->modifyRecord(rids[i], modify_field_ids[j], args[j], old_arg_pos);
+                    // modify succeed
+                    if (rtv == 0) 
+                        rollback_info.push_back(std::make_tuple(rids[i], modify_field_ids[j], old_arg_pos));
+                    // error occurs
+                    else {
+                        if (rtv == 4 || rtv == 5)
+                            checkLock(rtv - 3);
+                        if (rtv == 2) 
+                            throw DBError::NotNullExpected<DBError::UpdateRecordFailed>(query.table_name);
+                        if (rtv == 3) 
+                            throw DBError::DuplicatePrimaryKey<DBError::UpdateRecordFailed>(query.table_name);
+                        throw DBError::UpdateRecordFailed(query.table_name);
                     }
                 }
             }
+        } catch (...) {
+            // roll back
+            while (rollback_info.size()) {
+               int rtv = table_manager->modifyRecord(std::get<0>(rollback_info.back()), 
+                                                     std::get<1>(rollback_info.back()),
+                                                     std::get<2>(rollback_info.back()),
+                                                     nullptr);
+               // assert roll back always succeed
+               assert(rtv == 0);
+               rollback_info.pop_back();
+            }
+            // re-throw the exception
+            throw;
+        }
+        
+        return 0;
+    }
 
-            std::unique_ptr<char[]> old_args_buffer(new char[fields_desc.recordLength() * rids.size()]);
-            memset(old_args_buffer.get(), 0x00, fields_desc.recordLength() * rids.size());
-            // record operations, roll back if error occurs
-            std::vector< std::tuple<RID, uint64, void*> > rollback_info;
-            try {
-                for (std::size_t i = 0; i < rids.size(); ++i) {
-                    // check constraint
-                    if (record_buff.get()) {
-                        int rtv = table_manager->selectRecord(rids[i], record_buff.get());
-                        assert(rtv == 0);
-                        for (std::size_t j = 0; j < modify_field_ids.size(); ++j)
-                            memcpy(record_buff.get() + fields_desc.offset()[modify_field_ids[j]], 
-                                   args[j], fields_desc.field_length()[modify_field_ids[j]]);
-                        if (!meetConditions(record_buff.get(), ite->second, table_manager)) 
-                            throw DBError::CheckConstraintFailed<DBError::UpdateRecordFailed>(query.table_name);
-                    }
+    // parse as statement "LOAD DATA INFILE '<path>' INTO TABLE <table name> [FORMAT <format>];"
+    // returns 0 if parse and execute  succeed
+    // returns 1 if parse failed
+    int parseAsLoadDataStatement(const boost::string_ref str) {
+        QueryProcess::LoadDataStatement query;
+        bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
+                                                  str.end(),
+                                                  loadDataStatementParser,
+                                                  boost::spirit::qi::space,
+                                                  query);
+        if (ok) {
+            // assert database is opened 
+            if (db_inuse.length() == 0) 
+                throw DBError::DBNotOpened<DBError::LoadDataFailed>(query.path, query.table_name);
 
-                    for (std::size_t j = 0; j < modify_field_ids.size(); ++j) {
-                        char* old_arg_pos = old_args_buffer.get() + i * fields_desc.recordLength() + fields_desc.offset()[modify_field_ids[j]];
-                        int rtv = table_manager->modifyRecord(rids[i], modify_field_ids[j], args[j], old_arg_pos);
-                        // modify succeed
-                        if (rtv == 0) 
-                            rollback_info.push_back(std::make_tuple(rids[i], modify_field_ids[j], old_arg_pos));
-                        // error occurs
-                        else {
-                            if (rtv == 2) 
-                                throw DBError::NotNullExpected<DBError::UpdateRecordFailed>(query.table_name);
-                            if (rtv == 3) 
-                                throw DBError::DuplicatePrimaryKey<DBError::UpdateRecordFailed>(query.table_name);
-                            throw DBError::UpdateRecordFailed(query.table_name);
-                        }
-                    }
+            // open table
+            DBTableManager* table_manager = openTable(query.table_name);
+            // open failed
+            if (!table_manager) 
+                throw DBError::OpenTableFailed<DBError::LoadDataFailed>(query.table_name, query.path, query.table_name);
+
+            if (!fileAllowed(query.path))
+                throw DBError::FileNotAllowed<DBError::LoadDataFailed>(query.path, query.path, query.table_name);
+            std::ifstream fin(query.path, std::fstream::in | std::fstream::binary);
+            if (!fin)
+                throw DBError::OpenFileFailed<DBError::LoadDataFailed>(query.path, query.path, query.table_name);
+
+            const DBFields& fields_desc = table_manager->fieldsDesc();
+            std::unique_ptr<char[]> buffer(new char[fields_desc.recordLength()]);
+            const std::vector<Condition>* check_constraint = checkConstraint(query.table_name);
+
+            // csv by default
+            DelimitedReader reader(fin, query.format != "tsv");
+            std::vector<DelimitedReader::Field> fields;
+            // values of current record, for error info
+            std::vector<std::string> values;
+
+            // store all rids
+            // if one record insert failed, remove all stored rids
+            std::vector<RID> rids;
+            // indexes other than primary key index are built after all records are inserted
+            // records inserted in bulk are not in indexes until end, table is locked for it
+            lockTable(table_manager, DBLockManager::X);
+            table_manager->beginBulkInsert();
+            try {
+                while (true) {
+                    int rtv = reader.next(fields);
+                    if (rtv == 1) break;
+                    if (rtv == 2) 
+                        throw DBError::MalformedRecord(query.path, query.table_name, reader.line());
+
+                    values.resize(fields.size());
+                    for (std::size_t i = 0; i < fields.size(); ++i) 
+                        values[i] = fields[i].null? "NULL": fields[i].value;
+
+                    rids.push_back(loadRecord(query.table_name, table_manager, fields, values, 
+                                              buffer.get(), check_constraint));
                 }
             } catch (...) {
-                // roll back
-                while (rollback_info.size()) {
-                   int rtv = table_manager->modifyRecord(std::get<0>(rollback_info.back()), 
-                                                         std::get<1>(rollback_info.back()),
-                                                         std::get<2>(rollback_info.back()),
-                                                         nullptr);
-                   // assert roll back always succeed
-                   assert(rtv == 0);
-                   rollback_info.pop_back();
-                }
-                // re-throw the exception
+                table_manager->endBulkInsert();
+                for (const auto& rid: rids) 
+                    assert(table_manager->removeRecord(rid) == 0);
                 throw;
             }
+            table_manager->endBulkInsert();
             
             return 0;
         }
         return 1;
     }
 
-private: 
-    // output a certain record
-    void outputRID(const DBTableManager* table_manager,
-                   const std::vector<uint64>& display_field_ids,
-                   const std::vector<RID>& rids) const {
-        const DBFields& fields_desc = table_manager->fieldsDesc();
-        std::unique_ptr<char[]> buff(new char[fields_desc.recordLength()]);
-
-        AlignedOutputer outputer(out);
-
-        std::string output_buff;
-        for (const auto rid: rids) {
-            table_manager->selectRecord(rid, buff.get());
-            for (const auto id: display_field_ids) {
-                literalParser(buff.get() + fields_desc.offset()[id],
-                              fields_desc.field_type()[id],
-                              fields_desc.field_length()[id],
-                              output_buff);
-                outputer << output_buff;
-            }
-            outputer << AlignedOutputer::endl;
+    // parse as statement "PREPARE <statement name> AS <statement>"
+    // statement is INSERT, DELETE, UPDATE or simple SELECT, values in which can be placeholder '?'
+    // returns 0 if parse and execute succeed
+    // returns 1 if parse failed
+    int parseAsPrepareStatement(const boost::string_ref str) {
+        QueryProcess::PrepareStatement query;
+        bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
+                                                  str.end(),
+                                                  prepareStatementParser,
+                                                  boost::spirit::qi::space,
+                                                  query);
+        if (ok) {
+            const boost::string_ref statement(query.statement);
+            PreparedStatement prepared;
+            bool parsed = 0;
+            std::size_t pos = 0;
+            std::string keyword = nextWord(statement, pos);
+            if (keyword == "insert") {
+                prepared.kind = PreparedStatement::INSERT;
+                parsed = boost::spirit::qi::phrase_parse(statement.begin(), statement.end(),
+                                                         insertRecordStatementParser,
+                                                         boost::spirit::qi::space,
+                                                         prepared.insert_query);
+                for (const auto& value_tuple: prepared.insert_query.value_tuples)
+                    prepared.num_params += std::count(value_tuple.value_tuple.begin(), value_tuple.value_tuple.end(), "?");
+            } else if (keyword == "select") {
+                prepared.kind = PreparedStatement::SIMPLE_SELECT;
+                parsed = boost::spirit::qi::phrase_parse(statement.begin(), statement.end(),
+                                                         simpleSelectStatementParser,
+                                                         boost::spirit::qi::space,
+                                                         prepared.select_query);
+                // complex select cannot be prepared
+                QueryProcess::ComplexSelectStatement complex_query;
+                if (!parsed && boost::spirit::qi::phrase_parse(statement.begin(), statement.end(),
+                                                               complexSelectStatementParser,
+                                                               boost::spirit::qi::space,
+                                                               complex_query))
+                    throw DBError::UnsupportedStatement(query.name);
+                prepared.num_params = countPlaceholders(prepared.select_query.conditions);
+            } else if (keyword == "delete") {
+                prepared.kind = PreparedStatement::DELETE;
+                parsed = boost::spirit::qi::phrase_parse(statement.begin(), statement.end(),
+                                                         deleteStatementParser,
+                                                         boost::spirit::qi::space,
+                                                         prepared.delete_query);
+                prepared.num_params = countPlaceholders(prepared.delete_query.conditions);
+            } else if (keyword == "update") {
+                prepared.kind = PreparedStatement::UPDATE;
+                parsed = boost::spirit::qi::phrase_parse(statement.begin(), statement.end(),
+                                                         updateStatementParser,
+                                                         boost::spirit::qi::space,
+                                                         prepared.update_query);
+                for (const auto& new_value: prepared.update_query.new_values)
+                    prepared.num_params += new_value.value == "?";
+                prepared.num_params += countPlaceholders(prepared.update_query.conditions);
+            } else 
+                throw DBError::UnsupportedStatement(query.name);
+
+            if (!parsed) 
+                throw DBError::ParseFailed();
+
+            // statement of the same name is replaced
+            prepared_statements[query.name] = std::move(prepared);
+            return 0;
         }
+        return 1;
     }
 
+    // parse as statement "EXECUTE <statement name> [USING <value> [, <value>]*];"
+    // values are bound to placeholders in order
+    // returns 0 if parse and execute succeed
+    // returns 1 if parse failed
+    int parseAsExecuteStatement(const boost::string_ref str) {
+        QueryProcess::ExecuteStatement query;
+        bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
+                                                  str.end(),
+                                                  executeStatementParser,
+                                                  boost::spirit::qi::space,
+                                                  query);
+        if (ok) {
+            auto ite = prepared_statements.find(query.name);
+            if (ite == prepared_statements.end())
+                throw DBError::StatementNotPrepared<DBError::ExecuteFailed>(query.name);
+            PreparedStatement& prepared = ite->second;
 
-    // group by field_id
-    // assert rids is sorted
-    std::vector<std::vector<RID>::const_iterator> grouping(
-        const DBTableManager* table_manager,
-        const std::vector<RID>& rids, const uint64 field_id) {
-        std::vector<std::vector<RID>::const_iterator> groups;
-        if (!rids.size()) return groups;
-
-        const DBFields& fields_desc = table_manager->fieldsDesc();
+            if (query.values.size() != prepared.num_params)
+                throw DBError::WrongParameterSize(query.name, query.values.size(), prepared.num_params);
 
-        DBFields::Comparator comp;
-        comp.type = fields_desc.field_type()[field_id];
-        
-        std::unique_ptr<char[]> buff1(new char[fields_desc.recordLength()]);
-        std::unique_ptr<char[]> buff2(new char[fields_desc.recordLength()]);
-
-        // equal(0) or not(1)
-        auto comp_rule = [&table_manager, &fields_desc, &field_id, &comp, &buff1, &buff2]
-            (const RID rid1, const RID rid2)->bool {
-            table_manager->selectRecord(rid1, buff1.get());
-            table_manager->selectRecord(rid2, buff2.get());
-            int comp_result = comp(buff1.get() + fields_desc.offset()[field_id],
-                                   buff2.get() + fields_desc.offset()[field_id],
-                                   fields_desc.field_length()[field_id]);
-            return comp_result == 0;
-        };
-        
-        groups.push_back(rids.begin());
-        for (auto ite = rids.begin() + 1; ite != rids.end(); ++ite) 
-            if (!comp_rule(*ite, *(ite - 1)))
-                groups.push_back(ite);
+            auto value = query.values.cbegin();
+            std::vector<Condition> conditions;
+            switch (prepared.kind) {
+                case PreparedStatement::INSERT: {
+                    QueryProcess::InsertRecordStatement insert_query = prepared.insert_query;
+                    for (auto& value_tuple: insert_query.value_tuples)
+                        for (auto& v: value_tuple.value_tuple)
+                            if (v == "?") v = *value++;
+                    return executeInsertRecord(insert_query);
+                } 
+                case PreparedStatement::SIMPLE_SELECT: {
+                    QueryProcess::SimpleSelectStatement select_query = prepared.select_query;
+                    bindPlaceholders(select_query.conditions, value);
+                    int rtv = bindConditions<DBError::SimpleSelectFailed>(prepared, prepared.select_query.conditions,
+                                                                          select_query.table_name, 
+                                                                          select_query.conditions, conditions);
+                    return executeSimpleSelect(select_query, rtv? nullptr: &conditions);
+                } 
+                case PreparedStatement::DELETE: {
+                    QueryProcess::DeleteStatement delete_query = prepared.delete_query;
+                    bindPlaceholders(delete_query.conditions, value);
+                    int rtv = bindConditions<DBError::DeleteRecordFailed>(prepared, prepared.delete_query.conditions,
+                                                                          delete_query.table_name, 
+                                                                          delete_query.conditions, conditions);
+                    return executeDelete(delete_query, rtv? nullptr: &conditions);
+                } 
+                case PreparedStatement::UPDATE: {
+                    QueryProcess::UpdateStatement update_query = prepared.update_query;
+                    for (auto& new_value: update_query.new_values)
+                        if (new_value.value == "?") new_value.value = *value++;
+                    bindPlaceholders(update_query.conditions, value);
+                    int rtv = bindConditions<DBError::UpdateRecordFailed>(prepared, prepared.update_query.conditions,
+                                                                          update_query.table_name, 
+                                                                          update_query.conditions, conditions);
+                    return executeUpdate(update_query, rtv? nullptr: &conditions);
+                } 
+            }
+            assert(0);
+        }
+        return 1;
+    }
 
-        return groups;
+    // parse as statement "DEALLOCATE [PREPARE] <statement name>;"
+    // returns 0 if parse and execute succeed
+    // returns 1 if parse failed
+    int parseAsDeallocateStatement(const boost::string_ref str) {
+        QueryProcess::DeallocateStatement query;
+        bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
+                                                  str.end(),
+                                                  deallocateStatementParser,
+                                                  boost::spirit::qi::space,
+                                                  query);
+        if (ok) {
+            if (!prepared_statements.erase(query.name))
+                throw DBError::StatementNotPrepared<DBError::DeallocateFailed>(query.name);
+            return 0;
+        }
+        return 1;
     }
 
-    // sort rids in asc(1) | desc(0) order
-    void sortRID(const DBTableManager* table_manager,
-                 std::vector<RID>& rids, const uint64 field_id, bool order) {
-        const DBFields& fields_desc = table_manager->fieldsDesc();
+    // parse as statement "BEGIN [WORK];" or "START TRANSACTION;"
+    // transaction in progress is committed first
+    // returns 0 if parse and execute succeed
+    // returns 1 if parse failed
+    int parseAsBeginStatement(const boost::string_ref str) {
+        bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
+                                                  str.end(),
+                                                  beginStatementParser,
+                                                  boost::spirit::qi::space);
+        if (ok) {
+            if (db_inuse.empty()) throw DBError::DBNotOpened<DBError::BeginFailed>();
+            if (!log) throw DBError::LogNotOpened();
+            if (in_transaction) {
+                commitStatement();
+                log->begin();
+            }
+            // database can't be switched or changed by others until transaction ends
+            checkLock(lockManager().lockDatabase(log->transaction(), DBLockManager::IS));
+            in_transaction = 1;
+            return 0;
+        }
+        return 1;
+    }
 
-        DBFields::Comparator comp;
-        comp.type = fields_desc.field_type()[field_id];
-        
-        std::unique_ptr<char[]> buff1(new char[fields_desc.recordLength()]);
-        std::unique_ptr<char[]> buff2(new char[fields_desc.recordLength()]);
-
-        auto comp_rule = [&table_manager, &fields_desc, &field_id, &comp, &buff1, &buff2, &order]
-            (const RID rid1, const RID rid2)->bool {
-            table_manager->selectRecord(rid1, buff1.get());
-            table_manager->selectRecord(rid2, buff2.get());
-            int comp_result = comp(buff1.get() + fields_desc.offset()[field_id],
-                                   buff2.get() + fields_desc.offset()[field_id],
-                                   fields_desc.field_length()[field_id]);
-            return order? comp_result < 0: comp_result > 0;
-        };
-        std::sort(rids.begin(), rids.end(), comp_rule);
+    // parse as statement "COMMIT [WORK];"
+    // transaction is committed when statement ends
+    // returns 0 if parse and execute succeed
+    // returns 1 if parse failed
+    int parseAsCommitStatement(const boost::string_ref str) {
+        bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
+                                                  str.end(),
+                                                  commitStatementParser,
+                                                  boost::spirit::qi::space);
+        if (ok) {
+            in_transaction = 0;
+            return 0;
+        }
+        return 1;
     }
-    
-    template <class CALLBACK>
-    void innerJoin(const std::vector<std::string>& table_names,
-                   const std::unordered_map<std::string, DBTableManager*>& table_managers,
-                   const std::unordered_map<std::string, std::vector<ComplexCondition> >& conditions,
-                   CALLBACK callback) const {
-        uint64 max_length = 0;
-        for (const auto tm: table_managers)
-            max_length = std::max(max_length, tm.second->fieldsDesc().recordLength());
-        std::unique_ptr<char[]> buffer(new char[max_length]);
-        std::vector<RID> new_record;
-        innerJoin_assis(table_names, table_managers, conditions, new_record, buffer.get(), callback);
-    }
-
-
-    template <class CALLBACK>
-    void innerJoin_assis(const std::vector<std::string>& table_names,
-                         const std::unordered_map<std::string, DBTableManager*>& table_managers,
-                         const std::unordered_map<std::string, std::vector<ComplexCondition> >& conditions,
-                         std::vector<RID>& new_record,
-                         char* buffer,
-                         CALLBACK callback) const {
-        if (new_record.size() < table_names.size()) {
-            std::string table_name = table_names[new_record.size()];
-            // construct conditions
-            std::vector<Condition> local_conds;
-            for (const auto& cond: conditions.at(table_name)) {
-                assert(cond.left_name == table_name);
-                DBTableManager* table_manager = table_managers.at(cond.right_name);
-                table_manager->selectRecord(
-                    new_record[std::find(table_names.begin(), table_names.end(), cond.right_name) - table_names.begin()], 
-                    buffer);
-                std::string right_literal(buffer + table_manager->fieldsDesc().offset()[cond.right_id],
-                                          table_manager->fieldsDesc().field_length()[cond.right_id]);
-                local_conds.push_back({ 2, cond.left_id, std::numeric_limits<uint64>::max(), cond.op, right_literal });
-            }
-            // select rids
-            auto rids = selectRID(table_managers.at(table_name), local_conds);
-            // for each rid
-            for (const auto rid: rids) {
-                // insert into new_record 
-                new_record.push_back(rid);
-                // recursive 
-                innerJoin_assis(table_names, table_managers, conditions, new_record, buffer, callback);
-                // backtrace
-                new_record.pop_back();
+
+    // parse as statement "ROLLBACK [WORK];"
+    // database is closed if changes can't be undone
+    // returns 0 if parse and execute succeed
+    // returns 1 if parse failed
+    int parseAsRollbackStatement(const boost::string_ref str) {
+        bool ok = boost::spirit::qi::phrase_parse(str.begin(), 
+                                                  str.end(),
+                                                  rollbackStatementParser,
+                                                  boost::spirit::qi::space);
+        if (ok) {
+            if (!in_transaction) return 0;
+            in_transaction = 0;
+            if (rollbackTransaction()) {
+                closeDBAfterRollback();
+                throw DBError::RollbackFailed();
             }
-        } else 
-            // call back
-            callback(new_record);
+            return 0;
+        }
+        return 1;
     }
 
+private: 
     // check whether data meets all conditions
     bool meetConditions(const char* data, 
                         const std::vector<Condition>& conditions,
                         const DBTableManager* table_manager) const {
         const auto& fields_desc = table_manager->fieldsDesc();
-        std::string null_value = std::string(fields_desc.recordLength(), '\x00');
-        DBFields::Comparator comp;
         
-        bool comp_result = true;
         for (const auto& cond: conditions) {
             // condition is constantly true or false
             if (cond.type == 1) continue;
             if (cond.type == 0) return false;
 
-            comp.type = fields_desc.field_type()[cond.left_id];
             assert(cond.type == 2 || cond.type == 3);
             assert(!(cond.type == 3 && fields_desc.field_type()[cond.left_id] != fields_desc.field_type()[cond.right_id]));
             // process like or not like operators
@@ -1524,12 +2069,11 @@ private:
                               fields_desc.field_length()[cond.left_id],
                               literal, &isnull);
                 // if left values is null, result is always false
-                if (isnull) { comp_result &= 0; return false; }
+                if (isnull) return false;
 
                 // match with EMACScript regex grammar, case insensive
                 bool match_result = boost::regex_match(literal, boost::regex(cond.right_literal.substr(2, cond.right_literal.length() - 3), boost::regex::icase));
-                comp_result &= cond.op == "like" == match_result;
-                if (!comp_result) return false;
+                if ((cond.op == "like") != match_result) return false;
                 continue;
             }
             
@@ -1537,162 +2081,320 @@ private:
             const char* right_value = cond.type == 2? 
                 cond.right_literal.data(): 
                 data + fields_desc.offset()[cond.right_id]; 
-            // comp left and right
-            int tmp_result  = comp(data + fields_desc.offset()[cond.left_id],
-                                   right_value,
-                                   fields_desc.field_length()[cond.left_id]);
-            // comp left and null
-            int tmp_result2 = comp(data + fields_desc.offset()[cond.left_id],
-                                   null_value.data(),
-                                   fields_desc.field_length()[cond.left_id]);
-            // comp right and null
-            int tmp_result3 = comp(right_value,
-                                   null_value.data(),
-                                   fields_desc.field_length()[cond.left_id]);
-            // magic, DONOT touch
-            if (cond.op == "=")
-                comp_result &= tmp_result ==  0 && 
-                    ((tmp_result2 != 0 && tmp_result3 != 0) || (cond.type == 2 && tmp_result3 == 0));
-            else if (cond.op == ">")
-                comp_result &= tmp_result >=  1 && 
-                    ((tmp_result2 != 0 && tmp_result3 != 0) || (cond.type == 2 && tmp_result3 == 0));
-            else if (cond.op == "<")
-                comp_result &= tmp_result <= -1 && 
-                    ((tmp_result2 != 0 && tmp_result3 != 0) || (cond.type == 2 && tmp_result3 == 0));
-            else if (cond.op == ">=")
-                comp_result &= tmp_result >=  0 && 
-                    ((tmp_result2 != 0 && tmp_result3 != 0) || (cond.type == 2 && tmp_result3 == 0));
-            else if (cond.op == "<=")
-                comp_result &= tmp_result <=  0 && 
-                    ((tmp_result2 != 0 && tmp_result3 != 0) || (cond.type == 2 && tmp_result3 == 0));
-            else if (cond.op == "!=")
-                comp_result &= tmp_result !=  0 && 
-                    ((tmp_result2 != 0 && tmp_result3 != 0) || (cond.type == 2 && tmp_result3 == 0));
-            else assert(0);
-            if (!comp_result) return false;
-        }
-        if (comp_result) return true;
-        else return false;
+            if (!meetCondition(data + fields_desc.offset()[cond.left_id], right_value,
+                               fields_desc.field_type()[cond.left_id],
+                               fields_desc.field_length()[cond.left_id],
+                               cond.op, cond.type == 2))
+                return false;
+        }
+        return true;
+    }
+
+    // check whether left op right is true
+    // right_literal is 1 if right value is literal
+    bool meetCondition(const char* left, const char* right,
+                       const uint64 type, const uint64 length,
+                       const std::string& op, const bool right_literal) const {
+        DBFields::Comparator comp;
+        comp.type = type;
+        // comp left and right
+        int comp_result = comp(left, right, length);
+        bool left_null = left[0] == '\x00';
+        bool right_null = right[0] == '\x00';
+        // magic, DONOT touch
+        bool null_result = (!left_null && !right_null) || (right_literal && right_null);
+        if (op == "=")
+            return comp_result ==  0 && null_result;
+        else if (op == ">")
+            return comp_result >=  1 && null_result;
+        else if (op == "<")
+            return comp_result <= -1 && null_result;
+        else if (op == ">=")
+            return comp_result >=  0 && null_result;
+        else if (op == "<=")
+            return comp_result <=  0 && null_result;
+        else if (op == "!=")
+            return comp_result !=  0 && null_result;
+        else assert(0);
+        return false;
+    }
+
+    // throws if lock request returning rtv is not granted, see DBLockManager
+    static void checkLock(const int rtv) {
+        if (rtv == 1) throw DBError::LockWait();
+        if (rtv == 2) throw DBError::Deadlock();
+    }
+
+    // lock table for transaction of statement, see DBTableManager::lock()
+    // tables read by snapshots are not locked
+    void lockTable(const DBTableManager* table_manager, const uint64 mode, const uint64 read = 0) const {
+        if (!snapshot) checkLock(table_manager->lock(mode, read));
+    }
+
+    // locks of transactions on database in use, those of source for a writer
+    DBLockManager& lockManager() {
+        return source? source->locks: locks;
+    }
+
+    // bits of fields read by conditions
+    static uint64 conditionFields(const std::vector<Condition>& conditions) {
+        uint64 fields = 0;
+        for (const auto& cond: conditions) {
+            if (cond.type < 2) continue;
+            fields |= DBLockManager::fieldBit(cond.left_id);
+            if (cond.type == 3) fields |= DBLockManager::fieldBit(cond.right_id);
+        }
+        return fields;
     }
 
     // select rids meeting all conditions
+    // changes of fields in conditions by other transactions are waited for
     std::vector<RID> selectRID(const DBTableManager* table_manager,
                                const std::vector<Condition>& conditions) const {
+        lockTable(table_manager, DBLockManager::IS, conditionFields(conditions));
         std::vector<RID> rids;
+        if (selectRIDWithIndex(table_manager, conditions, rids)) return rids;
+
+        // else, just traverse each record
+        auto plan = scanPlan(table_manager, conditions);
+        Operator::RowBatch batch(table_manager->fieldsDesc().recordLength());
+        plan->open();
+        while (plan->next(batch))
+            for (uint64 i = 0; i < batch.size(); ++i)
+                rids.push_back(batch.rid(i));
+        plan->close();
+        return rids; 
+    }
+
+    // read records meeting all conditions
+    Operator::OperatorPtr scanPlan(const DBTableManager* table_manager,
+                                   const std::vector<Condition>& conditions) const {
+        std::vector<RID> rids;
+        if (selectRIDWithIndex(table_manager, conditions, rids))
+            return Operator::OperatorPtr(new Operator::IndexScan(table_manager, std::move(rids)));
+
+        // records are filtered by threads reading them
+        if (thread_pool)
+            return Operator::OperatorPtr(new Operator::ParallelTableScan(
+                table_manager, conditionsPredicate(table_manager, conditions), thread_pool.get()));
+
+        return filterPlan(Operator::OperatorPtr(new Operator::TableScan(table_manager)), 
+                          table_manager, conditions);
+    }
+
+    // read records meeting all conditions in order of field_id
+    // order is 1 if ascending, 0 if descending
+    // assert field_id is indexed
+    Operator::OperatorPtr indexOrderPlan(const DBTableManager* table_manager, const uint64 field_id,
+                                         const bool order, const std::vector<Condition>& conditions) const {
+        return filterPlan(Operator::OperatorPtr(new Operator::IndexOrderScan(table_manager, field_id, order)), 
+                          table_manager, conditions);
+    }
+
+    // write rows of plan to outfile if there is, to out otherwise
+    template <class ERRORTYPE, class ...Para>
+    void outputPlan(Operator::OperatorPtr plan, const QueryProcess::OutfileClause& outfile, 
+                    const Para&... error_info) const {
+        if (outfile.path.length()) {
+            if (!fileAllowed(outfile.path)) 
+                throw DBError::FileNotAllowed<ERRORTYPE>(outfile.path, error_info...);
+            std::ofstream fout(outfile.path, std::fstream::out | std::fstream::trunc | std::fstream::binary);
+            if (!fout) throw DBError::OpenFileFailed<ERRORTYPE>(outfile.path, error_info...);
+            // csv by default
+            uint64 format = outfile.format.length()? 
+                            Operator::Export::format(outfile.format):
+                            Operator::Export::FORMAT_CSV;
+            Operator::Export(std::move(plan), fout, format).run();
+            if (!fout) throw DBError::OpenFileFailed<ERRORTYPE>(outfile.path, error_info...);
+        } else if (output_format != std::numeric_limits<uint64>::max()) {
+            Operator::Export(std::move(plan), out, output_format).run();
+        } else {
+            Operator::Output(std::move(plan), out).run();
+        }
+    }
+
+    // whether file at path can be read or written, see restrictFiles()
+    // path is resolved through links, a file not existing yet is resolved by its directory
+    bool fileAllowed(const std::string& path) const {
+        namespace fs = boost::filesystem;
+        if (!restrict_files) return 1;
+        if (file_directory.empty()) return 0;
+        boost::system::error_code ec;
+        fs::path resolved = fs::canonical(path, ec);
+        if (ec) {
+            const fs::path absolute = fs::absolute(path);
+            resolved = fs::canonical(absolute.parent_path(), ec);
+            if (ec || !absolute.has_filename() || absolute.filename() == "." || absolute.filename() == "..") 
+                return 0;
+            resolved /= absolute.filename();
+        }
+        const fs::path directory(file_directory);
+        auto ite = resolved.begin();
+        for (const auto& element: directory) {
+            if (ite == resolved.end() || *ite != element) return 0;
+            ++ite;
+        }
+        // the directory itself is not a file
+        return ite != resolved.end();
+    }
+
+    // records of plan meeting all conditions pass
+    Operator::OperatorPtr filterPlan(Operator::OperatorPtr plan, 
+                                     const DBTableManager* table_manager,
+                                     const std::vector<Condition>& conditions) const {
+        Operator::Predicate predicate = conditionsPredicate(table_manager, conditions);
+        if (!predicate) return plan;
+        return Operator::OperatorPtr(new Operator::Filter(std::move(plan), predicate));
+    }
+
+    // predicate of records meeting all conditions
+    // returns empty predicate if conditions are constant-true
+    Operator::Predicate conditionsPredicate(const DBTableManager* table_manager,
+                                            const std::vector<Condition>& conditions) const {
+        // no condition, means constant-true
+        if (std::find_if(conditions.begin(), conditions.end(), 
+                         [](const Condition& cond) { return cond.type != 1; }) == conditions.end())
+            return Operator::Predicate();
+
+        return [this, conditions, table_manager](const char* data) {
+            return meetConditions(data, conditions, table_manager);
+        };
+    }
+
+    // get limit and offset from limit clause
+    // limit is max of uint64 if there's no limit clause
+    void parseLimit(const QueryProcess::LimitClause& clause, uint64& limit, uint64& offset) const {
+        limit = std::numeric_limits<uint64>::max();
+        offset = 0;
+        if (clause.count.length()) 
+            limit = std::strtoull(clause.count.c_str(), nullptr, 10);
+        if (clause.offset.length()) 
+            offset = std::strtoull(clause.offset.c_str(), nullptr, 10);
+    }
+
+    static uint64 saturatedAdd(const uint64 a, const uint64 b) {
+        return a > std::numeric_limits<uint64>::max() - b? std::numeric_limits<uint64>::max(): a + b;
+    }
+
+    // check if records meeting all conditions can be selected with index,
+    // which holds when conditions are constant-false, 
+    // or all right values are literal and conrresponding fields are indexed
+    bool indexSelectable(const DBTableManager* table_manager,
+                         const std::vector<Condition>& conditions) const {
+        // constant-false
+        if (std::find_if(conditions.begin(), conditions.end(), 
+                         [](const Condition& cond) { return cond.type == 0; }) != conditions.end())
+            return 1;
+
+        // no condition, means constant-true
+        if (std::find_if(conditions.begin(), conditions.end(), 
+                         [](const Condition& cond) { return cond.type != 1; }) == conditions.end())
+            return 0;
+
+        return std::find_if(conditions.begin(), conditions.end(),
+                    [&table_manager](const Condition& cond) { 
+                        return cond.type == 3 || 
+                               (cond.type == 2 && 
+                                (!table_manager->indexReadable(cond.left_id) ||
+                                 cond.op == "like" || 
+                                 cond.op == "not like"));
+                    }) == conditions.end();
+    }
+
+    // select rids meeting all conditions with index
+    // returns 1 and saves result in rids if index can be used
+    // returns 0 otherwise
+    bool selectRIDWithIndex(const DBTableManager* table_manager,
+                            const std::vector<Condition>& conditions,
+                            std::vector<RID>& rids) const {
+        rids.clear();
+        if (!indexSelectable(table_manager, conditions)) return 0;
         // conditions with right value is literal
         std::vector<Condition> condition_right_literal;
-        // conditions with right value is field id
-        std::vector<Condition> condition_right_fieldID;
-        // classify orig conditions
         for (const auto& cond: conditions) 
             // constant-false
-            if (cond.type == 0) return rids;
+            if (cond.type == 0) return 1;
             else if (cond.type == 2) condition_right_literal.push_back(cond);
-            else if (cond.type == 3) condition_right_fieldID.push_back(cond);
-
-        // no condition, means constant-true
-        if (condition_right_literal.size() + condition_right_fieldID.size() == 0)
-            return table_manager->findRecords(0, [](const char*) { return 1; });
 
+        // if all right values are literal and conrresponding fields are indexed
+        // then find records using index, store them in set and calculate intersection
 
         const auto& fields_desc = table_manager->fieldsDesc();
         std::string null_value = std::string(fields_desc.recordLength(), '\x00');
 
-        // if all right values are literal and conrresponding fields are indexed
-        // then find records using index, store them in set and calculate intersection
-        if (condition_right_fieldID.size() == 0 && 
-            std::find_if(condition_right_literal.begin(), 
-                    condition_right_literal.end(),
-                    [&table_manager](const Condition& cond) { 
-                        return table_manager->fieldsDesc().indexed()[cond.left_id] == 0 ||
-                               cond.op == "like" || 
-                               cond.op == "not like";
-                    }) == condition_right_literal.end()) {
-            // intersected rids
-            std::set<RID> intersected_rids;
-            std::unique_ptr<char[]> min_value(new char[fields_desc.recordLength()]);
-            bool first_loop = 1;
-            for (const auto& cond: condition_right_literal) {
-                // generate min value
-                memset(min_value.get(), 0x00, fields_desc.recordLength());
-                minGenerator(fields_desc.field_type()[cond.left_id], min_value.get(), fields_desc.field_length()[cond.left_id]);
-
-                std::vector< std::vector<RID> > include_rids;
-                std::vector< std::vector<RID> > exclude_rids;
-                if (cond.op == "=") {
-                    // [literal, literal]
-                    include_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data()));
-                } else if (cond.op == ">=") {
-                    // [literal, null)
-                    include_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data(), null_value.data()));
-                } else if (cond.op == ">") {
-                    // [literal, null)
-                    include_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data(), null_value.data()));
-                    // [literal, literal]
-                    exclude_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data()));
-                } else if (cond.op == "<=") {
-                    // [min, literal)
-                    include_rids.push_back(table_manager->findRecords(cond.left_id, min_value.get(), cond.right_literal.data()));
-                    // [literal, literal]
-                    include_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data()));
-                } else if (cond.op == "<") {
-                    // [min, literal)
-                    include_rids.push_back(table_manager->findRecords(cond.left_id, min_value.get(), cond.right_literal.data()));
-                } else if (cond.op == "!=") {
-                    // [min, null)
-                    include_rids.push_back(table_manager->findRecords(cond.left_id, min_value.get(), null_value.data()));
-                    // [literal, literal]
-                    exclude_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data()));
-                } else assert(0);
-                // all include sets
-                std::set<RID> include_rids_set;
-                std::size_t size_include = 0, size_exclude = 0;
-                for (const auto& i: include_rids) {
-                    include_rids_set.insert(i.begin(), i.end());
-                    size_include += i.size();
-                }
-                assert(include_rids_set.size() == size_include);
-                // all exclude sets
-                std::set<RID> exclude_rids_set;
-                for (const auto& e: exclude_rids) {
-                    exclude_rids_set.insert(e.begin(), e.end());
-                    size_exclude += e.size();
-                }
-                assert(exclude_rids_set.size() == size_exclude);
-                // difference set
-                std::set<RID> difference_rids;
-                std::set_difference(include_rids_set.begin(), include_rids_set.end(), 
-                                    exclude_rids_set.begin(), exclude_rids_set.end(),
-                                    std::inserter(difference_rids, difference_rids.end()));
-                assert(difference_rids.size() == size_include - size_exclude);
-                // get total intersection set
-                // first time in loop
-                if (first_loop) {
-                    intersected_rids = difference_rids;
-                    first_loop = 0;
-                    continue;
-                }
-                
-                std::set<RID> tmp;
-                std::set_intersection(difference_rids.begin(), difference_rids.end(),
-                                      intersected_rids.begin(), intersected_rids.end(), 
-                                      std::inserter(tmp, tmp.end()));
-                intersected_rids = tmp;
+        // intersected rids
+        std::set<RID> intersected_rids;
+        std::unique_ptr<char[]> min_value(new char[fields_desc.recordLength()]);
+        bool first_loop = 1;
+        for (const auto& cond: condition_right_literal) {
+            // generate min value
+            memset(min_value.get(), 0x00, fields_desc.recordLength());
+            minGenerator(fields_desc.field_type()[cond.left_id], min_value.get(), fields_desc.field_length()[cond.left_id]);
+
+            std::vector< std::vector<RID> > include_rids;
+            std::vector< std::vector<RID> > exclude_rids;
+            if (cond.op == "=") {
+                // [literal, literal]
+                include_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data()));
+            } else if (cond.op == ">=") {
+                // [literal, null)
+                include_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data(), null_value.data()));
+            } else if (cond.op == ">") {
+                // [literal, null)
+                include_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data(), null_value.data()));
+                // [literal, literal]
+                exclude_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data()));
+            } else if (cond.op == "<=") {
+                // [min, literal)
+                include_rids.push_back(table_manager->findRecords(cond.left_id, min_value.get(), cond.right_literal.data()));
+                // [literal, literal]
+                include_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data()));
+            } else if (cond.op == "<") {
+                // [min, literal)
+                include_rids.push_back(table_manager->findRecords(cond.left_id, min_value.get(), cond.right_literal.data()));
+            } else if (cond.op == "!=") {
+                // [min, null)
+                include_rids.push_back(table_manager->findRecords(cond.left_id, min_value.get(), null_value.data()));
+                // [literal, literal]
+                exclude_rids.push_back(table_manager->findRecords(cond.left_id, cond.right_literal.data()));
+            } else assert(0);
+            // all include sets
+            std::set<RID> include_rids_set;
+            std::size_t size_include = 0, size_exclude = 0;
+            for (const auto& i: include_rids) {
+                include_rids_set.insert(i.begin(), i.end());
+                size_include += i.size();
             }
-            rids.assign(intersected_rids.begin(), intersected_rids.end());
-        } else {
-        // else, just traverse each record
-            std::vector<Condition> all_conditions;
-            all_conditions.insert(all_conditions.end(), condition_right_literal.begin(), condition_right_literal.end());
-            all_conditions.insert(all_conditions.end(), condition_right_fieldID.begin(), condition_right_fieldID.end());
-
-            auto comp_rule = [this, &rids, &all_conditions, &table_manager](const char* data, const RID rid) {
-                if (meetConditions(data, all_conditions, table_manager))
-                    rids.push_back(rid);
-            };
-            table_manager->traverseRecords(comp_rule);
+            assert(include_rids_set.size() == size_include);
+            // all exclude sets
+            std::set<RID> exclude_rids_set;
+            for (const auto& e: exclude_rids) {
+                exclude_rids_set.insert(e.begin(), e.end());
+                size_exclude += e.size();
+            }
+            assert(exclude_rids_set.size() == size_exclude);
+            // difference set
+            std::set<RID> difference_rids;
+            std::set_difference(include_rids_set.begin(), include_rids_set.end(), 
+                                exclude_rids_set.begin(), exclude_rids_set.end(),
+                                std::inserter(difference_rids, difference_rids.end()));
+            assert(difference_rids.size() == size_include - size_exclude);
+            // get total intersection set
+            // first time in loop
+            if (first_loop) {
+                intersected_rids = difference_rids;
+                first_loop = 0;
+                continue;
+            }
+            
+            std::set<RID> tmp;
+            std::set_intersection(difference_rids.begin(), difference_rids.end(),
+                                  intersected_rids.begin(), intersected_rids.end(), 
+                                  std::inserter(tmp, tmp.end()));
+            intersected_rids = tmp;
         }
-        return rids; 
+        rids.assign(intersected_rids.begin(), intersected_rids.end());
+        return 1;
     }
     
     // parse simple condition
@@ -1705,27 +2407,10 @@ private:
     //     condition.left_expr is true or false
     //     condition.op and condition.right_expr is empty
     template <class ERRORTYPE, class ...ERRORINFO>
-    Condition parseSimpleCondition(QueryProcess::SimpleCondition condition, 
+    Condition parseSimpleCondition(const QueryProcess::SimpleCondition& condition, 
                                    const DBFields& fields_desc,
                                    const ERRORINFO&... error_info) const {
-        // convert "nOt(\blank)+nULl" to "not null", "nULl" to "null", "iS" to "is"
-        // convert "Not(\black)+ lIKE" to "not like", "lIKE" to "like"
-        // i.e. convert all to lower case and remove redundant blank chars
-        if (boost::regex_match(condition.left_expr, boost::regex("((not)(\\s+))?(null)", boost::regex_constants::icase)))
-            condition.left_expr = condition.left_expr.length() != 4? "not null": "null";
-        if (boost::regex_match(condition.right_expr, boost::regex("((not)(\\s+))?(null)", boost::regex_constants::icase)))
-            condition.right_expr = condition.right_expr.length() != 4? "not null": "null";
-        if (boost::regex_match(condition.op, boost::regex("(is)", boost::regex_constants::icase)))
-            condition.op = "is";
-        if (boost::regex_match(condition.op, boost::regex("((not)(\\s+))?(like)", boost::regex_constants::icase)))
-            condition.op = condition.op.length() != 4? "not like": "like";
-
-        // convert "tRuE" to "true", "FaLse" to "false"
-        if (boost::regex_match(condition.left_expr, boost::regex("(true)", boost::regex_constants::icase)))
-            condition.left_expr = "true";
-        if (boost::regex_match(condition.left_expr, boost::regex("(false)", boost::regex_constants::icase)))
-            condition.left_expr = "false";
-        
+        // keywords are already normalized to lower case by grammar
         if (condition.left_expr == "true" || condition.left_expr == "false") {
             if (condition.op.length())
                 throw DBError::InvalidConditionOperator<ERRORTYPE>(condition.op, error_info...);
@@ -1802,9 +2487,6 @@ private:
         // buffer is asserted to be cleared by callee
         memset(buffer, 0x00, fields_desc.recordLength());
 
-        // args with null flags
-        std::vector<void*> args;
-
         // check fields size
         uint64 expected_size = fields_desc.size() - 
             (fields_desc.field_name()[fields_desc.primary_key_field_id()].length() == 0? 1: 0);
@@ -1823,9 +2505,58 @@ private:
             // out of range
             if (rtv == 2) 
                 throw DBError::LiteralOutOfRange<DBError::InsertRecordFailed>(values[i], table_name, values);
-            args.push_back(buffer + fields_desc.offset()[i]);
         }
 
+        return insertRecordBuffer(table_name, table_manager, values, buffer, check_constraint);
+    }
+
+    // insert record of parsed fields
+    // values are only used as error info
+    RID loadRecord(const std::string& table_name, DBTableManager* table_manager, 
+                   const std::vector<DelimitedReader::Field>& fields, 
+                   const std::vector<std::string>& values, char* buffer,
+                   const std::vector<Condition>* check_constraint) {
+        const DBFields& fields_desc = table_manager->fieldsDesc();
+
+        // buffer is asserted to be cleared by callee
+        memset(buffer, 0x00, fields_desc.recordLength());
+
+        // check fields size
+        uint64 expected_size = fields_desc.size() - 
+            (fields_desc.field_name()[fields_desc.primary_key_field_id()].length() == 0? 1: 0);
+        if (fields.size() != expected_size)
+            throw DBError::WrongTupleSize(table_name, values, expected_size);
+
+        for (std::size_t i = 0; i < fields.size(); ++i) {
+            // null flag is already cleared
+            if (fields[i].null) continue;
+            int rtv = textParser(fields[i].value.data(), fields[i].value.length(),
+                                 fields_desc.field_type()[i],
+                                 fields_desc.field_length()[i],
+                                 buffer + fields_desc.offset()[i]);
+            // parse failed
+            if (rtv == 1) 
+                throw DBError::LiteralParseFailed<DBError::InsertRecordFailed>(values[i], table_name, values);
+            // out of range
+            if (rtv == 2) 
+                throw DBError::LiteralOutOfRange<DBError::InsertRecordFailed>(values[i], table_name, values);
+        }
+
+        return insertRecordBuffer(table_name, table_manager, values, buffer, check_constraint);
+    }
+
+    // insert record in buffer, whose auto created primary key is not generated yet
+    // values are only used as error info
+    RID insertRecordBuffer(const std::string& table_name, DBTableManager* table_manager, 
+                           const std::vector<std::string>& values, char* buffer,
+                           const std::vector<Condition>* check_constraint) {
+        const DBFields& fields_desc = table_manager->fieldsDesc();
+
+        // args with null flags
+        std::vector<void*> args;
+        for (const auto off: fields_desc.offset())
+            args.push_back(buffer + off);
+
         // auto created primary key
         if (fields_desc.field_name()[fields_desc.primary_key_field_id()].length() == 0) {
             // null flag
@@ -1835,7 +2566,6 @@ private:
                    &unique_number, 
                    fields_desc.field_length()[fields_desc.primary_key_field_id()] - 1);
             assert(fields_desc.field_length()[fields_desc.primary_key_field_id()] - 1 == sizeof(uint64));
-            args.push_back(buffer + fields_desc.offset()[fields_desc.primary_key_field_id()]);
         }
 
         // check constraint
@@ -1859,137 +2589,130 @@ private:
         }
 
         auto rid = table_manager->insertRecord(args);
+        // args of all fields are passed
+        assert(rid != RID(0, 1));
         // insert failed
-        if (rid == RID(0, 1)) 
-            throw DBError::WrongTupleSize(table_name, values, expected_size);
-        else if (rid == RID(0, 3)) 
+        if (rid == RID(0, 3)) 
             throw DBError::NotNullExpected<DBError::InsertRecordFailed>(table_name, values);
         else if (rid == RID(0, 4))
             throw DBError::DuplicatePrimaryKey<DBError::InsertRecordFailed>(table_name, values);
+        else if (rid == RID(0, 5) || rid == RID(0, 6))
+            checkLock(rid.slotID - 4);
         else if (!rid)
             throw DBError::InsertRecordFailed(table_name, values);
         return rid;
     }
 
-    template <class ERRORTYPE, class ...ERRORINFO>
-    // FIXME: aggregate function returns empty set of rid 
-    // when rid is originally empty.
-    std::vector<RID> groupBy(const std::string& group_by_field_name,
-                             IntermediateTable& intermediate,
-                             const DBFields& new_fields_desc, 
-                             const DBFields& fields_desc,
-                             const std::vector<uint64>& original_field_ids,
-                             const std::vector<uint64>& display_field_ids,
-                             const std::vector<std::string>& functions,
-                             const DBTableManager* table_manager, 
-                             std::vector<RID>& rids,
-                             const ERRORINFO&... error_info) {
-        // create intermediate table manager
-        std::tie(intermediate.table_manager_number, intermediate.table_manager) = getTempTable(-1);
-        assert(intermediate.table_manager_number >= 0);
-        assert(intermediate.table_manager);
-        auto temp_file = uniquePath(temp_dir);
-        assert(intermediate.table_manager->create(temp_file.string(), new_fields_desc, DBTableManager::DEFAULT_PAGE_SIZE) == 0);
-        assert(intermediate.table_manager->open(temp_file.string()) == 0);
-
-        // divide into groups
-        std::vector<std::vector<RID>::const_iterator> groups;
+    static uint64 countPlaceholders(const std::vector<QueryProcess::SimpleCondition>& conditions) {
+        uint64 count = 0;
+        for (const auto& cond: conditions)
+            count += cond.right_expr == "?";
+        return count;
+    }
+
+    // replace placeholders in conditions with values in order
+    // value is moved to the one after last used
+    static void bindPlaceholders(std::vector<QueryProcess::SimpleCondition>& conditions, 
+                                 std::vector<std::string>::const_iterator& value) {
+        for (auto& cond: conditions)
+            if (cond.right_expr == "?") cond.right_expr = *value++;
+    }
+
+    // compile where clause of prepared statement, and bind values to placeholders
+    // conditions are compiled only once, unless schema changes
+    // bound_conditions are conditions with placeholders replaced by values
+    // returns 0 if succeed
+    // returns 1 if table cannot be opened, conditions are left to be compiled on execution, 
+    // where errors are reported
+    template <class ERRORTYPE>
+    int bindConditions(PreparedStatement& prepared, 
+                       const std::vector<QueryProcess::SimpleCondition>& conditions,
+                       const std::string& table_name,
+                       const std::vector<QueryProcess::SimpleCondition>& bound_conditions,
+                       std::vector<Condition>& compiled_conditions) {
+        if (db_inuse.length() == 0) return 1;
+        DBTableManager* table_manager = openTable(table_name);
+        if (!table_manager) return 1;
+        const DBFields& fields_desc = table_manager->fieldsDesc();
 
+        if (!prepared.compiled || prepared.schema_version != schema_version) {
+            prepared.conditions.clear();
+            for (auto cond: conditions) {
+                bool placeholder = cond.right_expr == "?";
+                // placeholder is compiled as null, which is constantly false,
+                // except with operator "is", where value cannot be bound
+                if (placeholder) cond.right_expr = "null";
+                prepared.conditions.push_back(parseSimpleCondition<ERRORTYPE>(cond, fields_desc, table_name));
+                if (placeholder && prepared.conditions.back().type != 0)
+                    throw DBError::InvalidConditionOperator<ERRORTYPE>(cond.op, table_name);
+            }
+            prepared.compiled = 1;
+            prepared.schema_version = schema_version;
+        }
+
+        compiled_conditions = prepared.conditions;
+        for (std::size_t i = 0; i < conditions.size(); ++i) {
+            if (conditions[i].right_expr != "?") continue;
+            Condition& cond = compiled_conditions[i];
+            const std::string& literal = bound_conditions[i].right_expr;
+            bool like = cond.op == "like" || cond.op == "not like";
+
+            // right value of like is string literal
+            if (like && literal.length() >= 2 && literal.front() == '\'' && literal.back() == '\'') {
+                cond.type = 2;
+                cond.right_literal = "\xff" + literal;
+                continue;
+            }
+
+            cond.right_literal.assign(fields_desc.field_length()[cond.left_id], '\x00');
+            if (literalParser(literal, fields_desc.field_type()[cond.left_id],
+                              fields_desc.field_length()[cond.left_id], &cond.right_literal[0]))
+                throw DBError::InvalidConditionOperand<ERRORTYPE>(literal, table_name);
+            // comparing with null is constantly false
+            cond.type = cond.right_literal[0] == '\x00'? 0: 2;
+            if (like && cond.type) 
+                throw DBError::InvalidConditionOperand<ERRORTYPE>(literal, table_name);
+        }
+        return 0;
+    }
+
+    // FIXME: aggregate function returns empty set
+    // when input is originally empty.
+    template <class ERRORTYPE, class ...ERRORINFO>
+    Operator::OperatorPtr aggregatePlan(Operator::OperatorPtr plan,
+                                        const std::string& group_by_field_name,
+                                        const DBFields& new_fields_desc, 
+                                        const DBFields& fields_desc,
+                                        const std::vector<uint64>& original_field_ids,
+                                        const std::vector<uint64>& display_field_ids,
+                                        const std::vector<std::string>& functions,
+                                        const ERRORINFO&... error_info) const {
         // if group by
+        uint64 group_field_id = Operator::Aggregate::NO_GROUP;
         if (group_by_field_name.length()) {
             auto ite = std::find(fields_desc.field_name().begin(),
                                  fields_desc.field_name().end(),
                                  group_by_field_name);
             if (ite == fields_desc.field_name().end())
                 throw DBError::InvalidFieldName<ERRORTYPE>(group_by_field_name, error_info...);
-            // sort 
-            sortRID(table_manager, rids, ite - fields_desc.field_name().begin(), 1);
-
-            groups = grouping(table_manager, rids, ite - fields_desc.field_name().begin());
-        // else aggregate funtion(s) without group by
-        // this is the same as just one group
-        // except for table is empty
-        } else if (rids.size())
-            groups.push_back(rids.begin());
-
-        // aggeragate
-        // store record to be inserted into intermediate table
-        std::unique_ptr<char[]> inter_record_buffer(new char[new_fields_desc.recordLength()]);
-        std::vector<void*> inter_insert_args;
-        for (const auto off: new_fields_desc.offset())
-            inter_insert_args.push_back(inter_record_buffer.get() + off);
-        // record intermediate rids, to replace rids later
-        std::vector<RID> inter_rids;
-
-        std::unique_ptr<char[]> aggregate_tmp(new char[fields_desc.recordLength() * rids.size()]);
-        DBFields::Aggregator aggregator;
-        // rids between groups[i] and groups[i + 1] is a group
-        for (std::size_t i = 0; i < groups.size(); ++i) {
-            // read the first in the group to result buffer
-            table_manager->selectRecord(*groups[i], inter_record_buffer.get());
-            std::vector<void*> args;
-            // read all of this group to aggregate buffer
-            for (auto ite2 = groups[i]; ite2 != (i + 1 == groups.size()? rids.end(): groups[i + 1]); ++ite2) {
-                args.push_back(aggregate_tmp.get() + fields_desc.recordLength() * (ite2 - groups[i]));
-                table_manager->selectRecord(*ite2, args.back());
-            }
-            // calculate aggregate value and save to result buffer
-            // check each field to be displayed
-            for (std::size_t j = 0; j < display_field_ids.size(); ++j) {
-                // if there's a fucntion
-                if (functions[j].size()) {
-                    // paras of aggregator: pointers to all data, offset, type, length, result save to where
-                    int rtv;
-                    if (functions[j] == "sum") {
-                        rtv = aggregator.sum(args, fields_desc.offset()[original_field_ids[j]], 
-                            fields_desc.field_type()[original_field_ids[j]],
-                            fields_desc.field_length()[original_field_ids[j]],
-                            inter_record_buffer.get() + 
-                            new_fields_desc.offset()[display_field_ids[j]]);
-                    } else if (functions[j] == "avg") {
-                        rtv = aggregator.avg(args, fields_desc.offset()[original_field_ids[j]], 
-                            fields_desc.field_type()[original_field_ids[j]],
-                            inter_record_buffer.get() + 
-                            new_fields_desc.offset()[display_field_ids[j]]);
-                    } else if (functions[j] == "max") {
-                        rtv = aggregator.max(args, fields_desc.offset()[original_field_ids[j]], 
-                            fields_desc.field_type()[original_field_ids[j]],
-                            fields_desc.field_length()[original_field_ids[j]],
-                            inter_record_buffer.get() + 
-                            new_fields_desc.offset()[display_field_ids[j]]);
-                    } else if (functions[j] == "min") {
-                        rtv = aggregator.min(args, fields_desc.offset()[original_field_ids[j]], 
-                            fields_desc.field_type()[original_field_ids[j]],
-                            fields_desc.field_length()[original_field_ids[j]],
-                            inter_record_buffer.get() + 
-                            new_fields_desc.offset()[display_field_ids[j]]);
-                    } else if (functions[j] == "count") {
-                        rtv = aggregator.count(args, fields_desc.offset()[original_field_ids[j]],
-                                               inter_record_buffer.get() + 
-                                               new_fields_desc.offset()[display_field_ids[j]]);
-                    } else assert(0);
-                    if (rtv) 
-                        throw DBError::AggregateFailed<ERRORTYPE>(functions[j], fields_desc.field_name()[original_field_ids[j]], error_info...);
-                }
-            }
-            // insert into intermediate table
-            auto inter_rid = intermediate.table_manager->insertRecord(inter_insert_args);
-            assert(inter_rid);
-            inter_rids.push_back(inter_rid);
+            group_field_id = ite - fields_desc.field_name().begin();
         }
-        return inter_rids;
-    }
-
-
 
-    // get temporary table, if k < 0, create a new table
-    std::tuple<int, DBTableManager*> getTempTable(const int k) {
-        if (k < 0) {
-            DBTableManager* ptr = new DBTableManager;
-            temp_tables.push_back(ptr);
-            return std::make_tuple(temp_tables.size() - 1, ptr);
+        // check each field to be displayed
+        std::vector<Operator::AggregateFunction> aggregate_functions;
+        for (std::size_t j = 0; j < display_field_ids.size(); ++j) {
+            if (!functions[j].size()) continue;
+            // e.g. sum and avg cannot be applied to strings
+            if (original_field_ids[j] != Operator::Aggregate::ALL_FIELDS &&
+                !DBFields::Aggregator::applicable(DBFields::Aggregator::function(functions[j]),
+                                                  fields_desc.field_type()[original_field_ids[j]]))
+                throw DBError::AggregateFailed<ERRORTYPE>(functions[j], fields_desc.field_name()[original_field_ids[j]], error_info...);
+            aggregate_functions.push_back({ functions[j], original_field_ids[j], display_field_ids[j] });
         }
-        return std::make_tuple(k, temp_tables.at(k));
+
+        return Operator::OperatorPtr(new Operator::Aggregate(std::move(plan), new_fields_desc, 
+                                                             group_field_id, aggregate_functions,
+                                                             thread_pool.get()));
     }
 
     boost::filesystem::path uniquePath(const boost::filesystem::path& dir = ".") const {
@@ -2000,25 +2723,11 @@ private:
         }
     }
 
-    void removeTempTable(const int k) {
-        if (k < 0) return;
-        assert(temp_tables[k]);
-        assert(temp_tables[k]->remove() == 0);
-        delete temp_tables[k];
-        temp_tables[k] = nullptr;
-    }
-
-    void clearTempTables() {
-        for (auto& ptr: temp_tables) {
-            if (!ptr) continue;
-            assert(ptr->remove() == 0);
-            delete ptr;
-            ptr = nullptr;
-        }
-    }
-
-
+    // tables read by a snapshot or changed by a writer are those of its source
+    // tables are opened by snapshot readers, writers and this concurrently
     DBTableManager* openTable(const std::string& table_name) {
+        if (source) return source->openTable(table_name);
+        std::lock_guard<std::mutex> lock(tables_mutex);
         auto ptr = tables_inuse.find(table_name);
         if (ptr != tables_inuse.end()) return ptr->second;
 
@@ -2028,7 +2737,7 @@ private:
             return nullptr;
 
         // open table
-        DBTableManager* table_manager(new DBTableManager);
+        DBTableManager* table_manager(new DBTableManager(log.get(), versions.get(), &locks));
         // if failed
         int rtv = table_manager->open(db_inuse + '/' + table_name);
         if (rtv) {
@@ -2044,21 +2753,140 @@ private:
         return table_manager;
     }
 
+    // check constraint of table opened, nullptr if none
+    const std::vector<Condition>* checkConstraint(const std::string& table_name) {
+        if (source) return source->checkConstraint(table_name);
+        std::lock_guard<std::mutex> lock(tables_mutex);
+        auto ite = tables_check_constraints.find(table_name);
+        return ite == tables_check_constraints.end()? nullptr: &ite->second;
+    }
+
+    // redo and undo changes in log of database in use, left by a crash
+    // returns 0 if succeed, 1 otherwise
+    bool recover() {
+        std::vector<std::string> files;
+        if (DBRecovery(*log).recover(files)) return 1;
+        recountIndexes(files);
+        // all changes are on disk after files are closed
+        if (files.empty()) return 0;
+        return log->truncate();
+    }
+
+    // undo changes of transaction in progress, through tables open, which snapshots go on reading,
+    // and whose meta data cached is read again then
+    // if failed, database should be closed, and the transaction is left to recovery
+    // when database is used again
+    // returns 0 if succeed, 1 otherwise
+    bool rollbackTransaction() {
+        const uint64 txn = log->transaction();
+        std::vector<std::string> files;
+        // indexes of tables open are undone through them
+        DBQuery* tables = source? source: this;
+        auto find = [tables](const std::string& file) {
+            std::lock_guard<std::mutex> lock(tables->tables_mutex);
+            for (const auto& table: tables->tables_inuse)
+                if (auto index = table.second->index(file)) return index;
+            return static_cast<DBBLinkIndex<DBFields::Comparator>*>(nullptr);
+        };
+        if (DBRecovery(*log).rollback(files, find)) return 1;
+        reloadTables(files);
+        lockManager().release(txn);
+        return 0;
+    }
+
+    // meta data cached by tables open is outdated after changes of files are undone,
+    // indexes of tables not open are recounted
+    void reloadTables(const std::vector<std::string>& files) {
+        std::set<std::string> closed(files.begin(), files.end());
+        DBQuery* tables = source? source: this;
+        std::lock_guard<std::mutex> lock(tables->tables_mutex);
+        for (auto& table: tables->tables_inuse) {
+            bool changed = 0;
+            for (auto ite = closed.begin(); ite != closed.end(); )
+                if (table.second->hasFile(*ite)) {
+                    changed = 1;
+                    ite = closed.erase(ite);
+                } else {
+                    ++ite;
+                }
+            if (changed) table.second->reload();
+        }
+        recountIndexes(std::vector<std::string>(closed.begin(), closed.end()));
+    }
+
+    // numbers of records in indexes are outdated after changes are undone
+    void recountIndexes(const std::vector<std::string>& files) {
+        for (const auto& file: files) {
+            if (boost::filesystem::extension(file) != DBTableManager::INDEX_SUFFIX) continue;
+            DBBLinkIndex<DBFields::Comparator> index(file, log.get());
+            if (index.open()) index.countRecords();
+        }
+    }
+
+    // end transaction of last statement, its commit is left to the session in a session,
+    // and flushed with those after it otherwise
+    // returns 0 if succeed, 1 if log failed, with error written to err
+    bool commitStatement() {
+        if (!log) return 0;
+        const uint64 txn = log->transaction();
+        const uint64 lsn = log->commit();
+        // locks are released before commit is durable,
+        // transactions waiting for them commit after it in log
+        lockManager().release(txn);
+        if (!lsn) return 0;
+        // recovery starts from the last checkpoint completed, if this one fails
+        // writers committing meanwhile leave it to the first of them
+        if (log->checkpointDue()) {
+            std::unique_lock<std::mutex> lock((source? source: this)->checkpoint_mutex, std::try_to_lock);
+            if (lock && log->checkpointDue()) DBRecovery(*log).checkpoint();
+        }
+        commit_lsn = lsn;
+        if (in_session) return 0;
+        if (!group_lsn) {
+            group_lsn = lsn;
+            group_time = std::chrono::steady_clock::now();
+        }
+        if (lsn - group_lsn >= GROUP_COMMIT_SIZE || 
+            std::chrono::steady_clock::now() - group_time >= std::chrono::milliseconds(GROUP_COMMIT_DELAY))
+            return flushCommits();
+        return 0;
+    }
+
     void closeTable(const std::string& table_name) {
         auto ptr = tables_inuse.find(table_name);
         assert(ptr!= tables_inuse.end());
         delete ptr->second;
         tables_inuse.erase(ptr);
         tables_check_constraints.erase(table_name);
+        // compiled conditions of prepared statements may be outdated
+        ++schema_version;
     }
 
-    void closeDBInUse() {
+    void closeTables() {
         for (auto& ptr: tables_inuse) 
             delete ptr.second;
         tables_inuse.clear();
+        tables_check_constraints.clear();
+        ++schema_version;
+    }
+
+    void closeDBInUse() {
+        if (!in_session) flushCommits();
+        // transaction not committed is rolled back
+        if (in_transaction) {
+            in_transaction = 0;
+            rollbackTransaction();
+        }
+        closeTables();
+        // all pages are on disk after tables are closed,
+        // unless transactions of other sessions, or one failed to roll back, are left to recovery
+        if (log && !log->numTransactions()) log->truncate();
+        log.reset();
+        locks.clear();
+        versions.reset();
+        commit_lsn = 0;
         referenced_tables.clear();
         referencing_tables.clear();
-        tables_check_constraints.clear();
         db_inuse.clear();
     }
 
@@ -2151,25 +2979,58 @@ private:
 
 private:
     // member function pointers to parser action
-    typedef int (DBQuery::*ParseFunctions)(const std::string&);
-    constexpr static int kParseFunctions = 15;
-    ParseFunctions parseFunctions[kParseFunctions] = {
-        &DBQuery::parseAsCreateDBStatement,
-        &DBQuery::parseAsDropDBStatement,
-        &DBQuery::parseAsUseDBStatement,
-        &DBQuery::parseAsShowDBStatement,
-        &DBQuery::parseAsCreateTableStatement,
-        &DBQuery::parseAsShowTablesStatement,
-        &DBQuery::parseAsDropTableStatement,
-        &DBQuery::parseAsDescTableStatement,
-        &DBQuery::parseAsCreateIndexStatement,
-        &DBQuery::parseAsDropIndexStatement,
-        &DBQuery::parseAsInsertRecordStatement,
-        &DBQuery::parseAsSimpleSelectStatement,
-        &DBQuery::parseAsDeleteStatement,
-        &DBQuery::parseAsUpdateStatement,
-        &DBQuery::parseAsComplexSelectStatement
-    };
+    typedef int (DBQuery::*ParseFunctions)(const boost::string_ref);
+
+    // get parse functions of statement according to its first one or two words,
+    // so that a statement is parsed only by grammars starting with the same keywords
+    // returns nullptr if no parse function applies
+    const std::vector<ParseFunctions>* dispatchParseFunctions(const boost::string_ref str) const {
+        static const std::unordered_map< std::string, std::vector<ParseFunctions> > parse_functions = {
+            { "create database", { &DBQuery::parseAsCreateDBStatement } },
+            { "create table", { &DBQuery::parseAsCreateTableStatement } },
+            { "create index", { &DBQuery::parseAsCreateIndexStatement } },
+            { "drop database", { &DBQuery::parseAsDropDBStatement } },
+            { "drop table", { &DBQuery::parseAsDropTableStatement } },
+            { "drop index", { &DBQuery::parseAsDropIndexStatement } },
+            { "use", { &DBQuery::parseAsUseDBStatement } },
+            { "show databases", { &DBQuery::parseAsShowDBStatement } },
+            { "show tables", { &DBQuery::parseAsShowTablesStatement } },
+            { "desc", { &DBQuery::parseAsDescTableStatement } },
+            { "describe", { &DBQuery::parseAsDescTableStatement } },
+            { "insert", { &DBQuery::parseAsInsertRecordStatement } },
+            { "select", { &DBQuery::parseAsSimpleSelectStatement, 
+                          &DBQuery::parseAsComplexSelectStatement } },
+            { "delete", { &DBQuery::parseAsDeleteStatement } },
+            { "update", { &DBQuery::parseAsUpdateStatement } },
+            { "load", { &DBQuery::parseAsLoadDataStatement } },
+            { "prepare", { &DBQuery::parseAsPrepareStatement } },
+            { "execute", { &DBQuery::parseAsExecuteStatement } },
+            { "deallocate", { &DBQuery::parseAsDeallocateStatement } },
+            { "begin", { &DBQuery::parseAsBeginStatement } },
+            { "start transaction", { &DBQuery::parseAsBeginStatement } },
+            { "commit", { &DBQuery::parseAsCommitStatement } },
+            { "rollback", { &DBQuery::parseAsRollbackStatement } }
+        };
+
+        std::size_t pos = 0;
+        std::string first = nextWord(str, pos);
+        auto ite = parse_functions.find(first);
+        if (ite != parse_functions.end()) return &ite->second;
+
+        ite = parse_functions.find(first + ' ' + nextWord(str, pos));
+        if (ite != parse_functions.end()) return &ite->second;
+        return nullptr;
+    }
+
+    // get lowercase word starting from pos, skipping leading spaces
+    // pos is moved to the end of word
+    static std::string nextWord(const boost::string_ref str, std::size_t& pos) {
+        while (pos < str.length() && std::isspace(static_cast<unsigned char>(str[pos]))) ++pos;
+        std::string word;
+        for (; pos < str.length() && (std::isalnum(static_cast<unsigned char>(str[pos])) || str[pos] == '_'); ++pos) 
+            word += std::tolower(static_cast<unsigned char>(str[pos]));
+        return word;
+    }
 
     // parsers
     QueryProcess::CreateDBStatementParser createDBStatementParser;
@@ -2187,6 +3048,13 @@ private:
     QueryProcess::DeleteStatementParser deleteStatementParser;
     QueryProcess::UpdateStatementParser updateStatementParser;
     QueryProcess::ComplexSelectStatementParser complexSelectStatementParser;
+    QueryProcess::LoadDataStatementParser loadDataStatementParser;
+    QueryProcess::PrepareStatementParser prepareStatementParser;
+    QueryProcess::ExecuteStatementParser executeStatementParser;
+    QueryProcess::DeallocateStatementParser deallocateStatementParser;
+    QueryProcess::BeginStatementParser beginStatementParser;
+    QueryProcess::CommitStatementParser commitStatementParser;
+    QueryProcess::RollbackStatementParser rollbackStatementParser;
 #ifdef DEBUG
 public:
 #endif
@@ -2205,20 +3073,71 @@ public:
     // referenced table name -> referenced field id, referencing table name, referenced field id
     std::unordered_multimap< std::string, std::tuple<uint64, std::string, uint64> > referenced_tables;
 
-    // tables to save intermediate reuslt
-    // tables will be removed when database is closed
-    std::vector<DBTableManager*> temp_tables;
+    // memory limit of sorting
+    uint64 sort_memory;
+    // export format of select results, max of uint64 means aligned text
+    uint64 output_format;
+    // files of statements are restricted to file_directory, which is canonical, see restrictFiles()
+    bool restrict_files;
+    std::string file_directory;
+
+    // threads scanning tables, nullptr if tables are scanned by calling thread only
+    std::unique_ptr<DBThreadPool> thread_pool;
+
+    // prepared statements by name
+    std::unordered_map<std::string, PreparedStatement> prepared_statements;
+    // increased when tables are closed, since field ids may change
+    uint64 schema_version;
+
+    // write-ahead log of database in use, null if none
+    std::shared_ptr<DBLog> log;
+    // statements are executed in a session
+    bool in_session;
+    // the last commit not flushed, by session when it waits, or by flushCommits()
+    uint64 commit_lsn;
+    // the first commit not flushed out of sessions, and when it's done, 0 if none
+    uint64 group_lsn;
+    std::chrono::steady_clock::time_point group_time;
+    // statements are in a transaction begun by BEGIN
+    bool in_transaction;
+
+    // copies of pages kept for snapshots of database in use, null if none
+    std::unique_ptr<DBVersions> versions;
+    // DBQuery read with snapshot, or whose tables are changed, by this, nullptr if none
+    DBQuery* source;
+    std::unique_ptr<DBVersions::Snapshot> snapshot;
+    // shared by snapshot readers and writers, exclusive when tables are changed or closed
+    boost::shared_mutex snapshot_latch;
+    // shared by each statement of writers, exclusive when a snapshot begins
+    boost::shared_mutex statement_latch;
+    // guards open tables and check constraints, which are opened by snapshot readers too
+    std::mutex tables_mutex;
+    // one checkpoint is taken at a time
+    std::mutex checkpoint_mutex;
+    // writer failed to roll back, database in use is to be closed by source
+    bool close_pending;
+
+    // locks of transactions of sessions on database in use
+    DBLockManager locks;
+    // the last statement executed or session entered waits for locks, of blockers
+    bool lock_waiting;
+    std::vector<uint64> lock_blockers;
 
     // literal parser
     DBFields::LiteralParser literalParser;
+    // parser of unquoted text
+    DBFields::TextParser textParser;
     // min generator
     DBFields::MinGenerator minGenerator;
 
-    // outputer
-    std::ostream& out;
-    std::ostream& err;
+    // outputer, whose stream buffers are switched by sessions
+    mutable std::ostream out;
+    mutable std::ostream err;
 
 };
 
+constexpr Database::uint64 Database::DBQuery::GROUP_COMMIT_SIZE;
+constexpr Database::uint64 Database::DBQuery::GROUP_COMMIT_DELAY;
+constexpr Database::uint64 Database::DBQuery::MAX_SNAPSHOT_UNDO;
 
 #endif /* DB_QUERY_H_ */
@@ -24,6 +24,9 @@ namespace Database{
 namespace QueryProcess {
 using namespace boost::spirit;
 
+// statements are parsed in place from character buffers
+typedef const char* Iterator;
+
 // structs to store match result
 struct CreateDBStatement { std::string db_name; };
 struct DropDBStatement { std::string db_name; };
@@ -40,6 +43,14 @@ struct FullFieldName {
         return table_name + (field_name.length()? ".": "") + field_name;
     }
 };
+struct LimitClause {
+    std::string count;
+    std::string offset;
+};
+struct OutfileClause {
+    std::string path;
+    std::string format;
+};
 struct ComplexCondition {
     FullFieldName left_expr;
     std::string op;
@@ -97,6 +108,8 @@ struct SimpleSelectStatement {
     };
     std::string group_by_field_name;
     OrderByClause order_by;
+    LimitClause limit;
+    OutfileClause outfile;
 };
 struct ComplexSelectStatement {
     struct SelectFieldName {
@@ -112,6 +125,8 @@ struct ComplexSelectStatement {
     };
     OrderByClause order_by;
     FullFieldName group_by_field_name;
+    LimitClause limit;
+    OutfileClause outfile;
 };
         
 struct DeleteStatement {
@@ -127,6 +142,20 @@ struct UpdateStatement {
     std::vector<NewValue> new_values;
     std::vector<SimpleCondition> conditions;
 };
+struct LoadDataStatement {
+    std::string path;
+    std::string table_name;
+    std::string format;
+};
+struct PrepareStatement {
+    std::string name;
+    std::string statement;
+};
+struct ExecuteStatement {
+    std::string name;
+    std::vector<std::string> values;
+};
+struct DeallocateStatement { std::string name; };
 
 // keyword symbols set
 struct Keyword_symbols: qi::symbols<> {
@@ -141,26 +170,34 @@ struct Keyword_symbols: qi::symbols<> {
            ("create")
            ("database")
            ("databases")
+           ("deallocate")
            ("delete")
            ("desc")
            ("describe")
            ("drop")
+           ("execute")
            ("false")
            ("foreign")
            ("from")
            ("group")
            ("index")
+           ("infile")
            ("insert")
            ("into")
            ("is")
            ("key")
            ("like")
+           ("load")
+           ("limit")
            ("min")
            ("max")
            ("not")
            ("null")
+           ("offset")
            ("on")
            ("order")
+           ("outfile")
+           ("prepare")
            ("primary")
            ("references")
            ("select")
@@ -174,6 +211,7 @@ struct Keyword_symbols: qi::symbols<> {
            ("unsigned")
            ("update")
            ("use")
+           ("using")
            ("values")
            ("where")
         ;
@@ -221,76 +259,143 @@ struct Aggregate: qi::symbols<char, std::string> {
     }
 };
 
+struct Format: qi::symbols<char, std::string> {
+    Format() {
+        add("binary", "binary")
+           ("csv", "csv")
+           ("tsv", "tsv")
+          ;
+    }
+};
+
+// formats of text files, which can be loaded
+struct TextFormat: qi::symbols<char, std::string> {
+    TextFormat() {
+        add("csv", "csv")
+           ("tsv", "tsv")
+          ;
+    }
+};
+
+// orders of ORDER BY, in lower case whatever case they're written in
+struct Order: qi::symbols<char, std::string> {
+    Order() {
+        add("asc", "asc")
+           ("desc", "desc")
+          ;
+    }
+};
+
 // definition of datatype
-const qi::rule<std::string::const_iterator, std::string()> datatypes =
+const qi::rule<Iterator, std::string()> datatypes =
     repository::distinct(qi::alnum | qi::char_('_'))[qi::no_case[Datatype_symbols()]];
 
 // definition of keywords
-const qi::rule<std::string::const_iterator> keywords = 
+const qi::rule<Iterator> keywords = 
     repository::distinct(qi::alnum | qi::char_('_'))[qi::no_case[Keyword_symbols()]];
 
 // definition of sql identifier
-const qi::rule<std::string::const_iterator, std::string()> sql_identifier = 
+const qi::rule<Iterator, std::string()> sql_identifier = 
     lexeme[(qi::alpha | qi::char_('_')) >> *(qi::alnum | qi::char_('_'))] - keywords - datatypes;
 
 // definition of full field name
-const qi::rule<std::string::const_iterator, FullFieldName(), qi::space_type> full_field_name = 
+const qi::rule<Iterator, FullFieldName(), qi::space_type> full_field_name = 
     lexeme[sql_identifier >> '.' >> sql_identifier];
 
 // definition of numeric, integer and float
-const qi::rule<std::string::const_iterator, std::string(), qi::space_type> sql_float  =
+const qi::rule<Iterator, std::string(), qi::space_type> sql_float  =
     lexeme[-(qi::char_("+-")) >> 
         ((+qi::digit >> -(qi::char_('.') >> *qi::digit)) | 
          (qi::char_('.') >> +qi::digit))];
 
 // definition of string with single quotes
-const qi::rule<std::string::const_iterator, std::string(), qi::space_type> sql_string  =
+const qi::rule<Iterator, std::string(), qi::space_type> sql_string  =
     lexeme[qi::char_('\'') >> *(~qi::char_("\\\'") | ('\\' >> qi::char_)) >> qi::char_('\'')];
 
 // definition of not null and null
-const qi::rule<std::string::const_iterator, std::string(), qi::space_type> sql_null = 
+const qi::rule<Iterator, std::string(), qi::space_type> sql_null = 
     qi::as_string[qi::no_case["null"]];
-const qi::rule<std::string::const_iterator, std::string(), qi::space_type> sql_not = 
+const qi::rule<Iterator, std::string(), qi::space_type> sql_not = 
     qi::as_string[qi::no_case["not"]];
-const qi::rule<std::string::const_iterator, std::string(), qi::space_type> sql_notnull = 
+const qi::rule<Iterator, std::string(), qi::space_type> sql_notnull = 
     sql_not >> qi::no_skip[+qi::space] >> sql_null;
 
-// definition of like and not like 
-const qi::rule<std::string::const_iterator, std::string(), qi::space_type> sql_like = 
-    qi::as_string[qi::no_case["like"]];
-const qi::rule<std::string::const_iterator, std::string(), qi::space_type> sql_notlike = 
-    sql_not >> qi::no_skip[+qi::space] >> sql_like;
+// definition of like and not like, normalized to lower case
+const qi::rule<Iterator, std::string(), qi::space_type> sql_like = 
+    qi::no_case["like"] >> qi::attr(std::string("like"));
+const qi::rule<Iterator, std::string(), qi::space_type> sql_notlike = 
+    qi::no_case["not"] >> omit[no_skip[+qi::space]] >> 
+    qi::no_case["like"] >> qi::attr(std::string("not like"));
 
 // definition of bool, true and false
-const qi::rule<std::string::const_iterator, std::string(), qi::space_type> sql_bool = 
+const qi::rule<Iterator, std::string(), qi::space_type> sql_bool = 
     qi::as_string[qi::no_case["false"]] | qi::as_string[qi::no_case["true"]];
 
+// null, not null, true and false in conditions, normalized to lower case
+// values elsewhere are kept as they are written, for error info
+const qi::rule<Iterator, std::string(), qi::space_type> cond_null = 
+    qi::no_case["null"] >> qi::attr(std::string("null"));
+const qi::rule<Iterator, std::string(), qi::space_type> cond_notnull = 
+    qi::no_case["not"] >> omit[no_skip[+qi::space]] >> 
+    qi::no_case["null"] >> qi::attr(std::string("not null"));
+const qi::rule<Iterator, std::string(), qi::space_type> cond_bool = 
+    (qi::no_case["false"] >> qi::attr(std::string("false"))) | 
+    (qi::no_case["true"] >> qi::attr(std::string("true")));
+
 // definition of sql operators
-const qi::rule<std::string::const_iterator, std::string(), qi::space_type> sql_operators = 
+const qi::rule<Iterator, std::string(), qi::space_type> sql_operators = 
     qi::no_case[Operator()] | sql_like | sql_notlike;
 
 // definition of aggregate funtions
-const qi::rule<std::string::const_iterator, std::string(), qi::space_type> sql_aggregate_functions = 
+const qi::rule<Iterator, std::string(), qi::space_type> sql_aggregate_functions = 
     qi::no_case[Aggregate()];
 
+// limit clause
+// LIMIT <count> [OFFSET <offset>]
+const qi::rule<Iterator, LimitClause(), qi::space_type> limit_clause = 
+    qi::no_case["limit"] >> 
+    omit[no_skip[+qi::space]] >> 
+    lexeme[+qi::digit] >>
+    ((qi::no_case["offset"] >> omit[no_skip[+qi::space]] >> lexeme[+qi::digit]) |
+     qi::attr(std::string()));
+
+// definition of file path with single quotes, quotes are excluded
+const qi::rule<Iterator, std::string(), qi::space_type> sql_path = 
+    lexeme['\'' >> +(~qi::char_('\'')) >> '\''];
+
+// outfile clause
+// INTO OUTFILE '<path>' [FORMAT CSV | TSV | BINARY]
+const qi::rule<Iterator, OutfileClause(), qi::space_type> outfile_clause = 
+    qi::no_case["into"] >> 
+    omit[no_skip[+qi::space]] >> 
+    qi::no_case["outfile"] >> 
+    sql_path >>
+    ((qi::no_case["format"] >> omit[no_skip[+qi::space]] >> 
+      qi::no_case[Format()]) |
+     qi::attr(std::string()));
+
+// placeholder of value in prepared statement
+const qi::rule<Iterator, std::string(), qi::space_type> sql_placeholder = 
+    qi::string("?");
+
 // simple condition
 // left_expr operator right_expr
 // OR true(false)
-const qi::rule<std::string::const_iterator, SimpleCondition(), qi::space_type> simple_condition =
+const qi::rule<Iterator, SimpleCondition(), qi::space_type> simple_condition =
     // true or false
-    (sql_bool >> qi::attr(std::string()) >> qi::attr(std::string())) |
+    (cond_bool >> qi::attr(std::string()) >> qi::attr(std::string())) |
     // left expr
-    ((sql_identifier | sql_string | sql_float | sql_null | sql_notnull | sql_bool) >>
+    ((sql_identifier | sql_string | sql_float | cond_null | cond_notnull | cond_bool) >>
     // op
      sql_operators >>
     // right expr
-     (sql_identifier | sql_string | sql_float | sql_null | sql_notnull | sql_bool));
+     (sql_identifier | sql_string | sql_float | cond_null | cond_notnull | cond_bool | sql_placeholder));
 
 // complex condition
 // left_expr operator right_expr
-const qi::rule<std::string::const_iterator, ComplexCondition(), qi::space_type> complex_condition =
+const qi::rule<Iterator, ComplexCondition(), qi::space_type> complex_condition =
     // true or false
-    (qi::as<FullFieldName>()[sql_bool >> qi::attr(std::string())] >> qi::attr(std::string()) >> qi::attr(FullFieldName())) |
+    (qi::as<FullFieldName>()[cond_bool >> qi::attr(std::string())] >> qi::attr(std::string()) >> qi::attr(FullFieldName())) |
     (
      // tablename.fieldname
      full_field_name >> 
@@ -299,12 +404,12 @@ const qi::rule<std::string::const_iterator, ComplexCondition(), qi::space_type>
      // tablebane.fieldname
      (full_field_name | 
      // literal
-      ((sql_float | sql_string | sql_null | sql_notnull | sql_bool) >> qi::attr(std::string()))
+      ((sql_float | sql_string | cond_null | cond_notnull | cond_bool) >> qi::attr(std::string()))
      )
     );
 
 // parser of "CREATE DATABASE <database name>"
-struct CreateDBStatementParser: qi::grammar<std::string::const_iterator, CreateDBStatement(), qi::space_type> {
+struct CreateDBStatementParser: qi::grammar<Iterator, CreateDBStatement(), qi::space_type> {
     CreateDBStatementParser(): CreateDBStatementParser::base_type(start) {
         start = qi::no_case["create"] >>
                 omit[no_skip[+qi::space]] >> 
@@ -315,11 +420,11 @@ struct CreateDBStatementParser: qi::grammar<std::string::const_iterator, CreateD
                 qi::eoi;
     }
 private:
-    qi::rule<std::string::const_iterator, CreateDBStatement(), qi::space_type> start;
+    qi::rule<Iterator, CreateDBStatement(), qi::space_type> start;
 };
 
 // parser of "DROP DATABASE <database name>"
-struct DropDBStatementParser: qi::grammar<std::string::const_iterator, DropDBStatement(), qi::space_type> {
+struct DropDBStatementParser: qi::grammar<Iterator, DropDBStatement(), qi::space_type> {
     DropDBStatementParser(): DropDBStatementParser::base_type(start) {
         start = qi::no_case["drop"] >> 
                 omit[no_skip[+qi::space]] >> 
@@ -330,11 +435,11 @@ struct DropDBStatementParser: qi::grammar<std::string::const_iterator, DropDBSta
                 qi::eoi;
     }
 private:
-    qi::rule<std::string::const_iterator, DropDBStatement(), qi::space_type> start;
+    qi::rule<Iterator, DropDBStatement(), qi::space_type> start;
 };
 
 // parser of "USE DATABASE <database name>"
-struct UseDBStatementParser: qi::grammar<std::string::const_iterator, UseDBStatement(), qi::space_type> {
+struct UseDBStatementParser: qi::grammar<Iterator, UseDBStatement(), qi::space_type> {
     UseDBStatementParser(): UseDBStatementParser::base_type(start) {
         start = qi::no_case["use"] >>
                 omit[no_skip[+qi::space]] >>
@@ -343,11 +448,11 @@ struct UseDBStatementParser: qi::grammar<std::string::const_iterator, UseDBState
                 qi::eoi;
     }
 private:
-    qi::rule<std::string::const_iterator, UseDBStatement(), qi::space_type> start;
+    qi::rule<Iterator, UseDBStatement(), qi::space_type> start;
 };
 
 // parser of "SHOW DATABSES"
-struct ShowDBStatementParser: qi::grammar<std::string::const_iterator, unused_type, qi::space_type> {
+struct ShowDBStatementParser: qi::grammar<Iterator, unused_type, qi::space_type> {
     ShowDBStatementParser(): ShowDBStatementParser::base_type(start) {
         start = qi::no_case["show"] >>
                 omit[no_skip[+qi::space]] >>
@@ -355,14 +460,14 @@ struct ShowDBStatementParser: qi::grammar<std::string::const_iterator, unused_ty
                 ';';
     }
 private:
-    qi::rule<std::string::const_iterator, unused_type, qi::space_type> start;
+    qi::rule<Iterator, unused_type, qi::space_type> start;
 };
 
 // parser of 
 // "CREATE TABLE <table name> (<field name> <type>[(<size>)] [NOT NULL] 
 //                          [, <filed name> <type>[(<size>)] [NOT NULL]]* 
 //                          [, PRIMARY KEY (<field name>)]); "
-struct CreateTableStatementParser: qi::grammar<std::string::const_iterator, CreateTableStatement(), qi::space_type> {
+struct CreateTableStatementParser: qi::grammar<Iterator, CreateTableStatement(), qi::space_type> {
     CreateTableStatementParser(): CreateTableStatementParser::base_type(start) {
         start = 
                 // create
@@ -434,15 +539,15 @@ struct CreateTableStatementParser: qi::grammar<std::string::const_iterator, Crea
     }
 
 private:
-    qi::rule<std::string::const_iterator, CreateTableStatement::ForeignKeyConstraint(), qi::space_type> foreign_key_constraint;
-    qi::rule<std::string::const_iterator, std::vector<SimpleCondition>(), qi::space_type> check_constraint;
-    qi::rule<std::string::const_iterator, std::string(), qi::space_type> primary_key;
-    qi::rule<std::string::const_iterator, CreateTableStatement::FieldDesc(), qi::space_type> field_desc;
-    qi::rule<std::string::const_iterator, CreateTableStatement(), qi::space_type> start;
+    qi::rule<Iterator, CreateTableStatement::ForeignKeyConstraint(), qi::space_type> foreign_key_constraint;
+    qi::rule<Iterator, std::vector<SimpleCondition>(), qi::space_type> check_constraint;
+    qi::rule<Iterator, std::string(), qi::space_type> primary_key;
+    qi::rule<Iterator, CreateTableStatement::FieldDesc(), qi::space_type> field_desc;
+    qi::rule<Iterator, CreateTableStatement(), qi::space_type> start;
 };
 
 // parser of "SHOW TABLES"
-struct ShowTablesStatementParser: qi::grammar<std::string::const_iterator, unused_type, qi::space_type> {
+struct ShowTablesStatementParser: qi::grammar<Iterator, unused_type, qi::space_type> {
     ShowTablesStatementParser(): ShowTablesStatementParser::base_type(start) {
         start = qi::no_case["show"] >>
                 omit[no_skip[+qi::space]] >>
@@ -451,11 +556,11 @@ struct ShowTablesStatementParser: qi::grammar<std::string::const_iterator, unuse
                 qi::eoi;
     }
 private:
-    qi::rule<std::string::const_iterator, unused_type, qi::space_type> start;
+    qi::rule<Iterator, unused_type, qi::space_type> start;
 };
 
 // parser of "DROP DATABASE <database name>"
-struct DropTableStatementParser: qi::grammar<std::string::const_iterator, DropTableStatement(), qi::space_type> {
+struct DropTableStatementParser: qi::grammar<Iterator, DropTableStatement(), qi::space_type> {
     DropTableStatementParser(): DropTableStatementParser::base_type(start) {
         start = qi::no_case["drop"] >> 
                 omit[no_skip[+qi::space]] >> 
@@ -466,11 +571,11 @@ struct DropTableStatementParser: qi::grammar<std::string::const_iterator, DropTa
                 qi::eoi;
     }
 private:
-    qi::rule<std::string::const_iterator, DropTableStatement(), qi::space_type> start;
+    qi::rule<Iterator, DropTableStatement(), qi::space_type> start;
 };
 
 // parser of "DESC[RIBE] <table name>"
-struct DescTableStatementParser: qi::grammar<std::string::const_iterator, DescTableStatement(), qi::space_type> {
+struct DescTableStatementParser: qi::grammar<Iterator, DescTableStatement(), qi::space_type> {
     DescTableStatementParser(): DescTableStatementParser::base_type(start) {
         start = qi::no_case["desc"] >>
                 // DESC or DESCRIBE
@@ -481,11 +586,11 @@ struct DescTableStatementParser: qi::grammar<std::string::const_iterator, DescTa
                 qi::eoi;
     }
 private:
-    qi::rule<std::string::const_iterator, DescTableStatement(), qi::space_type> start;
+    qi::rule<Iterator, DescTableStatement(), qi::space_type> start;
 };
 
 // parser of "CREATE INDEX ON <table name> ( <field name> );"
-struct CreateIndexStatementParser: qi::grammar<std::string::const_iterator, CreateIndexStatement(), qi::space_type> {
+struct CreateIndexStatementParser: qi::grammar<Iterator, CreateIndexStatement(), qi::space_type> {
     CreateIndexStatementParser(): CreateIndexStatementParser::base_type(start) {
         start = qi::no_case["create"] >>
                 omit[no_skip[+qi::space]] >>
@@ -501,11 +606,11 @@ struct CreateIndexStatementParser: qi::grammar<std::string::const_iterator, Crea
                 qi::eoi;
     }
 private:
-    qi::rule<std::string::const_iterator, CreateIndexStatement(), qi::space_type> start;
+    qi::rule<Iterator, CreateIndexStatement(), qi::space_type> start;
 };
 
 // parser of "DROP INDEX ON <table name> ( <field name> );"
-struct DropIndexStatementParser: qi::grammar<std::string::const_iterator, DropIndexStatement(), qi::space_type> {
+struct DropIndexStatementParser: qi::grammar<Iterator, DropIndexStatement(), qi::space_type> {
     DropIndexStatementParser(): DropIndexStatementParser::base_type(start) {
         start = qi::no_case["drop"] >>
                 omit[no_skip[+qi::space]] >>
@@ -521,13 +626,13 @@ struct DropIndexStatementParser: qi::grammar<std::string::const_iterator, DropIn
                 qi::eoi;
     }
 private:
-    qi::rule<std::string::const_iterator, DropIndexStatement(), qi::space_type> start;
+    qi::rule<Iterator, DropIndexStatement(), qi::space_type> start;
 };
 
 
 // parser of "INSERT INTO <table name> VALUES (<value> [, <value>]*)
 //                                          (, <value> [, <value>]*);
-struct InsertRecordStatementParser: qi::grammar<std::string::const_iterator, InsertRecordStatement(), qi::space_type> {
+struct InsertRecordStatementParser: qi::grammar<Iterator, InsertRecordStatement(), qi::space_type> {
     InsertRecordStatementParser(): InsertRecordStatementParser::base_type(start) {
         start = qi::no_case["insert"] >>
                 omit[no_skip[+qi::space]] >>
@@ -540,18 +645,20 @@ struct InsertRecordStatementParser: qi::grammar<std::string::const_iterator, Ins
                 qi::eoi;
         value_tuple = 
                 '(' >>
-                (sql_string | sql_float | sql_null | sql_bool) % ',' >>
+                (sql_string | sql_float | sql_null | sql_bool | sql_placeholder) % ',' >>
                 ')';
 
     }
 private:
-    qi::rule<std::string::const_iterator, InsertRecordStatement::ValueTuple(), qi::space_type> value_tuple;
-    qi::rule<std::string::const_iterator, InsertRecordStatement(), qi::space_type> start;
+    qi::rule<Iterator, InsertRecordStatement::ValueTuple(), qi::space_type> value_tuple;
+    qi::rule<Iterator, InsertRecordStatement(), qi::space_type> start;
 };
 
-// parser of SELECT <field name> [, <field name>]* FROM <table name> [WHERE <condition>];
-//           SELECT * FROM <table name> [WHERE <condition>];
-struct SimpleSelectStatementParser: qi::grammar<std::string::const_iterator, SimpleSelectStatement(), qi::space_type> {
+// parser of SELECT <field name> [, <field name>]* FROM <table name> [WHERE <condition>] [LIMIT <count> [OFFSET <offset>]]
+//           [INTO OUTFILE '<path>' [FORMAT <format>]];
+//           SELECT * FROM <table name> [WHERE <condition>] [LIMIT <count> [OFFSET <offset>]]
+//           [INTO OUTFILE '<path>' [FORMAT <format>]];
+struct SimpleSelectStatementParser: qi::grammar<Iterator, SimpleSelectStatement(), qi::space_type> {
     SimpleSelectStatementParser(): SimpleSelectStatementParser::base_type(start) {
         start = qi::no_case["select"] >>
                 omit[no_skip[+qi::space]] >>
@@ -567,6 +674,8 @@ struct SimpleSelectStatementParser: qi::grammar<std::string::const_iterator, Sim
                     omit[no_skip[+qi::space]]))) >>
                 (group_by | qi::attr(std::string())) >>
                 (order_by | qi::attr(SimpleSelectStatement::OrderByClause())) >>
+                (limit_clause | qi::attr(LimitClause())) >>
+                (outfile_clause | qi::attr(OutfileClause())) >>
                 ';' >>
                 qi::eoi;
         
@@ -584,19 +693,20 @@ struct SimpleSelectStatementParser: qi::grammar<std::string::const_iterator, Sim
                    qi::no_case["by"] >>
                    omit[no_skip[+qi::space]] >>
                    sql_identifier >> 
-                   (qi::as_string[qi::no_case["asc"]] | qi::as_string[qi::no_case["desc"]] | qi::attr(std::string()));
+                   (qi::no_case[Order()] | qi::attr(std::string()));
         
     }
 private:
-    qi::rule<std::string::const_iterator, SimpleSelectStatement::SelectFieldName(), qi::space_type> field_name;
-    qi::rule<std::string::const_iterator, std::string(), qi::space_type> group_by;
-    qi::rule<std::string::const_iterator, SimpleSelectStatement(), qi::space_type> start;
-    qi::rule<std::string::const_iterator, SimpleSelectStatement::OrderByClause(), qi::space_type> order_by;
+    qi::rule<Iterator, SimpleSelectStatement::SelectFieldName(), qi::space_type> field_name;
+    qi::rule<Iterator, std::string(), qi::space_type> group_by;
+    qi::rule<Iterator, SimpleSelectStatement(), qi::space_type> start;
+    qi::rule<Iterator, SimpleSelectStatement::OrderByClause(), qi::space_type> order_by;
 };
 
 // parser of SELECT <table name>.<field name> [, <table name>.<field name>]* 
-//           FROM <table name> [, <table name>] [WHERE <condition>];
-struct ComplexSelectStatementParser: qi::grammar<std::string::const_iterator, ComplexSelectStatement(), qi::space_type> {
+//           FROM <table name> [, <table name>] [WHERE <condition>] [LIMIT <count> [OFFSET <offset>]]
+//           [INTO OUTFILE '<path>' [FORMAT <format>]];
+struct ComplexSelectStatementParser: qi::grammar<Iterator, ComplexSelectStatement(), qi::space_type> {
     ComplexSelectStatementParser(): ComplexSelectStatementParser::base_type(start) {
         start = qi::no_case["select"] >>
                 omit[no_skip[+qi::space]] >>
@@ -614,6 +724,8 @@ struct ComplexSelectStatementParser: qi::grammar<std::string::const_iterator, Co
                 
                 (group_by | qi::attr(FullFieldName())) >>
                 (order_by | qi::attr(ComplexSelectStatement::OrderByClause())) >>
+                (limit_clause | qi::attr(LimitClause())) >>
+                (outfile_clause | qi::attr(OutfileClause())) >>
                 ';' >>
                 qi::eoi;
         
@@ -635,18 +747,18 @@ struct ComplexSelectStatementParser: qi::grammar<std::string::const_iterator, Co
                    qi::no_case["by"] >>
                    omit[no_skip[+qi::space]] >>
                    full_field_name >> 
-                   (qi::as_string[qi::no_case["asc"]] | qi::as_string[qi::no_case["desc"]] | qi::attr(std::string()));
+                   (qi::no_case[Order()] | qi::attr(std::string()));
         
     }
 private:
-    qi::rule<std::string::const_iterator, ComplexSelectStatement::SelectFieldName(), qi::space_type> field_name;
-    qi::rule<std::string::const_iterator, FullFieldName(), qi::space_type> group_by;
-    qi::rule<std::string::const_iterator, ComplexSelectStatement(), qi::space_type> start;
-    qi::rule<std::string::const_iterator, ComplexSelectStatement::OrderByClause(), qi::space_type> order_by;
+    qi::rule<Iterator, ComplexSelectStatement::SelectFieldName(), qi::space_type> field_name;
+    qi::rule<Iterator, FullFieldName(), qi::space_type> group_by;
+    qi::rule<Iterator, ComplexSelectStatement(), qi::space_type> start;
+    qi::rule<Iterator, ComplexSelectStatement::OrderByClause(), qi::space_type> order_by;
 };
 
 // parser of DELETE FROM <table name> [WHERE <conditoon>];
-struct DeleteStatementParser: qi::grammar<std::string::const_iterator, DeleteStatement(), qi::space_type> {
+struct DeleteStatementParser: qi::grammar<Iterator, DeleteStatement(), qi::space_type> {
     DeleteStatementParser(): DeleteStatementParser::base_type(start) {
         start = qi::no_case["delete"] >>
                 omit[no_skip[+qi::space]] >>
@@ -663,13 +775,13 @@ struct DeleteStatementParser: qi::grammar<std::string::const_iterator, DeleteSta
                 qi::eoi;
     }
 private:
-    qi::rule<std::string::const_iterator, DeleteStatement(), qi::space_type> start;
+    qi::rule<Iterator, DeleteStatement(), qi::space_type> start;
 };
 
 // parser of UPDATE <table name> SET <field name> = <new value> 
 //                                [, <field name> = <new value>]* 
 //           WHERE <condition>;
-struct UpdateStatementParser: qi::grammar<std::string::const_iterator, UpdateStatement(), qi::space_type> {
+struct UpdateStatementParser: qi::grammar<Iterator, UpdateStatement(), qi::space_type> {
     UpdateStatementParser(): UpdateStatementParser::base_type(start) {
         start = qi::no_case["update"] >>
                 omit[no_skip[+qi::space]] >>
@@ -686,13 +798,121 @@ struct UpdateStatementParser: qi::grammar<std::string::const_iterator, UpdateSta
                 qi::eoi;
         new_value = sql_identifier >> 
                     '=' >>
-                    (sql_string | sql_float | sql_null | sql_notnull | sql_bool);
+                    (sql_string | sql_float | sql_null | sql_notnull | sql_bool | sql_placeholder);
+    }
+private:
+    qi::rule<Iterator, UpdateStatement::NewValue(), qi::space_type> new_value;
+    qi::rule<Iterator, UpdateStatement(), qi::space_type> start;
+};
+
+// parser of LOAD DATA INFILE '<path>' INTO TABLE <table name> [FORMAT <format>];
+struct LoadDataStatementParser: qi::grammar<Iterator, LoadDataStatement(), qi::space_type> {
+    LoadDataStatementParser(): LoadDataStatementParser::base_type(start) {
+        start = qi::no_case["load"] >>
+                omit[no_skip[+qi::space]] >>
+                qi::no_case["data"] >>
+                omit[no_skip[+qi::space]] >>
+                qi::no_case["infile"] >>
+                sql_path >>
+                qi::no_case["into"] >>
+                omit[no_skip[+qi::space]] >>
+                qi::no_case["table"] >>
+                omit[no_skip[+qi::space]] >>
+                sql_identifier >>
+                ((qi::no_case["format"] >> omit[no_skip[+qi::space]] >> qi::no_case[TextFormat()]) |
+                 qi::attr(std::string())) >>
+                ';' >>
+                qi::eoi;
+    }
+private:
+    qi::rule<Iterator, LoadDataStatement(), qi::space_type> start;
+};
+
+// parser of PREPARE <statement name> AS <statement>
+// statement is not parsed here
+struct PrepareStatementParser: qi::grammar<Iterator, PrepareStatement(), qi::space_type> {
+    PrepareStatementParser(): PrepareStatementParser::base_type(start) {
+        start = qi::no_case["prepare"] >>
+                omit[no_skip[+qi::space]] >>
+                sql_identifier >>
+                omit[no_skip[+qi::space]] >>
+                qi::no_case["as"] >>
+                omit[no_skip[+qi::space]] >>
+                lexeme[+qi::char_] >>
+                qi::eoi;
+    }
+private:
+    qi::rule<Iterator, PrepareStatement(), qi::space_type> start;
+};
+
+// parser of EXECUTE <statement name> [USING <value> [, <value>]*];
+struct ExecuteStatementParser: qi::grammar<Iterator, ExecuteStatement(), qi::space_type> {
+    ExecuteStatementParser(): ExecuteStatementParser::base_type(start) {
+        start = qi::no_case["execute"] >>
+                omit[no_skip[+qi::space]] >>
+                sql_identifier >>
+                -(qi::no_case["using"] >>
+                  omit[no_skip[+qi::space]] >>
+                  ((sql_string | sql_float | sql_null | sql_bool) % ',')) >>
+                ';' >>
+                qi::eoi;
+    }
+private:
+    qi::rule<Iterator, ExecuteStatement(), qi::space_type> start;
+};
+
+// parser of DEALLOCATE [PREPARE] <statement name>;
+struct DeallocateStatementParser: qi::grammar<Iterator, DeallocateStatement(), qi::space_type> {
+    DeallocateStatementParser(): DeallocateStatementParser::base_type(start) {
+        start = qi::no_case["deallocate"] >>
+                omit[no_skip[+qi::space]] >>
+                -(qi::no_case["prepare"] >> omit[no_skip[+qi::space]]) >>
+                sql_identifier >>
+                ';' >>
+                qi::eoi;
+    }
+private:
+    qi::rule<Iterator, DeallocateStatement(), qi::space_type> start;
+};
+
+// parser of BEGIN [WORK]; or START TRANSACTION;
+struct BeginStatementParser: qi::grammar<Iterator, unused_type, qi::space_type> {
+    BeginStatementParser(): BeginStatementParser::base_type(start) {
+        start = ((qi::no_case["begin"] >> 
+                  -(omit[no_skip[+qi::space]] >> qi::no_case["work"])) |
+                 (qi::no_case["start"] >>
+                  omit[no_skip[+qi::space]] >>
+                  qi::no_case["transaction"])) >>
+                ';' >>
+                qi::eoi;
+    }
+private:
+    qi::rule<Iterator, unused_type, qi::space_type> start;
+};
+
+// parser of COMMIT [WORK];
+struct CommitStatementParser: qi::grammar<Iterator, unused_type, qi::space_type> {
+    CommitStatementParser(): CommitStatementParser::base_type(start) {
+        start = qi::no_case["commit"] >>
+                -(omit[no_skip[+qi::space]] >> qi::no_case["work"]) >>
+                ';' >>
+                qi::eoi;
     }
 private:
-    qi::rule<std::string::const_iterator, UpdateStatement::NewValue(), qi::space_type> new_value;
-    qi::rule<std::string::const_iterator, UpdateStatement(), qi::space_type> start;
+    qi::rule<Iterator, unused_type, qi::space_type> start;
 };
 
+// parser of ROLLBACK [WORK];
+struct RollbackStatementParser: qi::grammar<Iterator, unused_type, qi::space_type> {
+    RollbackStatementParser(): RollbackStatementParser::base_type(start) {
+        start = qi::no_case["rollback"] >>
+                -(omit[no_skip[+qi::space]] >> qi::no_case["work"]) >>
+                ';' >>
+                qi::eoi;
+    }
+private:
+    qi::rule<Iterator, unused_type, qi::space_type> start;
+};
 
 } // namespace QueryProcess
 } // namespace Database
@@ -755,10 +975,26 @@ BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::SimpleSelectStatement,
                           (std::string, table_name)
                           (std::vector< ::Database::QueryProcess::SimpleCondition >, conditions)
                           (std::string, group_by_field_name)
-                          (::Database::QueryProcess::SimpleSelectStatement::OrderByClause, order_by))
+                          (::Database::QueryProcess::SimpleSelectStatement::OrderByClause, order_by)
+                          (::Database::QueryProcess::LimitClause, limit)
+                          (::Database::QueryProcess::OutfileClause, outfile))
 BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::FullFieldName,
                           (std::string, table_name)
                           (std::string, field_name))
+BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::LimitClause,
+                          (std::string, count)
+                          (std::string, offset))
+BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::OutfileClause,
+                          (std::string, path)
+                          (std::string, format))
+BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::PrepareStatement,
+                          (std::string, name)
+                          (std::string, statement))
+BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::ExecuteStatement,
+                          (std::string, name)
+                          (std::vector<std::string>, values))
+BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::DeallocateStatement,
+                          (std::string, name))
 BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::ComplexCondition,
                           (::Database::QueryProcess::FullFieldName, left_expr)
                           (std::string, op)
@@ -774,7 +1010,9 @@ BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::ComplexSelectStatement,
                           (std::vector<std::string>, table_names)
                           (std::vector< ::Database::QueryProcess::ComplexCondition >, conditions)
                           (::Database::QueryProcess::FullFieldName, group_by_field_name)
-                          (::Database::QueryProcess::ComplexSelectStatement::OrderByClause, order_by))
+                          (::Database::QueryProcess::ComplexSelectStatement::OrderByClause, order_by)
+                          (::Database::QueryProcess::LimitClause, limit)
+                          (::Database::QueryProcess::OutfileClause, outfile))
 BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::DeleteStatement,
                           (std::string, table_name)
                           (std::vector< ::Database::QueryProcess::SimpleCondition >, conditions))
@@ -785,6 +1023,10 @@ BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::UpdateStatement,
                           (std::string, table_name)
                           (std::vector< ::Database::QueryProcess::UpdateStatement::NewValue >, new_values)
                           (std::vector< ::Database::QueryProcess::SimpleCondition >, conditions))
+BOOST_FUSION_ADAPT_STRUCT(::Database::QueryProcess::LoadDataStatement,
+                          (std::string, path)
+                          (std::string, table_name)
+                          (std::string, format))
 
 
 #endif /* DB_QUERY_ANALYSER_H_ */
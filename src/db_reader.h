@@ -0,0 +1,188 @@
+/******************************************************************************
+ *  Copyright (c) 2014-2015 Jamis Hoo
+ *  Distributed under the MIT license
+ *  (See accompanying file LICENSE or copy at http://opensource.org/licenses/MIT)
+ *
+ *  Project: Database
+ *  Filename: db_reader.h
+ *  Version: 1.0
+ *  Author: Jamis Hoo
+ *  E-mail: hjm211324@gmail.com
+ *  Description: Reader of delimited text files, CSV or TSV.
+ *               File is read in large blocks, fields are scanned with memchr.
+ *****************************************************************************/
+#ifndef DB_READER_H_
+#define DB_READER_H_
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <vector>
+#include "db_common.h"
+
+// CSV: fields separated by ',', quoted by '"' with "" as a quote,
+//      empty unquoted field is NULL
+// TSV: fields separated by '\t', '\t', '\n', '\r' and '\\' escaped by '\\',
+//      \N is NULL
+// "\r\n" line endings are accepted, empty lines are skipped
+class Database::DelimitedReader {
+public:
+    struct Field {
+        std::string value;
+        bool null;
+    };
+
+    // size of block read from file at once
+    static constexpr uint64 BLOCK_SIZE = 1 << 20;
+
+    // csv is 1 if reading CSV, 0 if TSV
+    DelimitedReader(std::istream& in, const bool csv):
+        _in(in), _csv(csv), _delimiter(csv? ',': '\t'),
+        _buffer(new char[BLOCK_SIZE]), _pos(0), _end(0), _line(0) { }
+
+    ~DelimitedReader() { delete[] _buffer; }
+
+    DelimitedReader(const DelimitedReader&) = delete;
+    DelimitedReader& operator=(const DelimitedReader&) = delete;
+
+    // read fields of next record, fields are reused to avoid allocation
+    // returns 0 if succeed
+    // returns 1 if there's no more record
+    // returns 2 if record is malformed
+    int next(std::vector<Field>& fields) {
+        // skip empty lines
+        while (true) {
+            if (!available()) return 1;
+            if (_buffer[_pos] == '\n') {
+                ++_pos;
+                ++_line;
+            } else if (_buffer[_pos] == '\r') {
+                ++_pos;
+            } else break;
+        }
+        ++_line;
+
+        uint64 num_fields = 0;
+        while (true) {
+            if (num_fields == fields.size()) fields.emplace_back();
+            Field& field = fields[num_fields++];
+            field.value.clear();
+            field.null = 0;
+
+            if (_csv && available() && _buffer[_pos] == '"') {
+                if (readQuoted(field.value)) return 2;
+            } else {
+                readPlain(field.value);
+                if (_csv) {
+                    field.null = field.value.empty();
+                } else if (field.value == "\\N") {
+                    field.null = 1;
+                } else if (field.value.find('\\') != std::string::npos) {
+                    unescape(field.value);
+                }
+            }
+
+            // end of file
+            if (!available()) break;
+            char c = _buffer[_pos++];
+            if (c == _delimiter) continue;
+            if (c == '\r') c = available()? _buffer[_pos++]: '\n';
+            if (c == '\n') break;
+            return 2;
+        }
+        fields.resize(num_fields);
+        return 0;
+    }
+
+    // line number of the last record, starts from 1
+    uint64 line() const { return _line; }
+
+private:
+    // returns 1 if there's unread data in buffer,
+    // reads next block if buffer is exhausted
+    bool available() {
+        if (_pos < _end) return 1;
+        _in.read(_buffer, BLOCK_SIZE);
+        _pos = 0;
+        _end = _in.gcount();
+        return _end;
+    }
+
+    // read to delimiter or line end, which is not consumed
+    void readPlain(std::string& value) {
+        while (available()) {
+            const char* begin = _buffer + _pos;
+            const char* end = _buffer + _end;
+            // line end first, then delimiter in this line
+            const char* stop = static_cast<const char*>(memchr(begin, '\n', end - begin));
+            if (!stop) stop = end;
+            const char* delimiter = static_cast<const char*>(memchr(begin, _delimiter, stop - begin));
+            if (delimiter) stop = delimiter;
+            value.append(begin, stop);
+            _pos += stop - begin;
+            if (stop != end) break;
+        }
+        if (!value.empty() && value.back() == '\r' && (_pos == _end || _buffer[_pos] == '\n'))
+            value.pop_back();
+    }
+
+    // read quoted field, quotes are consumed
+    // returns 1 if quote is not closed
+    bool readQuoted(std::string& value) {
+        // opening quote
+        ++_pos;
+        while (available()) {
+            const char* begin = _buffer + _pos;
+            const char* end = _buffer + _end;
+            const char* quote = static_cast<const char*>(memchr(begin, '"', end - begin));
+            if (!quote) {
+                _line += std::count(begin, end, '\n');
+                value.append(begin, end);
+                _pos = _end;
+                continue;
+            }
+            _line += std::count(begin, quote, '\n');
+            value.append(begin, quote);
+            _pos += quote - begin + 1;
+            // "" is a quote in value
+            if (available() && _buffer[_pos] == '"') {
+                value += '"';
+                ++_pos;
+                continue;
+            }
+            return 0;
+        }
+        return 1;
+    }
+
+    static void unescape(std::string& value) {
+        std::size_t j = 0;
+        for (std::size_t i = 0; i < value.length(); ++i, ++j) {
+            if (value[i] != '\\' || i + 1 == value.length()) {
+                value[j] = value[i];
+                continue;
+            }
+            switch (value[++i]) {
+                case 't': value[j] = '\t'; break;
+                case 'n': value[j] = '\n'; break;
+                case 'r': value[j] = '\r'; break;
+                default: value[j] = value[i];
+            }
+        }
+        value.resize(j);
+    }
+
+    std::istream& _in;
+    bool _csv;
+    char _delimiter;
+    char* _buffer;
+    // unread data is _buffer[_pos, _end)
+    uint64 _pos;
+    uint64 _end;
+    uint64 _line;
+};
+
+constexpr Database::uint64 Database::DelimitedReader::BLOCK_SIZE;
+
+#endif /* DB_READER_H_ */
@@ -0,0 +1,513 @@
+/******************************************************************************
+ *  Copyright (c) 2014-2015 Jamis Hoo
+ *  Distributed under the MIT license
+ *  (See accompanying file LICENSE or copy at http://opensource.org/licenses/MIT)
+ *
+ *  Project: Database
+ *  Filename: db_recovery.h
+ *  Version: 1.0
+ *  Author: Jamis Hoo
+ *  E-mail: hjm211324@gmail.com
+ *  Description: Recovery of a database from its log after a crash, and checkpoints.
+ *               Analysis finds unfinished transactions and where redo starts,
+ *               redo repeats history of pages not on disk,
+ *               undo rolls back unfinished transactions.
+ *               Changes of unfinished transactions are undone in copies of pages for snapshots.
+ *****************************************************************************/
+
+/****************************************
+ *  Pages have no LSN, instead the first change of a page not dirty logs
+ *  a dirty record with checksum of the page, which is the page on disk then.
+ *  A page on disk is the page when one of its dirty records is logged,
+ *  or the page after all its records. Redo of a page starts from its first dirty record
+ *  whose checksum matches the page on disk, and repeats all its records after that.
+ *  Changes of a page not dirty at the last checkpoint are on disk if made before it began,
+ *  and those of a dirty page if made before its LSN in the dirty page table,
+ *  so redo starts from the earliest of them.
+ *  Records of a file before it's created or removed again are ignored.
+ *
+ *  Undo changes pages through buffers logging to the log, for the transactions undone,
+ *  so a crash during undo is recovered by redoing and undoing them all again.
+ *  ROLLBACK undoes through buffers of files open, so their pages and copies kept for
+ *  snapshots stay coherent, and tables aren't closed under readers.
+ *  Only bits an update record changed are restored, other bits in its range may belong to
+ *  records or slots changed by other transactions since, which are locked apart,
+ *  see db_lockmanager.h. The same undo applied to copies of pages lets a snapshot begin
+ *  while transactions go on, seeing pages as last committed, see db_versions.h.
+ *  Index records are undone after all changes of pages, when actions not committed
+ *  are undone and no node is left half changed, by inserting or removing entries again,
+ *  which are new actions. Entries are distinct, so this is repeated safely after a crash.
+ *
+ *  A checkpoint writes back pages dirty since before the last checkpoint,
+ *  so redo never starts before the checkpoint before the last one.
+ *******************************************************/
+
+#ifndef DB_RECOVERY_H_
+#define DB_RECOVERY_H_
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <queue>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "db_common.h"
+#include "db_file.h"
+#include "db_buffer.h"
+#include "db_fields.h"
+#include "db_blinkindex.h"
+#include "db_log.h"
+#include "db_versions.h"
+
+class Database::DBRecovery {
+public:
+    typedef DBBLinkIndex<DBFields::Comparator> Index;
+
+    // size of buffer of each file recovered
+    static constexpr uint64 BUFFER_SIZE = 16 * 1024 * 1024;
+
+    DBRecovery(DBLog& log): _log(log), _redo_lsn(0) { }
+
+    DBRecovery(const DBRecovery&) = delete;
+    DBRecovery& operator=(const DBRecovery&) = delete;
+
+    // redo committed transactions and undo the others in files of log,
+    // log should be open, and no file of it is open
+    // files changed are put into files, and are all on disk when returned,
+    // log can be truncated then
+    // returns 0 if succeed, 1 otherwise
+    bool recover(std::vector<std::string>& files) {
+        // nothing to recover after a normal close
+        if (_log.nextLSN() == _log.firstLSN()) return 0;
+
+        bool failed = analyze() || redo();
+        failed |= closeBuffers();
+        failed = failed || undo();
+        failed |= closeBuffers();
+        files.assign(_changed.begin(), _changed.end());
+        return failed;
+    }
+
+    // undo current transaction of log and end it, for ROLLBACK
+    // files changed by it are changed through their buffers attached to log, if open,
+    // and indexes through those find(file) returns, if not null
+    // files changed are put into files, meta data cached of those open is outdated then
+    // returns 0 if succeed, 1 otherwise
+    bool rollback(std::vector<std::string>& files, std::function<Index*(const std::string&)> find) {
+        _find_index = std::move(find);
+        const uint64 txn = _log.transaction();
+        DBLog::Transaction records;
+        if (!_log.records(txn, records)) return 0;
+        // records are read from file
+        if (_log.flush(records.last_lsn)) return 1;
+        _transactions.emplace(txn, records);
+        bool failed = undo();
+        failed |= closeBuffers();
+        files.assign(_changed.begin(), _changed.end());
+        return failed;
+    }
+
+    // undo of changes of unfinished transactions to pages of buffers attached to log,
+    // which are applied to copies of pages, the latest change first
+    // returns 0 if succeed, 1 if the transactions logged more than limit bytes,
+    // changed files not open, or their records can't be read
+    bool uncommitted(const uint64 limit, DBVersions::Uncommitted& uncommitted) {
+        std::map<uint64, DBLog::Transaction> transactions;
+        _log.transactions(transactions);
+        if (transactions.empty()) return 0;
+        uint64 length = 0, last_lsn = 0;
+        for (const auto& t: transactions) {
+            length += t.second.length;
+            last_lsn = std::max(last_lsn, t.second.last_lsn);
+        }
+        if (length > limit || _log.write(last_lsn)) return 1;
+
+        std::map<std::string, DBBuffer*> buffers;
+        _log.forEachBuffer([&buffers](DBBuffer& buffer) { buffers[buffer.filename()] = &buffer; });
+        // buffer and page -> LSN -> record, the latest first
+        typedef std::map< uint64, DBLog::Record, std::greater<uint64> > Records;
+        std::map< std::pair<const void*, uint64>, Records > pages;
+        uncommitted.pages.clear();
+        uncommitted.owners.clear();
+        DBLog::Record record;
+        for (const auto& t: transactions)
+            for (uint64 lsn = t.second.last_lsn; lsn; lsn = record.prev_lsn) {
+                if (!_log.readRecord(lsn, record) || record.txn != t.first) return 1;
+                if (record.type != DBLog::RECORD_UPDATE && record.type != DBLog::RECORD_MOVE &&
+                    record.type != DBLog::RECORD_INDEX) 
+                    continue;
+                auto buffer = buffers.find(record.file);
+                if (buffer == buffers.end()) return 1;
+                // entries of an index can't be told apart by pages
+                if (record.type == DBLog::RECORD_INDEX) {
+                    uncommitted.owners.insert(buffer->second);
+                    continue;
+                }
+                if (!validChange(record, buffer->second->pageSize())) return 1;
+                pages[std::make_pair(buffer->second, record.page_id)].emplace(lsn, record);
+            }
+
+        for (auto& p: pages) {
+            const uint64 page_size = static_cast<const DBBuffer*>(p.first.first)->pageSize();
+            std::shared_ptr<Records> records = std::make_shared<Records>(std::move(p.second));
+            uncommitted.pages.emplace(p.first, [records, page_size](char* data) {
+                for (const auto& r: *records)
+                    undoChange(r.second, data, page_size, 
+                               [](char* destination, const char* source, const uint64 length) {
+                                   memmove(destination, source, length);
+                               });
+            });
+        }
+        return 0;
+    }
+
+    // fuzzy checkpoint, pages are written and read by others meanwhile
+    // pages dirty since before the last checkpoint began are written back,
+    // so redo doesn't start before it
+    // returns 0 if succeed, 1 otherwise, recovery starts from the last checkpoint then
+    bool checkpoint() {
+        const uint64 last_begin = _log.checkpointBegin();
+        if (last_begin)
+            _log.forEachBuffer([last_begin](DBBuffer& buffer) { buffer.writeBack(last_begin); });
+
+        DBLog::Checkpoint checkpoint;
+        checkpoint.begin = _log.nextLSN();
+        _log.forEachBuffer([&checkpoint](DBBuffer& buffer) {
+            std::vector< std::pair<uint64, uint64> > pages;
+            buffer.dirtyPages(pages);
+            if (!pages.empty()) checkpoint.pages[buffer.filename()].swap(pages);
+        });
+        // pages not dirty must be on disk, including those written back before
+        bool failed = 0;
+        _log.forEachBuffer([&failed](DBBuffer& buffer) { failed |= buffer.sync(); });
+        if (failed) return 1;
+        return _log.checkpoint(checkpoint);
+    }
+
+private:
+    // file and page ID
+    typedef std::pair<std::string, uint64> Page;
+
+    // find where redo starts, unfinished transactions and files created or removed
+    // returns 0 if succeed, 1 otherwise
+    bool analyze() {
+        DBLog::Record record;
+        _redo_lsn = _log.firstLSN();
+        if (const uint64 checkpoint_lsn = _log.checkpointLSN()) {
+            DBLog::Checkpoint checkpoint;
+            if (!_log.readRecord(checkpoint_lsn, record) ||
+                !DBLog::parseCheckpoint(record.after, checkpoint))
+                return 1;
+            _redo_lsn = checkpoint.begin;
+            for (const auto& f: checkpoint.pages)
+                for (const auto& p: f.second)
+                    _redo_lsn = std::min(_redo_lsn, p.second);
+            _transactions = checkpoint.transactions;
+        }
+
+        for (uint64 lsn = _redo_lsn, next; (next = _log.readRecord(lsn, record)); lsn = next) {
+            if (record.type == DBLog::RECORD_CHECKPOINT) continue;
+            if (record.type == DBLog::RECORD_COMMIT || record.type == DBLog::RECORD_ABORT) {
+                _transactions.erase(record.txn);
+                continue;
+            }
+            if (record.type == DBLog::RECORD_CREATE || record.type == DBLog::RECORD_REMOVE)
+                _file_lsn[record.file] = lsn;
+            if (!record.txn) continue;
+            auto ite = _transactions.find(record.txn);
+            if (ite == _transactions.end()) {
+                _transactions.emplace(record.txn, DBLog::Transaction{ lsn, lsn, 0 });
+            } else {
+                ite->second.first_lsn = std::min(ite->second.first_lsn, lsn);
+                ite->second.last_lsn = std::max(ite->second.last_lsn, lsn);
+            }
+        }
+        return 0;
+    }
+
+    // repeat changes of pages not on disk, in order
+    // returns 0 if succeed, 1 otherwise
+    bool redo() {
+        DBLog::Record record;
+        // pages being redone, since their records matching them on disk
+        std::set<Page> redoing;
+        for (uint64 lsn = _redo_lsn, next; (next = _log.readRecord(lsn, record)); lsn = next) {
+            // finish removal, unless the file is created again
+            if (record.type == DBLog::RECORD_REMOVE) {
+                if (_file_lsn[record.file] == lsn) {
+                    _buffers.erase(record.file);
+                    DBFile(record.file).remove();
+                }
+                continue;
+            }
+            if (record.type != DBLog::RECORD_UPDATE && record.type != DBLog::RECORD_MOVE &&
+                record.type != DBLog::RECORD_DIRTY)
+                continue;
+            if (replaced(record.file, lsn)) continue;
+
+            const Page page(record.file, record.page_id);
+            const bool started = redoing.count(page);
+            if (!started && record.type != DBLog::RECORD_DIRTY) continue;
+            DBBuffer* buffer = openBuffer(record.file, 0);
+            if (!buffer) continue;
+            const uint64 page_size = buffer->pageSize();
+            if (record.type == DBLog::RECORD_DIRTY) {
+                // page in buffer is the page on disk until it's redone
+                uint64 sum;
+                if (started || record.after.length() != sizeof(sum)) continue;
+                memcpy(&sum, record.after.data(), sizeof(sum));
+                DBBuffer::PageGuard guard = buffer->fetchPage(record.page_id, 0);
+                if (DBLog::checksum(guard.data(), page_size) == sum) redoing.insert(page);
+                continue;
+            }
+
+            DBBuffer::PageGuard guard = buffer->fetchPage(record.page_id, 1);
+            char* data = guard.mutableData();
+            if (record.type == DBLog::RECORD_UPDATE) {
+                if (record.offset + record.after.length() > page_size) return 1;
+                memcpy(data + record.offset, record.after.data(), record.after.length());
+            } else {
+                uint64 source, length;
+                if (!parseMove(record, page_size, source, length)) return 1;
+                memmove(data + record.offset, data + source, length);
+            }
+            guard.markDirty();
+            _changed.insert(record.file);
+        }
+        return 0;
+    }
+
+    // roll back unfinished transactions, the latest change first
+    // returns 0 if succeed, 1 otherwise
+    bool undo() {
+        // LSN of the next record to undo, and its transaction
+        std::priority_queue< std::pair<uint64, uint64> > records;
+        for (const auto& t: _transactions) {
+            _log.resume(t.first, t.second.first_lsn, t.second.last_lsn);
+            records.emplace(t.second.last_lsn, t.first);
+        }
+        _log.setTransaction(0);
+
+        // index records, the latest first, and transactions all of whose records are undone
+        std::vector< std::pair<uint64, DBLog::Record> > entries;
+        std::vector<uint64> undone;
+        DBLog::Record record;
+        while (!records.empty()) {
+            const uint64 lsn = records.top().first;
+            const uint64 txn = records.top().second;
+            records.pop();
+            if (!_log.readRecord(lsn, record) || record.txn != txn) return 1;
+            // records of a file before it's created or removed again by rollback are ignored
+            if (record.type == DBLog::RECORD_CREATE || record.type == DBLog::RECORD_REMOVE)
+                _file_lsn.emplace(record.file, lsn);
+
+            if (record.type == DBLog::RECORD_INDEX) {
+                if (!replaced(record.file, lsn)) entries.emplace_back(lsn, record);
+            } else {
+                // changes are logged for the transaction
+                _log.setTransaction(txn);
+                if (undo(lsn, record)) return 1;
+                _log.setTransaction(0);
+            }
+            if (record.prev_lsn)
+                records.emplace(record.prev_lsn, txn);
+            else
+                undone.push_back(txn);
+        }
+
+        for (const auto& e: entries)
+            if (undoIndex(e.second)) return 1;
+        for (const uint64 txn: undone) {
+            _log.setTransaction(txn);
+            _log.abort();
+        }
+        return 0;
+    }
+
+    // undo index record by removing or inserting its entry, if not yet
+    // returns 0 if succeed, 1 otherwise
+    bool undoIndex(const DBLog::Record& record) {
+        // files created are removed by undo
+        if (!DBFile(record.file).accessible()) return 0;
+        Index* index = openIndex(record.file);
+        if (!index) return 0;
+        uint64 position[2];
+        if (record.before.length() != index->keyLength() || record.after.length() != sizeof(position))
+            return 1;
+        memcpy(position, record.after.data(), sizeof(position));
+        const RID rid(position[0], position[1]);
+        if (record.offset)
+            index->removeRecord(record.before.data(), rid);
+        else
+            index->insertRecord(record.before.data(), rid, 0);
+        _changed.insert(record.file);
+        return 0;
+    }
+
+    // undo record at lsn
+    // returns 0 if succeed, 1 otherwise
+    bool undo(const uint64 lsn, const DBLog::Record& record) {
+        if (replaced(record.file, lsn)) return 0;
+        // files created are removed, and files removed are left removed
+        if (record.type == DBLog::RECORD_CREATE) {
+            _buffers.erase(record.file);
+            DBFile file(record.file);
+            if (file.accessible()) file.remove();
+            return 0;
+        }
+        if (record.type != DBLog::RECORD_UPDATE && record.type != DBLog::RECORD_MOVE) return 0;
+
+        DBBuffer* buffer = openBuffer(record.file, 1);
+        if (!buffer) return 0;
+        const uint64 page_size = buffer->pageSize();
+        if (!validChange(record, page_size)) return 1;
+        DBBuffer::PageGuard guard = buffer->fetchPage(record.page_id, 1);
+        undoChange(record, guard.mutableData(), page_size, 
+                   [&guard](char* destination, const char* source, const uint64 length) {
+                       guard.move(destination, source, length);
+                   });
+        guard.markDirty();
+        _changed.insert(record.file);
+        return 0;
+    }
+
+    // whether update or move record fits in pages of page size
+    static bool validChange(const DBLog::Record& record, const uint64 page_size) {
+        if (record.type == DBLog::RECORD_UPDATE)
+            return record.offset + record.before.length() <= page_size &&
+                   record.after.length() == record.before.length();
+        uint64 source, length;
+        return parseMove(record, page_size, source, length) &&
+               lostOffset(record, source, length) + record.before.length() <= page_size;
+    }
+
+    // undo update or move record, which is valid, in data of page
+    // bytes are moved by move(destination, source, length)
+    template<class MOVE>
+    static void undoChange(const DBLog::Record& record, char* data, const uint64 page_size, MOVE move) {
+        if (record.type == DBLog::RECORD_UPDATE) {
+            // bits unchanged by the record may have been changed by other transactions since
+            for (uint64 i = 0; i < record.before.length(); ++i) {
+                const char changed = record.before[i] ^ record.after[i];
+                data[record.offset + i] = (data[record.offset + i] & ~changed) | (record.before[i] & changed);
+            }
+            return;
+        }
+        uint64 source = 0, length = 0;
+        parseMove(record, page_size, source, length);
+        // move back, and restore bytes overwritten
+        move(data + source, data + record.offset, length);
+        memcpy(data + lostOffset(record, source, length), record.before.data(), record.before.length());
+    }
+
+    // offset of bytes overwritten by move record, which are saved as its before
+    static uint64 lostOffset(const DBLog::Record& record, const uint64 source, const uint64 length) {
+        return record.offset > source? std::max(record.offset, source + length): record.offset;
+    }
+
+    // whether file is created or removed after lsn
+    bool replaced(const std::string& file, const uint64 lsn) const {
+        auto ite = _file_lsn.find(file);
+        return ite != _file_lsn.end() && ite->second > lsn;
+    }
+
+    // source and length of move record, which are checked with page size
+    // returns 1 if succeed, 0 if record is broken
+    static bool parseMove(const DBLog::Record& record, const uint64 page_size,
+                          uint64& source, uint64& length) {
+        if (record.after.length() != sizeof(uint64) * 2) return 0;
+        memcpy(&source, record.after.data(), sizeof(uint64));
+        memcpy(&length, record.after.data() + sizeof(uint64), sizeof(uint64));
+        return source + length <= page_size && record.offset + length <= page_size;
+    }
+
+    // buffer of file, which logs changes if logged is 1
+    // a logged buffer is the one attached to log if file is open, which is left open
+    // returns null if file can't be opened
+    DBBuffer* openBuffer(const std::string& file, const bool logged) {
+        auto ite = _buffers.find(file);
+        if (ite != _buffers.end()) return ite->second.get();
+        if (logged) {
+            auto attached = _attached.find(file);
+            if (attached != _attached.end()) return attached->second;
+            DBBuffer* open = nullptr;
+            _log.forEachBuffer([&file, &open](DBBuffer& buffer) {
+                if (buffer.filename() == file) open = &buffer;
+            });
+            if (open) return _attached[file] = open;
+        }
+        std::unique_ptr<DBBuffer> buffer(new DBBuffer(file, BUFFER_SIZE, logged? &_log: nullptr));
+        if (!buffer->open() || buffer->pageSize() > BUFFER_SIZE) buffer.reset();
+        return (_buffers[file] = std::move(buffer)).get();
+    }
+
+    // index of file, the one find returns if open, or one opened here, which is left open
+    // returns null if file can't be opened
+    Index* openIndex(const std::string& file) {
+        if (_find_index)
+            if (Index* index = _find_index(file)) return index;
+        auto ite = _indexes.find(file);
+        if (ite != _indexes.end()) return ite->second.get();
+        // pages are read through the buffer of index then
+        closeBuffer(file);
+        std::unique_ptr<Index> index(new Index(file, &_log));
+        if (!index->open()) index.reset();
+        return (_indexes[file] = std::move(index)).get();
+    }
+
+    // write back pages of buffer of file to disk, and close it
+    // returns 0 if succeed, 1 otherwise
+    bool closeBuffer(const std::string& file) {
+        _attached.erase(file);
+        auto ite = _buffers.find(file);
+        if (ite == _buffers.end()) return 0;
+        bool failed = 0;
+        if (ite->second) {
+            ite->second->writeBack(std::numeric_limits<uint64>::max());
+            failed = ite->second->sync();
+            ite->second->close();
+        }
+        _buffers.erase(ite);
+        return failed;
+    }
+
+    // write back pages of all buffers and indexes opened to disk, and close them
+    // returns 0 if succeed, 1 otherwise
+    bool closeBuffers() {
+        bool failed = 0;
+        while (!_buffers.empty()) failed |= closeBuffer(_buffers.begin()->first);
+        for (auto& i: _indexes)
+            if (i.second) failed |= i.second->close();
+        _indexes.clear();
+        _attached.clear();
+        return failed;
+    }
+
+    DBLog& _log;
+    // redo starts from here
+    uint64 _redo_lsn;
+    // unfinished transactions
+    std::map<uint64, DBLog::Transaction> _transactions;
+    // file -> LSN of its last creation or removal
+    std::unordered_map<std::string, uint64> _file_lsn;
+    // file -> its buffer, null if it can't be opened
+    std::map< std::string, std::unique_ptr<DBBuffer> > _buffers;
+    // file -> buffer attached to log, which is open before and after undo
+    std::map<std::string, DBBuffer*> _attached;
+    // indexes open, by file, through which index records are undone
+    std::function<Index*(const std::string&)> _find_index;
+    // file -> index opened by undo, null if it can't be opened
+    std::map< std::string, std::unique_ptr<Index> > _indexes;
+    // files redone or undone
+    std::set<std::string> _changed;
+};
+
+constexpr Database::uint64 Database::DBRecovery::BUFFER_SIZE;
+
+#endif /* DB_RECOVERY_H_ */
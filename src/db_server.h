@@ -0,0 +1,356 @@
+/******************************************************************************
+ *  Copyright (c) 2014-2015 Jamis Hoo
+ *  Distributed under the MIT license
+ *  (See accompanying file LICENSE or copy at http://opensource.org/licenses/MIT)
+ *
+ *  Project: Database
+ *  Filename: db_server.h
+ *  Version: 1.0
+ *  Author: Jamis Hoo
+ *  E-mail: hjm211324@gmail.com
+ *  Description: Server of multiple sessions on a unix socket or a local TCP port.
+ *               Sessions share one DBQuery with its opened tables, buffers and locks.
+ *               Statements of different sessions are executed at the same time by writers,
+ *               each a DBQuery of its own on the shared one, except those changing schema
+ *               or database in use, which are executed in turn by the shared one.
+ *               A statement waiting for locks of transactions of other sessions,
+ *               and those after it in the request, are executed again when one of them ends.
+ *               Requests of only SELECT statements are executed with a snapshot,
+ *               by readers running at the same time as other statements.
+ *               Files read and written by statements of clients are restricted to a directory.
+ *****************************************************************************/
+
+/****************************************
+ *  Protocol:
+ *      Each message is a 4 bytes length in big endian followed by its payload.
+ *      Request:  SQL statements. A statement may be continued in the next request.
+ *      Response: status followed by results and errors of the statements
+ *                completed by the request, in the order they are executed.
+ *                status is '\0' if all of them succeed, '\1' otherwise.
+ *      Each request gets exactly one response, in order.
+ *******************************************************/
+
+#ifndef DB_SERVER_H_
+#define DB_SERVER_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <csignal>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
+#include "db_common.h"
+#include "db_query.h"
+#include "db_interface.h"
+
+class Database::DBServer {
+public:
+    // longer requests are refused, and session is closed
+    static constexpr uint64 MAX_REQUEST_LENGTH = 1 << 24;
+    // requests are read in chunks of this size at most, split into statements as they arrive
+    static constexpr uint64 CHUNK_SIZE = 1 << 16;
+    static constexpr uint64 DEFAULT_THREADS = 4;
+
+    // sessions are served by num_threads threads
+    // clients read and write files only in file_directory, or none if it's empty
+    DBServer(DBQuery& query, const uint64 num_threads = DEFAULT_THREADS, 
+             const std::string& file_directory = ""):
+        _query(query), _num_threads(num_threads), _file_directory(file_directory), 
+        _signals(_io_service) {
+        assert(num_threads);
+    }
+
+    DBServer(const DBServer&) = delete;
+    DBServer& operator=(const DBServer&) = delete;
+
+    // listen on address, which is a port number of localhost or path of a unix socket,
+    // serve until SIGINT or SIGTERM is received
+    // returns 0 if stopped by signal, 1 if listen failed
+    bool run(const std::string& address) {
+        _query.restrictFiles(_file_directory);
+        try {
+            if (!address.empty() && std::all_of(address.begin(), address.end(), ::isdigit)) {
+                using boost::asio::ip::tcp;
+                tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), std::stoi(address));
+                std::unique_ptr<tcp::acceptor> acceptor(new tcp::acceptor(_io_service, endpoint));
+                accept<tcp>(*acceptor);
+                serve();
+            } else {
+                using boost::asio::local::stream_protocol;
+                // socket file left by a server not stopped normally
+                boost::system::error_code ec;
+                boost::filesystem::remove(address, ec);
+                std::unique_ptr<stream_protocol::acceptor> acceptor(
+                    new stream_protocol::acceptor(_io_service, stream_protocol::endpoint(address)));
+                accept<stream_protocol>(*acceptor);
+                serve();
+                boost::filesystem::remove(address, ec);
+            }
+        } catch (const boost::system::system_error& error) {
+            std::clog << "Failed when listening on " << address << ". " << error.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+private:
+    template <class PROTOCOL>
+    class Session: public std::enable_shared_from_this< Session<PROTOCOL> > {
+    public:
+        Session(DBServer& server, typename PROTOCOL::socket socket):
+            _server(server), _socket(std::move(socket)), _remaining(0), _failed(0) { }
+
+        void start() { readHeader(); }
+
+    private:
+        void readHeader() {
+            auto self = this->shared_from_this();
+            boost::asio::async_read(_socket, boost::asio::buffer(_header),
+                [this, self](const boost::system::error_code& ec, std::size_t) {
+                    if (ec) return close();
+                    uint64 length = 0;
+                    for (auto c: _header) length = length << 8 | c;
+                    if (length > MAX_REQUEST_LENGTH) return close();
+                    _remaining = length;
+                    readRequest();
+                });
+        }
+
+        // read the rest of request a chunk at a time, so memory grows only with bytes received
+        void readRequest() {
+            if (!_remaining) {
+                _output.str("");
+                // status placeholder
+                _output << '\0';
+                _failed = 0;
+                return executeRequest();
+            }
+            auto self = this->shared_from_this();
+            _chunk.resize(std::min(_remaining, CHUNK_SIZE));
+            boost::asio::async_read(_socket, boost::asio::buffer(_chunk),
+                [this, self](const boost::system::error_code& ec, std::size_t) {
+                    if (ec) return close();
+                    _remaining -= _chunk.size();
+                    _interface.feed(_chunk.data(), _chunk.size());
+                    boost::string_ref statement;
+                    while (_interface.next(statement)) 
+                        _statements.emplace_back(statement.data(), statement.size());
+                    readRequest();
+                });
+        }
+
+        // executed again when transactions of other sessions end, if statements wait for them
+        void executeRequest() {
+            auto self = this->shared_from_this();
+            if (!_server.execute(_state, _statements, _output, _failed, 
+                                 [this, self]() { executeRequest(); })) 
+                return;
+            _response = _output.str();
+            _response[0] = _failed;
+            const uint64 length = _response.size();
+            for (int i = 0; i < 4; ++i)
+                _header[i] = length >> (24 - 8 * i);
+            writeResponse();
+        }
+
+        void writeResponse() {
+            auto self = this->shared_from_this();
+            std::vector<boost::asio::const_buffer> buffers = {
+                boost::asio::buffer(_header), boost::asio::buffer(_response) };
+            boost::asio::async_write(_socket, buffers,
+                [this, self](const boost::system::error_code& ec, std::size_t) {
+                    if (ec) return close();
+                    readHeader();
+                });
+        }
+
+        // transaction left by client is rolled back
+        void close() {
+            if (_state.inTransaction()) _server.rollback(_state);
+        }
+
+        DBServer& _server;
+        typename PROTOCOL::socket _socket;
+        unsigned char _header[4];
+        // bytes of request not read yet
+        uint64 _remaining;
+        std::vector<char> _chunk;
+        std::string _response;
+        // splits statements, which may cross requests
+        DBInterface _interface;
+        DBQuery::Session _state;
+        // statements of request not executed yet, and response of those executed
+        std::deque<std::string> _statements;
+        std::ostringstream _output;
+        bool _failed;
+    };
+
+    template <class PROTOCOL>
+    void accept(typename PROTOCOL::acceptor& acceptor) {
+        acceptor.async_accept([this, &acceptor](const boost::system::error_code& ec,
+                                                typename PROTOCOL::socket socket) {
+            if (!ec) std::make_shared< Session<PROTOCOL> >(*this, std::move(socket))->start();
+            accept<PROTOCOL>(acceptor);
+        });
+    }
+
+    // run io service with threads until a signal is received
+    void serve() {
+        _signals.add(SIGINT);
+        _signals.add(SIGTERM);
+        _signals.async_wait([this](const boost::system::error_code&, int) { _io_service.stop(); });
+
+        std::vector<std::thread> threads;
+        for (uint64 i = 1; i < _num_threads; ++i)
+            threads.emplace_back([this]() { _io_service.run(); });
+        _io_service.run();
+        for (auto& thread: threads) thread.join();
+    }
+
+    // execute statements for session in order, failed is set if any of them fails
+    // statements executed are removed, those left wait for locks of transactions of other sessions,
+    // and retry is posted when one of them ends, unless it's empty
+    // returns 1 if all are executed, 0 if some are left
+    bool execute(DBQuery::Session& session, std::deque<std::string>& statements, 
+                 std::ostream& output, bool& failed, std::function<void()> retry) {
+        std::unique_ptr<DBQuery> reader;
+        std::unique_ptr<DBQuery> writer;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            // statements only reading are executed with a snapshot, after mutex is unlocked
+            if (!statements.empty() && 
+                std::all_of(statements.begin(), statements.end(), DBQuery::readOnly)) {
+                reader = worker();
+                if (_query.beginSnapshot(*reader, session, output)) {
+                    _workers.push_back(std::move(reader));
+                    reader.reset();
+                }
+            }
+
+            // other statements not changing schema are executed by a writer, after mutex is unlocked
+            if (!reader && !statements.empty() &&
+                std::none_of(statements.begin(), statements.end(), DBQuery::changesSchema)) {
+                writer = worker();
+                if (_query.beginWriter(*writer, session, output)) {
+                    _workers.push_back(std::move(writer));
+                    writer.reset();
+                }
+            }
+
+            if (!reader && !writer) {
+                bool blocked = _query.enterSession(session, output);
+                if (!blocked) {
+                    while (!statements.empty()) {
+                        const bool rtv = _query.execute(statements.front());
+                        if ((blocked = _query.blocked())) break;
+                        failed |= rtv;
+                        statements.pop_front();
+                    }
+                    _query.leaveSession(session);
+                }
+                wake();
+                if (blocked) {
+                    if (retry) _waiting.push_back(Waiting{ _query.blockers(), std::move(retry) });
+                    return 0;
+                }
+            }
+        }
+
+        if (reader) {
+            for (const auto& s: statements) failed |= reader->execute(s);
+            statements.clear();
+            _query.endSnapshot(*reader);
+            std::lock_guard<std::mutex> lock(_mutex);
+            _workers.push_back(std::move(reader));
+            return 1;
+        }
+
+        if (writer) {
+            bool blocked = 0;
+            while (!statements.empty()) {
+                const bool rtv = writer->execute(statements.front());
+                if ((blocked = writer->blocked())) break;
+                failed |= rtv;
+                statements.pop_front();
+            }
+            // statements of the shared DBQuery may wait for writer to end, with mutex locked
+            const bool closing = _query.endWriter(*writer, session);
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (closing) _query.closeDBAfterRollback();
+            // retry is posted at once if a transaction blocking writer has ended meanwhile
+            if (blocked && retry) _waiting.push_back(Waiting{ writer->blockers(), std::move(retry) });
+            _workers.push_back(std::move(writer));
+            wake();
+            if (blocked) return 0;
+        }
+        // sessions committing meanwhile share one log flush
+        if (session.waitDurable()) {
+            output << DBError::LogFailed().getInfo() << std::endl;
+            failed = 1;
+        }
+        return 1;
+    }
+
+    // a DBQuery reading snapshots or writing, reused if any
+    std::unique_ptr<DBQuery> worker() {
+        if (_workers.empty()) return std::unique_ptr<DBQuery>(new DBQuery);
+        std::unique_ptr<DBQuery> query = std::move(_workers.back());
+        _workers.pop_back();
+        return query;
+    }
+
+    // post requests waiting for transactions of which one has ended
+    void wake() {
+        for (auto ite = _waiting.begin(); ite != _waiting.end(); ) {
+            const auto& blockers = ite->blockers;
+            if (blockers.empty() || 
+                std::any_of(blockers.begin(), blockers.end(), 
+                            [this](const uint64 txn) { return _query.ended(txn); })) {
+                _io_service.post(std::move(ite->retry));
+                ite = _waiting.erase(ite);
+            } else {
+                ++ite;
+            }
+        }
+    }
+
+    // roll back transaction of session closed by client
+    // it's dropped if database has been closed by others
+    void rollback(DBQuery::Session& session) {
+        std::deque<std::string> statements(1, "ROLLBACK;");
+        std::ostringstream output;
+        bool failed = 0;
+        execute(session, statements, output, failed, nullptr);
+    }
+
+    DBQuery& _query;
+    uint64 _num_threads;
+    std::string _file_directory;
+    boost::asio::io_service _io_service;
+    boost::asio::signal_set _signals;
+    // guards the shared DBQuery, whose statements are executed by one session at a time
+    std::mutex _mutex;
+    // request waiting until one of transactions blocking it ends
+    struct Waiting {
+        std::vector<uint64> blockers;
+        std::function<void()> retry;
+    };
+    std::vector<Waiting> _waiting;
+    // DBQuery reading snapshots or writing, which are reused
+    std::vector< std::unique_ptr<DBQuery> > _workers;
+};
+
+constexpr Database::uint64 Database::DBServer::MAX_REQUEST_LENGTH;
+constexpr Database::uint64 Database::DBServer::CHUNK_SIZE;
+constexpr Database::uint64 Database::DBServer::DEFAULT_THREADS;
+
+#endif /* DB_SERVER_H_ */
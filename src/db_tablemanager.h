@@ -12,12 +12,26 @@
  *  Time: 08:47:20
  *  Description: read and write table page, manage table header
  *****************************************************************************/
+
+/****************************************
+ *  Records are changed in place by threads of transactions, one at a time.
+ *  A transaction locks records it inserts, removes or changes, and keys it inserts
+ *  or removes, so rollback undoes its changes of slots by bits and of indexes by entries,
+ *  without touching those of others. A slot removed and not committed is not reused
+ *  by others, since it's locked. New pages are linked by actions, see DBLog,
+ *  which aren't undone, since others may insert into them meanwhile.
+ *  Empty slots map is a hint, pages it marks full may have slots freed by rollback.
+ *******************************************************/
 #ifndef DB_TABLEMANAGER_H_
 #define DB_TABLEMANAGER_H_
 
 #include <cassert>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <vector>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <array>
 #include <tuple>
@@ -25,7 +39,8 @@
 #include "db_common.h"
 #include "db_fields.h"
 #include "db_buffer.h"
-#include "db_indexmanager.h"
+#include "db_blinkindex.h"
+#include "db_lockmanager.h"
 
 class Database::DBTableManager {
 public:
@@ -45,13 +60,20 @@ private:
     static constexpr uint64 FIRST_EMPTY_SLOTS_PAGE = 3;
 
 public:
-    DBTableManager(): _file(nullptr), 
+    // changes of table and its indexes are logged to log if it's not null,
+    // pages of them are kept for snapshots in versions if it's not null,
+    // and records are locked for transactions of log in locks if it's not null
+    DBTableManager(DBLog* log = nullptr, DBVersions* versions = nullptr, 
+                   DBLockManager* locks = nullptr): 
+                      _file(nullptr), _log(log), _versions(versions), _locks(locks), 
+                      _locked_txn(0), 
                       _num_fields(0), 
                       _pages_each_map_page(0),
                       _record_length(0),
                       _num_records_each_page(0),
                       _last_empty_slots_map_page(0),
-                      _last_record_page(0) { }
+                      _last_record_page(0),
+                      _bulk_insert(0) { }
 
     ~DBTableManager() {
 
@@ -77,7 +99,7 @@ public:
         if (!fields.hasPrimaryKey()) return 1;
 
         // create DBFile
-        _file = new DBBuffer(table_name + TABLE_SUFFIX, DEFAULT_BUFFER_SIZE);
+        _file = new DBBuffer(table_name + TABLE_SUFFIX, DEFAULT_BUFFER_SIZE, _log, _versions);
 
         std::unique_ptr<char[]> buffer(new char[page_size]);
 
@@ -155,8 +177,8 @@ public:
 
         for (uint64 i = 0; i < fields.indexed().size(); ++i) {
             if (fields.indexed()[i] == 0) continue;
-            _index[i] = new DBIndexManager<DBFields::Comparator>(
-                table_name + "_" + fields.field_name()[i] + INDEX_SUFFIX);
+            _index[i] = new DBBLinkIndex<DBFields::Comparator>(
+                table_name + "_" + fields.field_name()[i] + INDEX_SUFFIX, _log, _versions);
             rtv = _index[i]->create(page_size,
                 fields.field_length()[i],
                 fields.field_type()[i]);
@@ -188,10 +210,12 @@ public:
         _table_name = table_name;
 
         // create DBFile
-        _file = new DBBuffer(table_name + TABLE_SUFFIX, DEFAULT_BUFFER_SIZE);
+        _file = new DBBuffer(table_name + TABLE_SUFFIX, DEFAULT_BUFFER_SIZE, _log, _versions);
 
         // openfile
         uint64 page_size = _file->open();
+        // buffer is needed to latch pages
+        assert(DEFAULT_BUFFER_SIZE >= page_size);
         
         std::unique_ptr<char[]> buffer(new char[page_size]);
 
@@ -217,10 +241,10 @@ public:
         for (const auto id: _fields.field_id())
             // if this field has index
             if (_fields.indexed()[id]) {
-                _index[id] = new DBIndexManager<DBFields::Comparator>(
+                _index[id] = new DBBLinkIndex<DBFields::Comparator>(
                     table_name + "_" + 
                     _fields.field_name()[id] + 
-                    INDEX_SUFFIX);
+                    INDEX_SUFFIX, _log, _versions);
                 uint64 rtv = _index[id]->open();
                 assert(rtv);
             }
@@ -232,12 +256,46 @@ public:
         return _fields;
     }
 
+    // whether file is data file of this table, or one of its index files
+    // assert file is open
+    bool hasFile(const std::string& file) const {
+        assert(isopen());
+        if (_file->filename() == file) return 1;
+        for (const auto index: _index)
+            if (index && index->filename() == file) return 1;
+        return 0;
+    }
+
+    // index whose file is file, nullptr if none
+    // assert file is open
+    DBBLinkIndex<DBFields::Comparator>* index(const std::string& file) const {
+        assert(isopen());
+        // INDEX MANIPULATE
+        for (const auto index: _index)
+            if (index && index->filename() == file) return index;
+        return nullptr;
+    }
+
+    // read empty slots map of table again, after changes are undone through its buffer
+    // by rollback, indexes are undone by entries and stay valid
+    // assert file is open
+    void reload() {
+        assert(isopen() && !_bulk_insert);
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::unique_ptr<char[]> buffer(new char[_file->pageSize()]);
+        _empty_slots_map.clear();
+        _empty_slots_map_pages.clear();
+        _file->readPage(FIRST_EMPTY_SLOTS_PAGE, buffer.get());
+        parseEmptyMapPages(buffer.get());
+    }
+
     // close an open table
     // assert there's an open table
     // returns 0 if succeed, 1 otherwise
     bool close() {
         if (!isopen()) return 1;
 
+        endBulkInsert();
         bool rtv = _file->close();
 
         // close successful
@@ -262,6 +320,7 @@ public:
             _last_empty_slots_map_page = 0;
             _last_record_page = 0;
             _empty_slots_map.clear();
+            _empty_slots_map_pages.clear();
             return 0;
         } else {
         // close failed
@@ -289,7 +348,7 @@ public:
         assert(close() == 0);
 
         // construct a file operator
-        _file = new DBBuffer(table_name + TABLE_SUFFIX, DEFAULT_BUFFER_SIZE);
+        _file = new DBBuffer(table_name + TABLE_SUFFIX, DEFAULT_BUFFER_SIZE, _log, _versions);
 
         // remove data file
         bool rtv = _file->remove();
@@ -297,8 +356,8 @@ public:
         // INDEX MANIPULATE
         if (rtv == 0) {
             for (const auto& index_name: index_names) {
-                auto index = new DBIndexManager<DBFields::Comparator>(
-                    table_name + "_" + index_name + INDEX_SUFFIX);
+                auto index = new DBBLinkIndex<DBFields::Comparator>(
+                    table_name + "_" + index_name + INDEX_SUFFIX, _log, _versions);
                 assert(index->remove() == 0);
                 delete index;
             }
@@ -329,6 +388,8 @@ public:
     // assert number of args == number of fields
     // assert file is open
     // returns rid if succeed, rid(0, 0) otherwise
+    // returns rid(0, 5) if it has to wait for locks of other transactions,
+    // rid(0, 6) if waiting would deadlock
     RID insertRecord(const std::vector<void*> args) {
         if (!isopen()) return { 0, 0 };
         if (args.size() != _fields.size())
@@ -340,116 +401,124 @@ public:
                 pointer_convert<const char*>(args[i])[0] == '\x00')
                 return { 0, 3 };
 
+        const char* key = pointer_convert<const char*>(args[_fields.primary_key_field_id()]);
+        if (int rtv = lockKey(key)) return { 0, uint64(4 + rtv) };
+
         // INDEX MANIPULATE
         // find in index
-        auto rid = _index[_fields.primary_key_field_id()]->searchRecord(
-            pointer_convert<char*>(args[_fields.primary_key_field_id()]));
+        auto rid = _index[_fields.primary_key_field_id()]->searchRecord(key);
 
         // if exist already
         if (rid) return  { 0, 4 };
         // else not exist, continue inserting
 
+        // pass args to _field to generate a record in raw data
+        std::unique_ptr<char[]> buffer(new char[_record_length]);
+        _fields.generateRecord(args, buffer.get());
 
-        // find an empty record slot
-        uint64 empty_slot_pageID = findEmptySlot();
-
+        std::unique_lock<std::mutex> lock(_mutex);
+        // find an empty record slot, in pages marked in map
         // if not found, create a new page, 
         // append this page to record pages list tail, 
         // modify _last_record_page.
         // add this page to empty map(this may lead to new map pages)
-        if (!empty_slot_pageID)
-            empty_slot_pageID = createNewRecordPage();
-
-        // pass args to _field to generate a record in raw data
-        // allocate more space, reserve for later
-        std::unique_ptr<char[]> buffer(new char[_file->pageSize()]);
+        for (uint64 pageID = findEmptySlot(); !rid; pageID = findEmptySlot(pageID + 1)) {
+            if (!pageID) pageID = createNewRecordPage();
 
-        _fields.generateRecord(args, buffer.get());
+            // insert the record to the slot
+            auto rtv = insertRecordtoPage(pageID, buffer.get());
+            // rtv[0]: RID, rtv[1]: empty_slots_remained
+            rid = std::get<0>(rtv);
 
-        // insert the record to the slot
-        auto rtv = insertRecordtoPage(empty_slot_pageID, buffer.get());
-        // rtv[0]: RID, rtv[1]: empty_slots_remained
-
-        // if there isn't any empty slot in this page
-        // mark it as full in map
-        if (!std::get<1>(rtv)) {
-            _empty_slots_map[empty_slot_pageID] = 0;
-
-            // write back map page to file
-            uint64 pageID = empty_slot_pageID;
-            _file->readPage(FIRST_EMPTY_SLOTS_PAGE, buffer.get());
-            while (pageID >= _pages_each_map_page) {
-                pageID -= _pages_each_map_page;
-                uint64 nextPageID = *pointer_convert<uint64*>(buffer.get() + 2 * sizeof(uint64));
-                _file->readPage(nextPageID, buffer.get());
-            }
-            buffer[PAGE_HEADER_LENGTH + pageID / 8] &= ~('\x01' << pageID % 8);
-            _file->writePage(*pointer_convert<uint64*>(buffer.get()), buffer.get());
+            // if there isn't any empty slot in this page
+            // mark it as full in map
+            if (!std::get<1>(rtv)) markEmptySlots(pageID, 0);
         }
+        lock.unlock();
         
         // INDEX MANIPULATE
         // insert to index
         bool successful = 1;
         for (auto id: _fields.field_id()) 
-            if (_index[id])
+            if (_index[id] && _bulk_insert && id != _fields.primary_key_field_id())
+                deferIndexRecord(id, pointer_convert<const char*>(args[id]), rid);
+            else if (_index[id])
                 successful &= _index[id]->insertRecord(
                     pointer_convert<char*>(args[id]),
-                    std::get<0>(rtv),
+                    rid,
                     id == _fields.primary_key_field_id());
         assert(successful == 1);
 
-        return std::get<0>(rtv);
+        return rid;
+    }
+
+    // records inserted after this are not inserted into indexes 
+    // other than primary key index, until endBulkInsert() is called
+    // they can only be found through primary key or traversing table in between
+    // assert file is open
+    void beginBulkInsert() {
+        assert(isopen());
+        _bulk_insert = 1;
+        _deferred_keys.assign(_fields.size(), std::vector<DeferredKey>());
+    }
+
+    // insert deferred records into indexes in order of keys,
+    // so that neighbouring insertions hit the same index pages
+    void endBulkInsert() {
+        if (!_bulk_insert) return;
+        _bulk_insert = 0;
+        for (auto id: _fields.field_id()) {
+            auto& keys = _deferred_keys[id];
+            std::sort(keys.begin(), keys.end(), 
+                      [](const DeferredKey& a, const DeferredKey& b) { return a.key < b.key; });
+            bool successful = 1;
+            for (const auto& k: keys)
+                // INDEX MANIPULATE
+                successful &= _index[id]->insertRecord(k.data.data(), k.rid, 0);
+            assert(successful == 1);
+        }
+        _deferred_keys.clear();
     }
 
     // remove a record
     // input: record ID
     // assert file is open
     // returns 0 if succeed, 1 otherwise
-    bool removeRecord(const RID rid) {
+    // returns 2 if it has to wait for locks of other transactions, 3 if waiting would deadlock
+    int removeRecord(const RID rid) {
         if (!isopen()) return 1;
+        if (int rtv = lockChange(rid, DBLockManager::ALL_FIELDS)) return 1 + rtv;
+
+        // record is not changed by others after it's locked
+        std::unique_ptr<char[]> oldRecord(new char[_record_length]);
+        selectRecord(rid, oldRecord.get());
+        if (int rtv = lockKey(oldRecord.get() + _fields.offset()[_fields.primary_key_field_id()]))
+            return 1 + rtv;
+        // records being removed are asserted to be in indexes
+        endBulkInsert();
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        {
+            // find the record
+            DBBuffer::PageGuard page = _file->fetchPage(rid.pageID, 1);
+            char* buffer = page.mutableData();
+            // assert slot is originally full
+            assert(!(buffer[PAGE_HEADER_LENGTH + rid.slotID / 8] & '\x01' << rid.slotID % 8));
+            // mark this slot as empty
+            buffer[PAGE_HEADER_LENGTH + rid.slotID / 8] |= '\x01' << rid.slotID % 8;
+            page.markDirty();
+        }
 
-        std::unique_ptr<char[]> buffer(new char[_file->pageSize()]);
-
-        // find the record
-        _file->readPage(rid.pageID, buffer.get());
-        // assert slot is originally full
-        assert(!(buffer[PAGE_HEADER_LENGTH + rid.slotID / 8] & '\x01' << rid.slotID % 8));
-        // mark this slot as empty
-        buffer[PAGE_HEADER_LENGTH + rid.slotID / 8] |= '\x01' << rid.slotID % 8;
-        _file->writePage(rid.pageID, buffer.get());
-
+        // check whether this page get empty
+        if (_empty_slots_map[rid.pageID] != 1) markEmptySlots(rid.pageID, 1);
+        lock.unlock();
 
         // INDEX MANIPULATE
         for (const auto id: _fields.field_id()) 
             if (_index[id]) {
-                char* oldRecord = /* base */
-                                  buffer.get() + 
-                                  /* page header offset */
-                                  PAGE_HEADER_LENGTH + 
-                                  /* bitmap offset */
-                                  (_num_records_each_page + 8 * sizeof(uint64) - 1) / (8 * sizeof(uint64)) * sizeof(uint64) + 
-                                  /* record offset */
-                                  _record_length * rid.slotID +
-                                  /* field offset */
-                                  _fields.offset()[id];
-                assert(_index[id]->removeRecord(oldRecord, rid));
-            }
-        
-        // check whether this page get empty
-        if (_empty_slots_map[rid.pageID] != 1) {
-            // mark this page as empty
-            _empty_slots_map[rid.pageID] = 1;
-            
-            // write back to map page
-            uint64 pageID = rid.pageID;
-            _file->readPage(FIRST_EMPTY_SLOTS_PAGE, buffer.get());
-            while (pageID >= _pages_each_map_page) {
-                pageID -= _pages_each_map_page;
-                _file->readPage(*pointer_convert<uint64*>(buffer.get() + 2 * sizeof(uint64)), buffer.get());
+                bool rtv = _index[id]->removeRecord(oldRecord.get() + _fields.offset()[id], rid);
+                assert(rtv);
             }
-            buffer[PAGE_HEADER_LENGTH + pageID / 8] |= '\x01' << pageID % 8;
-            _file->writePage(*pointer_convert<uint64*>(buffer.get()), buffer.get());
-        }
         
         return 0;
     }
@@ -483,6 +552,7 @@ public:
     // assert file is open
     // old value will be saved into old_arg is old_arg is not null
     // returns 0 if succeed, non-zero otherwise
+    // returns 4 if it has to wait for locks of other transactions, 5 if waiting would deadlock
     int modifyRecord(const RID rid, const uint64 field_id, const void* arg, void* old_arg) {
         if (!isopen()) return 1;
 
@@ -491,46 +561,34 @@ public:
             pointer_convert<const char*>(arg)[0] == '\x00')
             return 2;
 
+        if (int rtv = lockChange(rid, DBLockManager::fieldBit(field_id))) return 3 + rtv;
+
+        // record is not changed by others after it's locked
+        std::unique_ptr<char[]> oldRecord(new char[_record_length]);
+        selectRecord(rid, oldRecord.get());
+        const char* oldValue = oldRecord.get() + _fields.offset()[field_id];
 
         // INDEX MANIPULATE
         // if this is primary key field, find in index
         if (field_id == _fields.primary_key_field_id()) {
+            // records with both keys are removed and inserted
+            if (int rtv = lockKey(oldValue)) return 3 + rtv;
+            if (int rtv = lockKey(pointer_convert<const char*>(arg))) return 3 + rtv;
             auto rtv = _index[_fields.primary_key_field_id()]->
                 searchRecord(pointer_convert<const char*>(arg));
             // if exist already
             if (rtv && rtv != rid) return 3;
         } // else not exist, continue modifying
-    
-
-        std::unique_ptr<char[]> buffer(new char[_file->pageSize()]);
-
-        // read in this page
-        _file->readPage(rid.pageID, buffer.get());
-        
-        // assert this slot is used
-        assert(!(buffer[PAGE_HEADER_LENGTH + rid.slotID / 8] & '\x01' << rid.slotID % 8));
-
-        // modify record
-        char* oldRecord = /* base */
-                          buffer.get() + 
-                          /* page header offset */
-                          PAGE_HEADER_LENGTH + 
-                          /* bitmap offset */
-                          (_num_records_each_page + 8 * sizeof(uint64) - 1) / (8 * sizeof(uint64)) * sizeof(uint64) + 
-                          /* record offset */
-                          _record_length * rid.slotID +
-                          /* field offset */
-                          _fields.offset()[field_id];
 
         // store old value
         if (old_arg) 
-            memcpy(old_arg, oldRecord, _fields.field_length()[field_id]);
+            memcpy(old_arg, oldValue, _fields.field_length()[field_id]);
 
         // INDEX MANIPULATE
         // remove old, insert new in index
         if (_index[field_id]) {
             bool rtv;
-            rtv = _index[field_id]->removeRecord(oldRecord, rid);
+            rtv = _index[field_id]->removeRecord(oldValue, rid);
             assert(rtv);
             rtv = _index[field_id]->insertRecord(pointer_convert<const char*>(arg), 
                                                  rid, 
@@ -538,12 +596,16 @@ public:
             assert(rtv);
         }
 
-        // modify record
-        memcpy(oldRecord, arg, _fields.field_length()[field_id]);
+        DBBuffer::PageGuard page = _file->fetchPage(rid.pageID, 1);
+        char* buffer = page.mutableData();
         
-        // write back
-        _file->writePage(rid.pageID, buffer.get());
+        // assert this slot is used
+        assert(!(buffer[PAGE_HEADER_LENGTH + rid.slotID / 8] & '\x01' << rid.slotID % 8));
 
+        // modify record
+        memcpy(buffer + recordOffset(rid.slotID) + _fields.offset()[field_id], 
+               arg, _fields.field_length()[field_id]);
+        page.markDirty();
 
         return 0;
     }
@@ -561,23 +623,74 @@ public:
         uint64 pageID = FIRST_RECORD_PAGE;
 
         // while page id != 0
-        while (pageID) {
-            _file->readPage(pageID, buffer.get());
+        while (pageID) 
+            pageID = traverseRecordPage(pageID, buffer.get(), func);
+    }
+
+    // traverse records in record page pageID
+    // buffer is at least one page in size, and is used to read the page
+    // CALLBACKFUNC is the same as that of traverseRecords
+    // returns id of next record page, 0 if this is the last one
+    // assert file is open
+    template <class CALLBACKFUNC>
+    uint64 traverseRecordPage(const uint64 pageID, char* buffer, CALLBACKFUNC func) const {
+        assert(isopen());
+
+        _file->readPage(pageID, buffer);
             
-            char* bitmap_offset = buffer.get() + PAGE_HEADER_LENGTH;
-            char* record_offset = buffer.get() + PAGE_HEADER_LENGTH + 
-                (_num_records_each_page + 8 * sizeof(uint64) - 1) / (8 * sizeof(uint64)) * sizeof(uint64);
-
-            // traverse each slot
-            for (uint64 i = 0; i < _num_records_each_page; ++i) 
-                // if slot is not empty
-                if ((bitmap_offset[i / 8] & ('\x01' << i % 8)) == 0) 
-                    // callback
-                    func(record_offset + _record_length * i, RID(pageID, i));
-
-            // next page id
-            pageID = *pointer_convert<uint64*>(buffer.get() + sizeof(uint64) * 2);
+        char* bitmap_offset = buffer + PAGE_HEADER_LENGTH;
+        char* record_offset = buffer + PAGE_HEADER_LENGTH + 
+            (_num_records_each_page + 8 * sizeof(uint64) - 1) / (8 * sizeof(uint64)) * sizeof(uint64);
+
+        // traverse each slot
+        for (uint64 i = 0; i < _num_records_each_page; ++i) 
+            // if slot is not empty
+            if ((bitmap_offset[i / 8] & ('\x01' << i % 8)) == 0) 
+                // callback
+                func(record_offset + _record_length * i, RID(pageID, i));
+
+        // next page id
+        return *pointer_convert<uint64*>(buffer + sizeof(uint64) * 2);
+    }
+
+    // id of the first record page, record pages are linked from it
+    uint64 firstRecordPage() const {
+        return FIRST_RECORD_PAGE;
+    }
+
+    // ids of all record pages, in the order they are linked
+    // pages are created in increasing order of id, 
+    // so record pages are all pages since the first one, except map pages
+    // assert file is open
+    std::vector<uint64> recordPages() const {
+        assert(isopen());
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<uint64> pages;
+        auto map_page = std::lower_bound(_empty_slots_map_pages.begin(), 
+                                         _empty_slots_map_pages.end(), 
+                                         FIRST_RECORD_PAGE);
+        for (uint64 i = FIRST_RECORD_PAGE; i < numPagesInUse(); ++i) {
+            if (map_page != _empty_slots_map_pages.end() && *map_page == i) {
+                ++map_page;
+                continue;
+            }
+            pages.push_back(i);
         }
+        return pages;
+    }
+
+    // start reading pages in background, pages may be skipped, see DBBuffer::prefetch()
+    // assert file is open
+    void prefetchPages(const std::vector<uint64>& pages) const {
+        assert(isopen());
+        _file->prefetch(pages);
+    }
+
+    // page size of table file
+    // assert file is open
+    uint64 pageSize() const {
+        assert(isopen());
+        return _file->pageSize();
     }
  
 
@@ -623,6 +736,63 @@ public:
         return _index[field_id]->rangeQuery(lb, ub);
     }
 
+    typedef DBBLinkIndex<DBFields::Comparator>::Cursor IndexCursor;
+
+    // get cursor pointing to the first record in index of field_id
+    // assert file is open
+    // assert there's already index for this field
+    IndexCursor firstIndexRecord(const uint64 field_id) const {
+        assert(isopen());
+        assert(_index[field_id]);
+        // INDEX MANIPULATE
+        return _index[field_id]->firstRecord();
+    }
+
+    // get cursor pointing to the last record in index of field_id,
+    // which traverses the index in descending order
+    // assert file is open
+    // assert there's already index for this field
+    IndexCursor lastIndexRecord(const uint64 field_id) const {
+        assert(isopen());
+        assert(_index[field_id]);
+        // INDEX MANIPULATE
+        return _index[field_id]->lastRecord();
+    }
+
+    // traverse at most n records in index of field_id from cursor, in order of cursor
+    // callback function is: func(const char* key, RID)
+    // returns number of records traversed
+    // assert file is open
+    // assert there's already index for this field
+    template <class CALLBACKFUNC>
+    uint64 traverseIndex(IndexCursor& cursor, const uint64 field_id, 
+                         const uint64 n, CALLBACKFUNC func) const {
+        assert(isopen());
+        assert(_index[field_id]);
+        // INDEX MANIPULATE
+        return _index[field_id]->traverseRecords(cursor, n, func);
+    }
+
+
+    // lock this table in mode for current transaction of log, fields whose bits are set
+    // in read are read from records not locked by it, see DBLockManager::lockTable()
+    // returns 0 if granted or locks are not used, 1 if it has to wait for other transactions,
+    // 2 if waiting would deadlock
+    int lock(const uint64 mode, const uint64 read = 0) const {
+        if (!_locks || !_log || !_log->transaction()) return 0;
+        const uint64 txn = _log->transaction();
+        const int rtv = _locks->lockTable(txn, _table_name, mode, read);
+        if (!rtv && mode == DBLockManager::X) _locked_txn = txn;
+        return rtv;
+    }
+
+    // whether index of field field_id can be read by calling thread, see DBBLinkIndex::readable()
+    // assert file is open
+    bool indexReadable(const uint64 field_id) const {
+        assert(isopen());
+        // INDEX MANIPULATE
+        return _index[field_id] && _index[field_id]->readable();
+    }
 
     // check if there's already table opened
     // returns 1 if there is, null string otherwise
@@ -643,10 +813,10 @@ public:
         if (_index[field_id] != nullptr) return 1;
 
         // create index
-        _index[field_id] = new DBIndexManager<DBFields::Comparator>(
+        _index[field_id] = new DBBLinkIndex<DBFields::Comparator>(
             _table_name + "_" + 
             _fields.field_name()[field_id] + 
-            INDEX_SUFFIX);
+            INDEX_SUFFIX, _log, _versions);
         bool rtv = _index[field_id]->create(_file->pageSize(),
                                             _fields.field_length()[field_id],
                                             _fields.field_type()[field_id]);
@@ -723,6 +893,60 @@ public:
     }
 
 private:   
+    // lock record rid for current transaction of log to change fields whose bits are set
+    // in write, unless it has locked this table exclusively
+    // if wait is 0, a record locked by others is not waited for
+    // returns the same as lock()
+    int lockChange(const RID rid, const uint64 write, const bool wait = 1) {
+        if (!_locks || !_log) return 0;
+        const uint64 txn = _log->transaction();
+        if (!txn || txn == _locked_txn) return 0;
+        return _locks->lockRecord(txn, _table_name, rid, write, wait);
+    }
+
+    // lock value key of primary key for current transaction of log, to insert or remove
+    // records with it, unless it has locked this table exclusively
+    // returns the same as lock()
+    int lockKey(const char* key) {
+        if (!_locks || !_log) return 0;
+        const uint64 txn = _log->transaction();
+        if (!txn || txn == _locked_txn) return 0;
+        return _locks->lockKey(txn, _table_name, 
+                               std::string(key, _fields.field_length()[_fields.primary_key_field_id()]));
+    }
+
+    // offset of record in slot slotID of a record page
+    uint64 recordOffset(const uint64 slotID) const {
+        return /* page header offset */
+               PAGE_HEADER_LENGTH + 
+               /* bitmap offset */
+               (_num_records_each_page + 8 * sizeof(uint64) - 1) / (8 * sizeof(uint64)) * sizeof(uint64) + 
+               /* record offset */
+               _record_length * slotID;
+    }
+
+    // mark page pageID in empty slots map, as having empty slots if empty is 1, full otherwise
+    void markEmptySlots(const uint64 pageID, const bool empty) {
+        _empty_slots_map[pageID] = empty;
+        DBBuffer::PageGuard page = _file->fetchPage(_empty_slots_map_pages[pageID / _pages_each_map_page], 1);
+        char* buffer = page.mutableData();
+        const uint64 bit = pageID % _pages_each_map_page;
+        if (empty)
+            buffer[PAGE_HEADER_LENGTH + bit / 8] |= '\x01' << bit % 8;
+        else
+            buffer[PAGE_HEADER_LENGTH + bit / 8] &= ~('\x01' << bit % 8);
+        page.markDirty();
+    }
+
+    // save field id of record rid to be inserted into index later
+    void deferIndexRecord(const uint64 id, const char* data, const RID rid) {
+        _deferred_keys[id].emplace_back();
+        DeferredKey& k = _deferred_keys[id].back();
+        _key_generator(data, _fields.field_type()[id], _fields.field_length()[id], k.key);
+        k.data.assign(data, _fields.field_length()[id]);
+        k.rid = rid;
+    }
+
     // create file description page, 0th page
     void createFileDescriptionPage(const uint64 page_size, char* buffer) const {
         // page size
@@ -869,6 +1093,7 @@ private:
     void parseEmptyMapPages(char* buffer) {
         uint64 page_id = *pointer_convert<const uint64*>(buffer);
         _last_empty_slots_map_page = page_id;
+        _empty_slots_map_pages.push_back(page_id);
         uint64 next_page_id = *pointer_convert<uint64*>(buffer + 2 * sizeof(uint64)); 
             
         // Here, we may add extra bits mapping non-existing pages
@@ -913,35 +1138,44 @@ private:
         }};
     }
 
-    // returns page id in which there's at least one empty slot
+    // returns page id not less than from in which there's at least one empty slot
     // returns 0 if not found
-    uint64 findEmptySlot() const {
-        for (std::size_t i = 0; i < _empty_slots_map.size(); ++i) 
+    uint64 findEmptySlot(const uint64 from = 0) const {
+        for (std::size_t i = from; i < _empty_slots_map.size(); ++i) 
             if (_empty_slots_map[i] == 1) return i;
         return 0;
     }
     
+    // number of pages linked from header pages
+    // pages after them are left by statements undone in recovery, and are reused
+    uint64 numPagesInUse() const {
+        return std::max(_last_record_page, _last_empty_slots_map_page) + 1;
+    }
+
     // create a new record page
+    // pages are created by an action, which is not undone with the transaction creating them
+    // assert _mutex is locked
     uint64 createNewRecordPage() {
-        uint64 newPageID = _file->numPages();
+        const uint64 txn = _log? _log->beginAction(): 0;
+        uint64 newPageID = numPagesInUse();
 
         std::unique_ptr<char[]> buffer(new char[_file->pageSize()]);
-
-        // record pages are double-linked list, need to modify the last page
-        _file->readPage(_last_record_page, buffer.get());
-
-        // page header of the last page
-        auto oldPageHeader = parsePageHeader(buffer.get());
-
-        
-        // modify "Next Page" to new page id
-        auto modifiedPageHeader = makePageHeader(oldPageHeader[0], 
-                                                 oldPageHeader[1],
-                                                 newPageID);
-        // copy to buffer
-        memcpy(buffer.get(), modifiedPageHeader.data(), PAGE_HEADER_LENGTH);
-        // and overwrite
-        _file->writePage(_last_record_page, buffer.get());
+        std::array<uint64, 3> oldPageHeader;
+        {
+            // record pages are double-linked list, need to modify the last page
+            DBBuffer::PageGuard page = _file->fetchPage(_last_record_page, 1);
+            char* data = page.mutableData();
+
+            // page header of the last page
+            oldPageHeader = parsePageHeader(data);
+
+            // modify "Next Page" to new page id
+            auto modifiedPageHeader = makePageHeader(oldPageHeader[0], 
+                                                     oldPageHeader[1],
+                                                     newPageID);
+            memcpy(data, modifiedPageHeader.data(), PAGE_HEADER_LENGTH);
+            page.markDirty();
+        }
         
         // generate new page header
         auto newPageHeader = makePageHeader(newPageID, 
@@ -969,51 +1203,49 @@ private:
         _last_record_page = newPageID;
 
         // write back last record page
-        _file->readPage(1, buffer.get());
-        memcpy(buffer.get() + 5 * sizeof(uint64), 
-               &_last_record_page, 
-               sizeof(_last_record_page));
-        _file->writePage(1, buffer.get());
-
+        {
+            DBBuffer::PageGuard page = _file->fetchPage(1, 1);
+            memcpy(page.mutableData() + 5 * sizeof(uint64), 
+                   &_last_record_page, 
+                   sizeof(_last_record_page));
+            page.markDirty();
+        }
 
-        assert(_file->numPages() == newPageID + 1);
+        assert(_file->numPages() > newPageID);
         
         // this may lead to new map page
         if (_empty_slots_map.size() == newPageID)
             createNewMapPage();
 
         // add the new page to slots map
-        _empty_slots_map[newPageID] = 1;
-
-        // write map page back to file
-        _file->readPage(_last_empty_slots_map_page, buffer.get());
-        buffer[PAGE_HEADER_LENGTH + (newPageID % _pages_each_map_page) / 8] |=
-            '\x01' << (newPageID % _pages_each_map_page) % 8;
-        _file->writePage(_last_empty_slots_map_page, buffer.get());
+        markEmptySlots(newPageID, 1);
 
+        if (_log) _log->endAction(txn);
         return newPageID;
     }
 
     // create new map page
+    // called in the action creating a record page
     void createNewMapPage() {
-        uint64 newPageID = _file->numPages();
+        uint64 newPageID = numPagesInUse();
 
         std::unique_ptr<char[]> buffer(new char[_file->pageSize()]);
-
-        // record pages are double-linked list, need to modify the last page
-        _file->readPage(_last_empty_slots_map_page, buffer.get());
-
-        // page header of the last page
-        auto oldPageHeader = parsePageHeader(buffer.get());
+        std::array<uint64, 3> oldPageHeader;
+        {
+            // map pages are double-linked list, need to modify the last page
+            DBBuffer::PageGuard page = _file->fetchPage(_last_empty_slots_map_page, 1);
+            char* data = page.mutableData();
+
+            // page header of the last page
+            oldPageHeader = parsePageHeader(data);
         
-        // modify "Next Page" to new page id
-        auto modifiedPageHeader = makePageHeader(oldPageHeader[0], 
-                                                 oldPageHeader[1],
-                                                 newPageID);
-        // copy to buffer
-        memcpy(buffer.get(), modifiedPageHeader.data(), PAGE_HEADER_LENGTH);
-        // and overwrite
-        _file->writePage(_last_empty_slots_map_page, buffer.get());
+            // modify "Next Page" to new page id
+            auto modifiedPageHeader = makePageHeader(oldPageHeader[0], 
+                                                     oldPageHeader[1],
+                                                     newPageID);
+            memcpy(data, modifiedPageHeader.data(), PAGE_HEADER_LENGTH);
+            page.markDirty();
+        }
         
         // generate new page header
         auto newPageHeader = makePageHeader(newPageID, 
@@ -1028,16 +1260,18 @@ private:
         // write to file, and modify _last_empty_slots_map_page
         _file->writePage(newPageID, buffer.get());
         _last_empty_slots_map_page = newPageID;;
+        _empty_slots_map_pages.push_back(newPageID);
 
-        assert(_file->numPages() == newPageID + 1);
+        assert(_file->numPages() > newPageID);
 
         // write back _last_map_page
-        _file->readPage(1, buffer.get());
-        memcpy(buffer.get() + 4 * sizeof(uint64), 
-               &_last_empty_slots_map_page, 
-               sizeof(_last_empty_slots_map_page));
-        _file->writePage(1, buffer.get());
-
+        {
+            DBBuffer::PageGuard page = _file->fetchPage(1, 1);
+            memcpy(page.mutableData() + 4 * sizeof(uint64), 
+                   &_last_empty_slots_map_page, 
+                   sizeof(_last_empty_slots_map_page));
+            page.markDirty();
+        }
         
         // add the new page to slots map
         _empty_slots_map.resize(_empty_slots_map.size() + 
@@ -1045,47 +1279,38 @@ private:
     }
     
     // select a slot in page pageID, insert buffer to this slot.
-    // returns RID of this slot
+    // slots locked by other transactions, as those of records they removed, are skipped
+    // returns RID of this slot, RID(0, 0) if there's no slot to insert to
     // returns whether there's still empty slot in this page
     std::tuple<RID, bool> insertRecordtoPage(const uint64 pageID, const char* recordBuffer) {
-        std::unique_ptr<char[]> pageBuffer(new char[_file->pageSize()]);
-        // read target page
-        _file->readPage(pageID, pageBuffer.get());
+        DBBuffer::PageGuard page = _file->fetchPage(pageID, 1);
+        const char* pageBuffer = page.data();
         
         uint64 empty_slot_num = _num_records_each_page;
+        bool empty_slot_remained = 0;
         // scan slots bitmap, find an empty slot
-        for (uint64 i = 0; i < _num_records_each_page; ++i) 
+        for (uint64 i = 0; i < _num_records_each_page; ++i) {
             // slot[i] == 1, it's empty
-            if (pageBuffer[PAGE_HEADER_LENGTH + i / 8] & ('\x01' << i % 8)) {
+            if (!(pageBuffer[PAGE_HEADER_LENGTH + i / 8] & ('\x01' << i % 8))) continue;
+            if (empty_slot_num == _num_records_each_page && 
+                lockChange(RID(pageID, i), DBLockManager::ALL_FIELDS, 0) == 0)
                 empty_slot_num = i;
-                // set this bit as full(0)
-                pageBuffer[PAGE_HEADER_LENGTH + i / 8] &= ~('\x01' << i % 8);
-                break;
-            }
-        
-        // there's still empty slot remained
-        bool empty_slot_remained = 0;
-        for (uint64 i = empty_slot_num; i < _num_records_each_page; ++i)
-            if (pageBuffer[PAGE_HEADER_LENGTH + i / 8] & ('\x01' << i % 8)) {
+            else {
+                // there's still empty slot remained
                 empty_slot_remained = 1;
-                break;
+                if (empty_slot_num != _num_records_each_page) break;
             }
+        }
 
-        assert(empty_slot_num < _num_records_each_page);
+        if (empty_slot_num == _num_records_each_page)
+            return std::make_tuple(RID(0, 0), empty_slot_remained);
 
+        char* data = page.mutableData();
+        // set this bit as full(0)
+        data[PAGE_HEADER_LENGTH + empty_slot_num / 8] &= ~('\x01' << empty_slot_num % 8);
         // write record
-        memcpy(pageBuffer.get() + 
-                   /* page header offset */
-                   PAGE_HEADER_LENGTH + 
-                   /* bitmap offset, bitmap is n bytes aligned */
-                   (_num_records_each_page + 8 * sizeof(uint64) - 1) / (8 * sizeof(uint64)) * sizeof(uint64) + 
-                   /* record offset */
-                   _record_length * empty_slot_num, 
-               recordBuffer,
-               _record_length);
-
-        // write to file
-        _file->writePage(pageID, pageBuffer.get());
+        memcpy(data + recordOffset(empty_slot_num), recordBuffer, _record_length);
+        page.markDirty();
         
         return std::make_tuple(RID(pageID, empty_slot_num), empty_slot_remained);
     }
@@ -1098,9 +1323,16 @@ private:
     DBTableManager& operator=(DBTableManager&&)& = delete;
 
     DBBuffer* _file;
+    DBLog* _log;
+    DBVersions* _versions;
+    DBLockManager* _locks;
+    // transaction which has locked this table exclusively
+    mutable std::atomic<uint64> _locked_txn;
+    // guards empty slots map and creation of pages
+    mutable std::mutex _mutex;
 
     // indexes
-    std::vector< DBIndexManager<DBFields::Comparator>* > _index;
+    std::vector< DBBLinkIndex<DBFields::Comparator>* > _index;
 
     // variables below descript an open table
     // they will be reset when closing the table
@@ -1119,6 +1351,19 @@ private:
     // 1 means there's empty slot in this page
     // 0 means page is full or non-existing
     std::vector<bool> _empty_slots_map;
+    // ids of map pages, in increasing order
+    std::vector<uint64> _empty_slots_map_pages;
+
+    // index records deferred by bulk insert
+    struct DeferredKey {
+        // memcmp-comparable key
+        std::string key;
+        std::string data;
+        RID rid = RID(0, 0);
+    };
+    bool _bulk_insert;
+    std::vector< std::vector<DeferredKey> > _deferred_keys;
+    DBFields::KeyGenerator _key_generator;
 
 };
 
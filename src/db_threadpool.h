@@ -0,0 +1,142 @@
+/******************************************************************************
+ *  Copyright (c) 2014-2015 Jamis Hoo
+ *  Distributed under the MIT license
+ *  (See accompanying file LICENSE or copy at http://opensource.org/licenses/MIT)
+ *
+ *  Project: Database
+ *  Filename: db_threadpool.h
+ *  Version: 1.0
+ *  Author: Jamis Hoo
+ *  E-mail: hjm211324@gmail.com
+ *  Description: Pool of worker threads.
+ *               A job is split into tasks numbered from 0,
+ *               which are taken by workers and the calling thread.
+ *****************************************************************************/
+#ifndef DB_THREADPOOL_H_
+#define DB_THREADPOOL_H_
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "db_common.h"
+
+class Database::DBThreadPool {
+public:
+    // num_threads includes the calling thread,
+    // so num_threads - 1 workers are created
+    DBThreadPool(const uint64 num_threads):
+        _num_tasks(0), _next_task(0), _unfinished(0),
+        _generation(0), _active(0), _stop(0) {
+        assert(num_threads);
+        for (uint64 i = 1; i < num_threads; ++i)
+            _threads.emplace_back([this]() { work(); });
+    }
+
+    ~DBThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = 1;
+        }
+        _wakeup.notify_all();
+        for (auto& thread: _threads) thread.join();
+    }
+
+    DBThreadPool(const DBThreadPool&) = delete;
+    DBThreadPool& operator=(const DBThreadPool&) = delete;
+
+    // number of threads running tasks, including the calling thread
+    uint64 size() const { return _threads.size() + 1; }
+
+    // run func(i) for i in [0, n), returns after all tasks finish
+    // if any task throws, the first exception is rethrown after all tasks finish
+    // must not be called in tasks
+    void run(const uint64 n, std::function<void(uint64)> func) {
+        if (!n) return;
+        {
+            // a worker woken up late may still be looking for tasks of last job
+            std::unique_lock<std::mutex> lock(_mutex);
+            _done.wait(lock, [this]() { return !_active; });
+            _task = std::move(func);
+            _num_tasks = n;
+            _next_task = 0;
+            _unfinished = n;
+            _exception = nullptr;
+            ++_generation;
+        }
+        _wakeup.notify_all();
+
+        runTasks();
+
+        // wait until all tasks finish and no worker is still taking tasks
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this]() { return !_unfinished && !_active; });
+        _task = nullptr;
+        if (_exception) std::rethrow_exception(_exception);
+    }
+
+private:
+    void work() {
+        uint64 generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wakeup.wait(lock, [this, generation]() { return _stop || _generation != generation; });
+                if (_stop) return;
+                generation = _generation;
+                ++_active;
+            }
+
+            runTasks();
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                --_active;
+            }
+            _done.notify_all();
+        }
+    }
+
+    // take tasks until there's none
+    void runTasks() {
+        while (true) {
+            uint64 i = _next_task++;
+            if (i >= _num_tasks) return;
+            try {
+                _task(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_exception) _exception = std::current_exception();
+            }
+            if (--_unfinished == 0) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _done.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> _threads;
+
+    // current job
+    std::function<void(uint64)> _task;
+    uint64 _num_tasks;
+    std::atomic<uint64> _next_task;
+    std::atomic<uint64> _unfinished;
+    std::exception_ptr _exception;
+
+    // increased when a job is submitted
+    uint64 _generation;
+    // number of workers taking tasks of current job
+    uint64 _active;
+    bool _stop;
+
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+    std::condition_variable _done;
+};
+
+#endif /* DB_THREADPOOL_H_ */
@@ -0,0 +1,194 @@
+/******************************************************************************
+ *  Copyright (c) 2014-2015 Jamis Hoo
+ *  Distributed under the MIT license
+ *  (See accompanying file LICENSE or copy at http://opensource.org/licenses/MIT)
+ *
+ *  Project: Database
+ *  Filename: db_versions.h
+ *  Version: 1.0
+ *  Author: Jamis Hoo
+ *  E-mail: hjm211324@gmail.com
+ *  Description: Old versions of pages of a database, kept for snapshot reads.
+ *               A snapshot sees pages as they were when it began.
+ *               Before a page is changed for the first time after a snapshot began,
+ *               buffer saves a copy of it here, which the snapshot reads instead,
+ *               so readers of snapshots and writers never wait for each other.
+ *               Copies no snapshot can read are dropped when snapshots end.
+ *               A snapshot begun while transactions go on undoes their changes
+ *               in its own copies of pages they changed, so it sees them as last committed.
+ *               Files whose changes can't be undone so, as indexes changed by key,
+ *               are not read by it.
+ *****************************************************************************/
+#ifndef DB_VERSIONS_H_
+#define DB_VERSIONS_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+#include "db_common.h"
+
+// changes are numbered by epochs, a snapshot sees all changes of epochs not after its own,
+// and beginning a snapshot starts a new epoch.
+// a copy saved in epoch e is the page before its first change of epoch e,
+// which is read by snapshots of epochs before e but not before the previous copy
+class Database::DBVersions {
+public:
+    // changes not committed when a snapshot began
+    struct Uncommitted {
+        // owner and page ID -> undo of changes of the page, applied to a copy
+        std::map< std::pair<const void*, uint64>, std::function<void(char*)> > pages;
+        // owners whose changes can't be undone in copies, which the snapshot doesn't read
+        std::set<const void*> owners;
+    };
+
+    // a snapshot read by the thread creating it, until destruction
+    // a thread reads one snapshot at a time
+    class Snapshot {
+    public:
+        Snapshot(DBVersions& versions, Uncommitted uncommitted = Uncommitted()): 
+            _versions(versions), _epoch(versions.begin()), _uncommitted(std::move(uncommitted)) {
+            assert(!current());
+            current() = this;
+        }
+        ~Snapshot() {
+            current() = nullptr;
+            _versions.end(_epoch);
+        }
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+    private:
+        friend class DBVersions;
+        // snapshot of calling thread, nullptr if none
+        static const Snapshot*& current() {
+            static thread_local const Snapshot* snapshot = nullptr;
+            return snapshot;
+        }
+
+        DBVersions& _versions;
+        const uint64 _epoch;
+        const Uncommitted _uncommitted;
+        // owner and page ID -> page as last committed, made when first read
+        mutable std::map< std::pair<const void*, uint64>, std::unique_ptr<char[]> > _committed;
+    };
+
+    DBVersions(): _epoch(1), _num_snapshots(0) { }
+
+    DBVersions(const DBVersions&) = delete;
+    DBVersions& operator=(const DBVersions&) = delete;
+
+    // whether calling thread reads a snapshot of these versions
+    bool inSnapshot() const {
+        const Snapshot* snapshot = Snapshot::current();
+        return snapshot && &snapshot->_versions == this;
+    }
+
+    // whether owner can be read by snapshot of calling thread, if any
+    bool readable(const void* owner) const {
+        if (!inSnapshot()) return 1;
+        return !Snapshot::current()->_uncommitted.owners.count(owner);
+    }
+
+    // save page of owner, which is going to be changed, if a snapshot may read it
+    // page must be latched exclusively, and not changed since latched
+    void save(const void* owner, const uint64 pageid, const char* data, const uint64 page_size) {
+        if (!_num_snapshots) return;
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_snapshots.empty()) return;
+        std::vector<Version>& versions = _pages[std::make_pair(owner, pageid)];
+        // snapshots all begin before the last copy, or it's saved in this epoch
+        if (!versions.empty() && *_snapshots.rbegin() < versions.back().epoch) return;
+        Version version{ _epoch, std::unique_ptr<char[]>(new char[page_size]) };
+        memcpy(version.data.get(), data, page_size);
+        versions.push_back(std::move(version));
+    }
+
+    // page of owner as seen by snapshot of calling thread, whose data is the page now
+    // nullptr if it's not read with a snapshot of these versions, or not changed since
+    // copy is valid until the snapshot ends
+    // page must be latched, shared or exclusively
+    const char* find(const void* owner, const uint64 pageid, const char* data, const uint64 page_size) const {
+        if (!inSnapshot()) return nullptr;
+        const Snapshot& snapshot = *Snapshot::current();
+        const char* version = find(snapshot._epoch, owner, pageid);
+        const auto page = std::make_pair(owner, pageid);
+        auto undo = snapshot._uncommitted.pages.find(page);
+        if (undo == snapshot._uncommitted.pages.end()) return version;
+        std::unique_ptr<char[]>& committed = snapshot._committed[page];
+        if (!committed) {
+            committed.reset(new char[page_size]);
+            memcpy(committed.get(), version? version: data, page_size);
+            undo->second(committed.get());
+        }
+        return committed.get();
+    }
+
+private:
+    struct Version {
+        uint64 epoch;
+        std::unique_ptr<char[]> data;
+    };
+
+    // copy of page of owner read by snapshot of epoch, nullptr if not changed since
+    const char* find(const uint64 epoch, const void* owner, const uint64 pageid) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto ite = _pages.find(std::make_pair(owner, pageid));
+        if (ite == _pages.end()) return nullptr;
+        // the first copy saved after snapshot began
+        for (const auto& version: ite->second)
+            if (version.epoch > epoch) return version.data.get();
+        return nullptr;
+    }
+
+    // returns epoch of the new snapshot
+    uint64 begin() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const uint64 epoch = _epoch++;
+        _snapshots.insert(epoch);
+        ++_num_snapshots;
+        return epoch;
+    }
+
+    void end(const uint64 epoch) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const uint64 oldest = *_snapshots.begin();
+        _snapshots.erase(_snapshots.find(epoch));
+        --_num_snapshots;
+        if (_snapshots.empty()) {
+            _pages.clear();
+            return;
+        }
+        if (*_snapshots.begin() == oldest) return;
+        // copies saved before the oldest snapshot began are read by none
+        const uint64 min_epoch = *_snapshots.begin();
+        for (auto ite = _pages.begin(); ite != _pages.end(); ) {
+            std::vector<Version>& versions = ite->second;
+            auto end = versions.begin();
+            while (end != versions.end() && end->epoch <= min_epoch) ++end;
+            versions.erase(versions.begin(), end);
+            if (versions.empty())
+                ite = _pages.erase(ite);
+            else
+                ++ite;
+        }
+    }
+
+    mutable std::mutex _mutex;
+    // epoch of changes made now
+    uint64 _epoch;
+    // epochs of snapshots not ended
+    std::multiset<uint64> _snapshots;
+    // size of _snapshots, checked without mutex before each change
+    std::atomic<uint64> _num_snapshots;
+    // owner and page ID -> copies in order of epoch
+    std::map< std::pair<const void*, uint64>, std::vector<Version> > _pages;
+};
+
+#endif /* DB_VERSIONS_H_ */
@@ -13,26 +13,80 @@
  *  Description: main function of total project.
  *               read in sql statements and pass them to query parser.
  *****************************************************************************/
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <string>
+#include <unistd.h>
 #include "../src/db_query.h"
 #include "../src/db_interface.h"
+#include "../src/db_server.h"
 
 int main(int argc, char** argv) {
     using namespace Database;
 
-    // argc == 1, stdin
-    // argc == 2, read from file
-    if (argc > 2) return 1;
-    
+    // size of block read from file at once
+    constexpr uint64 BLOCK_SIZE = 1 << 20;
+
+    // oursql [--format <csv | tsv | binary | text>] [--threads <number>]
+    //        [--listen <port | socket path> [--sessions <number>] [--files <directory>]] [file]
+    // without file, read from stdin
+    // with --listen, serve clients after file is executed,
+    // who read and write files only in directory given by --files, or none without it
+    // statements of file or stdin which isn't a terminal are committed together,
+    // see DBQuery::flushCommits(), so one's durable only when those after it are
     DBQuery query;
     DBInterface ui;
 
+    const char* file = nullptr;
+    const char* listen = nullptr;
+    const char* files = "";
+    uint64 num_sessions = DBServer::DEFAULT_THREADS;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--format") {
+            if (i + 1 == argc || query.setOutputFormat(argv[++i])) {
+                std::clog << "Unknown output format. " << std::endl;
+                return 1;
+            }
+        } else if (std::string(argv[i]) == "--threads") {
+            uint64 num_threads = i + 1 == argc? 0: std::strtoull(argv[++i], nullptr, 10);
+            if (!num_threads) {
+                std::clog << "Invalid number of threads. " << std::endl;
+                return 1;
+            }
+            query.setThreads(num_threads);
+        } else if (std::string(argv[i]) == "--listen") {
+            if (i + 1 == argc) {
+                std::clog << "Missing address to listen on. " << std::endl;
+                return 1;
+            }
+            listen = argv[++i];
+        } else if (std::string(argv[i]) == "--files") {
+            if (i + 1 == argc) {
+                std::clog << "Missing directory of files. " << std::endl;
+                return 1;
+            }
+            files = argv[++i];
+        } else if (std::string(argv[i]) == "--sessions") {
+            num_sessions = i + 1 == argc? 0: std::strtoull(argv[++i], nullptr, 10);
+            if (!num_sessions) {
+                std::clog << "Invalid number of sessions. " << std::endl;
+                return 1;
+            }
+        } else if (!file) {
+            file = argv[i];
+        } else return 1;
+    }
+    bool interactive = !file && !listen;
+    // each line typed is durable before the next prompt
+    bool terminal = interactive && ::isatty(STDIN_FILENO);
+
     std::ifstream fin;
     // open file
-    if (argc == 2)
-        fin.open(argv[1]);
-    else {
+    if (file)
+        fin.open(file, std::fstream::in | std::fstream::binary);
+    else if (interactive) {
         std::clog << "Welcome to OurSQL(Version 1.0) monitor. " << std::endl;
         std::clog << std::endl;
         std::clog << "Commands end with ;. Press Ctrl + D to exit. " << std::endl;
@@ -44,20 +98,35 @@ int main(int argc, char** argv) {
     }
     
     std::string str;
-    while (true) {
-        // if stdin mode, output prompt
-        if (argc == 1) 
+    std::unique_ptr<char[]> block(new char[BLOCK_SIZE]);
+    boost::string_ref statement;
+    while (interactive || file) {
+        if (interactive) {
+            // output prompt
             std::clog << (ui.emptyBuff()? "oursql> ": "      > ") << std::flush;
 
-        // read a line
-        if (!std::getline(argc == 1? std::cin: fin, str)) break;
-
-        ui.feed(str + '\n');
+            // read a line
+            if (!std::getline(std::cin, str)) break;
+            str += '\n';
+            ui.feed(str);
+        } else {
+            // read a block
+            fin.read(block.get(), BLOCK_SIZE);
+            if (!fin.gcount()) break;
+            ui.feed(block.get(), fin.gcount());
+        }
 
         // fetch commands and execute
-        while (ui.ready()) query.execute(ui.get());
+        while (ui.next(statement)) query.execute(statement);
+        if (terminal) query.flushCommits();
+    }
+    query.flushCommits();
+    if (interactive) std::clog << "Bye! " << std::endl;
+
+    if (listen) {
+        DBServer server(query, num_sessions, files);
+        return server.run(listen);
     }
-    if (argc == 1) std::clog << "Bye! " << std::endl;
     
     return 0; 
 } 
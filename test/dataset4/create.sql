@@ -0,0 +1,24 @@
+# scripts are run in order: create, insert, limit, outfile, load, prepare, transaction, drop
+
+CREATE DATABASE test4;
+
+USE test4;
+
+CREATE TABLE table_1 (field_1 INT SIGNED NOT NULL,
+                      field_2 VARCHAR(20),
+                      field_3 INT,
+                      field_4 FLOAT,
+                      PRIMARY KEY(field_1)
+                     );
+
+# field_3 is indexed, field_4 is not
+CREATE INDEX ON table_1(field_3);
+
+CREATE TABLE table_2 (field_1 INT SIGNED NOT NULL,
+                      field_2 VARCHAR(20),
+                      PRIMARY KEY(field_1),
+                      CHECK (field_1 >= 0)
+                     );
+
+DESC table_1;
+DESC table_2;
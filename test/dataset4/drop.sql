@@ -0,0 +1,4 @@
+USE test4;
+DROP TABLE table_2;
+DROP TABLE table_1;
+DROP DATABASE test4;
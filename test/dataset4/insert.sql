@@ -0,0 +1,17 @@
+USE test4;
+
+INSERT INTO table_1 VALUES
+(1, 'VARCHAR01', 30, 1.5),
+(2, 'VARCHAR02', 10, 9.25),
+(3, 'VARCHAR03', 50, -2.5),
+(4, 'VARCHAR04', 20, 7.75),
+(5, 'VARCHAR05', 40, 0.5),
+(6, 'VARCHAR06', NULL, 3.125),
+(7, 'VARCHAR07', 70, NULL),
+(8, 'VARCHAR08', 60, 11),
+(9, 'VARCHAR09', 90, -8.5),
+(10, 'VARCHAR10', 80, 4.25);
+
+INSERT INTO table_2 VALUES
+(1, 'first'),
+(2, 'second');
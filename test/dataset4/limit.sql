@@ -0,0 +1,33 @@
+USE test4;
+
+# indexed, by primary key
+SELECT * FROM table_1 ORDER BY field_1 ASC LIMIT 3;
+SELECT * FROM table_1 ORDER BY field_1 DESC LIMIT 3;
+SELECT * FROM table_1 ORDER BY field_1 LIMIT 3 OFFSET 4;
+
+# indexed, NULL is the greatest
+SELECT field_1, field_3 FROM table_1 ORDER BY field_3 ASC LIMIT 4;
+SELECT field_1, field_3 FROM table_1 ORDER BY field_3 DESC LIMIT 2 OFFSET 1;
+
+# indexed, with a condition on the field ordered by
+SELECT field_1, field_3 FROM table_1 WHERE field_3 > 25 ORDER BY field_3 ASC LIMIT 2;
+
+# not indexed, sorted keeping the first rows only
+SELECT field_1, field_4 FROM table_1 ORDER BY field_4 ASC LIMIT 3;
+SELECT field_1, field_4 FROM table_1 ORDER BY field_4 DESC LIMIT 3 OFFSET 2;
+SELECT field_1, field_4 FROM table_1 WHERE field_4 < 5 ORDER BY field_4 DESC LIMIT 2;
+
+# without order, which rows are returned is undefined
+SELECT COUNT(*) FROM table_1 LIMIT 1;
+
+# nothing is returned
+SELECT * FROM table_1 ORDER BY field_3 LIMIT 0;
+SELECT * FROM table_1 ORDER BY field_4 LIMIT 5 OFFSET 10;
+
+# complex select
+SELECT table_1.field_1, table_2.field_2 FROM table_1, table_2
+WHERE table_1.field_1 = table_2.field_1
+ORDER BY table_1.field_1 DESC LIMIT 1;
+
+# fail, negative count
+SELECT * FROM table_1 ORDER BY field_1 LIMIT -1;
@@ -0,0 +1,26 @@
+# run in this directory, paths are relative to it
+USE test4;
+
+LOAD DATA INFILE 'load.csv' INTO TABLE table_2;
+LOAD DATA INFILE 'load.tsv' INTO TABLE table_2 FORMAT TSV;
+
+SELECT * FROM table_2 ORDER BY field_1;
+
+# fail, records loaded before the malformed one are removed
+# quote not closed
+LOAD DATA INFILE 'malformed_quote.csv' INTO TABLE table_2 FORMAT CSV;
+# text after closing quote
+LOAD DATA INFILE 'malformed_text.csv' INTO TABLE table_2;
+# too few fields
+LOAD DATA INFILE 'malformed_size.csv' INTO TABLE table_2;
+# not an integer
+LOAD DATA INFILE 'malformed_value.tsv' INTO TABLE table_2 FORMAT TSV;
+# against check constraint
+LOAD DATA INFILE 'malformed_check.csv' INTO TABLE table_2;
+# duplicate primary key
+LOAD DATA INFILE 'malformed_key.csv' INTO TABLE table_2;
+
+# fail, file not exists
+LOAD DATA INFILE 'not_exists.csv' INTO TABLE table_2;
+
+SELECT COUNT(*) FROM table_2;
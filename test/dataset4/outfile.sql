@@ -0,0 +1,18 @@
+USE test4;
+
+# fields are separated by ',', NULL is empty
+SELECT * FROM table_1 ORDER BY field_1 LIMIT 4 INTO OUTFILE 'table_1.csv' FORMAT CSV;
+
+# fields are separated by tabs
+SELECT field_1, field_2, field_3 FROM table_1 WHERE field_3 > 50 INTO OUTFILE 'table_1.tsv' FORMAT TSV;
+
+# records in raw data, as stored in table file
+SELECT * FROM table_1 ORDER BY field_4 DESC LIMIT 3 INTO OUTFILE 'table_1.bin' FORMAT BINARY;
+
+# CSV by default
+SELECT table_1.field_1, table_2.field_2 FROM table_1, table_2
+WHERE table_1.field_1 = table_2.field_1
+INTO OUTFILE 'table_2.csv';
+
+# fail, unknown format
+SELECT * FROM table_1 INTO OUTFILE 'table_1.xml' FORMAT XML;
@@ -0,0 +1,49 @@
+USE test4;
+
+PREPARE insert_1 AS INSERT INTO table_1 VALUES (?, ?, ?, 0.25);
+EXECUTE insert_1 USING 11, 'VARCHAR11', 15;
+EXECUTE insert_1 USING 12, NULL, NULL;
+
+PREPARE select_1 AS SELECT field_1, field_2, field_3 FROM table_1
+WHERE field_3 > ? ORDER BY field_3 DESC LIMIT 2;
+EXECUTE select_1 USING 0;
+EXECUTE select_1 USING 75;
+
+PREPARE update_1 AS UPDATE table_1 SET field_2 = ? WHERE field_1 = ?;
+EXECUTE update_1 USING 'changed', 12;
+
+SELECT * FROM table_1 WHERE field_1 > 10;
+
+PREPARE delete_1 AS DELETE FROM table_1 WHERE field_1 > ?;
+EXECUTE delete_1 USING 10;
+
+# a statement without placeholders
+PREPARE count_1 AS SELECT COUNT(*) FROM table_1;
+EXECUTE count_1;
+
+# fail, too few values
+EXECUTE insert_1 USING 13, 'VARCHAR13';
+# fail, too many values
+EXECUTE select_1 USING 10, 20;
+# fail, value can't be parsed as the field
+EXECUTE insert_1 USING 13, 'VARCHAR13', 'thirteen';
+# fail, placeholder of a table name
+PREPARE select_2 AS SELECT * FROM ?;
+# fail, statement can't be prepared
+PREPARE create_1 AS CREATE TABLE table_3 (field_1 INT);
+# fail, statement not prepared
+EXECUTE insert_2 USING 13, 'VARCHAR13', 13;
+
+# prepared again, replacing the old one
+PREPARE count_1 AS SELECT COUNT(*) FROM table_2;
+EXECUTE count_1;
+
+DEALLOCATE PREPARE insert_1;
+DEALLOCATE select_1;
+DEALLOCATE update_1;
+DEALLOCATE delete_1;
+DEALLOCATE count_1;
+
+# fail, deallocated
+EXECUTE insert_1 USING 13, 'VARCHAR13', 13;
+DEALLOCATE insert_1;
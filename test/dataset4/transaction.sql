@@ -0,0 +1,50 @@
+USE test4;
+
+# committed
+BEGIN;
+INSERT INTO table_2 VALUES (100, 'committed');
+UPDATE table_2 SET field_2 = 'updated' WHERE field_1 = 1;
+COMMIT;
+
+# rolled back, records, indexes and free slots are as before
+START TRANSACTION;
+INSERT INTO table_2 VALUES (101, 'rolled back');
+DELETE FROM table_2 WHERE field_1 = 2;
+UPDATE table_2 SET field_2 = 'rolled back' WHERE field_1 = 100;
+SELECT * FROM table_2 WHERE field_1 >= 100;
+ROLLBACK;
+
+SELECT * FROM table_2 WHERE field_1 = 1;
+SELECT * FROM table_2 WHERE field_1 >= 100;
+SELECT * FROM table_2 WHERE field_1 = 2;
+
+# a failed statement is undone, the transaction goes on
+BEGIN WORK;
+INSERT INTO table_2 VALUES (102, 'undone'), (1, 'duplicate');
+INSERT INTO table_2 VALUES (103, 'kept');
+COMMIT WORK;
+
+SELECT * FROM table_2 WHERE field_1 >= 100;
+
+# BEGIN in a transaction commits it first
+BEGIN;
+DELETE FROM table_2 WHERE field_1 = 103;
+BEGIN;
+INSERT INTO table_2 VALUES (104, 'rolled back');
+ROLLBACK WORK;
+
+SELECT * FROM table_2 WHERE field_1 >= 100;
+
+# do nothing out of a transaction
+COMMIT;
+ROLLBACK;
+
+# fail, not allowed in a transaction
+BEGIN;
+CREATE TABLE table_3 (field_1 INT);
+DROP TABLE table_2;
+USE test4;
+ROLLBACK;
+
+SHOW TABLES;
+SELECT COUNT(*) FROM table_2;